@@ -0,0 +1,109 @@
+/*
+ * Himiko Discord Bot (C Edition) - Anti-Spam Contention Benchmark
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Many threads push message updates into the pressure table, the part of
+ * antispam_check that holds a lock. One stripe is the old single global
+ * mutex; throughput with PRESSURE_TABLE_STRIPES should keep climbing
+ * with the thread count.
+ */
+
+#include "pressure_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define UPDATES_PER_THREAD 1000000
+#define GUILDS 200
+#define USERS_PER_GUILD 500
+#define MAX_THREADS 32
+
+typedef struct {
+    pressure_table_t *table;
+    unsigned int seed;
+    pthread_barrier_t *start;
+} worker_arg_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Same shape as the module's update: decay, add, near-repeat check */
+static double apply(user_pressure_t *user, void *ctx) {
+    uint64_t hash = *(const uint64_t *)ctx;
+    if (user->pressure > 0) user->pressure *= 0.99;
+    user->pressure += 1.0;
+    for (int i = 0; i < PRESSURE_TABLE_HISTORY; i++) {
+        if (user->recent[i] && __builtin_popcountll(user->recent[i] ^ hash) <= 8) {
+            user->pressure += 5.0;
+            break;
+        }
+    }
+    user->recent[user->recent_next++ % PRESSURE_TABLE_HISTORY] = hash;
+    return user->pressure;
+}
+
+static void *worker(void *p) {
+    worker_arg_t *arg = p;
+    unsigned int rng = arg->seed;
+    double sink = 0;
+
+    pthread_barrier_wait(arg->start);
+    for (int i = 0; i < UPDATES_PER_THREAD; i++) {
+        rng = rng * 1103515245u + 12345u;
+        uint64_t guild = 1 + (rng >> 8) % GUILDS;
+        rng = rng * 1103515245u + 12345u;
+        uint64_t user = 1 + (rng >> 8) % USERS_PER_GUILD;
+        uint64_t hash = 1 + (rng & 7);
+        sink += pressure_table_update(arg->table, guild, user, apply, &hash);
+    }
+    return sink > 0 ? NULL : arg;
+}
+
+static double run(int stripes, int threads) {
+    pressure_table_t *table = pressure_table_create(stripes, GUILDS * USERS_PER_GUILD, 64u << 20);
+    if (!table) {
+        fprintf(stderr, "table allocation failed\n");
+        exit(1);
+    }
+
+    pthread_t tids[MAX_THREADS];
+    worker_arg_t args[MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)threads + 1);
+
+    for (int i = 0; i < threads; i++) {
+        args[i].table = table;
+        args[i].seed = 12345u + (unsigned)i * 7919u;
+        args[i].start = &start;
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+    }
+
+    pthread_barrier_wait(&start);
+    double begin = now_ns();
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_ns() - begin;
+
+    pthread_barrier_destroy(&start);
+    pressure_table_destroy(table);
+    return (double)threads * UPDATES_PER_THREAD / (elapsed / 1e9);
+}
+
+int main(void) {
+    static const int thread_counts[] = { 1, 2, 4, 8, 16, 32 };
+
+    printf("%8s %16s %16s\n", "threads", "1 stripe Mop/s", "striped Mop/s");
+
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        int threads = thread_counts[t];
+        double single = run(1, threads);
+        double striped = run(PRESSURE_TABLE_STRIPES, threads);
+        printf("%8d %16.2f %16.2f\n", threads, single / 1e6, striped / 1e6);
+    }
+    return 0;
+}
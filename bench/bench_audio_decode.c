@@ -0,0 +1,100 @@
+/*
+ * Himiko Discord Bot (C Edition) - Audio Decoder Benchmark
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Time to first 20 ms frame and CPU per second of decoded audio for the
+ * in-process libav backend against the ffmpeg subprocess, on the same
+ * input. Decoding is unpaced, so the CPU figure is what one real-time
+ * stream costs; the subprocess is charged its child CPU after it exits.
+ *
+ * Usage: bench_audio_decode <file-or-url> [runs] [max-seconds]
+ */
+
+#include "audio/audio_decoder.h"
+#include "audio/audio_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static double cpu_ms(void) {
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    double ms = 0;
+    ms += (double)(self.ru_utime.tv_sec + children.ru_utime.tv_sec) * 1e3;
+    ms += (double)(self.ru_stime.tv_sec + children.ru_stime.tv_sec) * 1e3;
+    ms += (double)(self.ru_utime.tv_usec + children.ru_utime.tv_usec) / 1e3;
+    ms += (double)(self.ru_stime.tv_usec + children.ru_stime.tv_usec) / 1e3;
+    return ms;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_backend(audio_decoder_backend_t backend, const char *url, int runs, int max_frames) {
+    int16_t pcm[AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS];
+    double *first = calloc((size_t)runs, sizeof(double));
+    double cpu_per_sec = 0, audio_secs = 0;
+    int ok = 0;
+
+    for (int r = 0; r < runs; r++) {
+        double cpu0 = cpu_ms();
+        double t0 = now_ms();
+        audio_decoder_t *d = audio_decoder_open(url, backend);
+        if (!d) break;
+
+        long samples = 0;
+        int frames = 0, n;
+        while (frames < max_frames && (n = audio_decoder_read(d, pcm, AUDIO_FRAME_SAMPLES)) > 0) {
+            if (frames == 0) first[ok] = now_ms() - t0;
+            samples += n;
+            frames++;
+        }
+        audio_decoder_close(d);
+        if (frames == 0) break;
+
+        double secs = (double)samples / AUDIO_SAMPLE_RATE;
+        cpu_per_sec += (cpu_ms() - cpu0) / secs;
+        audio_secs = secs;
+        ok++;
+    }
+
+    if (ok == 0) {
+        printf("%-8s  unavailable or failed to decode\n", audio_decoder_backend_name(backend));
+        free(first);
+        return;
+    }
+
+    qsort(first, (size_t)ok, sizeof(double), cmp_double);
+    cpu_per_sec /= ok;
+    printf("%-8s  first frame %8.1f ms (median of %d)   cpu %7.2f ms per audio second (%5.2f%% of a core per stream, %.1fs decoded)\n",
+           audio_decoder_backend_name(backend), first[ok / 2], ok, cpu_per_sec, cpu_per_sec / 10.0, audio_secs);
+    free(first);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file-or-url> [runs] [max-seconds]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    int max_secs = argc > 3 ? atoi(argv[3]) : 120;
+    if (runs < 1) runs = 1;
+    if (max_secs < 1) max_secs = 1;
+
+    int max_frames = max_secs * 1000 / AUDIO_FRAME_MS;
+    printf("Decoding %s, %d runs, up to %d s each\n", argv[1], runs, max_secs);
+    run_backend(AUDIO_DECODER_LIBAV, argv[1], runs, max_frames);
+    run_backend(AUDIO_DECODER_FFMPEG, argv[1], runs, max_frames);
+    return 0;
+}
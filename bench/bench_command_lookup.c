@@ -0,0 +1,86 @@
+/*
+ * Himiko Discord Bot (C Edition) - Command Lookup Benchmark
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Compares the old linear strcmp scan against the command index
+ * for growing command counts. Index cost should stay flat.
+ */
+
+#include "command_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOOKUPS 2000000
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int linear_find(char **names, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+int main(void) {
+    static const int sizes[] = { 16, 64, 128, 256, 500, 1024, 4096 };
+    volatile int sink = 0;
+
+    printf("%8s %14s %14s\n", "commands", "linear ns/op", "index ns/op");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int count = sizes[s];
+        char **names = calloc(count, sizeof(char *));
+        command_index_t idx;
+        command_index_init(&idx);
+
+        for (int i = 0; i < count; i++) {
+            names[i] = malloc(32);
+            snprintf(names[i], 32, "command%d", i);
+            command_index_add(&idx, names[i], i);
+        }
+        if (command_index_build(&idx) != 0) {
+            fprintf(stderr, "build failed for %d commands\n", count);
+            return 1;
+        }
+
+        /* Verify before timing */
+        for (int i = 0; i < count; i++) {
+            if (command_index_find(&idx, names[i]) != i) {
+                fprintf(stderr, "lookup mismatch for %s\n", names[i]);
+                return 1;
+            }
+        }
+
+        unsigned int rng = 12345;
+        double start = now_ns();
+        for (int i = 0; i < LOOKUPS; i++) {
+            rng = rng * 1103515245u + 12345u;
+            sink += linear_find(names, count, names[(rng >> 8) % count]);
+        }
+        double linear = (now_ns() - start) / LOOKUPS;
+
+        rng = 12345;
+        start = now_ns();
+        for (int i = 0; i < LOOKUPS; i++) {
+            rng = rng * 1103515245u + 12345u;
+            sink += command_index_find(&idx, names[(rng >> 8) % count]);
+        }
+        double indexed = (now_ns() - start) / LOOKUPS;
+
+        printf("%8d %14.1f %14.1f\n", count, linear, indexed);
+
+        command_index_free(&idx);
+        for (int i = 0; i < count; i++) free(names[i]);
+        free(names);
+    }
+
+    (void)sink;
+    return 0;
+}
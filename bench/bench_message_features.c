@@ -0,0 +1,125 @@
+/*
+ * Himiko Discord Bot (C Edition) - Message Feature Scan Benchmark
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Throughput of the old per-feature passes (one strstr/strchr loop per
+ * count, as antispam and spam_filter each did) against the single scalar
+ * pass and the vector scan, over short chat lines and long pastes.
+ */
+
+#include "message_features.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TARGET_BYTES (256u << 20)
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int old_urls(const char *p) {
+    int count = 0;
+    while ((p = strstr(p, "http")) != NULL) {
+        if (strncmp(p, "http://", 7) == 0 || strncmp(p, "https://", 8) == 0) count++;
+        p++;
+    }
+    return count;
+}
+
+static int old_emojis(const char *content) {
+    int count = 0;
+    const char *p = content;
+    while ((p = strchr(p, '<')) != NULL) {
+        if ((p[1] == ':' || (p[1] == 'a' && p[2] == ':')) && strchr(p, '>')) count++;
+        p++;
+    }
+    for (p = content; *p; p++) {
+        if ((unsigned char)p[0] == 0xF0 && (unsigned char)p[1] == 0x9F) count++;
+    }
+    return count;
+}
+
+static int old_lines(const char *p) {
+    int count = 0;
+    for (; *p; p++) count += *p == '\n';
+    return count;
+}
+
+/* Both modules used to run their own passes over the same content */
+static void old_scan(const char *text, message_features_t *f) {
+    memset(f, 0, sizeof(*f));
+    f->urls = old_urls(text);
+    f->lines = old_lines(text);
+    f->length = strlen(text);
+    f->urls += old_urls(text);
+    f->custom_emojis = old_emojis(text);
+}
+
+static char *make_corpus(size_t len, unsigned int seed) {
+    static const char *words[] = {
+        "the ", "spam ", "filter ", "hello ", "anyone ", "around ", "lol ", "ok ",
+        "https://example.com/a ", "<:pog:123456789> ", "\xF0\x9F\x98\x80 ", "<@123456789> ",
+        "\n", "discord.gg/abc ", "time: 12:30 ", "and/or ",
+    };
+    char *text = malloc(len + 1);
+    size_t n = 0;
+    while (n < len) {
+        seed = seed * 1103515245u + 12345u;
+        const char *w = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        size_t wl = strlen(w);
+        if (n + wl > len) break;
+        memcpy(text + n, w, wl);
+        n += wl;
+    }
+    text[n] = '\0';
+    return text;
+}
+
+typedef void (*scan_fn)(const char *, message_features_t *);
+
+static double throughput(scan_fn fn, const char *text, size_t len) {
+    size_t iterations = TARGET_BYTES / (len ? len : 1) + 1;
+    volatile size_t sink = 0;
+    message_features_t f;
+
+    double begin = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        fn(text, &f);
+        sink += f.length + (size_t)f.urls;
+    }
+    double elapsed = now_ns() - begin;
+    (void)sink;
+    return (double)iterations * (double)len / (elapsed / 1e9) / (1024.0 * 1024.0);
+}
+
+int main(void) {
+    static const size_t sizes[] = { 64, 256, 2000, 16384 };
+
+    printf("%8s %14s %14s %14s\n", "bytes", "old MB/s", "scalar MB/s", "vector MB/s");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        char *text = make_corpus(sizes[s], 42u + (unsigned)s);
+        size_t len = strlen(text);
+
+        /* Verify before timing */
+        message_features_t a, b;
+        message_features_scan_scalar(text, &a);
+        message_features_scan(text, &b);
+        if (memcmp(&a, &b, sizeof(a)) != 0) {
+            fprintf(stderr, "scan mismatch at %zu bytes\n", len);
+            return 1;
+        }
+
+        printf("%8zu %14.0f %14.0f %14.0f\n", len,
+               throughput(old_scan, text, len),
+               throughput(message_features_scan_scalar, text, len),
+               throughput(message_features_scan, text, len));
+        free(text);
+    }
+    return 0;
+}
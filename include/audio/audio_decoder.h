@@ -0,0 +1,55 @@
+/*
+ * Himiko Discord Bot (C Edition) - Audio Decoder
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Turns a stream URL into 48 kHz stereo s16 PCM, one Opus frame at a time.
+ * Two backends:
+ * - libav: libavformat/libavcodec/libswresample in-process, resampling
+ *   straight into the caller's frame buffer (built with ENABLE_LIBAV)
+ * - ffmpeg: an ffmpeg child process writing raw PCM into a pipe
+ * AUDIO_DECODER_AUTO prefers libav and falls back to the subprocess.
+ */
+
+#ifndef HIMIKO_AUDIO_DECODER_H
+#define HIMIKO_AUDIO_DECODER_H
+
+#include <stdint.h>
+
+typedef enum {
+    AUDIO_DECODER_AUTO,
+    AUDIO_DECODER_LIBAV,
+    AUDIO_DECODER_FFMPEG
+} audio_decoder_backend_t;
+
+typedef struct audio_decoder audio_decoder_t;
+
+/* Open url with the given backend. NULL on failure (or if the backend is not built). */
+audio_decoder_t *audio_decoder_open(const char *url, audio_decoder_backend_t backend);
+
+/*
+ * Fill pcm with up to frames interleaved stereo samples per channel.
+ * Returns the count written; fewer than frames only at end of stream,
+ * 0 once it is over, -1 on error.
+ */
+int audio_decoder_read(audio_decoder_t *decoder, int16_t *pcm, int frames);
+
+/*
+ * Decode up to frames samples per channel ahead of time so the first reads
+ * are served from memory. Returns the count buffered (less only at end of
+ * stream), -1 on error or if already primed.
+ */
+int audio_decoder_prime(audio_decoder_t *decoder, int frames);
+
+/* Make a blocked or later read return; safe from another thread while reading */
+void audio_decoder_interrupt(audio_decoder_t *decoder);
+
+/* Stop the decoder and free it; not concurrently with read */
+void audio_decoder_close(audio_decoder_t *decoder);
+
+/* Backend an open decoder ended up using */
+audio_decoder_backend_t audio_decoder_get_backend(const audio_decoder_t *decoder);
+
+const char *audio_decoder_backend_name(audio_decoder_backend_t backend);
+
+#endif /* HIMIKO_AUDIO_DECODER_H */
@@ -4,9 +4,9 @@
  * SPDX-License-Identifier: AGPL-3.0-or-later
  *
  * Handles audio streaming pipeline:
- * - FFmpeg subprocess for audio decoding
- * - Opus encoding
- * - Precise 20ms frame timing
+ * - Decoding to PCM (in-process libav or an FFmpeg subprocess)
+ * - Opus encoding, on its own thread, into a ring of encoded frames
+ * - Precise 20ms frame timing, sending silence when the ring runs dry
  * - Integration with voice UDP layer
  */
 
@@ -14,7 +14,9 @@
 #define HIMIKO_AUDIO_STREAM_H
 
 #include "audio/voice_udp.h"
+#include "audio/audio_decoder.h"
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
@@ -31,6 +33,11 @@
 /* Opus buffer size */
 #define AUDIO_OPUS_MAX_SIZE     4000
 
+/* Encoded audio kept ahead of the sender; playback starts once half of it is there */
+#define AUDIO_BUFFER_DEFAULT_MS 500
+#define AUDIO_BUFFER_MIN_MS     60
+#define AUDIO_BUFFER_MAX_MS     5000
+
 /* Audio stream state */
 typedef enum {
     AUDIO_STREAM_IDLE,
@@ -58,17 +65,19 @@ typedef struct audio_stream {
     /* Voice UDP connection */
     voice_udp_t *udp;
 
-    /* Opus encoder */
-    void *opus_encoder;
-
-    /* FFmpeg subprocess */
-    pid_t ffmpeg_pid;
-    int ffmpeg_pipe;    /* Read end of pipe */
+    /* Decoder for the current track; opened by play, closed by the audio thread */
+    audio_decoder_t *decoder;
 
     /* Timing */
     struct timespec next_frame_time;
     uint64_t frames_sent;
 
+    /* Encoded frame ring between the decode thread and the sender */
+    int buffer_ms;                      /* depth for the next play */
+    atomic_int buffered_frames;         /* fill at the last tick */
+    atomic_uint_fast64_t underruns;     /* ticks sent as silence because the ring was empty */
+    atomic_uint_fast64_t overruns;      /* times the decoder was a full ring ahead and had to wait */
+
     /* Current track info */
     char current_url[2048];
 
@@ -99,9 +108,12 @@ void audio_stream_set_voice(audio_stream_t *stream, struct discord_voice *vc);
 void audio_stream_set_callback(audio_stream_t *stream,
                                 void (*callback)(void *), void *user_data);
 
-/* Start playing a URL (spawns FFmpeg and audio thread) */
+/* Start playing a URL (opens a decoder and starts the audio thread) */
 int audio_stream_play(audio_stream_t *stream, const char *url);
 
+/* Start playing from an open (possibly primed) decoder; takes ownership even on failure */
+int audio_stream_play_decoder(audio_stream_t *stream, audio_decoder_t *decoder, const char *url);
+
 /* Stop playback */
 void audio_stream_stop(audio_stream_t *stream);
 
@@ -123,4 +135,18 @@ bool audio_stream_is_playing(audio_stream_t *stream);
 /* Get frames sent count */
 uint64_t audio_stream_get_frames_sent(audio_stream_t *stream);
 
+typedef struct {
+    uint64_t frames_sent;
+    uint64_t underruns;
+    uint64_t overruns;
+    int buffered_ms;
+    int buffer_ms;
+} audio_stream_stats_t;
+
+/* Depth of the encoded frame ring (clamped to AUDIO_BUFFER_MIN_MS..MAX_MS); applies from the next play */
+void audio_stream_set_buffer_ms(audio_stream_t *stream, int ms);
+
+/* Counters for the current or last track */
+void audio_stream_get_stats(audio_stream_t *stream, audio_stream_stats_t *stats);
+
 #endif /* HIMIKO_AUDIO_STREAM_H */
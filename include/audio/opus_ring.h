@@ -0,0 +1,49 @@
+/*
+ * Himiko Discord Bot (C Edition) - Opus Frame Ring
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Fixed-size ring of encoded Opus frames between exactly one producer
+ * (the decode/encode thread) and one consumer (the 20 ms sender). Each
+ * side only writes its own index, so neither ever takes a lock. Frames
+ * are encoded straight into a reserved slot and sent straight from it.
+ */
+
+#ifndef HIMIKO_OPUS_RING_H
+#define HIMIKO_OPUS_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OPUS_RING_FRAME_MAX 1275    /* RFC 6716 limit for one 20 ms frame */
+
+typedef struct {
+    uint16_t len;
+    uint8_t data[OPUS_RING_FRAME_MAX];
+} opus_frame_t;
+
+typedef struct {
+    opus_frame_t *slots;
+    uint32_t capacity;
+    /* Free-running counters; separate cache lines so the threads don't share one */
+    _Alignas(64) atomic_uint_fast64_t head;   /* frames committed by the producer */
+    _Alignas(64) atomic_uint_fast64_t tail;   /* frames released by the consumer */
+} opus_ring_t;
+
+/* Room for capacity frames. 0 on success. */
+int opus_ring_init(opus_ring_t *ring, uint32_t capacity);
+void opus_ring_free(opus_ring_t *ring);
+
+/* Producer: the next free slot (NULL when full), then commit it once filled */
+opus_frame_t *opus_ring_reserve(opus_ring_t *ring);
+void opus_ring_commit(opus_ring_t *ring);
+
+/* Consumer: the oldest frame (NULL when empty), then release it once sent */
+const opus_frame_t *opus_ring_peek(opus_ring_t *ring);
+void opus_ring_release(opus_ring_t *ring);
+
+/* Frames waiting; exact from either side, a snapshot from anywhere else */
+uint32_t opus_ring_count(opus_ring_t *ring);
+
+#endif /* HIMIKO_OPUS_RING_H */
@@ -0,0 +1,35 @@
+/*
+ * Himiko Discord Bot (C Edition) - Bot Ban Set
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Memory-resident copy of the bot_bans table keyed by numeric snowflake.
+ * Lookups read an immutable snapshot without locking; bans are rare, so
+ * add/remove rebuild the snapshot copy-on-write and free the old one once
+ * every lookup that could see it has finished.
+ */
+
+#ifndef HIMIKO_BAN_SET_H
+#define HIMIKO_BAN_SET_H
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+/* Sets at least this large get a bloom filter in front of the table */
+#define BAN_SET_BLOOM_MIN 1024
+
+/* Load every target_id from bot_bans. Returns 0 on success. */
+int ban_set_load(sqlite3 *db);
+
+/* Returns 1 if banned, 0 if not, -1 if the set was never loaded */
+int ban_set_contains(uint64_t id);
+
+void ban_set_add(uint64_t id);
+void ban_set_remove(uint64_t id);
+
+/* Number of banned IDs in the current snapshot */
+int ban_set_count(void);
+
+void ban_set_clear(void);
+
+#endif /* HIMIKO_BAN_SET_H */
@@ -10,6 +10,7 @@
 #include <concord/discord.h>
 #include "config.h"
 #include "database.h"
+#include "command_index.h"
 
 #define HIMIKO_VERSION "1.0.0"
 
@@ -31,6 +32,9 @@ typedef struct himiko_bot {
     himiko_database_t database;
     himiko_command_t *commands;
     int command_count;
+    command_index_t command_index;
+    int unindexed_count;    /* commands the index rejected; found by linear scan */
+    int commands_sealed;    /* set once dispatch can read the table */
     int running;
 } himiko_bot_t;
 
@@ -43,8 +47,9 @@ void bot_cleanup(himiko_bot_t *bot);
 int bot_run(himiko_bot_t *bot);
 void bot_stop(himiko_bot_t *bot);
 
-/* Command registration */
+/* Command registration (startup only; the table is read without locking afterwards) */
 void bot_register_command(himiko_bot_t *bot, const himiko_command_t *cmd);
+void bot_register_alias(himiko_bot_t *bot, const char *alias, const char *name);
 void bot_register_all_commands(himiko_bot_t *bot);
 himiko_command_t *bot_find_command(himiko_bot_t *bot, const char *name);
 
@@ -54,6 +59,12 @@ void on_interaction_create(struct discord *client, const struct discord_interact
 void on_message_create(struct discord *client, const struct discord_message *msg);
 void on_message_delete(struct discord *client, const struct discord_message_delete *event);
 void on_guild_member_add(struct discord *client, const struct discord_guild_member *member);
+void on_guild_create(struct discord *client, const struct discord_guild *guild);
+void on_guild_update(struct discord *client, const struct discord_guild *guild);
+void on_guild_delete(struct discord *client, const struct discord_guild *guild);
+void on_guild_role_create(struct discord *client, const struct discord_guild_role_create *event);
+void on_guild_role_update(struct discord *client, const struct discord_guild_role_update *event);
+void on_guild_role_delete(struct discord *client, const struct discord_guild_role_delete *event);
 
 /* Utility functions */
 u64snowflake parse_user_mention(const char *mention);
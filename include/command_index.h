@@ -0,0 +1,56 @@
+/*
+ * Himiko Discord Bot (C Edition) - Command Index
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Collision-free, case-insensitive name -> command slot lookup.
+ * Keys are added while commands register, then the index is built once
+ * with hash-and-displace so every lookup probes exactly one slot.
+ */
+
+#ifndef HIMIKO_COMMAND_INDEX_H
+#define HIMIKO_COMMAND_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COMMAND_INDEX_MAX_NAME 64
+
+/* Pending key (command name or alias) */
+typedef struct {
+    char name[COMMAND_INDEX_MAX_NAME];
+    int target;
+} command_index_key_t;
+
+/* Built table slot */
+typedef struct {
+    const char *name;
+    int target;
+} command_index_slot_t;
+
+typedef struct command_index {
+    command_index_key_t *keys;
+    int key_count;
+    int key_capacity;
+
+    command_index_slot_t *slots;
+    uint32_t slot_mask;
+    uint32_t *displace;
+    uint32_t bucket_count;
+    uint32_t seed;
+    int built;
+} command_index_t;
+
+void command_index_init(command_index_t *idx);
+void command_index_free(command_index_t *idx);
+
+/* Add a name (or alias) resolving to target. Earlier additions win on duplicates. */
+int command_index_add(command_index_t *idx, const char *name, int target);
+
+/* Build the collision-free table. Must be re-run after further additions. */
+int command_index_build(command_index_t *idx);
+
+/* Returns target, or -1 if not found or not built */
+int command_index_find(const command_index_t *idx, const char *name);
+
+#endif /* HIMIKO_COMMAND_INDEX_H */
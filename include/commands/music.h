@@ -25,6 +25,10 @@
 #define MUSIC_MAX_TITLE_LEN    256
 #define MUSIC_MAX_URL_LEN      512
 
+/* Next-track prefetch */
+#define MUSIC_PREFETCH_PRIME_MS   3000    /* PCM decoded ahead before the switch */
+#define MUSIC_PREFETCH_LEAD_SECS  20      /* open the decoder this long before the current track ends */
+
 /* Track source types */
 typedef enum {
     TRACK_SOURCE_YOUTUBE,
@@ -76,6 +80,27 @@ typedef struct {
     u64snowflake user_id;
 } voice_connection_info_t;
 
+/*
+ * The queue entry after the current one, resolved by a per-player worker
+ * while the current track plays. Its stream URL is fetched right away and
+ * its decoder opened and primed shortly before the current track ends, so
+ * the switch is a handoff. Any change to what plays next bumps generation;
+ * work for an older generation is thrown away. Guarded by the player lock.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_cond_t cond;
+    bool thread_started;
+    bool quit;
+    bool wanted;                /* a fetch has been asked for */
+    bool busy;                  /* the worker is fetching */
+    uint64_t generation;
+    audio_decoder_t *priming;   /* decoder being primed, for interrupting it */
+    music_track_t *track;       /* ready entry, NULL if none */
+    audio_decoder_t *decoder;
+    char *stream_url;
+} music_prefetch_t;
+
 /* Guild music player */
 typedef struct music_player {
     u64snowflake guild_id;
@@ -97,6 +122,8 @@ typedef struct music_player {
     /* Discord voice pointer (from Concord callback) */
     struct discord_voice *voice_connection;
 
+    music_prefetch_t prefetch;
+
     pthread_mutex_t lock;
 
     /* Linked list for multiple guilds */
@@ -149,6 +176,9 @@ void music_on_voice_session_descriptor(struct discord_voice *vc);
 /* Start playback of next track */
 int music_start_playback(music_player_t *player);
 
+/* Drop any prefetched next track and, if something is playing, fetch it again */
+void music_prefetch_invalidate(music_player_t *player);
+
 /* Playback control */
 int music_play(music_player_t *player, const char *query, u64snowflake user_id);
 int music_skip(music_player_t *player);
@@ -166,6 +196,7 @@ int music_queue_shuffle(const char *guild_id);
 int music_queue_move(const char *guild_id, int from, int to);
 music_track_t *music_queue_get(const char *guild_id, int *count);
 music_track_t *music_queue_next(const char *guild_id);
+music_track_t *music_queue_after(const char *guild_id, int position);
 
 /* Track resolution */
 int music_resolve_track(const char *query, music_track_t *track);
@@ -219,6 +250,8 @@ void cmd_seek(struct discord *client, const struct discord_interaction *interact
 void cmd_seek_prefix(struct discord *client, const struct discord_message *msg, const char *args);
 void cmd_musicsetup(struct discord *client, const struct discord_interaction *interaction);
 void cmd_musicsetup_prefix(struct discord *client, const struct discord_message *msg, const char *args);
+void cmd_musiccache(struct discord *client, const struct discord_interaction *interaction);
+void cmd_musiccache_prefix(struct discord *client, const struct discord_message *msg, const char *args);
 
 /* Register commands */
 void register_music_commands(himiko_bot_t *bot);
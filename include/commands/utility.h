@@ -32,4 +32,7 @@ void cmd_math_prefix(struct discord *client, const struct discord_message *msg,
 /* Utility function */
 time_t parse_duration(const char *str);
 
+/* Arm a scheduler timer for every uncompleted reminder; returns how many */
+int utility_load_reminders(himiko_database_t *db);
+
 #endif /* HIMIKO_COMMANDS_UTILITY_H */
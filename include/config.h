@@ -26,6 +26,7 @@ typedef struct {
     char prefix[MAX_PREFIX_LEN];
     char database_path[MAX_PATH_LEN];
     uint64_t app_id; /* Application ID for interaction responses */
+    uint64_t bot_id; /* Bot's own user ID, set on ready */
 
     /* Single owner (backwards compatible with old configs) */
     char owner_id[MAX_SNOWFLAKE_LEN];
@@ -59,6 +60,21 @@ typedef struct {
         int update_check_hours;
         char update_notify_channel[MAX_SNOWFLAKE_LEN];
         int debug_mode;
+        int message_xp;          /* award XP for chatting */
+        int worker_threads;      /* 0 runs handlers on the gateway thread */
+        int worker_queue_depth;
+        int antispam_max_users;  /* tracked (guild, user) pairs before eviction */
+        int antispam_max_memory_kb;
+        int antispam_repeat_distance; /* SimHash bits; 0 = exact repeats only */
+        int antispam_wave_authors;    /* distinct authors of one text that make a wave */
+        int antispam_wave_window_secs;
+        int regex_filter_budget_ms;   /* regex matching time per message */
+        int keyword_dm_per_sec;       /* keyword notification DMs sent per second */
+        int keyword_cooldown_secs;    /* per user and channel */
+        char resolver_worker[MAX_PATH_LEN]; /* persistent yt-dlp worker program */
+        int resolver_workers;         /* 0 runs yt-dlp once per lookup */
+        int resolver_timeout_secs;    /* per lookup */
+        int audio_buffer_ms;          /* encoded audio queued ahead of the voice sender */
     } features;
 
 } himiko_config_t;
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <sqlite3.h>
 #include <time.h>
+#include <stdatomic.h>
 
 #define MAX_REASON_LEN 512
 #define MAX_CONTENT_LEN 2048
@@ -115,6 +116,15 @@ typedef struct {
     int completed;
 } reminder_t;
 
+/* Persisted timer, fired by the scheduler */
+typedef struct {
+    int64_t id;
+    char guild_id[32];
+    char event_type[32];
+    char target_id[32];
+    time_t execute_at;
+} scheduled_event_t;
+
 /* Anti-raid config */
 typedef struct {
     char guild_id[32];
@@ -171,9 +181,150 @@ typedef struct {
     char action[32];
 } spam_filter_config_t;
 
+/* Prepared statement IDs, one per distinct query */
+typedef enum {
+    /* database.c */
+    DB_STMT_LOAD_GUILD_SETTINGS,
+    DB_STMT_SET_GUILD_SETTINGS,
+    DB_STMT_LOG_COMMAND,
+    DB_STMT_ADD_WARNING,
+    DB_STMT_GET_WARNINGS,
+    DB_STMT_CLEAR_WARNINGS,
+    DB_STMT_DELETE_WARNING,
+    DB_STMT_LOG_DELETED_MESSAGE,
+    DB_STMT_GET_DELETED_MESSAGES,
+    DB_STMT_CLEAN_OLD_DELETED_MESSAGES,
+    DB_STMT_GET_USER_XP,
+    DB_STMT_SET_USER_XP,
+    DB_STMT_ADD_USER_XP,
+    DB_STMT_GET_LEADERBOARD,
+    DB_STMT_GET_USER_RANK,
+    DB_STMT_LOAD_LEADERBOARD,
+    DB_STMT_ADD_LEVEL_RANK,
+    DB_STMT_REMOVE_LEVEL_RANK,
+    DB_STMT_GET_LEVEL_RANKS,
+    DB_STMT_GET_RANKS_FOR_LEVEL,
+    DB_STMT_ADD_BOT_BAN,
+    DB_STMT_REMOVE_BOT_BAN,
+    DB_STMT_IS_BOT_BANNED,
+    DB_STMT_GET_BOT_BANS,
+    DB_STMT_GET_BOT_BANS_BY_TYPE,
+    DB_STMT_SET_AFK,
+    DB_STMT_GET_AFK,
+    DB_STMT_REMOVE_AFK,
+    DB_STMT_ADD_MOD_ACTION,
+    DB_STMT_GET_MOD_ACTIONS_COUNT,
+    DB_STMT_ADD_REMINDER,
+    DB_STMT_GET_PENDING_REMINDERS,
+    DB_STMT_MARK_REMINDER_COMPLETED,
+    DB_STMT_ADD_SCHEDULED_EVENT,
+    DB_STMT_GET_SCHEDULED_EVENTS,
+    DB_STMT_DELETE_SCHEDULED_EVENT,
+    DB_STMT_GET_ANTIRAID_CONFIG,
+    DB_STMT_RECORD_MEMBER_JOIN,
+    DB_STMT_COUNT_RECENT_JOINS,
+    DB_STMT_GET_ANTISPAM_CONFIG,
+    DB_STMT_GET_LOGGING_CONFIG,
+    DB_STMT_SET_LOG_CHANNEL,
+    DB_STMT_GET_CUSTOM_COMMAND,
+    DB_STMT_CREATE_CUSTOM_COMMAND,
+    DB_STMT_DELETE_CUSTOM_COMMAND,
+    DB_STMT_LIST_CUSTOM_COMMANDS,
+    DB_STMT_INCREMENT_COMMAND_USE,
+    DB_STMT_GET_SPAM_FILTER_CONFIG,
+    DB_STMT_SET_SPAM_FILTER_CONFIG,
+    DB_STMT_SET_ANTIRAID_CONFIG,
+    DB_STMT_SET_ANTISPAM_CONFIG,
+    DB_STMT_SET_LOGGING_CONFIG,
+    DB_STMT_IS_LOG_CHANNEL_DISABLED,
+    DB_STMT_ADD_DISABLED_LOG_CHANNEL,
+    DB_STMT_REMOVE_DISABLED_LOG_CHANNEL,
+
+    /* Music (commands/music.c) */
+    DB_STMT_MUSIC_QUEUE_ADD,
+    DB_STMT_MUSIC_QUEUE_REMOVE,
+    DB_STMT_MUSIC_QUEUE_REMOVE_REORDER,
+    DB_STMT_MUSIC_QUEUE_CLEAR,
+    DB_STMT_MUSIC_QUEUE_GET_COUNT,
+    DB_STMT_MUSIC_QUEUE_GET,
+    DB_STMT_MUSIC_QUEUE_NEXT,
+    DB_STMT_MUSIC_QUEUE_AFTER,
+    DB_STMT_MUSIC_QUEUE_SHUFFLE,
+    DB_STMT_MUSIC_QUEUE_SHUFFLE_UPDATE,
+    DB_STMT_MUSIC_GET_SETTINGS,
+    DB_STMT_MUSIC_SET_SETTINGS,
+    DB_STMT_MUSIC_ADD_TO_HISTORY,
+    DB_STMT_MUSIC_CACHE_GET,
+    DB_STMT_MUSIC_CACHE_PUT_META,
+    DB_STMT_MUSIC_CACHE_PUT_STREAM,
+    DB_STMT_MUSIC_CACHE_PURGE,
+    DB_STMT_MUSIC_CACHE_PURGE_ALL,
+    DB_STMT_MUSIC_CACHE_PRUNE,
+    DB_STMT_MUSIC_CACHE_PRUNE_STREAMS,
+
+    /* Auto-clean (modules/auto_cleaner.c) */
+    DB_STMT_AUTOCLEAN_LOAD_CHANNELS,
+    DB_STMT_AUTOCLEAN_GET_CHANNEL,
+    DB_STMT_AUTOCLEAN_UPDATE_NEXT_RUN,
+    DB_STMT_AUTOCLEAN_ADD_CHANNEL,
+    DB_STMT_AUTOCLEAN_REMOVE_CHANNEL,
+    DB_STMT_AUTOCLEAN_GET_CHANNELS,
+    DB_STMT_AUTOCLEAN_SET_CLEAN_MESSAGE,
+    DB_STMT_AUTOCLEAN_SET_CLEAN_IMAGE,
+
+    /* Mention responses (modules/mention_response.c) */
+    DB_STMT_MENTION_ADD,
+    DB_STMT_MENTION_REMOVE,
+    DB_STMT_MENTION_GET_ALL,
+    DB_STMT_MENTION_FIND,
+    DB_STMT_MENTION_GET_GUILDS,
+
+    /* Regex filters (modules/regex_filter.c) */
+    DB_STMT_REGEX_FILTER_ADD,
+    DB_STMT_REGEX_FILTER_REMOVE,
+    DB_STMT_REGEX_FILTER_GET_ALL,
+
+    /* Keyword notifications (modules/keyword_notify.c) */
+    DB_STMT_KEYWORD_ADD,
+    DB_STMT_KEYWORD_REMOVE,
+    DB_STMT_KEYWORD_GET_USER,
+    DB_STMT_KEYWORD_GET_GUILD,
+
+    /* Tickets (modules/ticket.c) */
+    DB_STMT_TICKET_GET_CONFIG,
+    DB_STMT_TICKET_SET_CONFIG,
+    DB_STMT_TICKET_DELETE_CONFIG,
+
+    DB_STMT_COUNT
+} db_stmt_id_t;
+
+/* Connection tuning (applied per connection) */
+#define DB_READ_POOL_SIZE 4
+#define DB_BUSY_TIMEOUT_MS 5000
+#define DB_MMAP_SIZE (256LL * 1024 * 1024)
+#define DB_CACHE_SIZE_KB 16384
+
+/* Background writer batching (see db_writer.h) */
+#define DB_WRITER_INTERVAL_MS 50
+#define DB_WRITER_BATCH_ROWS 256
+
+struct db_writer;
+
+/* Read-only connection, checked out by one thread at a time */
+typedef struct {
+    sqlite3 *db;
+    atomic_int in_use;
+    sqlite3_stmt *stmt_cache[DB_STMT_COUNT];
+} db_reader_t;
+
 /* Database handle */
 typedef struct {
     sqlite3 *db;
+    _Atomic(sqlite3_stmt *) stmt_cache[DB_STMT_COUNT];
+    atomic_ullong prepares_avoided;
+    db_reader_t readers[DB_READ_POOL_SIZE];
+    int reader_count;
+    struct db_writer *writer;
 } himiko_database_t;
 
 /* Database lifecycle */
@@ -181,6 +332,20 @@ int db_open(himiko_database_t *database, const char *path);
 void db_close(himiko_database_t *database);
 int db_migrate(himiko_database_t *database);
 
+/* Block until every queued fire-and-forget write is committed */
+int db_flush_writes(himiko_database_t *database);
+
+/* SQL helpers every connection needs, e.g. xp_level() for the XP upsert */
+void db_register_functions(sqlite3 *db);
+
+/* Statement cache: prepare hands out a cached statement when one is idle,
+ * release resets it and returns it to the cache (or finalizes a spare). */
+int db_stmt_prepare(himiko_database_t *db, db_stmt_id_t id, const char *sql, sqlite3_stmt **stmt);
+/* Same, but for SELECTs: runs on an idle read-only connection when one is free */
+int db_stmt_prepare_read(himiko_database_t *db, db_stmt_id_t id, const char *sql, sqlite3_stmt **stmt);
+void db_stmt_release(himiko_database_t *db, db_stmt_id_t id, sqlite3_stmt *stmt);
+unsigned long long db_stmt_prepares_avoided(himiko_database_t *db);
+
 /* Guild settings */
 int db_get_guild_settings(himiko_database_t *db, const char *guild_id, guild_settings_t *settings);
 int db_set_guild_settings(himiko_database_t *db, const guild_settings_t *settings);
@@ -212,6 +377,8 @@ int db_clean_old_deleted_messages(himiko_database_t *db, int older_than_hours);
 int db_get_user_xp(himiko_database_t *db, const char *guild_id, const char *user_id, user_xp_t *xp);
 int db_set_user_xp(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t xp, int level);
 int db_add_user_xp(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t amount, user_xp_t *result);
+/* Queued xp = xp + delta; the level follows from the stored total */
+int db_add_user_xp_delta(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t delta);
 int db_get_leaderboard(himiko_database_t *db, const char *guild_id, user_xp_t *results, int max_results, int *count);
 int db_get_user_rank(himiko_database_t *db, const char *guild_id, const char *user_id, int *rank);
 
@@ -229,6 +396,7 @@ int db_get_mod_actions_count(himiko_database_t *db, const char *guild_id, int *c
 int db_add_bot_ban(himiko_database_t *db, const char *target_id, const char *ban_type, const char *reason, const char *banned_by);
 int db_remove_bot_ban(himiko_database_t *db, const char *target_id);
 int db_is_bot_banned(himiko_database_t *db, const char *target_id);
+int db_is_bot_banned_id(himiko_database_t *db, uint64_t target_id);
 int db_get_bot_bans(himiko_database_t *db, const char *ban_type, bot_ban_t *bans, int max_bans, int *count);
 
 /* AFK */
@@ -237,10 +405,16 @@ int db_get_afk(himiko_database_t *db, const char *user_id, afk_status_t *afk);
 int db_remove_afk(himiko_database_t *db, const char *user_id);
 
 /* Reminders */
-int db_add_reminder(himiko_database_t *db, const char *user_id, const char *channel_id, const char *message, time_t remind_at);
-int db_get_pending_reminders(himiko_database_t *db, reminder_t *reminders, int max_reminders, int *count);
+int db_add_reminder(himiko_database_t *db, const char *user_id, const char *channel_id, const char *message, time_t remind_at, int64_t *id);
+/* Uncompleted reminders with id > after_id, in id order */
+int db_get_pending_reminders(himiko_database_t *db, int64_t after_id, reminder_t *reminders, int max_reminders, int *count);
 int db_mark_reminder_completed(himiko_database_t *db, int64_t id);
 
+/* Scheduled events */
+int db_add_scheduled_event(himiko_database_t *db, const char *guild_id, const char *event_type, const char *target_id, time_t execute_at, int64_t *id);
+int db_get_scheduled_events(himiko_database_t *db, int64_t after_id, scheduled_event_t *events, int max_events, int *count);
+int db_delete_scheduled_event(himiko_database_t *db, int64_t id);
+
 /* Anti-raid */
 int db_get_antiraid_config(himiko_database_t *db, const char *guild_id, antiraid_config_t *config);
 int db_set_antiraid_config(himiko_database_t *db, const antiraid_config_t *config);
@@ -0,0 +1,58 @@
+/*
+ * Himiko Discord Bot (C Edition) - Guild Settings Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Process-wide cache of per-guild config rows. Entries are loaded on first
+ * touch and invalidated by the db_set_* functions. Readers never take a
+ * lock: each entry is guarded by a sequence counter and retried on a
+ * concurrent write.
+ */
+
+#ifndef HIMIKO_DB_CACHE_H
+#define HIMIKO_DB_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cached row kinds */
+typedef enum {
+    DB_CACHE_GUILD_SETTINGS = 0,
+    DB_CACHE_ANTISPAM,
+    DB_CACHE_ANTIRAID,
+    DB_CACHE_LOGGING,
+    DB_CACHE_SPAM_FILTER,
+    DB_CACHE_KIND_COUNT
+} db_cache_kind_t;
+
+/* Ticket returned by a miss, passed back to db_cache_store */
+typedef struct {
+    void *entry;
+    uint32_t gen;
+} db_cache_ticket_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+    int guilds;
+} db_cache_stats_t;
+
+/*
+ * Copy len bytes at offset from the cached row into out.
+ * Returns 1 on hit, 0 on miss (ticket is filled for a later store).
+ */
+int db_cache_lookup(db_cache_kind_t kind, const char *guild_id, void *out, size_t offset, size_t len, db_cache_ticket_t *ticket);
+
+/* Publish a freshly loaded row, unless it was invalidated since the miss */
+void db_cache_store(db_cache_kind_t kind, const db_cache_ticket_t *ticket, const void *row);
+
+/* Drop a cached row after its table was written */
+void db_cache_invalidate(db_cache_kind_t kind, const char *guild_id);
+
+void db_cache_get_stats(db_cache_stats_t *stats);
+
+/* Free every entry (called from db_close) */
+void db_cache_clear(void);
+
+#endif /* HIMIKO_DB_CACHE_H */
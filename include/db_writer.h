@@ -0,0 +1,38 @@
+/*
+ * Himiko Discord Bot (C Edition) - Database Writer
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Fire-and-forget inserts (command history, joins, snipes, mod log, music
+ * history) are pushed onto a lock-free MPSC queue and executed by one
+ * thread on its own connection, many rows per transaction. A batch is
+ * committed every DB_WRITER_INTERVAL_MS or once DB_WRITER_BATCH_ROWS are
+ * pending, whichever comes first.
+ */
+
+#ifndef HIMIKO_DB_WRITER_H
+#define HIMIKO_DB_WRITER_H
+
+#include "database.h"
+
+#define DB_WRITER_MAX_ARGS 8
+
+typedef struct db_writer db_writer_t;
+
+/* Open a dedicated connection to uri and start the thread. NULL on failure. */
+db_writer_t *db_writer_start(const char *uri, int interval_ms, int batch_rows);
+
+/* Drain the queue, commit, join the thread and close the connection */
+void db_writer_stop(db_writer_t *writer);
+
+/*
+ * Queue one statement. types holds one character per argument:
+ * 't' for const char * (copied, NULL binds NULL), 'i' for int64_t.
+ * Returns 0 once queued; execution errors are logged by the writer.
+ */
+int db_writer_enqueue(db_writer_t *writer, db_stmt_id_t id, const char *sql, const char *types, ...);
+
+/* Barrier: returns after everything queued before the call is committed */
+int db_writer_flush(db_writer_t *writer);
+
+#endif /* HIMIKO_DB_WRITER_H */
@@ -0,0 +1,36 @@
+/*
+ * Himiko Discord Bot (C Edition) - Guild Permission Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Owner and role permissions of every guild, kept current from gateway
+ * events (GUILD_CREATE/UPDATE/DELETE and the role events). Members on
+ * MESSAGE_CREATE carry roles but no permissions, so prefix commands work
+ * theirs out here without a REST call.
+ */
+
+#ifndef HIMIKO_GUILD_PERMS_H
+#define HIMIKO_GUILD_PERMS_H
+
+#include <concord/discord.h>
+#include <stdint.h>
+
+/* Gateway events; a guild or role update replaces what was cached */
+void guild_perms_on_guild(const struct discord_guild *guild);
+void guild_perms_on_guild_delete(u64snowflake guild_id);
+void guild_perms_on_role(u64snowflake guild_id, const struct discord_role *role);
+void guild_perms_on_role_delete(u64snowflake guild_id, u64snowflake role_id);
+
+/*
+ * Guild-level permissions of a member with these roles: @everyone plus
+ * each role, or everything for the owner and administrators. 0 when the
+ * guild is not cached, so checks fail closed.
+ */
+uint64_t guild_perms_of(u64snowflake guild_id, u64snowflake user_id, const struct snowflakes *roles);
+
+/* 1 if the member has any permission in mask (Administrator always counts) */
+int guild_perms_has(u64snowflake guild_id, u64snowflake user_id, const struct snowflakes *roles, uint64_t mask);
+
+void guild_perms_cleanup(void);
+
+#endif /* HIMIKO_GUILD_PERMS_H */
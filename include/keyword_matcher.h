@@ -0,0 +1,54 @@
+/*
+ * Himiko Discord Bot (C Edition) - Keyword Matcher
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Every subscribed keyword of a guild in one Aho-Corasick trie, so a
+ * message is scanned once no matter how many keywords exist. Keywords
+ * are ASCII case-insensitive and match either as whole words or
+ * anywhere in the text. Adding or removing a subscription edits the
+ * trie in place and relinks it; the guild's keywords are never
+ * reloaded to apply a change.
+ */
+
+#ifndef HIMIKO_KEYWORD_MATCHER_H
+#define HIMIKO_KEYWORD_MATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KEYWORD_MAX_LEN 64
+
+typedef struct keyword_matcher keyword_matcher_t;
+
+typedef enum {
+    KEYWORD_MATCH_WORD,         /* no word character on either side */
+    KEYWORD_MATCH_SUBSTRING     /* anywhere, like strstr */
+} keyword_match_t;
+
+keyword_matcher_t *keyword_matcher_create(keyword_match_t mode);
+void keyword_matcher_free(keyword_matcher_t *matcher);
+
+/* Lowercase and trim keyword into out; returns its length, 0 if unusable */
+size_t keyword_normalize(const char *keyword, char *out, size_t out_size);
+
+/* Subscribe id (a user, a row...) to a normalized keyword. Adding twice is a no-op. 0 on success. */
+int keyword_matcher_add(keyword_matcher_t *matcher, const char *keyword, uint64_t id);
+
+/*
+ * Bulk loading: insert any number of subscriptions without relinking,
+ * then build once. Nothing may scan the matcher in between.
+ */
+int keyword_matcher_insert(keyword_matcher_t *matcher, const char *keyword, uint64_t id);
+void keyword_matcher_build(keyword_matcher_t *matcher);
+
+/* 0 if the subscription existed; trie nodes nobody uses any more are freed */
+int keyword_matcher_remove(keyword_matcher_t *matcher, const char *keyword, uint64_t id);
+
+/* Distinct subscribers with a keyword in text, at most max; returns the count */
+int keyword_matcher_scan(const keyword_matcher_t *matcher, const char *text, uint64_t *ids, int max);
+
+/* Live subscriptions */
+size_t keyword_matcher_count(const keyword_matcher_t *matcher);
+
+#endif /* HIMIKO_KEYWORD_MATCHER_H */
@@ -0,0 +1,40 @@
+/*
+ * Himiko Discord Bot (C Edition) - Leaderboard Index
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Per-guild order-statistic skip list over user_xp, ordered by xp
+ * descending. Built lazily from SQLite the first time a guild is queried,
+ * then kept current by the XP write paths, so rank and top-N are O(log n)
+ * instead of a scan over every member.
+ */
+
+#ifndef HIMIKO_LEADERBOARD_H
+#define HIMIKO_LEADERBOARD_H
+
+#include <stdint.h>
+#include "database.h"
+
+#define LEADERBOARD_MAX_LEVEL 24
+
+typedef struct {
+    uint64_t user_id;
+    int64_t xp;
+} leaderboard_entry_t;
+
+/*
+ * Rank of user_id (1 + members with strictly more XP). Builds the guild
+ * from db on first use. Returns 0 on success, -1 if the guild can't be loaded.
+ */
+int leaderboard_rank(himiko_database_t *db, uint64_t guild_id, uint64_t user_id, int *rank);
+
+/* Top max entries, highest XP first. Returns the count, or -1 on error. */
+int leaderboard_top(himiko_database_t *db, uint64_t guild_id, leaderboard_entry_t *out, int max);
+
+/* Record a user's new total; ignored for guilds that aren't loaded yet */
+void leaderboard_set_xp(uint64_t guild_id, uint64_t user_id, int64_t xp);
+
+/* Drop every guild (called from db_close) */
+void leaderboard_clear(void);
+
+#endif /* HIMIKO_LEADERBOARD_H */
@@ -0,0 +1,42 @@
+/*
+ * Himiko Discord Bot (C Edition) - Message Features
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * One pass over message content that gathers everything the spam checks
+ * count: length, lines, links, invites, emoji and mention tokens. The
+ * scan skips ahead a vector at a time and only looks closely at the few
+ * bytes that can start or end a token.
+ */
+
+#ifndef HIMIKO_MESSAGE_FEATURES_H
+#define HIMIKO_MESSAGE_FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t length;          /* bytes */
+    int lines;              /* newlines */
+    int urls;               /* http:// and https:// */
+    int invites;            /* discord.gg/ and discord(app).com/invite/ */
+    int custom_emojis;      /* <:name:id> and <a:name:id> */
+    int unicode_emojis;     /* 4-byte sequences starting F0 9F */
+    int user_mentions;      /* <@id> and <@!id>, repeats included */
+    int role_mentions;      /* <@&id> */
+    int everyone_mentions;  /* @everyone and @here */
+} message_features_t;
+
+/* Scan text; NULL gives all zeroes */
+void message_features_scan(const char *text, message_features_t *out);
+
+/* Same result without vector instructions; kept for comparison */
+void message_features_scan_scalar(const char *text, message_features_t *out);
+
+/*
+ * Features of a message, scanned at most once per thread while the same
+ * message is being handled, so each module can ask without rescanning.
+ */
+const message_features_t *message_features_get(uint64_t message_id, const char *text);
+
+#endif /* HIMIKO_MESSAGE_FEATURES_H */
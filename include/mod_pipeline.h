@@ -0,0 +1,49 @@
+/*
+ * Himiko Discord Bot (C Edition) - Moderation Action Pipeline
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Member actions issued in bulk (raid silences, kicks and bans) are
+ * queued per guild and sent as asynchronous requests instead of one call
+ * per user on the gateway thread. A target is queued once per action no
+ * matter how often it is submitted. Each guild keeps a window of requests
+ * in flight that grows while Discord accepts them and halves when one
+ * fails; Concord's per-route buckets pace whatever is in flight. Progress
+ * and throughput are posted to the guild's report channel.
+ */
+
+#ifndef HIMIKO_MOD_PIPELINE_H
+#define HIMIKO_MOD_PIPELINE_H
+
+#include <concord/discord.h>
+
+#define MOD_PIPELINE_START_WINDOW 4
+#define MOD_PIPELINE_MAX_WINDOW 16
+#define MOD_PIPELINE_REPORT_EVERY 50    /* completed actions between progress posts */
+#define MOD_PIPELINE_REPORT_MIN 5       /* smaller batches finish without a summary */
+
+typedef enum {
+    MOD_ACTION_SILENCE,
+    MOD_ACTION_KICK,
+    MOD_ACTION_BAN,
+    MOD_ACTION_COUNT
+} mod_request_type_t;
+
+typedef struct {
+    u64snowflake guild_id;
+    u64snowflake user_id;
+    mod_request_type_t type;
+    u64snowflake role_id;               /* silence only */
+    u64snowflake report_channel_id;     /* 0 to keep the guild's current one */
+} mod_request_t;
+
+/* Queue an action. 0 if queued, 1 if the same action is already pending, -1 on error. */
+int mod_pipeline_submit(struct discord *client, const mod_request_t *action);
+
+/* Actions queued or in flight for a guild */
+int mod_pipeline_pending(u64snowflake guild_id);
+
+/* Drop everything still queued; call once the client can no longer complete requests */
+void mod_pipeline_shutdown(void);
+
+#endif /* HIMIKO_MOD_PIPELINE_H */
@@ -11,18 +11,40 @@
 #include <time.h>
 #include <pthread.h>
 
-/* Raid tracker state per guild */
+/* scheduled_events type that ends an automatic lockdown */
+#define ANTIRAID_LOCKDOWN_EVENT "lockdown_end"
+
+#define ANTIRAID_GUILD_BUCKETS 256
+#define ANTIRAID_DEFAULT_RAID_SECS 300              /* raid window when a guild has no config */
+#define ANTIRAID_JOIN_RING_MAX 8192                 /* counts saturate beyond this */
+#define ANTIRAID_YOUNG_ACCOUNT_MS (7 * 24 * 60 * 60 * 1000LL)
+
+/* One join as kept in memory; times in ms */
 typedef struct {
-    char guild_id[32];
+    u64snowflake user_id;
+    int64_t joined_at;
+    int64_t account_created_at;
+} raid_join_t;
+
+/* Raid tracker state per guild */
+typedef struct raid_guild_state {
+    struct raid_guild_state *next;
+    u64snowflake guild_id;
     time_t last_raid_alert;
     time_t lockdown_start;
     int in_lockdown;
+
+    /* Ring of joins inside the raid window, oldest at join_head */
+    raid_join_t *joins;
+    int join_head;
+    int join_count;
+    int join_cap;
+    int young_accounts;         /* joins whose account was under a week old */
 } raid_guild_state_t;
 
 /* Global raid tracker */
 typedef struct {
-    raid_guild_state_t guilds[100];
-    int guild_count;
+    raid_guild_state_t *guilds[ANTIRAID_GUILD_BUCKETS];
     pthread_mutex_t mutex;
 } raid_tracker_t;
 
@@ -30,8 +52,9 @@ typedef struct {
 void antiraid_init(himiko_bot_t *bot);
 void antiraid_cleanup(himiko_bot_t *bot);
 
-/* Event handler */
-void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, const struct discord_user *user);
+/* Event handler; joined_at_ms is Unix time in milliseconds, 0 for now */
+void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, const struct discord_user *user,
+                             int64_t joined_at_ms);
 
 /* Commands */
 void cmd_antiraid(struct discord *client, const struct discord_interaction *interaction);
@@ -48,7 +71,6 @@ void cmd_lockdown(struct discord *client, const struct discord_interaction *inte
 void cmd_lockdown_prefix(struct discord *client, const struct discord_message *msg, const char *args);
 
 /* Helper functions */
-void antiraid_check_lockdown_expiry(struct discord *client);
 int64_t snowflake_to_timestamp_ms(u64snowflake id);
 void register_antiraid_commands(himiko_bot_t *bot);
 
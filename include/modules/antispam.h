@@ -9,22 +9,6 @@
 #include <concord/discord.h>
 #include "bot.h"
 #include <time.h>
-#include <pthread.h>
-
-/* User pressure tracking */
-typedef struct {
-    char guild_user_key[96]; /* guild_id:user_id */
-    double pressure;
-    char last_message[512];
-    time_t last_update;
-} user_pressure_t;
-
-/* Global spam tracker */
-typedef struct {
-    user_pressure_t users[1000];
-    int user_count;
-    pthread_mutex_t mutex;
-} spam_tracker_t;
 
 /* Module lifecycle */
 void antispam_init(himiko_bot_t *bot);
@@ -24,9 +24,8 @@ typedef struct {
     time_t created_at;
 } autoclean_channel_t;
 
-/* Module lifecycle */
+/* Module lifecycle; init arms a scheduler timer per configured channel */
 void auto_cleaner_init(himiko_bot_t *bot);
-void auto_cleaner_tick(struct discord *client);
 void auto_cleaner_cleanup(himiko_bot_t *bot);
 
 /* Commands */
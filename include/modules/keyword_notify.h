@@ -0,0 +1,29 @@
+/*
+ * Himiko Discord Bot (C Edition) - Keyword Notification Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#ifndef HIMIKO_MODULES_KEYWORD_NOTIFY_H
+#define HIMIKO_MODULES_KEYWORD_NOTIFY_H
+
+#include <concord/discord.h>
+#include "bot.h"
+
+#define KEYWORD_MAX_PER_USER 10
+#define KEYWORD_QUEUE_MAX 1000
+#define KEYWORD_MAX_RECIPIENTS 50       /* per message */
+
+/* Module lifecycle */
+void keyword_notify_init(himiko_bot_t *bot);
+void keyword_notify_cleanup(himiko_bot_t *bot);
+
+/* Message handler - queues DMs for users whose keywords appear */
+void keyword_notify_on_message(struct discord *client, const struct discord_message *msg);
+
+/* Commands */
+void cmd_keyword(struct discord *client, const struct discord_interaction *interaction);
+void cmd_keyword_prefix(struct discord *client, const struct discord_message *msg, const char *args);
+
+void register_keyword_notify_commands(himiko_bot_t *bot);
+
+#endif /* HIMIKO_MODULES_KEYWORD_NOTIFY_H */
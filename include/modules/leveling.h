@@ -0,0 +1,36 @@
+/*
+ * Himiko Discord Bot (C Edition) - Message XP Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#ifndef HIMIKO_MODULES_LEVELING_H
+#define HIMIKO_MODULES_LEVELING_H
+
+#include <concord/discord.h>
+#include "bot.h"
+#include <stdint.h>
+
+#define LEVELING_COOLDOWN_SECS 60
+#define LEVELING_XP_MIN 15
+#define LEVELING_XP_MAX 25
+#define LEVELING_FLUSH_SECS 5
+/* Idle users with nothing to flush are dropped after this long */
+#define LEVELING_IDLE_SECS 600
+
+/* Module lifecycle; cleanup flushes whatever is still pending */
+void leveling_init(himiko_bot_t *bot);
+void leveling_cleanup(himiko_bot_t *bot);
+
+/* Award XP for a guild message, subject to the per-user cooldown */
+void leveling_on_message(struct discord *client, const struct discord_message *msg);
+
+/* XP awarded but not yet written to user_xp */
+int64_t leveling_pending_xp(u64snowflake guild_id, u64snowflake user_id);
+
+/* Reload the cached total after an admin command rewrote it; waits for queued XP writes */
+void leveling_forget(u64snowflake guild_id, u64snowflake user_id);
+
+/* Queue every pending delta now */
+void leveling_flush(void);
+
+#endif /* HIMIKO_MODULES_LEVELING_H */
@@ -10,6 +10,8 @@
 #include "bot.h"
 #include <time.h>
 
+#define MENTION_RESPONSE_MAX_PER_GUILD 50
+
 /* Mention response structure */
 typedef struct {
     int id;
@@ -28,6 +30,9 @@ void mention_response_cleanup(himiko_bot_t *bot);
 /* Check message for mention triggers - returns 1 if handled */
 int mention_response_check(struct discord *client, const struct discord_message *msg);
 
+/* Recompile a guild's triggers after they change in the database */
+void mention_response_invalidate(himiko_bot_t *bot, u64snowflake guild_id);
+
 /* Commands */
 void cmd_mention(struct discord *client, const struct discord_interaction *interaction);
 void cmd_mention_prefix(struct discord *client, const struct discord_message *msg, const char *args);
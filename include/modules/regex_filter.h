@@ -0,0 +1,41 @@
+/*
+ * Himiko Discord Bot (C Edition) - Regex Filter Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#ifndef HIMIKO_MODULES_REGEX_FILTER_H
+#define HIMIKO_MODULES_REGEX_FILTER_H
+
+#include <concord/discord.h>
+#include "bot.h"
+
+#define REGEX_FILTER_MAX_PER_GUILD 100
+#define REGEX_FILTER_DEFAULT_BUDGET_MS 5
+
+/* Regex filter structure */
+typedef struct {
+    int id;
+    char guild_id[32];
+    char pattern[512];
+    char action[32];
+    char reason[256];
+    char created_by[32];
+} regex_filter_t;
+
+/* Module lifecycle */
+void regex_filter_init(himiko_bot_t *bot);
+void regex_filter_cleanup(himiko_bot_t *bot);
+
+/* Message check - returns 1 if a filter matched and was acted on */
+int regex_filter_check(struct discord *client, const struct discord_message *msg);
+
+/* Drop a guild's compiled filters; the next message rebuilds them */
+void regex_filter_invalidate(u64snowflake guild_id);
+
+/* Commands */
+void cmd_regexfilter(struct discord *client, const struct discord_interaction *interaction);
+void cmd_regexfilter_prefix(struct discord *client, const struct discord_message *msg, const char *args);
+
+void register_regex_filter_commands(himiko_bot_t *bot);
+
+#endif /* HIMIKO_MODULES_REGEX_FILTER_H */
@@ -0,0 +1,75 @@
+/*
+ * Himiko Discord Bot (C Edition) - Track Resolution Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * What yt-dlp told us about a URL or search query, so popular tracks are
+ * not resolved again on every play. Two levels: an in-memory LRU in front
+ * of the music_resolve_cache table. Metadata (title, duration, thumbnail,
+ * webpage URL) is kept until purged; signed stream URLs only until the
+ * expiry embedded in them, less a margin so playback can finish.
+ */
+
+#ifndef HIMIKO_MUSIC_CACHE_H
+#define HIMIKO_MUSIC_CACHE_H
+
+#include "database.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MUSIC_CACHE_MEM_ENTRIES     1024
+#define MUSIC_CACHE_KEY_LEN         512
+#define MUSIC_CACHE_STREAM_TTL      3600    /* seconds, for stream URLs without an expiry */
+#define MUSIC_CACHE_EXPIRY_MARGIN   600     /* stop handing out a stream URL this long before it expires */
+
+typedef struct {
+    char title[256];
+    int duration;
+    char thumbnail[512];
+    char webpage_url[512];
+} music_cache_meta_t;
+
+typedef struct {
+    uint64_t meta_memory_hits;
+    uint64_t meta_disk_hits;
+    uint64_t meta_misses;
+    uint64_t stream_memory_hits;
+    uint64_t stream_disk_hits;
+    uint64_t stream_misses;
+    int entries;                /* in memory */
+} music_cache_stats_t;
+
+/* Use db for the persistent level and drop stream URLs that have expired */
+int music_cache_init(himiko_database_t *db);
+
+/* Free the in-memory level */
+void music_cache_cleanup(void);
+
+/*
+ * Reduce a URL or search query to its cache key: YouTube links to their
+ * video id, other URLs to host and path without fragment, searches to
+ * lowercase with single spaces.
+ */
+void music_cache_normalize(const char *query, char *key, size_t len);
+
+/* 1 on hit, 0 on miss */
+int music_cache_get_meta(const char *key, music_cache_meta_t *meta);
+void music_cache_put_meta(const char *key, const music_cache_meta_t *meta);
+
+/* 1 on hit (url filled), 0 on miss or if the cached URL is about to expire */
+int music_cache_get_stream(const char *key, char *url, size_t len);
+void music_cache_put_stream(const char *key, const char *url);
+
+/* When a stream URL stops working: its expire= parameter, or now + MUSIC_CACHE_STREAM_TTL */
+time_t music_cache_stream_expiry(const char *url, time_t now);
+
+/*
+ * Forget a key and everything that resolved to the same page, or every
+ * entry when key is NULL. Returns the number of entries removed, -1 on error.
+ */
+int music_cache_purge(const char *key);
+
+void music_cache_get_stats(music_cache_stats_t *stats);
+
+#endif /* HIMIKO_MUSIC_CACHE_H */
@@ -0,0 +1,56 @@
+/*
+ * Himiko Discord Bot (C Edition) - Pressure Table
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Per-(guild, user) anti-spam state. Entries are split across stripes
+ * chosen by a hash of the pair; each stripe is its own open-addressing
+ * table with its own lock and CLOCK hand, so concurrent message checks
+ * only contend when they land on the same stripe.
+ */
+
+#ifndef HIMIKO_PRESSURE_TABLE_H
+#define HIMIKO_PRESSURE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PRESSURE_TABLE_STRIPES 64
+#define PRESSURE_TABLE_INITIAL_SLOTS 64
+#define PRESSURE_TABLE_HISTORY 4
+
+/* One tracked user; user_id 0 marks an empty slot */
+typedef struct {
+    uint64_t guild_id;
+    uint64_t user_id;
+    double pressure;
+    uint64_t recent[PRESSURE_TABLE_HISTORY]; /* SimHash of the last messages, 0 = unused */
+    time_t last_update;
+    uint32_t recent_next;
+    int referenced;             /* CLOCK bit, set on every hit */
+} user_pressure_t;
+
+typedef struct pressure_table pressure_table_t;
+
+/* Runs under the stripe lock; returns the value handed back to the caller */
+typedef double (*pressure_update_fn)(user_pressure_t *user, void *ctx);
+
+/*
+ * stripes is rounded up to a power of two. max_users caps occupancy and
+ * max_bytes caps slot memory; both are split evenly between stripes.
+ */
+pressure_table_t *pressure_table_create(int stripes, size_t max_users, size_t max_bytes);
+void pressure_table_destroy(pressure_table_t *table);
+
+/* Find or create the entry and apply fn to it */
+double pressure_table_update(pressure_table_t *table, uint64_t guild_id, uint64_t user_id,
+                             pressure_update_fn fn, void *ctx);
+
+/* Clear pressure and repeat state; no-op if the user is not tracked */
+void pressure_table_reset(pressure_table_t *table, uint64_t guild_id, uint64_t user_id);
+
+size_t pressure_table_count(pressure_table_t *table);
+unsigned long long pressure_table_evictions(pressure_table_t *table);
+
+#endif /* HIMIKO_PRESSURE_TABLE_H */
@@ -0,0 +1,49 @@
+/*
+ * Himiko Discord Bot (C Edition) - Regex Engine
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Matches one text against a set of POSIX extended, case-insensitive
+ * patterns. Each pattern's longest required literal goes into a single
+ * Aho-Corasick automaton, so one pass over the text rules out every
+ * pattern whose literal is absent; only the rest run regexec. Patterns
+ * with no usable literal are always confirmed.
+ */
+
+#ifndef HIMIKO_REGEX_ENGINE_H
+#define HIMIKO_REGEX_ENGINE_H
+
+#include <stddef.h>
+
+#define REGEX_ENGINE_MAX_PATTERNS 128
+#define REGEX_ENGINE_MIN_LITERAL 3      /* shorter literals filter too little */
+#define REGEX_ENGINE_MAX_LITERAL 32
+#define REGEX_ENGINE_STRIKES 3          /* budget overruns before a pattern is disabled */
+
+#define REGEX_ENGINE_NO_MATCH (-1)
+#define REGEX_ENGINE_OVER_BUDGET (-2)
+
+typedef struct regex_engine regex_engine_t;
+
+/*
+ * Compile up to REGEX_ENGINE_MAX_PATTERNS patterns. One that fails to
+ * compile never matches but keeps its index. NULL on allocation failure.
+ */
+regex_engine_t *regex_engine_build(const char *const *patterns, int count);
+void regex_engine_free(regex_engine_t *engine);
+
+/*
+ * Index of the first pattern, in build order, that matches text. Stops
+ * with REGEX_ENGINE_OVER_BUDGET once budget_us has been spent; a pattern
+ * that overruns the whole budget by itself REGEX_ENGINE_STRIKES times is
+ * disabled for the life of the engine. Safe to call from many threads.
+ */
+int regex_engine_match(regex_engine_t *engine, const char *text, long budget_us);
+
+/* 0 if pattern compiles; otherwise -1 with the reason in err */
+int regex_engine_check(const char *pattern, char *err, size_t err_size);
+
+/* Longest literal every match of pattern must contain, lowercased; returns its length */
+size_t regex_engine_literal(const char *pattern, char *out, size_t out_size);
+
+#endif /* HIMIKO_REGEX_ENGINE_H */
@@ -0,0 +1,58 @@
+/*
+ * Himiko Discord Bot (C Edition) - Resolver Pool
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Keeps a few yt-dlp resolver processes running instead of starting one
+ * per lookup. Workers are started with fork/exec (no shell) and speak one
+ * JSON object per line on stdin/stdout:
+ *   request  {"id":1,"op":"resolve"|"stream","query":"..."}
+ *   reply    {"id":1,"ok":true,...} or {"id":1,"ok":false,"error":"..."}
+ * Requests queue FIFO and each one gets a deadline; a worker that misses
+ * it, crashes or talks garbage is killed and started again.
+ * See scripts/ytdlp_worker.py and the offline scripts/ytdlp_worker_stub.py.
+ */
+
+#ifndef HIMIKO_RESOLVER_POOL_H
+#define HIMIKO_RESOLVER_POOL_H
+
+#include "music_cache.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESOLVER_POOL_MAX_WORKERS       16
+#define RESOLVER_POOL_DEFAULT_WORKERS   2
+#define RESOLVER_POOL_DEFAULT_TIMEOUT   30      /* seconds per request */
+#define RESOLVER_POOL_QUEUE_DEPTH       256
+#define RESOLVER_POOL_RESTART_DELAY_MS  1000    /* between starts of the same worker */
+#define RESOLVER_POOL_REPLY_MAX         65536
+
+typedef struct {
+    uint64_t requests;
+    uint64_t failures;          /* worker answered ok:false */
+    uint64_t timeouts;
+    uint64_t restarts;          /* workers started again after dying or being killed */
+    int workers;
+    int workers_alive;
+    int queued;
+} resolver_pool_stats_t;
+
+/*
+ * Start workers copies of worker_path. With workers 0, or while a worker
+ * cannot be started, each request execs yt-dlp once instead (still
+ * without a shell).
+ */
+int resolver_pool_init(const char *worker_path, int workers, int timeout_secs);
+
+/* Fail queued requests, stop the workers and join their threads */
+void resolver_pool_shutdown(void);
+
+/* Metadata for a URL or "ytsearch:" query. 0 on success, -1 on failure or timeout. */
+int resolver_pool_resolve(const char *query, music_cache_meta_t *meta);
+
+/* Best audio stream URL for a page URL. 0 on success, -1 on failure or timeout. */
+int resolver_pool_stream_url(const char *url, char *out, size_t len);
+
+void resolver_pool_get_stats(resolver_pool_stats_t *stats);
+
+#endif /* HIMIKO_RESOLVER_POOL_H */
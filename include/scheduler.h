@@ -0,0 +1,47 @@
+/*
+ * Himiko Discord Bot (C Edition) - Scheduler
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * One thread owns every timed job: reminders, autoclean runs, lockdown
+ * expiry and rows in scheduled_events. Timers sit in a min-heap keyed by
+ * their wall-clock deadline and the thread sleeps until the earliest one,
+ * so nothing polls the database. Timers are loaded from SQLite once at
+ * startup and added by the command paths afterwards.
+ */
+
+#ifndef HIMIKO_SCHEDULER_H
+#define HIMIKO_SCHEDULER_H
+
+#include "database.h"
+#include <time.h>
+
+#define SCHEDULER_MAX_EVENT_TYPES 16
+
+typedef void (*scheduler_fn)(void *arg);
+typedef void (*scheduler_event_fn)(const scheduled_event_t *event);
+
+/* Start the thread and load scheduled_events from db. 0 on success. */
+int scheduler_init(himiko_database_t *db);
+
+/* Join the thread; timers that have not fired are dropped */
+void scheduler_shutdown(void);
+
+/*
+ * Run fn(arg) on the scheduler thread at when (already-due timers fire at
+ * once). drop(arg), if set, runs after fn or when the timer is discarded.
+ * Timers may be added before scheduler_init. Returns -1 on allocation failure.
+ */
+int scheduler_add(time_t when, scheduler_fn fn, scheduler_fn drop, void *arg);
+
+/* Handle scheduled_events rows of event_type; the row is deleted once fn returns */
+int scheduler_register_event(const char *event_type, scheduler_event_fn fn);
+
+/* Persist an event in scheduled_events and arm its timer */
+int scheduler_add_event(himiko_database_t *db, const char *guild_id, const char *event_type,
+                        const char *target_id, time_t execute_at);
+
+/* Timers waiting to fire */
+int scheduler_pending(void);
+
+#endif /* HIMIKO_SCHEDULER_H */
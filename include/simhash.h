@@ -0,0 +1,25 @@
+/*
+ * Himiko Discord Bot (C Edition) - SimHash
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * 64-bit SimHash over character trigrams of normalized text (ASCII
+ * lowercased, whitespace runs collapsed). Texts that differ by a few
+ * characters land a few bits apart, so near-duplicates are found by
+ * Hamming distance instead of string equality.
+ */
+
+#ifndef HIMIKO_SIMHASH_H
+#define HIMIKO_SIMHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fingerprint of text; 0 for empty or whitespace-only text */
+uint64_t simhash_text(const char *text);
+
+static inline int simhash_distance(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+#endif /* HIMIKO_SIMHASH_H */
@@ -0,0 +1,51 @@
+/*
+ * Himiko Discord Bot (C Edition) - Spam Wave Detector
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Catches the same content posted by many different accounts within a
+ * few seconds, which per-user pressure never sees. Each guild has a
+ * count-min sketch over normalized content fingerprints, split into
+ * rotating sub-windows, and a small top-K of heavy hitters that tracks
+ * who posted them. Memory per guild is fixed.
+ */
+
+#ifndef HIMIKO_WAVE_DETECTOR_H
+#define HIMIKO_WAVE_DETECTOR_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define WAVE_SKETCH_DEPTH 4
+#define WAVE_SKETCH_WIDTH 256
+#define WAVE_SUBWINDOWS 4
+#define WAVE_TOP_K 8
+#define WAVE_MAX_POSTS 16
+#define WAVE_RECENT_POSTS 64     /* untracked posts kept per guild for backfill */
+#define WAVE_MIN_CONTENT 16      /* normalized bytes; shorter chatter is ignored */
+#define WAVE_DEFAULT_MIN_AUTHORS 5
+#define WAVE_DEFAULT_WINDOW_SECS 20
+
+typedef struct {
+    uint64_t channel_id;
+    uint64_t message_id;
+    uint64_t author_id;
+    time_t posted_at;
+} wave_post_t;
+
+/* Thresholds apply to every guild. 0 on success. */
+int wave_detector_init(int min_authors, int window_secs);
+void wave_detector_cleanup(void);
+
+/* Fingerprint of lowercased letters and digits; 0 if too short to judge */
+uint64_t wave_fingerprint(const char *text);
+
+/*
+ * Record one post. Returns 1 if its content is part of a flagged wave.
+ * On the post that trips the threshold, the earlier tracked posts are
+ * copied to earlier so the caller can act on them too.
+ */
+int wave_detector_observe(uint64_t guild_id, uint64_t fingerprint, const wave_post_t *post,
+                          wave_post_t *earlier, int max_earlier, int *earlier_count);
+
+#endif /* HIMIKO_WAVE_DETECTOR_H */
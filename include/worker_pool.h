@@ -0,0 +1,43 @@
+/*
+ * Himiko Discord Bot (C Edition) - Worker Pool
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Runs command handlers off the gateway thread. Jobs are hashed by key
+ * (the guild ID) into lanes; a lane runs on one worker at a time, so jobs
+ * with the same key execute in submission order. Runnable lanes sit on a
+ * per-worker deque and idle workers steal from their siblings.
+ */
+
+#ifndef HIMIKO_WORKER_POOL_H
+#define HIMIKO_WORKER_POOL_H
+
+#include <stdint.h>
+
+#define WORKER_POOL_LANES 256
+#define WORKER_POOL_MAX_THREADS 64
+#define WORKER_POOL_DEFAULT_THREADS 4
+#define WORKER_POOL_DEFAULT_QUEUE_DEPTH 1024
+
+typedef void (*worker_job_fn)(void *arg);
+
+/* Start threads workers; at most queue_depth jobs may be pending. 0 on success. */
+int worker_pool_init(int threads, int queue_depth);
+
+/* Stop accepting jobs, run every queued one, then join the workers */
+void worker_pool_shutdown(void);
+
+/*
+ * Queue fn(arg) behind earlier jobs with the same key.
+ * Returns -1 if the pool is not running, is shutting down or is full;
+ * the caller still owns arg and should run the job itself.
+ */
+int worker_pool_submit(uint64_t key, worker_job_fn fn, void *arg);
+
+/* Jobs queued or running right now */
+int worker_pool_pending(void);
+
+/* Whether submit can take jobs at all (as opposed to being full) */
+int worker_pool_running(void);
+
+#endif /* HIMIKO_WORKER_POOL_H */
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Himiko Discord Bot (C Edition) - yt-dlp Resolver Worker
+# Copyright (C) 2025 Himiko Contributors
+# SPDX-License-Identifier: AGPL-3.0-or-later
+#
+# Long-lived resolver run by src/resolver_pool.c, so Python and yt-dlp are
+# loaded once instead of on every lookup. One JSON object per line:
+#
+#   {"id": 1, "op": "resolve", "query": "ytsearch:never gonna give you up"}
+#   {"id": 1, "ok": true, "title": "...", "duration": 213,
+#    "thumbnail": "https://...", "webpage_url": "https://..."}
+#
+#   {"id": 2, "op": "stream", "query": "https://www.youtube.com/watch?v=..."}
+#   {"id": 2, "ok": true, "url": "https://...googlevideo.com/..."}
+#
+# Failures answer {"id": N, "ok": false, "error": "..."}. Exits at EOF.
+# Needs the yt_dlp module (pip install yt-dlp).
+
+import json
+import sys
+
+import yt_dlp
+
+COMMON = {
+    "quiet": True,
+    "no_warnings": True,
+    "noplaylist": True,
+    "skip_download": True,
+}
+
+
+def first_entry(info):
+    # ytsearch: queries come back as a one-entry playlist
+    while info and info.get("_type") == "playlist":
+        entries = list(info.get("entries") or [])
+        info = entries[0] if entries else None
+    if not info:
+        raise ValueError("no results")
+    return info
+
+
+def resolve(ydl, query):
+    info = first_entry(ydl.extract_info(query, download=False))
+    return {
+        "title": info.get("title") or "",
+        "duration": int(info.get("duration") or 0),
+        "thumbnail": info.get("thumbnail") or "",
+        "webpage_url": info.get("webpage_url") or query,
+    }
+
+
+def stream(ydl, query):
+    info = first_entry(ydl.extract_info(query, download=False))
+    url = info.get("url")
+    if not url:
+        formats = info.get("requested_formats") or []
+        url = formats[0].get("url") if formats else None
+    if not url:
+        raise ValueError("no audio format")
+    return {"url": url}
+
+
+def main():
+    # yt-dlp may print; replies own stdout
+    out = sys.stdout
+    sys.stdout = sys.stderr
+
+    meta_ydl = yt_dlp.YoutubeDL(dict(COMMON))
+    stream_ydl = yt_dlp.YoutubeDL(dict(COMMON, format="bestaudio/best"))
+    ops = {"resolve": (resolve, meta_ydl), "stream": (stream, stream_ydl)}
+
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        reply = {"id": None, "ok": False}
+        try:
+            request = json.loads(line)
+            reply["id"] = request.get("id")
+            handler, ydl = ops[request.get("op")]
+            reply.update(handler(ydl, request["query"]))
+            reply["ok"] = True
+        except KeyError as e:
+            reply["error"] = "bad request: missing or unknown %s" % e
+        except Exception as e:  # yt-dlp raises a zoo of types
+            reply["error"] = str(e) or type(e).__name__
+        out.write(json.dumps(reply) + "\n")
+        out.flush()
+
+
+if __name__ == "__main__":
+    main()
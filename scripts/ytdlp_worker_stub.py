@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# Himiko Discord Bot (C Edition) - Offline Resolver Worker
+# Copyright (C) 2025 Himiko Contributors
+# SPDX-License-Identifier: AGPL-3.0-or-later
+#
+# Speaks the same protocol as ytdlp_worker.py without touching the network,
+# for running the bot or the resolver pool offline. Point
+# features.resolver_worker at this file. Every stream resolves to
+# $HIMIKO_STUB_AUDIO (any file ffmpeg can read), or to the query itself.
+#
+# Queries that exercise the pool's failure handling:
+#   stub:fail   answer ok:false
+#   stub:hang   never answer (request timeout, worker killed)
+#   stub:crash  exit without answering (worker restarted)
+#   stub:noise  print a non-JSON line before answering
+
+import json
+import os
+import sys
+import time
+import zlib
+
+
+def resolve(query):
+    name = query.split(":", 1)[1] if query.startswith("ytsearch:") else query
+    vid = "%08x" % (zlib.crc32(name.encode()) & 0xffffffff)
+    page = query if "://" in query else "https://stub.invalid/watch?v=" + vid
+    return {
+        "title": "Stub: " + name.strip(),
+        "duration": 30 + zlib.crc32(name.encode()) % 270,
+        "thumbnail": "https://stub.invalid/thumb/%s.jpg" % vid,
+        "webpage_url": page,
+    }
+
+
+def stream(query):
+    return {"url": os.environ.get("HIMIKO_STUB_AUDIO") or query}
+
+
+def main():
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        request = json.loads(line)
+        query = request.get("query", "")
+        reply = {"id": request.get("id"), "ok": True}
+
+        if query == "stub:hang":
+            time.sleep(3600)
+        elif query == "stub:crash":
+            sys.exit(1)
+        elif query == "stub:noise":
+            print("[youtube] not a reply", flush=True)
+
+        if query == "stub:fail":
+            reply = {"id": request.get("id"), "ok": False, "error": "stub failure"}
+        elif request.get("op") == "resolve":
+            reply.update(resolve(query))
+        elif request.get("op") == "stream":
+            reply.update(stream(query))
+        else:
+            reply = {"id": request.get("id"), "ok": False, "error": "unknown op"}
+
+        print(json.dumps(reply), flush=True)
+
+
+if __name__ == "__main__":
+    main()
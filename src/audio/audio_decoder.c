@@ -0,0 +1,445 @@
+/*
+ * Himiko Discord Bot (C Edition) - Audio Decoder
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "audio/audio_decoder.h"
+#include "audio/audio_stream.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+
+#ifdef HAVE_LIBAV
+#include <pthread.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+#endif
+
+struct audio_decoder {
+    audio_decoder_backend_t backend;
+    atomic_bool interrupted;
+
+    /* PCM decoded ahead by prime, handed out before the backend is read again */
+    int16_t *primed;
+    int primed_len;     /* samples per channel */
+    int primed_pos;
+
+    /* ffmpeg subprocess */
+    pid_t pid;
+    int pipe_fd;        /* read end */
+
+#ifdef HAVE_LIBAV
+    AVFormatContext *format;
+    AVCodecContext *codec;
+    SwrContext *swr;
+    AVPacket *packet;
+    AVFrame *frame;
+    int stream_index;
+    int input_done;     /* demuxer hit the end; decoder was sent the flush packet */
+    int decoder_done;   /* decoder has no more frames */
+#endif
+};
+
+const char *audio_decoder_backend_name(audio_decoder_backend_t backend) {
+    switch (backend) {
+        case AUDIO_DECODER_LIBAV: return "libav";
+        case AUDIO_DECODER_FFMPEG: return "ffmpeg";
+        default: return "auto";
+    }
+}
+
+audio_decoder_backend_t audio_decoder_get_backend(const audio_decoder_t *decoder) {
+    return decoder ? decoder->backend : AUDIO_DECODER_AUTO;
+}
+
+/* ffmpeg subprocess backend */
+
+/* Read exactly n bytes from file descriptor */
+static ssize_t read_full(int fd, void *buf, size_t count) {
+    size_t total = 0;
+    uint8_t *ptr = buf;
+
+    while (total < count) {
+        ssize_t n = read(fd, ptr + total, count - total);
+        if (n <= 0) {
+            if (n == 0) return (ssize_t)total;  /* EOF */
+            if (errno == EINTR) continue;
+            return -1;  /* Error */
+        }
+        total += (size_t)n;
+    }
+    return (ssize_t)total;
+}
+
+static int open_ffmpeg(audio_decoder_t *d, const char *url) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        DEBUG_LOG("Failed to create pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        DEBUG_LOG("Failed to fork: %s", strerror(errno));
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Child process */
+        close(pipefd[0]);  /* Close read end */
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[1]);
+
+        /* Redirect stderr to /dev/null */
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+        }
+
+        /* Execute FFmpeg */
+        execlp("ffmpeg", "ffmpeg",
+               "-reconnect", "1",
+               "-reconnect_streamed", "1",
+               "-reconnect_delay_max", "5",
+               "-i", url,
+               "-f", "s16le",           /* Raw PCM output */
+               "-ar", "48000",          /* 48kHz sample rate */
+               "-ac", "2",              /* Stereo */
+               "-acodec", "pcm_s16le",
+               "pipe:1",                /* Output to stdout */
+               NULL);
+
+        /* If exec fails */
+        _exit(1);
+    }
+
+    /* Parent process */
+    close(pipefd[1]);  /* Close write end */
+
+    d->pid = pid;
+    d->pipe_fd = pipefd[0];
+
+    DEBUG_LOG("Started FFmpeg (PID %d) for URL: %s", pid, url);
+    return 0;
+}
+
+static int read_ffmpeg(audio_decoder_t *d, int16_t *pcm, int frames) {
+    size_t frame_bytes = AUDIO_CHANNELS * sizeof(int16_t);
+    ssize_t n = read_full(d->pipe_fd, pcm, (size_t)frames * frame_bytes);
+    if (n < 0) return -1;
+    return (int)((size_t)n / frame_bytes);
+}
+
+static void close_ffmpeg(audio_decoder_t *d) {
+    if (d->pid > 0) {
+        kill(d->pid, SIGTERM);
+
+        /* Wait briefly for graceful shutdown */
+        int status;
+        pid_t result = waitpid(d->pid, &status, WNOHANG);
+        if (result == 0) {
+            /* Still running, give it a moment */
+            usleep(100000);  /* 100ms */
+            result = waitpid(d->pid, &status, WNOHANG);
+            if (result == 0) {
+                /* Force kill */
+                kill(d->pid, SIGKILL);
+                waitpid(d->pid, &status, 0);
+            }
+        }
+
+        DEBUG_LOG("Stopped FFmpeg (PID %d)", d->pid);
+        d->pid = -1;
+    }
+
+    if (d->pipe_fd >= 0) {
+        close(d->pipe_fd);
+        d->pipe_fd = -1;
+    }
+}
+
+/* In-process libav backend */
+
+#ifdef HAVE_LIBAV
+static pthread_once_t g_libav_once = PTHREAD_ONCE_INIT;
+
+/* Non-NULL and empty: pull what swr already holds without flushing it */
+static const uint8_t *g_no_input[64];
+
+static void libav_global_init(void) {
+    /* ffmpeg's stderr went to /dev/null too */
+    av_log_set_level(AV_LOG_QUIET);
+    avformat_network_init();
+}
+
+static int libav_interrupt_cb(void *opaque) {
+    audio_decoder_t *d = opaque;
+    return atomic_load(&d->interrupted);
+}
+
+static void close_libav(audio_decoder_t *d) {
+    av_frame_free(&d->frame);
+    av_packet_free(&d->packet);
+    swr_free(&d->swr);
+    avcodec_free_context(&d->codec);
+    avformat_close_input(&d->format);
+}
+
+static int open_libav(audio_decoder_t *d, const char *url) {
+    pthread_once(&g_libav_once, libav_global_init);
+
+    d->format = avformat_alloc_context();
+    if (!d->format) return -1;
+    d->format->interrupt_callback.callback = libav_interrupt_cb;
+    d->format->interrupt_callback.opaque = d;
+
+    /* Same reconnect behaviour as the ffmpeg command line */
+    AVDictionary *options = NULL;
+    av_dict_set(&options, "reconnect", "1", 0);
+    av_dict_set(&options, "reconnect_streamed", "1", 0);
+    av_dict_set(&options, "reconnect_delay_max", "5", 0);
+    int err = avformat_open_input(&d->format, url, NULL, &options);
+    av_dict_free(&options);
+    if (err < 0) return -1;     /* format context is freed on failure */
+
+    if (avformat_find_stream_info(d->format, NULL) < 0) return -1;
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+    const AVCodec *codec = NULL;
+#else
+    AVCodec *codec = NULL;
+#endif
+    d->stream_index = av_find_best_stream(d->format, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (d->stream_index < 0 || !codec) return -1;
+
+    /* Skip video and other tracks in the demuxer */
+    for (unsigned i = 0; i < d->format->nb_streams; i++) {
+        if ((int)i != d->stream_index) d->format->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    d->codec = avcodec_alloc_context3(codec);
+    if (!d->codec ||
+        avcodec_parameters_to_context(d->codec, d->format->streams[d->stream_index]->codecpar) < 0 ||
+        avcodec_open2(d->codec, codec, NULL) < 0 ||
+        d->codec->sample_rate <= 0) {
+        return -1;
+    }
+
+#if LIBSWRESAMPLE_VERSION_INT >= AV_VERSION_INT(4, 5, 100)
+    AVChannelLayout out_layout = AV_CHANNEL_LAYOUT_STEREO;
+    AVChannelLayout in_layout;
+    if (d->codec->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
+        av_channel_layout_default(&in_layout, d->codec->ch_layout.nb_channels);
+    } else if (av_channel_layout_copy(&in_layout, &d->codec->ch_layout) < 0) {
+        return -1;
+    }
+    err = swr_alloc_set_opts2(&d->swr, &out_layout, AV_SAMPLE_FMT_S16, AUDIO_SAMPLE_RATE,
+                              &in_layout, d->codec->sample_fmt, d->codec->sample_rate, 0, NULL);
+    av_channel_layout_uninit(&in_layout);
+    if (err < 0) return -1;
+#else
+    int64_t in_layout = d->codec->channel_layout ? (int64_t)d->codec->channel_layout
+                                                 : av_get_default_channel_layout(d->codec->channels);
+    d->swr = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, AUDIO_SAMPLE_RATE,
+                                in_layout, d->codec->sample_fmt, d->codec->sample_rate, 0, NULL);
+#endif
+    if (!d->swr || swr_init(d->swr) < 0) return -1;
+
+    d->packet = av_packet_alloc();
+    d->frame = av_frame_alloc();
+    if (!d->packet || !d->frame) return -1;
+
+    DEBUG_LOG("libav decoding %s (%s, %d Hz) from %s",
+              codec->name, av_get_sample_fmt_name(d->codec->sample_fmt), d->codec->sample_rate, url);
+    return 0;
+}
+
+/* Hand the decoder its next packet, or the flush packet at end of input */
+static int feed_packet(audio_decoder_t *d) {
+    for (;;) {
+        int err = av_read_frame(d->format, d->packet);
+        if (err == AVERROR_EOF) {
+            d->input_done = 1;
+            return avcodec_send_packet(d->codec, NULL) < 0 ? -1 : 0;
+        }
+        if (err < 0) return -1;     /* includes AVERROR_EXIT from an interrupt */
+
+        if (d->packet->stream_index != d->stream_index) {
+            av_packet_unref(d->packet);
+            continue;
+        }
+        err = avcodec_send_packet(d->codec, d->packet);
+        av_packet_unref(d->packet);
+        /* A damaged packet costs a few ms of audio, not the track */
+        if (err < 0 && err != AVERROR_INVALIDDATA) return -1;
+        return 0;
+    }
+}
+
+static int read_libav(audio_decoder_t *d, int16_t *pcm, int frames) {
+    int got = 0;
+
+    while (got < frames) {
+        /* Samples swr buffered from the previous frame go out first */
+        uint8_t *out = (uint8_t *)(pcm + (size_t)got * AUDIO_CHANNELS);
+        int n = swr_convert(d->swr, &out, frames - got, d->decoder_done ? NULL : g_no_input, 0);
+        if (n < 0) return -1;
+        got += n;
+        if (got == frames || d->decoder_done) break;
+
+        int err = avcodec_receive_frame(d->codec, d->frame);
+        if (err == AVERROR(EAGAIN)) {
+            if (d->input_done) {
+                d->decoder_done = 1;
+            } else if (feed_packet(d) < 0) {
+                return got > 0 ? got : -1;
+            }
+            continue;
+        }
+        if (err == AVERROR_EOF) {
+            d->decoder_done = 1;    /* one more pass flushes the resampler */
+            continue;
+        }
+        if (err < 0) return -1;
+
+        out = (uint8_t *)(pcm + (size_t)got * AUDIO_CHANNELS);
+        n = swr_convert(d->swr, &out, frames - got,
+                        (const uint8_t **)d->frame->extended_data, d->frame->nb_samples);
+        av_frame_unref(d->frame);
+        if (n < 0) return -1;
+        got += n;
+    }
+    return got;
+}
+#endif /* HAVE_LIBAV */
+
+audio_decoder_t *audio_decoder_open(const char *url, audio_decoder_backend_t backend) {
+    if (!url) return NULL;
+
+    audio_decoder_t *d = calloc(1, sizeof(audio_decoder_t));
+    if (!d) return NULL;
+    d->pid = -1;
+    d->pipe_fd = -1;
+    atomic_init(&d->interrupted, false);
+
+#ifdef HAVE_LIBAV
+    if (backend == AUDIO_DECODER_AUTO || backend == AUDIO_DECODER_LIBAV) {
+        if (open_libav(d, url) == 0) {
+            d->backend = AUDIO_DECODER_LIBAV;
+            return d;
+        }
+        close_libav(d);
+        d->input_done = d->decoder_done = 0;
+        if (backend == AUDIO_DECODER_LIBAV) {
+            free(d);
+            return NULL;
+        }
+        DEBUG_LOG("libav could not open %s, falling back to ffmpeg", url);
+    }
+#else
+    if (backend == AUDIO_DECODER_LIBAV) {
+        free(d);
+        return NULL;
+    }
+#endif
+
+    if (open_ffmpeg(d, url) != 0) {
+        free(d);
+        return NULL;
+    }
+    d->backend = AUDIO_DECODER_FFMPEG;
+    return d;
+}
+
+static int read_backend(audio_decoder_t *d, int16_t *pcm, int frames) {
+#ifdef HAVE_LIBAV
+    if (d->backend == AUDIO_DECODER_LIBAV) return read_libav(d, pcm, frames);
+#endif
+    return read_ffmpeg(d, pcm, frames);
+}
+
+int audio_decoder_read(audio_decoder_t *decoder, int16_t *pcm, int frames) {
+    if (!decoder || !pcm || frames <= 0) return -1;
+    if (atomic_load(&decoder->interrupted)) return 0;
+
+    int got = 0;
+    if (decoder->primed) {
+        got = decoder->primed_len - decoder->primed_pos;
+        if (got > frames) got = frames;
+        memcpy(pcm, decoder->primed + (size_t)decoder->primed_pos * AUDIO_CHANNELS,
+               (size_t)got * AUDIO_CHANNELS * sizeof(int16_t));
+        decoder->primed_pos += got;
+        if (decoder->primed_pos == decoder->primed_len) {
+            free(decoder->primed);
+            decoder->primed = NULL;
+        }
+        if (got == frames) return got;
+    }
+
+    int n = read_backend(decoder, pcm + (size_t)got * AUDIO_CHANNELS, frames - got);
+    if (n < 0) return got > 0 ? got : -1;
+    return got + n;
+}
+
+int audio_decoder_prime(audio_decoder_t *decoder, int frames) {
+    if (!decoder || frames <= 0 || decoder->primed) return -1;
+
+    int16_t *buf = malloc((size_t)frames * AUDIO_CHANNELS * sizeof(int16_t));
+    if (!buf) return -1;
+
+    int got = 0;
+    while (got < frames && !atomic_load(&decoder->interrupted)) {
+        int want = frames - got < AUDIO_FRAME_SAMPLES ? frames - got : AUDIO_FRAME_SAMPLES;
+        int n = read_backend(decoder, buf + (size_t)got * AUDIO_CHANNELS, want);
+        if (n < 0) {
+            free(buf);
+            return -1;
+        }
+        got += n;
+        if (n < want) break;    /* end of stream */
+    }
+
+    if (got == 0) {
+        free(buf);
+        return 0;
+    }
+    decoder->primed = buf;
+    decoder->primed_len = got;
+    decoder->primed_pos = 0;
+    return got;
+}
+
+void audio_decoder_interrupt(audio_decoder_t *decoder) {
+    if (!decoder) return;
+    atomic_store(&decoder->interrupted, true);
+
+    /* libav polls the flag; a blocked pipe read needs the writer gone */
+    if (decoder->backend == AUDIO_DECODER_FFMPEG && decoder->pid > 0) {
+        kill(decoder->pid, SIGTERM);
+    }
+}
+
+void audio_decoder_close(audio_decoder_t *decoder) {
+    if (!decoder) return;
+
+#ifdef HAVE_LIBAV
+    close_libav(decoder);
+#endif
+    close_ffmpeg(decoder);
+    free(decoder->primed);
+    free(decoder);
+}
@@ -5,16 +5,13 @@
  */
 
 #include "audio/audio_stream.h"
+#include "audio/opus_ring.h"
 #include "debug.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <errno.h>
-#include <signal.h>
-#include <sys/wait.h>
-#include <fcntl.h>
 #include <time.h>
 
 #ifdef HAVE_OPUS
@@ -25,6 +22,25 @@
 #include <concord/discord.h>
 #endif
 
+/* One Opus frame of digital silence */
+static const uint8_t OPUS_SILENCE_FRAME[] = {0xF8, 0xFF, 0xFE};
+
+/*
+ * One track's worth of state shared by the audio thread and its decode
+ * thread. Per playback rather than per stream, so a thread left over from
+ * a stop that timed out never touches the next track's ring or encoder.
+ */
+typedef struct {
+    audio_stream_t *stream;
+    audio_decoder_t *decoder;
+#ifdef HAVE_OPUS
+    OpusEncoder *encoder;
+#endif
+    opus_ring_t ring;
+    atomic_bool stop;       /* set by the audio thread */
+    atomic_bool finished;   /* set by the decode thread after its last frame */
+} playback_t;
+
 /* Helper to sleep until next frame time with precise timing */
 static void sleep_until_next_frame(struct timespec *next) {
     clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL);
@@ -51,123 +67,117 @@ static void apply_volume(int16_t *samples, size_t count, int volume) {
     }
 }
 
-/* Read exactly n bytes from file descriptor */
-static ssize_t read_full(int fd, void *buf, size_t count) {
-    size_t total = 0;
-    uint8_t *ptr = buf;
-
-    while (total < count) {
-        ssize_t n = read(fd, ptr + total, count - total);
-        if (n <= 0) {
-            if (n == 0) return (ssize_t)total;  /* EOF */
-            if (errno == EINTR) continue;
-            return -1;  /* Error */
+#ifdef HAVE_OPUS
+/* Producer: decode, apply volume and encode into the ring until the track ends */
+static void *decode_thread_func(void *arg) {
+    playback_t *pb = arg;
+    audio_stream_t *stream = pb->stream;
+    OpusEncoder *encoder = pb->encoder;
+    int16_t pcm_buffer[AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS];
+    bool waiting = false;
+
+    while (!atomic_load(&pb->stop)) {
+        opus_frame_t *slot = opus_ring_reserve(&pb->ring);
+        if (!slot) {
+            /* A full ring ahead of the sender; a slot frees up every frame */
+            if (!waiting) atomic_fetch_add(&stream->overruns, 1);
+            waiting = true;
+            usleep(AUDIO_FRAME_MS * 1000);
+            continue;
         }
-        total += (size_t)n;
-    }
-    return (ssize_t)total;
-}
+        waiting = false;
 
-/* Start FFmpeg subprocess */
-static int start_ffmpeg(audio_stream_t *stream, const char *url) {
-    int pipefd[2];
-    if (pipe(pipefd) < 0) {
-        DEBUG_LOG("Failed to create pipe: %s", strerror(errno));
-        return -1;
-    }
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        DEBUG_LOG("Failed to fork: %s", strerror(errno));
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return -1;
-    }
+        /* Decode one frame of PCM straight into the encoder's buffer */
+        int samples = audio_decoder_read(pb->decoder, pcm_buffer, AUDIO_FRAME_SAMPLES);
 
-    if (pid == 0) {
-        /* Child process */
-        close(pipefd[0]);  /* Close read end */
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[1]);
-
-        /* Redirect stderr to /dev/null */
-        int devnull = open("/dev/null", O_WRONLY);
-        if (devnull >= 0) {
-            dup2(devnull, STDERR_FILENO);
-            close(devnull);
+        if (samples <= 0) {
+            /* EOF or error - track ended */
+            DEBUG_LOG("Decoder stream ended (read returned %d)", samples);
+            break;
         }
 
-        /* Execute FFmpeg */
-        execlp("ffmpeg", "ffmpeg",
-               "-reconnect", "1",
-               "-reconnect_streamed", "1",
-               "-reconnect_delay_max", "5",
-               "-i", url,
-               "-f", "s16le",           /* Raw PCM output */
-               "-ar", "48000",          /* 48kHz sample rate */
-               "-ac", "2",              /* Stereo */
-               "-acodec", "pcm_s16le",
-               "pipe:1",                /* Output to stdout */
-               NULL);
-
-        /* If exec fails */
-        _exit(1);
-    }
-
-    /* Parent process */
-    close(pipefd[1]);  /* Close write end */
+        if (samples < AUDIO_FRAME_SAMPLES) {
+            /* Partial frame at end - pad with silence */
+            memset(pcm_buffer + samples * AUDIO_CHANNELS, 0,
+                   (size_t)(AUDIO_FRAME_SAMPLES - samples) * AUDIO_CHANNELS * sizeof(int16_t));
+        }
 
-    stream->ffmpeg_pid = pid;
-    stream->ffmpeg_pipe = pipefd[0];
+        /* Apply volume */
+        apply_volume(pcm_buffer, AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS, stream->volume);
 
-    DEBUG_LOG("Started FFmpeg (PID %d) for URL: %s", pid, url);
-    return 0;
-}
+        /* Encode to Opus, into the slot the sender will read */
+        int opus_len = opus_encode(encoder, pcm_buffer, AUDIO_FRAME_SAMPLES,
+                                   slot->data, OPUS_RING_FRAME_MAX);
 
-/* Stop FFmpeg subprocess */
-static void stop_ffmpeg(audio_stream_t *stream) {
-    if (stream->ffmpeg_pid > 0) {
-        kill(stream->ffmpeg_pid, SIGTERM);
-
-        /* Wait briefly for graceful shutdown */
-        int status;
-        pid_t result = waitpid(stream->ffmpeg_pid, &status, WNOHANG);
-        if (result == 0) {
-            /* Still running, give it a moment */
-            usleep(100000);  /* 100ms */
-            result = waitpid(stream->ffmpeg_pid, &status, WNOHANG);
-            if (result == 0) {
-                /* Force kill */
-                kill(stream->ffmpeg_pid, SIGKILL);
-                waitpid(stream->ffmpeg_pid, &status, 0);
-            }
+        if (opus_len < 0) {
+            DEBUG_LOG("Opus encode error: %s", opus_strerror(opus_len));
+            continue;
         }
 
-        DEBUG_LOG("Stopped FFmpeg (PID %d)", stream->ffmpeg_pid);
-        stream->ffmpeg_pid = -1;
+        slot->len = (uint16_t)opus_len;
+        opus_ring_commit(&pb->ring);
     }
 
-    if (stream->ffmpeg_pipe >= 0) {
-        close(stream->ffmpeg_pipe);
-        stream->ffmpeg_pipe = -1;
+    atomic_store(&pb->finished, true);
+    return NULL;
+}
+
+static OpusEncoder *create_encoder(void) {
+    int error;
+    OpusEncoder *encoder = opus_encoder_create(AUDIO_SAMPLE_RATE, AUDIO_CHANNELS,
+                                               OPUS_APPLICATION_AUDIO, &error);
+    if (error != OPUS_OK) {
+        DEBUG_LOG("Failed to create Opus encoder: %s", opus_strerror(error));
+        return NULL;
     }
+
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(AUDIO_OPUS_BITRATE));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
+    return encoder;
 }
 
-/* Audio thread main function */
+/* Frames of encoded audio for a ring of ms milliseconds */
+static uint32_t ring_frames(int ms) {
+    if (ms < AUDIO_BUFFER_MIN_MS) ms = AUDIO_BUFFER_MIN_MS;
+    if (ms > AUDIO_BUFFER_MAX_MS) ms = AUDIO_BUFFER_MAX_MS;
+    return (uint32_t)(ms / AUDIO_FRAME_MS);
+}
+#endif
+
+/* Audio thread main function: paces and sends what the decode thread encodes */
 static void *audio_thread_func(void *arg) {
     audio_stream_t *stream = arg;
 
+    /* Ours even if a stop timed out and play has since opened another */
+    pthread_mutex_lock(&stream->lock);
+    audio_decoder_t *decoder = stream->decoder;
+    int buffer_ms = stream->buffer_ms;
+    pthread_mutex_unlock(&stream->lock);
+
 #ifdef HAVE_OPUS
-    /* Buffers */
-    int16_t pcm_buffer[AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS];
-    uint8_t opus_buffer[AUDIO_OPUS_MAX_SIZE];
+    playback_t pb = {.stream = stream, .decoder = decoder, .encoder = create_encoder()};
+    atomic_init(&pb.stop, false);
+    atomic_init(&pb.finished, false);
+
+    pthread_t decode_thread;
+    bool decoding = false;
+    if (pb.encoder && opus_ring_init(&pb.ring, ring_frames(buffer_ms)) == 0) {
+        decoding = pthread_create(&decode_thread, NULL, decode_thread_func, &pb) == 0;
+    }
+    if (!decoding) DEBUG_LOG("Failed to start the decode thread");
+
+    DEBUG_LOG("Audio thread started (%u ms buffer)", (unsigned)pb.ring.capacity * AUDIO_FRAME_MS);
+
+    /* Let the ring fill halfway so a slow start doesn't open with silence */
+    while (decoding && !stream->should_stop && !atomic_load(&pb.finished) &&
+           opus_ring_count(&pb.ring) < (pb.ring.capacity + 1) / 2) {
+        usleep(AUDIO_FRAME_MS * 1000 / 4);
+    }
 
     /* Initialize timing */
     clock_gettime(CLOCK_MONOTONIC, &stream->next_frame_time);
 
-    DEBUG_LOG("Audio thread started");
-
-    while (!stream->should_stop) {
+    while (decoding && !stream->should_stop) {
         /* Check if paused */
         if (stream->paused) {
             usleep(50000);  /* 50ms */
@@ -176,64 +186,62 @@ static void *audio_thread_func(void *arg) {
             continue;
         }
 
-        /* Read PCM data from FFmpeg */
-        ssize_t bytes_read = read_full(stream->ffmpeg_pipe, pcm_buffer, AUDIO_FRAME_SIZE);
-
-        if (bytes_read <= 0) {
-            /* EOF or error - track ended */
-            DEBUG_LOG("FFmpeg stream ended (read returned %zd)", bytes_read);
-            break;
-        }
-
-        if (bytes_read < (ssize_t)AUDIO_FRAME_SIZE) {
-            /* Partial frame at end - pad with silence */
-            memset((uint8_t *)pcm_buffer + bytes_read, 0, AUDIO_FRAME_SIZE - bytes_read);
-        }
+        /* Read finished first: if it is set, every frame is already visible */
+        bool finished = atomic_load(&pb.finished);
+        const opus_frame_t *frame = opus_ring_peek(&pb.ring);
+        if (!frame && finished) break;
 
-        /* Apply volume */
-        apply_volume(pcm_buffer, AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS, stream->volume);
-
-        /* Encode to Opus */
-        OpusEncoder *encoder = (OpusEncoder *)stream->opus_encoder;
-        int opus_len = opus_encode(encoder, pcm_buffer, AUDIO_FRAME_SAMPLES,
-                                   opus_buffer, sizeof(opus_buffer));
-
-        if (opus_len < 0) {
-            DEBUG_LOG("Opus encode error: %s", opus_strerror(opus_len));
-            continue;
-        }
-
-        /* Send via UDP */
+        /* Send via UDP; an empty ring still gets its tick, as silence */
         if (stream->udp && stream->udp->ready) {
-            if (voice_udp_send_audio(stream->udp, opus_buffer, (size_t)opus_len) != 0) {
+            const uint8_t *data = frame ? frame->data : OPUS_SILENCE_FRAME;
+            size_t len = frame ? frame->len : sizeof(OPUS_SILENCE_FRAME);
+            if (voice_udp_send_audio(stream->udp, data, len) != 0) {
                 /* UDP send failed - might be disconnected */
                 DEBUG_LOG("UDP send failed");
             }
         }
 
-        stream->frames_sent++;
+        if (frame) {
+            opus_ring_release(&pb.ring);
+            stream->frames_sent++;
+        } else {
+            atomic_fetch_add(&stream->underruns, 1);
+        }
+        atomic_store(&stream->buffered_frames, (int)opus_ring_count(&pb.ring));
 
         /* Sleep until next frame */
         sleep_until_next_frame(&stream->next_frame_time);
     }
 
+    /* A decode thread blocked in read was already interrupted by stop */
+    atomic_store(&pb.stop, true);
+    if (decoding) pthread_join(decode_thread, NULL);
+    opus_ring_free(&pb.ring);
+    if (pb.encoder) opus_encoder_destroy(pb.encoder);
+    atomic_store(&stream->buffered_frames, 0);
+
     /* Send silence frames to signal end of speaking */
     if (stream->udp && stream->udp->ready) {
         voice_udp_send_silence(stream->udp);
     }
 
-    DEBUG_LOG("Audio thread stopping (sent %lu frames)", stream->frames_sent);
+    DEBUG_LOG("Audio thread stopping (sent %lu frames, %lu underruns, %lu overruns)",
+              (unsigned long)stream->frames_sent, (unsigned long)atomic_load(&stream->underruns),
+              (unsigned long)atomic_load(&stream->overruns));
 
 #else
     (void)stream;
+    (void)buffer_ms;
     DEBUG_LOG("Audio thread: Opus not available");
 #endif
 
-    /* Update state */
+    /* Update state; stop can no longer reach the decoder once it is unhooked */
     pthread_mutex_lock(&stream->lock);
+    if (stream->decoder == decoder) stream->decoder = NULL;
     stream->state = AUDIO_STREAM_IDLE;
     stream->thread_running = false;
     pthread_mutex_unlock(&stream->lock);
+    audio_decoder_close(decoder);
 
     /* Call completion callback */
     if (stream->on_track_end && !stream->should_stop) {
@@ -250,29 +258,13 @@ int audio_stream_init(audio_stream_t *stream) {
     memset(stream, 0, sizeof(audio_stream_t));
 
     pthread_mutex_init(&stream->lock, NULL);
-    stream->ffmpeg_pid = -1;
-    stream->ffmpeg_pipe = -1;
     stream->volume = 100;
+    stream->buffer_ms = AUDIO_BUFFER_DEFAULT_MS;
     stream->state = AUDIO_STREAM_IDLE;
 
 #ifdef HAVE_OPUS
-    /* Create Opus encoder */
-    int error;
-    stream->opus_encoder = opus_encoder_create(AUDIO_SAMPLE_RATE, AUDIO_CHANNELS,
-                                                OPUS_APPLICATION_AUDIO, &error);
-    if (error != OPUS_OK) {
-        DEBUG_LOG("Failed to create Opus encoder: %s", opus_strerror(error));
-        pthread_mutex_destroy(&stream->lock);
-        return -1;
-    }
-
-    /* Configure encoder */
-    opus_encoder_ctl((OpusEncoder *)stream->opus_encoder,
-                     OPUS_SET_BITRATE(AUDIO_OPUS_BITRATE));
-    opus_encoder_ctl((OpusEncoder *)stream->opus_encoder,
-                     OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
-
-    DEBUG_LOG("Audio stream initialized with Opus encoder");
+    /* Each playback creates its own encoder */
+    DEBUG_LOG("Audio stream initialized");
 #else
     DEBUG_LOG("Audio stream initialized (Opus not available)");
 #endif
@@ -287,13 +279,6 @@ void audio_stream_cleanup(audio_stream_t *stream) {
     /* Stop any active playback */
     audio_stream_stop(stream);
 
-#ifdef HAVE_OPUS
-    if (stream->opus_encoder) {
-        opus_encoder_destroy((OpusEncoder *)stream->opus_encoder);
-        stream->opus_encoder = NULL;
-    }
-#endif
-
     pthread_mutex_destroy(&stream->lock);
     DEBUG_LOG("Audio stream cleaned up");
 }
@@ -336,6 +321,28 @@ int audio_stream_play(audio_stream_t *stream, const char *url) {
     return -1;
 #endif
 
+    /* Stop any existing playback before starting another decoder */
+    audio_stream_stop(stream);
+
+    audio_decoder_t *decoder = audio_decoder_open(url, AUDIO_DECODER_AUTO);
+    if (!decoder) return -1;
+
+    return audio_stream_play_decoder(stream, decoder, url);
+}
+
+/* Start playing from an already open decoder */
+int audio_stream_play_decoder(audio_stream_t *stream, audio_decoder_t *decoder, const char *url) {
+    if (!stream || !decoder) {
+        audio_decoder_close(decoder);
+        return -1;
+    }
+
+#ifndef HAVE_OPUS
+    DEBUG_LOG("Cannot play: Opus not available");
+    audio_decoder_close(decoder);
+    return -1;
+#endif
+
     pthread_mutex_lock(&stream->lock);
 
     /* Stop any existing playback */
@@ -346,21 +353,15 @@ int audio_stream_play(audio_stream_t *stream, const char *url) {
     }
 
     /* Store URL */
-    strncpy(stream->current_url, url, sizeof(stream->current_url) - 1);
+    if (url) strncpy(stream->current_url, url, sizeof(stream->current_url) - 1);
 
     /* Reset state */
     stream->should_stop = false;
     stream->paused = false;
     stream->frames_sent = 0;
-    stream->state = AUDIO_STREAM_STARTING;
-
-    pthread_mutex_unlock(&stream->lock);
-
-    /* Start FFmpeg */
-    if (start_ffmpeg(stream, url) != 0) {
-        stream->state = AUDIO_STREAM_IDLE;
-        return -1;
-    }
+    atomic_store(&stream->underruns, 0);
+    atomic_store(&stream->overruns, 0);
+    stream->decoder = decoder;
 
     /* Send speaking indicator */
 #ifdef CCORD_VOICE
@@ -375,15 +376,19 @@ int audio_stream_play(audio_stream_t *stream, const char *url) {
 
     if (pthread_create(&stream->thread, NULL, audio_thread_func, stream) != 0) {
         DEBUG_LOG("Failed to create audio thread");
-        stop_ffmpeg(stream);
+        stream->decoder = NULL;
         stream->thread_running = false;
         stream->state = AUDIO_STREAM_IDLE;
+        pthread_mutex_unlock(&stream->lock);
+        audio_decoder_close(decoder);
         return -1;
     }
 
     pthread_detach(stream->thread);
+    pthread_mutex_unlock(&stream->lock);
 
-    DEBUG_LOG("Started playback: %s", url);
+    DEBUG_LOG("Started playback (%s): %s", audio_decoder_backend_name(audio_decoder_get_backend(decoder)),
+              url ? url : "(prefetched)");
     return 0;
 }
 
@@ -401,10 +406,10 @@ void audio_stream_stop(audio_stream_t *stream) {
     stream->should_stop = true;
     stream->state = AUDIO_STREAM_STOPPING;
 
-    pthread_mutex_unlock(&stream->lock);
+    /* Unblock the decoder to make the thread exit; the thread closes it */
+    audio_decoder_interrupt(stream->decoder);
 
-    /* Stop FFmpeg to make the thread exit */
-    stop_ffmpeg(stream);
+    pthread_mutex_unlock(&stream->lock);
 
     /* Wait for thread to finish (with timeout) */
     for (int i = 0; i < 50; i++) {  /* 5 second timeout */
@@ -509,3 +514,31 @@ uint64_t audio_stream_get_frames_sent(audio_stream_t *stream) {
 
     return frames;
 }
+
+/* Set the encoded frame ring depth */
+void audio_stream_set_buffer_ms(audio_stream_t *stream, int ms) {
+    if (!stream) return;
+
+    if (ms < AUDIO_BUFFER_MIN_MS) ms = AUDIO_BUFFER_MIN_MS;
+    if (ms > AUDIO_BUFFER_MAX_MS) ms = AUDIO_BUFFER_MAX_MS;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->buffer_ms = ms;
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/* Get ring and pacing counters */
+void audio_stream_get_stats(audio_stream_t *stream, audio_stream_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!stream) return;
+
+    pthread_mutex_lock(&stream->lock);
+    stats->frames_sent = stream->frames_sent;
+    stats->buffer_ms = stream->buffer_ms;
+    pthread_mutex_unlock(&stream->lock);
+
+    stats->underruns = atomic_load(&stream->underruns);
+    stats->overruns = atomic_load(&stream->overruns);
+    stats->buffered_ms = atomic_load(&stream->buffered_frames) * AUDIO_FRAME_MS;
+}
@@ -0,0 +1,62 @@
+/*
+ * Himiko Discord Bot (C Edition) - Opus Frame Ring
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "audio/opus_ring.h"
+#include <stdlib.h>
+
+int opus_ring_init(opus_ring_t *ring, uint32_t capacity) {
+    if (!ring || capacity == 0) return -1;
+
+    ring->slots = malloc((size_t)capacity * sizeof(opus_frame_t));
+    if (!ring->slots) return -1;
+
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+void opus_ring_free(opus_ring_t *ring) {
+    if (!ring) return;
+    free(ring->slots);
+    ring->slots = NULL;
+    ring->capacity = 0;
+}
+
+/*
+ * Acquire on the other side's index pairs with its release, so a slot is
+ * only reused after the consumer is done with it and only read after the
+ * producer has finished writing it.
+ */
+opus_frame_t *opus_ring_reserve(opus_ring_t *ring) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= ring->capacity) return NULL;
+    return &ring->slots[head % ring->capacity];
+}
+
+void opus_ring_commit(opus_ring_t *ring) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+const opus_frame_t *opus_ring_peek(opus_ring_t *ring) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    return &ring->slots[tail % ring->capacity];
+}
+
+void opus_ring_release(opus_ring_t *ring) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+uint32_t opus_ring_count(opus_ring_t *ring) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head >= tail ? (uint32_t)(head - tail) : 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Himiko Discord Bot (C Edition) - Bot Ban Set
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "ban_set.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Immutable once published. Slot value 0 means empty (0 is never a snowflake). */
+typedef struct ban_snapshot {
+    size_t mask;
+    int count;
+    uint64_t *bloom;
+    size_t bloom_mask;
+    uint64_t slots[];
+} ban_snapshot_t;
+
+static _Atomic(ban_snapshot_t *) g_snapshot = NULL;
+static pthread_mutex_t g_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Readers announce themselves in one of two counters, picked by the
+ * epoch's parity. A writer that replaced a snapshot flips the epoch and
+ * waits for each counter to drain in turn; new readers land in the other
+ * one, so the wait always ends and nobody can still hold the old copy.
+ */
+static atomic_uint g_epoch = 0;
+static atomic_int g_readers[2];
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline int bloom_test(const ban_snapshot_t *s, uint64_t h) {
+    size_t b1 = (size_t)h & s->bloom_mask;
+    size_t b2 = (size_t)(h >> 32) & s->bloom_mask;
+    return ((s->bloom[b1 >> 6] >> (b1 & 63)) & 1) &&
+           ((s->bloom[b2 >> 6] >> (b2 & 63)) & 1);
+}
+
+static inline void bloom_set(ban_snapshot_t *s, uint64_t h) {
+    size_t b1 = (size_t)h & s->bloom_mask;
+    size_t b2 = (size_t)(h >> 32) & s->bloom_mask;
+    s->bloom[b1 >> 6] |= 1ULL << (b1 & 63);
+    s->bloom[b2 >> 6] |= 1ULL << (b2 & 63);
+}
+
+static int snapshot_has(const ban_snapshot_t *s, uint64_t id) {
+    uint64_t h = mix(id);
+    if (s->bloom && !bloom_test(s, h)) return 0;
+
+    size_t i = (size_t)h & s->mask;
+    while (s->slots[i]) {
+        if (s->slots[i] == id) return 1;
+        i = (i + 1) & s->mask;
+    }
+    return 0;
+}
+
+static ban_snapshot_t *build_snapshot(const uint64_t *ids, int n) {
+    size_t capacity = 16;
+    while (capacity < (size_t)n * 2) capacity <<= 1;
+
+    ban_snapshot_t *s = calloc(1, sizeof(ban_snapshot_t) + capacity * sizeof(uint64_t));
+    if (!s) return NULL;
+    s->mask = capacity - 1;
+
+    if (n >= BAN_SET_BLOOM_MIN) {
+        /* ~8 bits per entry, two probes: under 5% false positives */
+        size_t bits = 64;
+        while (bits < (size_t)n * 8) bits <<= 1;
+        s->bloom = calloc(bits / 64, sizeof(uint64_t));
+        if (s->bloom) s->bloom_mask = bits - 1;
+    }
+
+    for (int k = 0; k < n; k++) {
+        uint64_t id = ids[k];
+        if (id == 0 || snapshot_has(s, id)) continue;
+
+        uint64_t h = mix(id);
+        size_t i = (size_t)h & s->mask;
+        while (s->slots[i]) i = (i + 1) & s->mask;
+        s->slots[i] = id;
+        if (s->bloom) bloom_set(s, h);
+        s->count++;
+    }
+    return s;
+}
+
+static ban_snapshot_t *read_begin(unsigned *slot) {
+    *slot = atomic_load(&g_epoch) & 1;
+    atomic_fetch_add(&g_readers[*slot], 1);
+    return atomic_load(&g_snapshot);
+}
+
+static void read_end(unsigned slot) {
+    atomic_fetch_sub_explicit(&g_readers[slot], 1, memory_order_release);
+}
+
+/* Caller holds g_write_lock; returns once no reader can see a snapshot unpublished before the call */
+static void wait_for_readers(void) {
+    for (int phase = 0; phase < 2; phase++) {
+        unsigned old = atomic_fetch_add(&g_epoch, 1) & 1;
+        while (atomic_load_explicit(&g_readers[old], memory_order_acquire) != 0) sched_yield();
+    }
+}
+
+static void free_snapshot(ban_snapshot_t *s) {
+    if (!s) return;
+    free(s->bloom);
+    free(s);
+}
+
+/* Caller holds g_write_lock. s may be NULL to empty the set. */
+static void publish(ban_snapshot_t *s) {
+    ban_snapshot_t *old = atomic_exchange(&g_snapshot, s);
+    if (old) {
+        wait_for_readers();
+        free_snapshot(old);
+    }
+}
+
+/* Collect the current IDs, optionally dropping one */
+static uint64_t *snapshot_ids(const ban_snapshot_t *s, uint64_t skip, int extra, int *n) {
+    int cap = (s ? s->count : 0) + extra;
+    uint64_t *ids = malloc((cap > 0 ? cap : 1) * sizeof(uint64_t));
+    *n = 0;
+    if (!ids || !s) return ids;
+
+    for (size_t i = 0; i <= s->mask; i++) {
+        if (s->slots[i] && s->slots[i] != skip) ids[(*n)++] = s->slots[i];
+    }
+    return ids;
+}
+
+int ban_set_load(sqlite3 *db) {
+    const char *sql = "SELECT target_id FROM bot_bans";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+
+    int cap = 64, n = 0;
+    uint64_t *ids = malloc(cap * sizeof(uint64_t));
+    int rc;
+    while (ids && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (n == cap) {
+            cap *= 2;
+            uint64_t *grown = realloc(ids, cap * sizeof(uint64_t));
+            if (!grown) {
+                free(ids);
+                ids = NULL;
+                break;
+            }
+            ids = grown;
+        }
+        ids[n++] = (uint64_t)sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    if (!ids || rc != SQLITE_DONE) {
+        free(ids);
+        return -1;
+    }
+
+    ban_snapshot_t *s = build_snapshot(ids, n);
+    free(ids);
+    if (!s) return -1;
+
+    pthread_mutex_lock(&g_write_lock);
+    publish(s);
+    pthread_mutex_unlock(&g_write_lock);
+    return 0;
+}
+
+int ban_set_contains(uint64_t id) {
+    unsigned slot;
+    ban_snapshot_t *s = read_begin(&slot);
+    int found = s ? snapshot_has(s, id) : -1;
+    read_end(slot);
+    return found;
+}
+
+void ban_set_add(uint64_t id) {
+    if (id == 0) return;
+
+    pthread_mutex_lock(&g_write_lock);
+    ban_snapshot_t *cur = atomic_load_explicit(&g_snapshot, memory_order_relaxed);
+    if (cur && !snapshot_has(cur, id)) {
+        int n;
+        uint64_t *ids = snapshot_ids(cur, 0, 1, &n);
+        if (ids) {
+            ids[n++] = id;
+            ban_snapshot_t *s = build_snapshot(ids, n);
+            if (s) publish(s);
+            free(ids);
+        }
+    }
+    pthread_mutex_unlock(&g_write_lock);
+}
+
+void ban_set_remove(uint64_t id) {
+    pthread_mutex_lock(&g_write_lock);
+    ban_snapshot_t *cur = atomic_load_explicit(&g_snapshot, memory_order_relaxed);
+    if (cur && snapshot_has(cur, id)) {
+        int n;
+        uint64_t *ids = snapshot_ids(cur, id, 0, &n);
+        if (ids) {
+            ban_snapshot_t *s = build_snapshot(ids, n);
+            if (s) publish(s);
+            free(ids);
+        }
+    }
+    pthread_mutex_unlock(&g_write_lock);
+}
+
+int ban_set_count(void) {
+    unsigned slot;
+    ban_snapshot_t *s = read_begin(&slot);
+    int count = s ? s->count : 0;
+    read_end(slot);
+    return count;
+}
+
+void ban_set_clear(void) {
+    pthread_mutex_lock(&g_write_lock);
+    publish(NULL);
+    pthread_mutex_unlock(&g_write_lock);
+}
@@ -5,11 +5,24 @@
  */
 
 #include "bot.h"
+#include "worker_pool.h"
+#include "scheduler.h"
+#include "mod_pipeline.h"
+#include "guild_perms.h"
+#include "commands/utility.h"
+#include "modules/leveling.h"
+#include "modules/keyword_notify.h"
+#include "modules/auto_cleaner.h"
+#include "modules/antiraid.h"
+#include "modules/regex_filter.h"
+#include "modules/mention_response.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <ctype.h>
+#include <strings.h>
+#include <time.h>
 
 /* Forward declarations for command registration */
 void register_admin_commands(himiko_bot_t *bot);
@@ -90,6 +103,12 @@ int bot_init(himiko_bot_t *bot, const char *config_path) {
     discord_set_on_message_create(bot->client, on_message_create);
     discord_set_on_message_delete(bot->client, on_message_delete);
     discord_set_on_guild_member_add(bot->client, on_guild_member_add);
+    discord_set_on_guild_create(bot->client, on_guild_create);
+    discord_set_on_guild_update(bot->client, on_guild_update);
+    discord_set_on_guild_delete(bot->client, on_guild_delete);
+    discord_set_on_guild_role_create(bot->client, on_guild_role_create);
+    discord_set_on_guild_role_update(bot->client, on_guild_role_update);
+    discord_set_on_guild_role_delete(bot->client, on_guild_role_delete);
 
     /* Set intents */
     discord_add_intents(bot->client, DISCORD_GATEWAY_GUILDS);
@@ -101,24 +120,64 @@ int bot_init(himiko_bot_t *bot, const char *config_path) {
     /* Allocate commands array */
     bot->commands = calloc(500, sizeof(himiko_command_t));
     bot->command_count = 0;
+    bot->unindexed_count = 0;
+    bot->commands_sealed = 0;
+    command_index_init(&bot->command_index);
 
     /* Register all commands */
     bot_register_all_commands(bot);
 
+    /* Handlers run off the gateway thread when the pool is enabled */
+    if (bot->config.features.worker_threads > 0 &&
+        worker_pool_init(bot->config.features.worker_threads, bot->config.features.worker_queue_depth) != 0) {
+        fprintf(stderr, "Worker pool failed to start, running handlers inline\n");
+    }
+
+    if (bot->config.features.message_xp) {
+        leveling_init(bot);
+    }
+    regex_filter_init(bot);
+    mention_response_init(bot);
+
+    /*
+     * Timed work (reminders, autoclean, scheduled events) fires from one
+     * thread. Event handlers are registered and module timers armed first,
+     * so overdue rows loaded by scheduler_init find their handler.
+     */
+    antiraid_init(bot);
+    auto_cleaner_init(bot);
+    if (scheduler_init(&bot->database) == 0) {
+        utility_load_reminders(&bot->database);
+    }
+    keyword_notify_init(bot);
+
     bot->running = 1;
     return 0;
 }
 
 void bot_cleanup(himiko_bot_t *bot) {
+    /* Finish queued handlers while the client and database are still up */
+    scheduler_shutdown();
+    worker_pool_shutdown();
+    auto_cleaner_cleanup(bot);
+    antiraid_cleanup(bot);
+    regex_filter_cleanup(bot);
+    mention_response_cleanup(bot);
+    leveling_cleanup(bot);
+    keyword_notify_cleanup(bot);
     if (bot->client) {
         discord_cleanup(bot->client);
         bot->client = NULL;
     }
+    /* No request callbacks can run past this point */
+    mod_pipeline_shutdown();
+    guild_perms_cleanup();
     db_close(&bot->database);
     if (bot->commands) {
         free(bot->commands);
         bot->commands = NULL;
     }
+    command_index_free(&bot->command_index);
     g_bot = NULL;
 }
 
@@ -147,14 +206,45 @@ void bot_stop(himiko_bot_t *bot) {
 }
 
 void bot_register_command(himiko_bot_t *bot, const himiko_command_t *cmd) {
+    if (bot->commands_sealed) {
+        fprintf(stderr, "Command %s registered after startup, ignoring\n", cmd->name);
+        return;
+    }
     if (bot->command_count < 500) {
+        if (command_index_add(&bot->command_index, cmd->name, bot->command_count) != 0) {
+            fprintf(stderr, "Command %s not indexed, using linear lookup\n", cmd->name);
+            bot->unindexed_count++;
+        }
         bot->commands[bot->command_count++] = *cmd;
     }
 }
 
+void bot_register_alias(himiko_bot_t *bot, const char *alias, const char *name) {
+    if (bot->commands_sealed) {
+        fprintf(stderr, "Alias %s registered after startup, ignoring\n", alias);
+        return;
+    }
+    for (int i = 0; i < bot->command_count; i++) {
+        if (strcasecmp(bot->commands[i].name, name) == 0) {
+            if (command_index_add(&bot->command_index, alias, i) != 0) {
+                fprintf(stderr, "Alias %s could not be indexed\n", alias);
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "Alias %s refers to unknown command %s\n", alias, name);
+}
+
 himiko_command_t *bot_find_command(himiko_bot_t *bot, const char *name) {
+    if (bot->command_index.built) {
+        int i = command_index_find(&bot->command_index, name);
+        if (i >= 0) return &bot->commands[i];
+        if (bot->unindexed_count == 0) return NULL;
+    }
+
+    /* Index not built, or the name was one it rejected */
     for (int i = 0; i < bot->command_count; i++) {
-        if (strcmp(bot->commands[i].name, name) == 0) {
+        if (strcasecmp(bot->commands[i].name, name) == 0) {
             return &bot->commands[i];
         }
     }
@@ -174,6 +264,21 @@ void bot_register_all_commands(himiko_bot_t *bot) {
     register_settings_commands(bot);
     register_xp_commands(bot);
     register_ai_commands(bot);
+    register_keyword_notify_commands(bot);
+    register_regex_filter_commands(bot);
+    register_mention_response_commands(bot);
+
+    /* Short aliases */
+    bot_register_alias(bot, "lb", "leaderboard");
+    bot_register_alias(bot, "av", "avatar");
+    bot_register_alias(bot, "ui", "userinfo");
+    bot_register_alias(bot, "si", "serverinfo");
+
+    /* Build the lookup index once everything is registered */
+    if (command_index_build(&bot->command_index) != 0) {
+        fprintf(stderr, "Command index build failed, using linear lookup\n");
+    }
+    bot->commands_sealed = 1;
 
     printf("Registered %d commands\n", bot->command_count);
 }
@@ -184,6 +289,8 @@ void on_ready(struct discord *client, const struct discord_ready *event) {
 
     /* Store application ID for interaction responses */
     g_bot->config.app_id = event->application->id;
+    /* And our own user ID, so mention checks need no REST call */
+    g_bot->config.bot_id = event->user->id;
 
     printf("\n");
     printf("Bot is online!\n");
@@ -231,6 +338,88 @@ void on_ready(struct discord *client, const struct discord_ready *event) {
     printf("Himiko is ready!\n");
 }
 
+/* Handler jobs keep the event claimed until the worker is done with it */
+typedef struct {
+    struct discord *client;
+    const struct discord_interaction *interaction;
+    himiko_command_t *cmd;
+} slash_job_t;
+
+typedef struct {
+    struct discord *client;
+    const struct discord_message *msg;
+    himiko_command_t *cmd;
+    const char *args;
+} prefix_job_t;
+
+static void run_slash_job(void *arg) {
+    slash_job_t *job = arg;
+    job->cmd->slash_handler(job->client, job->interaction);
+    discord_unclaim(job->client, job->interaction);
+    free(job);
+}
+
+static void run_prefix_job(void *arg) {
+    prefix_job_t *job = arg;
+    job->cmd->prefix_handler(job->client, job->msg, job->args);
+    discord_unclaim(job->client, job->msg);
+    free(job);
+}
+
+/* When the pool's queue is full */
+#define BUSY_REPLY "I'm swamped right now, please try that again in a moment."
+
+/* Same guild runs in order; DMs are keyed by channel */
+static uint64_t dispatch_key(u64snowflake guild_id, u64snowflake channel_id) {
+    return guild_id ? guild_id : channel_id;
+}
+
+static void dispatch_slash(struct discord *client, const struct discord_interaction *interaction, himiko_command_t *cmd) {
+    slash_job_t *job = malloc(sizeof(slash_job_t));
+    if (job) {
+        job->client = client;
+        job->interaction = discord_claim(client, interaction);
+        job->cmd = cmd;
+        if (worker_pool_submit(dispatch_key(interaction->guild_id, interaction->channel_id), run_slash_job, job) == 0) {
+            return;
+        }
+        /* Full: running it here would overtake the guild's queued commands */
+        if (worker_pool_running()) {
+            respond_ephemeral(client, interaction, BUSY_REPLY);
+            discord_unclaim(client, job->interaction);
+            free(job);
+            return;
+        }
+        /* Pool disabled: everything runs here, in order */
+        run_slash_job(job);
+        return;
+    }
+    cmd->slash_handler(client, interaction);
+}
+
+static void dispatch_prefix(struct discord *client, const struct discord_message *msg, himiko_command_t *cmd, const char *args) {
+    prefix_job_t *job = malloc(sizeof(prefix_job_t));
+    if (job) {
+        job->client = client;
+        job->msg = discord_claim(client, msg);
+        job->cmd = cmd;
+        job->args = args; /* points into the claimed msg->content */
+        if (worker_pool_submit(dispatch_key(msg->guild_id, msg->channel_id), run_prefix_job, job) == 0) {
+            return;
+        }
+        if (worker_pool_running()) {
+            struct discord_create_message params = { .content = BUSY_REPLY };
+            discord_create_message(client, msg->channel_id, &params, NULL);
+            discord_unclaim(client, job->msg);
+            free(job);
+            return;
+        }
+        run_prefix_job(job);
+        return;
+    }
+    cmd->prefix_handler(client, msg, args);
+}
+
 void on_interaction_create(struct discord *client, const struct discord_interaction *interaction) {
     if (interaction->type != DISCORD_INTERACTION_APPLICATION_COMMAND) {
         return;
@@ -239,7 +428,7 @@ void on_interaction_create(struct discord *client, const struct discord_interact
     /* Check if user is bot banned */
     char user_id_str[32];
     snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)interaction->member->user->id);
-    if (db_is_bot_banned(&g_bot->database, user_id_str)) {
+    if (db_is_bot_banned_id(&g_bot->database, interaction->member->user->id)) {
         respond_ephemeral(client, interaction, "You are banned from using this bot.");
         return;
     }
@@ -255,7 +444,7 @@ void on_interaction_create(struct discord *client, const struct discord_interact
             db_log_command(&g_bot->database, guild_id_str, channel_id_str, user_id_str, cmd->name, "");
         }
 
-        cmd->slash_handler(client, interaction);
+        dispatch_slash(client, interaction, cmd);
     } else {
         respond_ephemeral(client, interaction, "Unknown command.");
     }
@@ -266,12 +455,18 @@ void on_message_create(struct discord *client, const struct discord_message *msg
     if (msg->author->bot) return;
 
     /* Check if user is bot banned */
-    char user_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)msg->author->id);
-    if (db_is_bot_banned(&g_bot->database, user_id_str)) {
+    if (db_is_bot_banned_id(&g_bot->database, msg->author->id)) {
         return;
     }
 
+    /* A filtered message is deleted; it earns no XP and runs no command */
+    if (regex_filter_check(client, msg)) return;
+
+    leveling_on_message(client, msg);
+
+    char user_id_str[32];
+    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)msg->author->id);
+
     /* Get guild prefix */
     char prefix[16];
     char guild_id_str[32];
@@ -282,6 +477,8 @@ void on_message_create(struct discord *client, const struct discord_message *msg
     size_t prefix_len = strlen(prefix);
     if (strncmp(msg->content, prefix, prefix_len) != 0) {
         /* Check for AFK mentions, etc. */
+        mention_response_check(client, msg);
+        keyword_notify_on_message(client, msg);
         return;
     }
 
@@ -326,7 +523,7 @@ void on_message_create(struct discord *client, const struct discord_message *msg
 
     /* Execute command */
     if (cmd->prefix_handler) {
-        cmd->prefix_handler(client, msg, args);
+        dispatch_prefix(client, msg, cmd, args);
     } else {
         char reply[256];
         snprintf(reply, sizeof(reply), "Usage: `%s%s <args>`\nUse `%shelp %s` for details.", prefix, cmd_name, prefix, cmd_name);
@@ -344,17 +541,44 @@ void on_message_delete(struct discord *client, const struct discord_message_dele
 }
 
 void on_guild_member_add(struct discord *client, const struct discord_guild_member *member) {
+    if (!member->user) return;
+
+    /* Raid tracking counts in milliseconds; it also records the join */
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t now_ms = (int64_t)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+    antiraid_on_member_join(client, member->guild_id, member->user, now_ms);
+}
+
+/* Roles and owners feed the permission cache prefix commands check against */
+void on_guild_create(struct discord *client, const struct discord_guild *guild) {
+    (void)client;
+    guild_perms_on_guild(guild);
+}
+
+void on_guild_update(struct discord *client, const struct discord_guild *guild) {
+    (void)client;
+    guild_perms_on_guild(guild);
+}
+
+void on_guild_delete(struct discord *client, const struct discord_guild *guild) {
     (void)client;
+    guild_perms_on_guild_delete(guild->id);
+}
 
-    char guild_id_str[32], user_id_str[32];
-    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)member->guild_id);
-    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)member->user->id);
+void on_guild_role_create(struct discord *client, const struct discord_guild_role_create *event) {
+    (void)client;
+    guild_perms_on_role(event->guild_id, event->role);
+}
 
-    /* Record join for anti-raid tracking */
-    time_t now = time(NULL);
-    db_record_member_join(&g_bot->database, guild_id_str, user_id_str, now, 0);
+void on_guild_role_update(struct discord *client, const struct discord_guild_role_update *event) {
+    (void)client;
+    guild_perms_on_role(event->guild_id, event->role);
+}
 
-    /* TODO: Welcome messages, anti-raid checks */
+void on_guild_role_delete(struct discord *client, const struct discord_guild_role_delete *event) {
+    (void)client;
+    guild_perms_on_role_delete(event->guild_id, event->role_id);
 }
 
 /* Utility Functions */
@@ -0,0 +1,255 @@
+/*
+ * Himiko Discord Bot (C Edition) - Command Index
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "command_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DISPLACE_MAX_TRIES 65536
+
+/* Command names are ASCII; avoid the locale-aware tolower() on the hot path */
+static inline unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* FNV-1a over the case-folded name */
+static uint64_t hash_name(const char *name, uint32_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h ^= (uint64_t)fold(*p);
+        h *= 0x100000001b3ULL;
+    }
+    return mix64(h);
+}
+
+static inline uint32_t slot_for(uint64_t h, uint32_t d, uint32_t mask) {
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    return (h1 + d * h2) & mask;
+}
+
+static int name_equals(const char *folded, const char *name) {
+    while (*folded && *name) {
+        if ((unsigned char)*folded != fold((unsigned char)*name)) return 0;
+        folded++;
+        name++;
+    }
+    return *folded == *name;
+}
+
+void command_index_init(command_index_t *idx) {
+    memset(idx, 0, sizeof(command_index_t));
+}
+
+static void free_table(command_index_t *idx) {
+    free(idx->slots);
+    free(idx->displace);
+    idx->slots = NULL;
+    idx->displace = NULL;
+    idx->slot_mask = 0;
+    idx->bucket_count = 0;
+    idx->built = 0;
+}
+
+void command_index_free(command_index_t *idx) {
+    free_table(idx);
+    free(idx->keys);
+    memset(idx, 0, sizeof(command_index_t));
+}
+
+int command_index_add(command_index_t *idx, const char *name, int target) {
+    if (!name || !*name || strlen(name) >= COMMAND_INDEX_MAX_NAME) return -1;
+
+    if (idx->key_count >= idx->key_capacity) {
+        int cap = idx->key_capacity ? idx->key_capacity * 2 : 128;
+        command_index_key_t *keys = realloc(idx->keys, cap * sizeof(command_index_key_t));
+        if (!keys) return -1;
+        idx->keys = keys;
+        idx->key_capacity = cap;
+    }
+
+    command_index_key_t *key = &idx->keys[idx->key_count++];
+    int i = 0;
+    for (; name[i]; i++) {
+        key->name[i] = (char)fold((unsigned char)name[i]);
+    }
+    key->name[i] = '\0';
+    key->target = target;
+
+    /* Table is stale until rebuilt */
+    idx->built = 0;
+    return 0;
+}
+
+/* Sort keys by name, then by insertion order so the first registration wins */
+typedef struct {
+    const command_index_key_t *key;
+    int order;
+    uint64_t hash;
+    uint32_t bucket;
+} build_entry_t;
+
+static int compare_by_name(const void *a, const void *b) {
+    const build_entry_t *ea = a, *eb = b;
+    int c = strcmp(ea->key->name, eb->key->name);
+    return c ? c : ea->order - eb->order;
+}
+
+typedef struct {
+    uint32_t bucket;
+    int start;
+    int count;
+} build_bucket_t;
+
+static int compare_bucket_size(const void *a, const void *b) {
+    const build_bucket_t *ba = a, *bb = b;
+    if (ba->count != bb->count) return bb->count - ba->count;
+    return (int)ba->bucket - (int)bb->bucket;
+}
+
+static int compare_by_bucket(const void *a, const void *b) {
+    const build_entry_t *ea = a, *eb = b;
+    if (ea->bucket != eb->bucket) return ea->bucket < eb->bucket ? -1 : 1;
+    return ea->order - eb->order;
+}
+
+/* Try to place every bucket; returns 0 on success */
+static int place_buckets(command_index_t *idx, build_entry_t *entries, build_bucket_t *buckets,
+                         uint32_t bucket_count, uint32_t slot_count) {
+    uint32_t mask = slot_count - 1;
+    uint32_t probe[COMMAND_INDEX_MAX_NAME * 2];
+
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        build_bucket_t *bucket = &buckets[b];
+        if (bucket->count == 0) break;
+        if (bucket->count > (int)(sizeof(probe) / sizeof(probe[0]))) return -1;
+
+        uint32_t d;
+        for (d = 0; d < DISPLACE_MAX_TRIES; d++) {
+            int ok = 1;
+            for (int k = 0; k < bucket->count && ok; k++) {
+                uint32_t s = slot_for(entries[bucket->start + k].hash, d, mask);
+                if (idx->slots[s].name) ok = 0;
+                for (int j = 0; j < k && ok; j++) {
+                    if (probe[j] == s) ok = 0;
+                }
+                probe[k] = s;
+            }
+            if (ok) break;
+        }
+        if (d == DISPLACE_MAX_TRIES) return -1;
+
+        idx->displace[bucket->bucket] = d;
+        for (int k = 0; k < bucket->count; k++) {
+            const command_index_key_t *key = entries[bucket->start + k].key;
+            idx->slots[probe[k]].name = key->name;
+            idx->slots[probe[k]].target = key->target;
+        }
+    }
+    return 0;
+}
+
+int command_index_build(command_index_t *idx) {
+    free_table(idx);
+    if (idx->key_count == 0) return 0;
+
+    build_entry_t *entries = calloc(idx->key_count, sizeof(build_entry_t));
+    if (!entries) return -1;
+
+    for (int i = 0; i < idx->key_count; i++) {
+        entries[i].key = &idx->keys[i];
+        entries[i].order = i;
+    }
+
+    /* Drop duplicate names, keeping the earliest */
+    qsort(entries, idx->key_count, sizeof(build_entry_t), compare_by_name);
+    int n = 0;
+    for (int i = 0; i < idx->key_count; i++) {
+        if (n > 0 && strcmp(entries[n - 1].key->name, entries[i].key->name) == 0) continue;
+        entries[n++] = entries[i];
+    }
+
+    /* Roughly two keys per bucket, load factor at most one half */
+    uint32_t bucket_count = (uint32_t)n / 2 + 1;
+    uint32_t slot_count = 8;
+    while (slot_count < (uint32_t)n * 2) slot_count <<= 1;
+
+    build_bucket_t *buckets = calloc(bucket_count, sizeof(build_bucket_t));
+    if (!buckets) {
+        free(entries);
+        return -1;
+    }
+
+    int rc = -1;
+    for (uint32_t seed = 0; seed < 64 && rc != 0; seed++) {
+        for (int i = 0; i < n; i++) {
+            entries[i].hash = hash_name(entries[i].key->name, seed);
+            entries[i].bucket = (uint32_t)(entries[i].hash % bucket_count);
+        }
+        qsort(entries, n, sizeof(build_entry_t), compare_by_bucket);
+
+        memset(buckets, 0, bucket_count * sizeof(build_bucket_t));
+        for (uint32_t b = 0; b < bucket_count; b++) buckets[b].bucket = b;
+        for (int i = n - 1; i >= 0; i--) {
+            build_bucket_t *bucket = &buckets[entries[i].bucket];
+            bucket->start = i;
+            bucket->count++;
+        }
+        qsort(buckets, bucket_count, sizeof(build_bucket_t), compare_bucket_size);
+
+        idx->slots = calloc(slot_count, sizeof(command_index_slot_t));
+        idx->displace = calloc(bucket_count, sizeof(uint32_t));
+        if (!idx->slots || !idx->displace) break;
+
+        idx->slot_mask = slot_count - 1;
+        idx->bucket_count = bucket_count;
+        idx->seed = seed;
+        rc = place_buckets(idx, entries, buckets, bucket_count, slot_count);
+        if (rc != 0) {
+            free(idx->slots);
+            free(idx->displace);
+            idx->slots = NULL;
+            idx->displace = NULL;
+            /* Give the next seed more room */
+            if ((seed & 7) == 7) slot_count <<= 1;
+        }
+    }
+
+    free(buckets);
+    free(entries);
+
+    if (rc != 0) {
+        free_table(idx);
+        fprintf(stderr, "Failed to build command index for %d names\n", n);
+        return -1;
+    }
+
+    idx->built = 1;
+    return 0;
+}
+
+int command_index_find(const command_index_t *idx, const char *name) {
+    if (!idx->built || !name) return -1;
+
+    uint64_t h = hash_name(name, idx->seed);
+    uint32_t d = idx->displace[h % idx->bucket_count];
+    const command_index_slot_t *slot = &idx->slots[slot_for(h, d, idx->slot_mask)];
+
+    if (slot->name && name_equals(slot->name, name)) {
+        return slot->target;
+    }
+    return -1;
+}
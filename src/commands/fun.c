@@ -349,7 +349,8 @@ void cmd_choose(struct discord *client, const struct discord_interaction *intera
 
     /* Try splitting by | first, then by comma */
     char *delim = strchr(options_copy, '|') ? "|" : ",";
-    char *token = strtok(options_copy, delim);
+    char *save = NULL;
+    char *token = strtok_r(options_copy, delim, &save);
     while (token && choice_count < 50) {
         /* Trim whitespace */
         while (*token == ' ') token++;
@@ -359,7 +360,7 @@ void cmd_choose(struct discord *client, const struct discord_interaction *intera
         if (*token) {
             choices[choice_count++] = token;
         }
-        token = strtok(NULL, delim);
+        token = strtok_r(NULL, delim, &save);
     }
 
     if (choice_count < 2) {
@@ -393,7 +394,8 @@ void cmd_choose_prefix(struct discord *client, const struct discord_message *msg
     int choice_count = 0;
 
     char *delim = strchr(options_copy, '|') ? "|" : ",";
-    char *token = strtok(options_copy, delim);
+    char *save = NULL;
+    char *token = strtok_r(options_copy, delim, &save);
     while (token && choice_count < 50) {
         while (*token == ' ') token++;
         char *end = token + strlen(token) - 1;
@@ -402,7 +404,7 @@ void cmd_choose_prefix(struct discord *client, const struct discord_message *msg
         if (*token) {
             choices[choice_count++] = token;
         }
-        token = strtok(NULL, delim);
+        token = strtok_r(NULL, delim, &save);
     }
 
     if (choice_count < 2) {
@@ -7,6 +7,7 @@
 #include "commands/info.h"
 #include "bot.h"
 #include "database.h"
+#include "db_cache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -201,6 +202,9 @@ void cmd_botinfo(struct discord *client, const struct discord_interaction *inter
     struct utsname sys_info;
     uname(&sys_info);
 
+    db_cache_stats_t cache_stats;
+    db_cache_get_stats(&cache_stats);
+
     char response[2048];
     snprintf(response, sizeof(response),
         "**Himiko Bot Information**\n\n"
@@ -209,14 +213,17 @@ void cmd_botinfo(struct discord *client, const struct discord_interaction *inter
         "**Language:** C11\n"
         "**Platform:** %s %s\n"
         "**Commands:** %d registered\n"
-        "**Prefix:** `%s`\n\n"
+        "**Prefix:** `%s`\n"
+        "**Settings Cache:** %llu hits / %llu misses (%d guilds)\n\n"
         "**Links:**\n"
         "[GitHub](https://github.com/blubskye/himiko_c) |"
         "[Support Server](https://discord.gg/himiko)",
         HIMIKO_VERSION,
         sys_info.sysname, sys_info.release,
         g_bot->command_count,
-        g_bot->config.prefix);
+        g_bot->config.prefix,
+        (unsigned long long)cache_stats.hits, (unsigned long long)cache_stats.misses,
+        cache_stats.guilds);
 
     respond_message(client, interaction, response);
 }
@@ -227,6 +234,9 @@ void cmd_botinfo_prefix(struct discord *client, const struct discord_message *ms
     struct utsname sys_info;
     uname(&sys_info);
 
+    db_cache_stats_t cache_stats;
+    db_cache_get_stats(&cache_stats);
+
     char response[2048];
     snprintf(response, sizeof(response),
         "**Himiko Bot Information**\n\n"
@@ -235,14 +245,17 @@ void cmd_botinfo_prefix(struct discord *client, const struct discord_message *ms
         "**Language:** C11\n"
         "**Platform:** %s %s\n"
         "**Commands:** %d registered\n"
-        "**Prefix:** `%s`\n\n"
+        "**Prefix:** `%s`\n"
+        "**Settings Cache:** %llu hits / %llu misses (%d guilds)\n\n"
         "**Links:**\n"
         "[GitHub](https://github.com/blubskye/himiko_c) |"
         "[Support Server](https://discord.gg/himiko)",
         HIMIKO_VERSION,
         sys_info.sysname, sys_info.release,
         g_bot->command_count,
-        g_bot->config.prefix);
+        g_bot->config.prefix,
+        (unsigned long long)cache_stats.hits, (unsigned long long)cache_stats.misses,
+        cache_stats.guilds);
 
     struct discord_create_message params = { .content = response };
     discord_create_message(client, msg->channel_id, &params, NULL);
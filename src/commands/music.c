@@ -8,6 +8,9 @@
 #include "audio/discord_voice_internal.h"
 #include "bot.h"
 #include "database.h"
+#include "db_writer.h"
+#include "music_cache.h"
+#include "resolver_pool.h"
 #include "debug.h"
 
 #include <stdio.h>
@@ -41,6 +44,177 @@ static void format_duration(int seconds, char *buf, size_t buf_size) {
     }
 }
 
+/* Move the ready prefetch out of the player; call with the player lock held */
+static void prefetch_take(music_prefetch_t *pf, music_track_t **track,
+                          audio_decoder_t **decoder, char **stream_url) {
+    *track = pf->track;
+    *decoder = pf->decoder;
+    *stream_url = pf->stream_url;
+    pf->track = NULL;
+    pf->decoder = NULL;
+    pf->stream_url = NULL;
+}
+
+static void prefetch_discard(music_track_t *track, audio_decoder_t *decoder, char *stream_url) {
+    audio_decoder_close(decoder);
+    free(stream_url);
+    free(track);
+}
+
+/* Seconds until the prefetch decoder should be opened; call with the player lock held */
+static int prefetch_delay(music_player_t *player) {
+    int duration = player->current_track ? player->current_track->duration : 0;
+    if (duration <= 0) return 0;
+
+    int played = (int)(audio_stream_get_frames_sent(&player->audio) * AUDIO_FRAME_MS / 1000);
+    int delay = duration - played - MUSIC_PREFETCH_LEAD_SECS;
+    return delay > 0 ? delay : 0;
+}
+
+/* Prefetch worker: resolves the entry after the current one whenever asked */
+static void *prefetch_thread_func(void *arg) {
+    music_player_t *player = arg;
+    music_prefetch_t *pf = &player->prefetch;
+
+    char guild_str[32];
+    snprintf(guild_str, sizeof(guild_str), "%"PRIu64, player->guild_id);
+
+    pthread_mutex_lock(&player->lock);
+    while (!pf->quit) {
+        if (!pf->wanted) {
+            pthread_cond_wait(&pf->cond, &player->lock);
+            continue;
+        }
+        pf->wanted = false;
+        pf->busy = true;
+        uint64_t generation = pf->generation;
+        int position = player->current_track ? player->current_track->position : -1;
+        pthread_mutex_unlock(&player->lock);
+
+        music_track_t *track = position >= 0 ? music_queue_after(guild_str, position) : NULL;
+        char *stream_url = track ? music_get_stream_url(track) : NULL;
+        audio_decoder_t *decoder = NULL;
+
+        /* The URL keeps; an open stream should not sit idle for the whole track */
+        pthread_mutex_lock(&player->lock);
+        while (stream_url && !pf->quit && pf->generation == generation) {
+            int delay = prefetch_delay(player);
+            if (delay == 0) break;
+
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += delay < 5 ? delay : 5;   /* re-check; pauses push the end back */
+            pthread_cond_timedwait(&pf->cond, &player->lock, &until);
+        }
+        bool wanted = !pf->quit && pf->generation == generation;
+        pthread_mutex_unlock(&player->lock);
+
+        bool primed = false;
+        if (stream_url && wanted) {
+            decoder = audio_decoder_open(stream_url, AUDIO_DECODER_AUTO);
+
+            /* Invalidation can interrupt a slow prime through this */
+            pthread_mutex_lock(&player->lock);
+            pf->priming = decoder;
+            pthread_mutex_unlock(&player->lock);
+
+            if (decoder) {
+                primed = audio_decoder_prime(decoder, MUSIC_PREFETCH_PRIME_MS * AUDIO_SAMPLE_RATE / 1000) > 0;
+                if (!primed) DEBUG_LOG("Prefetch could not decode %s", track->title);
+            }
+        }
+
+        pthread_mutex_lock(&player->lock);
+        pf->priming = NULL;
+        pf->busy = false;
+        if (primed && !pf->quit && pf->generation == generation) {
+            DEBUG_LOG("Prefetched next track for guild %"PRIu64": %s", player->guild_id, track->title);
+            pf->track = track;
+            pf->decoder = decoder;
+            pf->stream_url = stream_url;
+            track = NULL;
+            decoder = NULL;
+            stream_url = NULL;
+        }
+        pthread_mutex_unlock(&player->lock);
+
+        prefetch_discard(track, decoder, stream_url);
+        pthread_mutex_lock(&player->lock);
+    }
+    pthread_mutex_unlock(&player->lock);
+    return NULL;
+}
+
+/* Ask the worker for the next entry, starting it on first use; call with the player lock held */
+static void prefetch_request(music_player_t *player) {
+    music_prefetch_t *pf = &player->prefetch;
+    if (pf->quit || player->loop_track) return;
+
+    if (!pf->thread_started) {
+        if (pthread_create(&pf->thread, NULL, prefetch_thread_func, player) != 0) {
+            DEBUG_LOG("Failed to create prefetch thread");
+            return;
+        }
+        pf->thread_started = true;
+    }
+    pf->wanted = true;
+    pthread_cond_signal(&pf->cond);
+}
+
+/* Drop the prefetch and, if something is playing, fetch the entry after it again */
+void music_prefetch_invalidate(music_player_t *player) {
+    if (!player) return;
+
+    music_track_t *track;
+    audio_decoder_t *decoder;
+    char *stream_url;
+
+    pthread_mutex_lock(&player->lock);
+    music_prefetch_t *pf = &player->prefetch;
+    pf->generation++;
+    prefetch_take(pf, &track, &decoder, &stream_url);
+    audio_decoder_interrupt(pf->priming);
+
+    bool playing = player->current_track &&
+                   (player->state == PLAYER_STATE_PLAYING || player->state == PLAYER_STATE_PAUSED);
+    if (playing) {
+        prefetch_request(player);
+    } else {
+        pf->wanted = false;
+        pthread_cond_signal(&pf->cond);
+    }
+    pthread_mutex_unlock(&player->lock);
+
+    prefetch_discard(track, decoder, stream_url);
+}
+
+/* Invalidate the prefetch of a guild's player after its queue changed */
+static void prefetch_invalidate_guild(u64snowflake guild_id) {
+    music_player_t *player = music_get_player(guild_id);
+    if (player) music_prefetch_invalidate(player);
+}
+
+/* Stop the worker and free whatever it had ready */
+static void prefetch_shutdown(music_player_t *player) {
+    music_track_t *track;
+    audio_decoder_t *decoder;
+    char *stream_url;
+
+    pthread_mutex_lock(&player->lock);
+    music_prefetch_t *pf = &player->prefetch;
+    pf->quit = true;
+    pf->generation++;
+    prefetch_take(pf, &track, &decoder, &stream_url);
+    audio_decoder_interrupt(pf->priming);
+    pthread_cond_signal(&pf->cond);
+    bool started = pf->thread_started;
+    pf->thread_started = false;
+    pthread_mutex_unlock(&player->lock);
+
+    if (started) pthread_join(pf->thread, NULL);
+    prefetch_discard(track, decoder, stream_url);
+}
+
 /* Initialize music system */
 int music_init(void) {
     if (g_music.initialized) return 0;
@@ -49,6 +223,13 @@ int music_init(void) {
     g_music.players = NULL;
     g_music.initialized = true;
 
+    if (g_bot) {
+        music_cache_init(&g_bot->database);
+        resolver_pool_init(g_bot->config.features.resolver_worker,
+                           g_bot->config.features.resolver_workers,
+                           g_bot->config.features.resolver_timeout_secs);
+    }
+
     DEBUG_LOG("Music system initialized");
     return 0;
 }
@@ -71,6 +252,9 @@ void music_cleanup(void) {
     pthread_mutex_unlock(&g_music.lock);
     pthread_mutex_destroy(&g_music.lock);
 
+    resolver_pool_shutdown();
+    music_cache_cleanup();
+
     g_music.initialized = false;
     DEBUG_LOG("Music system cleaned up");
 }
@@ -106,6 +290,7 @@ music_player_t *music_create_player(u64snowflake guild_id) {
     player->voice_state = VOICE_STATE_DISCONNECTED;
 
     pthread_mutex_init(&player->lock, NULL);
+    pthread_cond_init(&player->prefetch.cond, NULL);
 
     /* Initialize voice UDP */
     voice_udp_init(&player->udp);
@@ -113,6 +298,7 @@ music_player_t *music_create_player(u64snowflake guild_id) {
     /* Initialize audio stream */
     if (audio_stream_init(&player->audio) != 0) {
         DEBUG_LOG("Failed to initialize audio stream");
+        pthread_cond_destroy(&player->prefetch.cond);
         pthread_mutex_destroy(&player->lock);
         free(player);
         return NULL;
@@ -120,6 +306,7 @@ music_player_t *music_create_player(u64snowflake guild_id) {
 
     /* Set volume on audio stream */
     audio_stream_set_volume(&player->audio, player->volume);
+    if (g_bot) audio_stream_set_buffer_ms(&player->audio, g_bot->config.features.audio_buffer_ms);
 
     /* Add to global list */
     pthread_mutex_lock(&g_music.lock);
@@ -138,6 +325,9 @@ void music_destroy_player(music_player_t *player) {
     /* Stop audio streaming */
     audio_stream_stop(&player->audio);
 
+    /* Stop the prefetch worker before the player goes away */
+    prefetch_shutdown(player);
+
     /* Cleanup audio stream */
     audio_stream_cleanup(&player->audio);
 
@@ -153,6 +343,7 @@ void music_destroy_player(music_player_t *player) {
     }
 
     pthread_mutex_unlock(&player->lock);
+    pthread_cond_destroy(&player->prefetch.cond);
     pthread_mutex_destroy(&player->lock);
 
     /* Remove from global list */
@@ -394,6 +585,40 @@ void music_on_voice_session_descriptor(struct discord_voice *vc) {
 #endif
 }
 
+static int start_decoder(music_player_t *player, audio_decoder_t *decoder, char *stream_url);
+
+/*
+ * Play the head of the queue. The prefetched decoder is used when it is
+ * for that entry; otherwise the stream is resolved and opened here.
+ */
+static void play_queue_head(music_player_t *player, const char *guild_str) {
+    music_track_t *next = music_queue_next(guild_str);
+
+    music_track_t *track;
+    audio_decoder_t *decoder;
+    char *stream_url;
+
+    pthread_mutex_lock(&player->lock);
+    player->prefetch.generation++;
+    prefetch_take(&player->prefetch, &track, &decoder, &stream_url);
+    if (next) player->current_track = next;
+    pthread_mutex_unlock(&player->lock);
+
+    if (next && decoder && track->id == next->id) {
+        DEBUG_LOG("Switching to prefetched track: %s", next->title);
+        start_decoder(player, decoder, stream_url);
+        decoder = NULL;
+        stream_url = NULL;
+    } else if (next) {
+        music_start_playback(player);
+    } else if (player->loop_queue) {
+        /* TODO: Reload queue for loop */
+        DEBUG_LOG("Queue ended, loop_queue not fully implemented");
+    }
+
+    prefetch_discard(track, decoder, stream_url);
+}
+
 /* Track end callback */
 static void on_track_end(void *user_data) {
     music_player_t *player = (music_player_t *)user_data;
@@ -401,53 +626,38 @@ static void on_track_end(void *user_data) {
 
     DEBUG_LOG("Track ended for guild %"PRIu64, player->guild_id);
 
-    /* Free current track */
     pthread_mutex_lock(&player->lock);
-    if (player->current_track) {
-        free(player->current_track);
-        player->current_track = NULL;
-    }
+    music_track_t *finished = player->current_track;
+    bool loop = player->loop_track && finished;
+    if (!loop) player->current_track = NULL;
     player->state = PLAYER_STATE_IDLE;
     pthread_mutex_unlock(&player->lock);
 
-    /* Check for loop or next track */
-    if (player->loop_track && player->current_track) {
-        /* Loop current track */
+    /* Loop current track */
+    if (loop) {
         music_start_playback(player);
-    } else {
-        /* Try to play next track */
-        char guild_str[32];
-        snprintf(guild_str, sizeof(guild_str), "%"PRIu64, player->guild_id);
-
-        music_track_t *next = music_queue_next(guild_str);
-        if (next) {
-            pthread_mutex_lock(&player->lock);
-            player->current_track = next;
-            pthread_mutex_unlock(&player->lock);
-            music_start_playback(player);
-        } else if (player->loop_queue) {
-            /* TODO: Reload queue for loop */
-            DEBUG_LOG("Queue ended, loop_queue not fully implemented");
-        }
+        return;
     }
-}
 
-/* Start playback of current track */
-int music_start_playback(music_player_t *player) {
-    if (!player || !player->current_track) return -1;
+    char guild_str[32];
+    snprintf(guild_str, sizeof(guild_str), "%"PRIu64, player->guild_id);
 
-    /* Get stream URL */
-    char *stream_url = music_get_stream_url(player->current_track);
-    if (!stream_url) {
-        DEBUG_LOG("Failed to get stream URL for track");
-        return -1;
+    /* The finished track leaves the queue, as on skip */
+    if (finished) {
+        music_queue_remove(guild_str, finished->position);
+        free(finished);
     }
 
+    play_queue_head(player, guild_str);
+}
+
+/* Hand an open decoder to the audio stream; takes ownership of both */
+static int start_decoder(music_player_t *player, audio_decoder_t *decoder, char *stream_url) {
     /* Set callback for track end */
     audio_stream_set_callback(&player->audio, on_track_end, player);
 
     /* Start audio stream */
-    int ret = audio_stream_play(&player->audio, stream_url);
+    int ret = audio_stream_play_decoder(&player->audio, decoder, stream_url);
     free(stream_url);
 
     if (ret != 0) {
@@ -460,9 +670,33 @@ int music_start_playback(music_player_t *player) {
     pthread_mutex_unlock(&player->lock);
 
     DEBUG_LOG("Started playback: %s", player->current_track->title);
+
+    /* Start on the entry after this one while it plays */
+    music_prefetch_invalidate(player);
     return 0;
 }
 
+/* Start playback of current track */
+int music_start_playback(music_player_t *player) {
+    if (!player || !player->current_track) return -1;
+
+    /* Get stream URL */
+    char *stream_url = music_get_stream_url(player->current_track);
+    if (!stream_url) {
+        DEBUG_LOG("Failed to get stream URL for track");
+        return -1;
+    }
+
+    audio_decoder_t *decoder = audio_decoder_open(stream_url, AUDIO_DECODER_AUTO);
+    if (!decoder) {
+        DEBUG_LOG("Failed to open decoder for track");
+        free(stream_url);
+        return -1;
+    }
+
+    return start_decoder(player, decoder, stream_url);
+}
+
 /* Queue management - add track */
 int music_queue_add(const char *guild_id, const music_track_t *track) {
     if (!g_bot || !g_bot->database.db || !guild_id || !track) return -1;
@@ -475,7 +709,7 @@ int music_queue_add(const char *guild_id, const music_track_t *track) {
         "datetime('now'))";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_ADD, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -490,7 +724,7 @@ int music_queue_add(const char *guild_id, const music_track_t *track) {
     sqlite3_bind_text(stmt, 9, guild_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_ADD, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -502,7 +736,7 @@ int music_queue_remove(const char *guild_id, int position) {
     const char *sql = "DELETE FROM music_queue WHERE guild_id = ? AND position = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_REMOVE, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -510,7 +744,7 @@ int music_queue_remove(const char *guild_id, int position) {
     sqlite3_bind_int(stmt, 2, position);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_REMOVE, stmt);
 
     if (rc != SQLITE_DONE) return -1;
 
@@ -519,11 +753,11 @@ int music_queue_remove(const char *guild_id, int position) {
         "UPDATE music_queue SET position = position - 1 "
         "WHERE guild_id = ? AND position > ?";
 
-    if (sqlite3_prepare_v2(g_bot->database.db, reorder, -1, &stmt, NULL) == SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_REMOVE_REORDER, reorder, &stmt) == SQLITE_OK) {
         sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
         sqlite3_bind_int(stmt, 2, position);
         sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_REMOVE_REORDER, stmt);
     }
 
     return 0;
@@ -536,14 +770,14 @@ int music_queue_clear(const char *guild_id) {
     const char *sql = "DELETE FROM music_queue WHERE guild_id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_CLEAR, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_CLEAR, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -557,7 +791,7 @@ music_track_t *music_queue_get(const char *guild_id, int *count) {
     /* First get count */
     const char *count_sql = "SELECT COUNT(*) FROM music_queue WHERE guild_id = ?";
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, count_sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(&g_bot->database, DB_STMT_MUSIC_QUEUE_GET_COUNT, count_sql, &stmt) != SQLITE_OK) {
         return NULL;
     }
 
@@ -567,7 +801,7 @@ music_track_t *music_queue_get(const char *guild_id, int *count) {
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         total = sqlite3_column_int(stmt, 0);
     }
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_GET_COUNT, stmt);
 
     if (total == 0) return NULL;
 
@@ -580,7 +814,7 @@ music_track_t *music_queue_get(const char *guild_id, int *count) {
         "thumbnail, is_local, position, added_at FROM music_queue "
         "WHERE guild_id = ? ORDER BY position ASC";
 
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(&g_bot->database, DB_STMT_MUSIC_QUEUE_GET, sql, &stmt) != SQLITE_OK) {
         free(tracks);
         return NULL;
     }
@@ -616,12 +850,45 @@ music_track_t *music_queue_get(const char *guild_id, int *count) {
 
         i++;
     }
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_GET, stmt);
 
     *count = i;
     return tracks;
 }
 
+/* Build a track from a music_queue row selected in the order used below */
+static music_track_t *track_from_row(sqlite3_stmt *stmt) {
+    music_track_t *track = calloc(1, sizeof(music_track_t));
+    if (!track) return NULL;
+
+    track->id = sqlite3_column_int(stmt, 0);
+
+    const char *gid = (const char *)sqlite3_column_text(stmt, 1);
+    if (gid) strncpy(track->guild_id, gid, sizeof(track->guild_id) - 1);
+
+    const char *cid = (const char *)sqlite3_column_text(stmt, 2);
+    if (cid) strncpy(track->channel_id, cid, sizeof(track->channel_id) - 1);
+
+    const char *uid = (const char *)sqlite3_column_text(stmt, 3);
+    if (uid) strncpy(track->user_id, uid, sizeof(track->user_id) - 1);
+
+    const char *title = (const char *)sqlite3_column_text(stmt, 4);
+    if (title) strncpy(track->title, title, sizeof(track->title) - 1);
+
+    const char *url = (const char *)sqlite3_column_text(stmt, 5);
+    if (url) strncpy(track->url, url, sizeof(track->url) - 1);
+
+    track->duration = sqlite3_column_int(stmt, 6);
+
+    const char *thumb = (const char *)sqlite3_column_text(stmt, 7);
+    if (thumb) strncpy(track->thumbnail, thumb, sizeof(track->thumbnail) - 1);
+
+    track->is_local = sqlite3_column_int(stmt, 8) != 0;
+    track->position = sqlite3_column_int(stmt, 9);
+
+    return track;
+}
+
 /* Queue management - get next track */
 music_track_t *music_queue_next(const char *guild_id) {
     if (!g_bot || !g_bot->database.db || !guild_id) return NULL;
@@ -632,7 +899,7 @@ music_track_t *music_queue_next(const char *guild_id) {
         "WHERE guild_id = ? ORDER BY position ASC LIMIT 1";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(&g_bot->database, DB_STMT_MUSIC_QUEUE_NEXT, sql, &stmt) != SQLITE_OK) {
         return NULL;
     }
 
@@ -640,35 +907,35 @@ music_track_t *music_queue_next(const char *guild_id) {
 
     music_track_t *track = NULL;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        track = calloc(1, sizeof(music_track_t));
-        if (track) {
-            track->id = sqlite3_column_int(stmt, 0);
-
-            const char *gid = (const char *)sqlite3_column_text(stmt, 1);
-            if (gid) strncpy(track->guild_id, gid, sizeof(track->guild_id) - 1);
-
-            const char *cid = (const char *)sqlite3_column_text(stmt, 2);
-            if (cid) strncpy(track->channel_id, cid, sizeof(track->channel_id) - 1);
+        track = track_from_row(stmt);
+    }
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_NEXT, stmt);
 
-            const char *uid = (const char *)sqlite3_column_text(stmt, 3);
-            if (uid) strncpy(track->user_id, uid, sizeof(track->user_id) - 1);
+    return track;
+}
 
-            const char *title = (const char *)sqlite3_column_text(stmt, 4);
-            if (title) strncpy(track->title, title, sizeof(track->title) - 1);
+/* Queue management - get the track following a position */
+music_track_t *music_queue_after(const char *guild_id, int position) {
+    if (!g_bot || !g_bot->database.db || !guild_id) return NULL;
 
-            const char *url = (const char *)sqlite3_column_text(stmt, 5);
-            if (url) strncpy(track->url, url, sizeof(track->url) - 1);
+    const char *sql =
+        "SELECT id, guild_id, channel_id, user_id, title, url, duration, "
+        "thumbnail, is_local, position FROM music_queue "
+        "WHERE guild_id = ? AND position > ? ORDER BY position ASC LIMIT 1";
 
-            track->duration = sqlite3_column_int(stmt, 6);
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare_read(&g_bot->database, DB_STMT_MUSIC_QUEUE_AFTER, sql, &stmt) != SQLITE_OK) {
+        return NULL;
+    }
 
-            const char *thumb = (const char *)sqlite3_column_text(stmt, 7);
-            if (thumb) strncpy(track->thumbnail, thumb, sizeof(track->thumbnail) - 1);
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, position);
 
-            track->is_local = sqlite3_column_int(stmt, 8) != 0;
-            track->position = sqlite3_column_int(stmt, 9);
-        }
+    music_track_t *track = NULL;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        track = track_from_row(stmt);
     }
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_AFTER, stmt);
 
     return track;
 }
@@ -680,7 +947,7 @@ int music_queue_shuffle(const char *guild_id) {
     /* Get all track IDs */
     const char *sql = "SELECT id FROM music_queue WHERE guild_id = ? ORDER BY position";
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_SHUFFLE, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -692,7 +959,7 @@ int music_queue_shuffle(const char *guild_id) {
     while (sqlite3_step(stmt) == SQLITE_ROW && count < MUSIC_MAX_QUEUE_SIZE) {
         ids[count++] = sqlite3_column_int(stmt, 0);
     }
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_SHUFFLE, stmt);
 
     if (count < 2) return 0;  /* Nothing to shuffle */
 
@@ -708,11 +975,11 @@ int music_queue_shuffle(const char *guild_id) {
     /* Update positions */
     const char *update = "UPDATE music_queue SET position = ? WHERE id = ?";
     for (int i = 0; i < count; i++) {
-        if (sqlite3_prepare_v2(g_bot->database.db, update, -1, &stmt, NULL) == SQLITE_OK) {
+        if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_QUEUE_SHUFFLE_UPDATE, update, &stmt) == SQLITE_OK) {
             sqlite3_bind_int(stmt, 1, i + 1);
             sqlite3_bind_int(stmt, 2, ids[i]);
             sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+            db_stmt_release(&g_bot->database, DB_STMT_MUSIC_QUEUE_SHUFFLE_UPDATE, stmt);
         }
     }
 
@@ -741,46 +1008,32 @@ int music_resolve_track(const char *query, music_track_t *track) {
         snprintf(track->url, sizeof(track->url), "ytsearch:%s", query);
     }
 
-    /* Use yt-dlp to get metadata */
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd),
-             "yt-dlp --no-download --print title --print duration --print thumbnail "
-             "--print webpage_url \"%s\" 2>/dev/null | head -4",
-             track->url);
+    char key[MUSIC_CACHE_KEY_LEN];
+    music_cache_normalize(query, key, sizeof(key));
 
-    FILE *fp = popen(cmd, "r");
-    if (!fp) {
-        strncpy(track->title, query, sizeof(track->title) - 1);
+    music_cache_meta_t meta;
+    if (music_cache_get_meta(key, &meta)) {
+        strncpy(track->title, meta.title, sizeof(track->title) - 1);
+        track->duration = meta.duration;
+        strncpy(track->thumbnail, meta.thumbnail, sizeof(track->thumbnail) - 1);
+        if (meta.webpage_url[0]) strncpy(track->url, meta.webpage_url, sizeof(track->url) - 1);
         return 0;
     }
 
-    char line[512];
-    int line_num = 0;
+    /* Ask a yt-dlp worker; only a complete answer is worth keeping, and the page URL gets it too */
+    if (resolver_pool_resolve(track->url, &meta) == 0) {
+        strncpy(track->title, meta.title, sizeof(track->title) - 1);
+        track->duration = meta.duration;
+        strncpy(track->thumbnail, meta.thumbnail, sizeof(track->thumbnail) - 1);
+        if (meta.webpage_url[0]) strncpy(track->url, meta.webpage_url, sizeof(track->url) - 1);
 
-    while (fgets(line, sizeof(line), fp) && line_num < 4) {
-        /* Remove newline */
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') line[len-1] = '\0';
+        music_cache_put_meta(key, &meta);
 
-        switch (line_num) {
-            case 0:  /* Title */
-                strncpy(track->title, line, sizeof(track->title) - 1);
-                break;
-            case 1:  /* Duration */
-                track->duration = atoi(line);
-                break;
-            case 2:  /* Thumbnail */
-                strncpy(track->thumbnail, line, sizeof(track->thumbnail) - 1);
-                break;
-            case 3:  /* URL */
-                strncpy(track->url, line, sizeof(track->url) - 1);
-                break;
-        }
-        line_num++;
+        char page_key[MUSIC_CACHE_KEY_LEN];
+        music_cache_normalize(track->url, page_key, sizeof(page_key));
+        if (strcmp(page_key, key) != 0) music_cache_put_meta(page_key, &meta);
     }
 
-    pclose(fp);
-
     /* Fallback title */
     if (track->title[0] == '\0') {
         strncpy(track->title, query, sizeof(track->title) - 1);
@@ -789,36 +1042,26 @@ int music_resolve_track(const char *query, music_track_t *track) {
     return 0;
 }
 
-/* Get stream URL using yt-dlp */
+/* Get stream URL from a yt-dlp worker */
 char *music_get_stream_url(const music_track_t *track) {
     if (!track) return NULL;
 
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd),
-             "yt-dlp -f bestaudio --get-url \"%s\" 2>/dev/null | head -1",
-             track->url);
+    char key[MUSIC_CACHE_KEY_LEN];
+    music_cache_normalize(track->url, key, sizeof(key));
 
-    FILE *fp = popen(cmd, "r");
-    if (!fp) return NULL;
+    char *cached = malloc(2048);
+    if (cached && music_cache_get_stream(key, cached, 2048)) return cached;
+    free(cached);
 
     char *url = malloc(2048);
-    if (!url) {
-        pclose(fp);
-        return NULL;
-    }
+    if (!url) return NULL;
 
-    if (!fgets(url, 2048, fp)) {
+    if (resolver_pool_stream_url(track->url, url, 2048) != 0) {
         free(url);
-        pclose(fp);
         return NULL;
     }
 
-    /* Remove newline */
-    size_t len = strlen(url);
-    if (len > 0 && url[len-1] == '\n') url[len-1] = '\0';
-
-    pclose(fp);
-
+    music_cache_put_stream(key, url);
     return url;
 }
 
@@ -863,6 +1106,12 @@ int music_play(music_player_t *player, const char *query, u64snowflake user_id)
         player->state = PLAYER_STATE_LOADING;
         pthread_mutex_unlock(&player->lock);
     } else {
+        /* Already playing; the new track may be the one to prefetch */
+        music_prefetch_t *pf = &player->prefetch;
+        if (player->state != PLAYER_STATE_LOADING && player->current_track &&
+            !pf->track && !pf->wanted && !pf->busy) {
+            prefetch_request(player);
+        }
         pthread_mutex_unlock(&player->lock);
     }
 
@@ -889,13 +1138,11 @@ int music_skip(music_player_t *player) {
     player->state = PLAYER_STATE_IDLE;
     pthread_mutex_unlock(&player->lock);
 
-    /* Start next track */
-    music_track_t *next = music_queue_next(guild_str);
-    if (next && player->udp.ready) {
-        pthread_mutex_lock(&player->lock);
-        player->current_track = next;
-        pthread_mutex_unlock(&player->lock);
-        music_start_playback(player);
+    /* Start next track, from the prefetch if it got that far */
+    if (player->udp.ready) {
+        play_queue_head(player, guild_str);
+    } else {
+        music_prefetch_invalidate(player);
     }
 
     return 0;
@@ -920,6 +1167,8 @@ int music_stop(music_player_t *player) {
 
     pthread_mutex_unlock(&player->lock);
 
+    music_prefetch_invalidate(player);
+
     /* Clear queue */
     char guild_str[32];
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, player->guild_id);
@@ -1013,7 +1262,7 @@ int music_get_settings(const char *guild_id, music_settings_t *settings) {
         "WHERE guild_id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(&g_bot->database, DB_STMT_MUSIC_GET_SETTINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1032,7 +1281,7 @@ int music_get_settings(const char *guild_id, music_settings_t *settings) {
         if (folder) strncpy(settings->music_folder, folder, sizeof(settings->music_folder) - 1);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_GET_SETTINGS, stmt);
     return 0;
 }
 
@@ -1046,7 +1295,7 @@ int music_set_settings(const char *guild_id, const music_settings_t *settings) {
         "VALUES (?, ?, ?, ?, ?, datetime('now'))";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_SET_SETTINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1057,7 +1306,7 @@ int music_set_settings(const char *guild_id, const music_settings_t *settings) {
     sqlite3_bind_text(stmt, 5, settings->music_folder, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_SET_SETTINGS, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -1104,8 +1353,13 @@ int music_add_to_history(const char *guild_id, const char *user_id,
         "INSERT INTO music_history (guild_id, user_id, title, url, played_at) "
         "VALUES (?, ?, ?, ?, datetime('now'))";
 
+    if (g_bot->database.writer) {
+        return db_writer_enqueue(g_bot->database.writer, DB_STMT_MUSIC_ADD_TO_HISTORY, sql, "tttt",
+                                 guild_id, user_id, track->title, track->url);
+    }
+
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(g_bot->database.db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(&g_bot->database, DB_STMT_MUSIC_ADD_TO_HISTORY, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1115,7 +1369,7 @@ int music_add_to_history(const char *guild_id, const char *user_id,
     sqlite3_bind_text(stmt, 4, track->url, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(&g_bot->database, DB_STMT_MUSIC_ADD_TO_HISTORY, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -1447,12 +1701,17 @@ void cmd_nowplaying(struct discord *client, const struct discord_interaction *in
     char duration_str[16];
     format_duration(player->current_track->duration, duration_str, sizeof(duration_str));
 
+    audio_stream_stats_t stats;
+    audio_stream_get_stats(&player->audio, &stats);
+
     char response[512];
     snprintf(response, sizeof(response),
              ":musical_note: **Now Playing:**\n"
              "**%s**\n"
-             "Duration: %s | Volume: %d%%",
-             player->current_track->title, duration_str, player->volume);
+             "Duration: %s | Volume: %d%%\n"
+             "Buffer: %d/%d ms | Underruns: %llu",
+             player->current_track->title, duration_str, player->volume,
+             stats.buffered_ms, stats.buffer_ms, (unsigned long long)stats.underruns);
 
     respond_message(client, interaction, response);
 }
@@ -1470,12 +1729,17 @@ void cmd_nowplaying_prefix(struct discord *client, const struct discord_message
     char duration_str[16];
     format_duration(player->current_track->duration, duration_str, sizeof(duration_str));
 
+    audio_stream_stats_t stats;
+    audio_stream_get_stats(&player->audio, &stats);
+
     char response[512];
     snprintf(response, sizeof(response),
              ":musical_note: **Now Playing:**\n"
              "**%s**\n"
-             "Duration: %s | Volume: %d%%",
-             player->current_track->title, duration_str, player->volume);
+             "Duration: %s | Volume: %d%%\n"
+             "Buffer: %d/%d ms | Underruns: %llu",
+             player->current_track->title, duration_str, player->volume,
+             stats.buffered_ms, stats.buffer_ms, (unsigned long long)stats.underruns);
 
     struct discord_create_message params = { .content = response };
     discord_create_message(client, msg->channel_id, &params, NULL);
@@ -1577,6 +1841,7 @@ void cmd_shuffle(struct discord *client, const struct discord_interaction *inter
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, interaction->guild_id);
 
     if (music_queue_shuffle(guild_str) == 0) {
+        prefetch_invalidate_guild(interaction->guild_id);
         respond_message(client, interaction, ":twisted_rightwards_arrows: Queue shuffled!");
     } else {
         respond_ephemeral(client, interaction, "Failed to shuffle queue!");
@@ -1590,6 +1855,7 @@ void cmd_shuffle_prefix(struct discord *client, const struct discord_message *ms
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, msg->guild_id);
 
     if (music_queue_shuffle(guild_str) == 0) {
+        prefetch_invalidate_guild(msg->guild_id);
         struct discord_create_message params = { .content = ":twisted_rightwards_arrows: Queue shuffled!" };
         discord_create_message(client, msg->channel_id, &params, NULL);
     } else {
@@ -1609,6 +1875,7 @@ void cmd_loop(struct discord *client, const struct discord_interaction *interact
     player->loop_track = !player->loop_track;
     bool looping = player->loop_track;
     pthread_mutex_unlock(&player->lock);
+    music_prefetch_invalidate(player);
 
     char response[128];
     snprintf(response, sizeof(response),
@@ -1630,6 +1897,7 @@ void cmd_loop_prefix(struct discord *client, const struct discord_message *msg,
     player->loop_track = !player->loop_track;
     bool looping = player->loop_track;
     pthread_mutex_unlock(&player->lock);
+    music_prefetch_invalidate(player);
 
     char response[128];
     snprintf(response, sizeof(response),
@@ -1654,6 +1922,7 @@ void cmd_remove(struct discord *client, const struct discord_interaction *intera
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, interaction->guild_id);
 
     if (music_queue_remove(guild_str, position) == 0) {
+        prefetch_invalidate_guild(interaction->guild_id);
         char response[128];
         snprintf(response, sizeof(response), ":wastebasket: Removed track #%d from queue!", position);
         respond_message(client, interaction, response);
@@ -1672,6 +1941,7 @@ void cmd_remove_prefix(struct discord *client, const struct discord_message *msg
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, msg->guild_id);
 
     if (music_queue_remove(guild_str, position) == 0) {
+        prefetch_invalidate_guild(msg->guild_id);
         char response[128];
         snprintf(response, sizeof(response), ":wastebasket: Removed track #%d from queue!", position);
         struct discord_create_message params = { .content = response };
@@ -1687,6 +1957,7 @@ void cmd_clear(struct discord *client, const struct discord_interaction *interac
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, interaction->guild_id);
 
     if (music_queue_clear(guild_str) == 0) {
+        prefetch_invalidate_guild(interaction->guild_id);
         respond_message(client, interaction, ":wastebasket: Queue cleared!");
     } else {
         respond_ephemeral(client, interaction, "Failed to clear queue!");
@@ -1700,6 +1971,7 @@ void cmd_clear_prefix(struct discord *client, const struct discord_message *msg,
     snprintf(guild_str, sizeof(guild_str), "%"PRIu64, msg->guild_id);
 
     if (music_queue_clear(guild_str) == 0) {
+        prefetch_invalidate_guild(msg->guild_id);
         struct discord_create_message params = { .content = ":wastebasket: Queue cleared!" };
         discord_create_message(client, msg->channel_id, &params, NULL);
     } else {
@@ -1732,6 +2004,119 @@ void cmd_musicsetup_prefix(struct discord *client, const struct discord_message
     discord_create_message(client, msg->channel_id, &params, NULL);
 }
 
+/* Resolution cache report: hit rates per level */
+static void format_cache_stats(char *buf, size_t len) {
+    music_cache_stats_t st;
+    music_cache_get_stats(&st);
+    resolver_pool_stats_t rs;
+    resolver_pool_get_stats(&rs);
+
+    unsigned long long meta_total = st.meta_memory_hits + st.meta_disk_hits + st.meta_misses;
+    unsigned long long stream_total = st.stream_memory_hits + st.stream_disk_hits + st.stream_misses;
+    double meta_rate = meta_total ? 100.0 * (double)(st.meta_memory_hits + st.meta_disk_hits) / (double)meta_total : 0;
+    double stream_rate = stream_total ? 100.0 * (double)(st.stream_memory_hits + st.stream_disk_hits) / (double)stream_total : 0;
+
+    snprintf(buf, len,
+        "**Track Resolution Cache**\n"
+        "Metadata: %.1f%% hit (%llu memory, %llu disk, %llu yt-dlp)\n"
+        "Stream URLs: %.1f%% hit (%llu memory, %llu disk, %llu yt-dlp)\n"
+        "In memory: %d/%d entries\n"
+        "**Resolver Workers**\n"
+        "%d/%d running, %d queued, %llu lookups (%llu failed, %llu timed out), %llu restarts",
+        meta_rate, (unsigned long long)st.meta_memory_hits, (unsigned long long)st.meta_disk_hits,
+        (unsigned long long)st.meta_misses,
+        stream_rate, (unsigned long long)st.stream_memory_hits, (unsigned long long)st.stream_disk_hits,
+        (unsigned long long)st.stream_misses,
+        st.entries, MUSIC_CACHE_MEM_ENTRIES,
+        rs.workers_alive, rs.workers, rs.queued, (unsigned long long)rs.requests,
+        (unsigned long long)rs.failures, (unsigned long long)rs.timeouts, (unsigned long long)rs.restarts);
+}
+
+/* Run a musiccache action; target is "all" or a URL/search for purge */
+static void run_cache_command(const char *action, const char *target, char *buf, size_t len) {
+    if (!action || !*action || strcmp(action, "stats") == 0) {
+        format_cache_stats(buf, len);
+        return;
+    }
+
+    if (strcmp(action, "purge") != 0) {
+        snprintf(buf, len, "Usage: musiccache [stats | purge <all | url | search>]");
+        return;
+    }
+    if (!target || !*target) {
+        snprintf(buf, len, "Tell me what to purge: `all`, a URL or a search.");
+        return;
+    }
+
+    int removed;
+    if (strcmp(target, "all") == 0) {
+        removed = music_cache_purge(NULL);
+    } else {
+        char key[MUSIC_CACHE_KEY_LEN];
+        music_cache_normalize(target, key, sizeof(key));
+        removed = music_cache_purge(key);
+    }
+
+    if (removed < 0) {
+        snprintf(buf, len, "Failed to purge the cache.");
+    } else {
+        snprintf(buf, len, ":wastebasket: Purged %d cached %s.", removed, removed == 1 ? "entry" : "entries");
+    }
+}
+
+void cmd_musiccache(struct discord *client, const struct discord_interaction *interaction) {
+    char user_id_str[32];
+    snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, interaction->member->user->id);
+    if (!config_is_owner(&g_bot->config, user_id_str)) {
+        respond_ephemeral(client, interaction, "This command is only available to bot owners.");
+        return;
+    }
+
+    const char *action = NULL;
+    const char *target = NULL;
+    if (interaction->data && interaction->data->options) {
+        for (int i = 0; i < interaction->data->options->size; i++) {
+            if (strcmp(interaction->data->options->array[i].name, "action") == 0) {
+                action = interaction->data->options->array[i].value;
+            } else if (strcmp(interaction->data->options->array[i].name, "target") == 0) {
+                target = interaction->data->options->array[i].value;
+            }
+        }
+    }
+
+    char response[512];
+    run_cache_command(action, target, response, sizeof(response));
+    respond_ephemeral(client, interaction, response);
+}
+
+void cmd_musiccache_prefix(struct discord *client, const struct discord_message *msg, const char *args) {
+    char user_id_str[32];
+    snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, msg->author->id);
+    if (!config_is_owner(&g_bot->config, user_id_str)) {
+        struct discord_create_message params = { .content = "This command is only available to bot owners." };
+        discord_create_message(client, msg->channel_id, &params, NULL);
+        return;
+    }
+
+    char action[16] = "";
+    const char *target = NULL;
+    if (args) {
+        while (isspace((unsigned char)*args)) args++;
+        size_t n = strcspn(args, " \t");
+        if (n < sizeof(action)) {
+            memcpy(action, args, n);
+            action[n] = '\0';
+        }
+        target = args + n;
+        while (isspace((unsigned char)*target)) target++;
+    }
+
+    char response[512];
+    run_cache_command(action, target, response, sizeof(response));
+    struct discord_create_message params = { .content = response };
+    discord_create_message(client, msg->channel_id, &params, NULL);
+}
+
 /* Register music commands */
 void register_music_commands(himiko_bot_t *bot) {
     /* Initialize music system */
@@ -1768,6 +2153,7 @@ void register_music_commands(himiko_bot_t *bot) {
         {"clearqueue", "Clear the queue", "Music", cmd_clear, cmd_clear_prefix, 0, 1},
         {"seek", "Seek to a position", "Music", cmd_seek, cmd_seek_prefix, 0, 1},
         {"musicsetup", "Configure music settings", "Music", cmd_musicsetup, cmd_musicsetup_prefix, 0, 1},
+        {"musiccache", "Track cache stats or purge (owner)", "Music", cmd_musiccache, cmd_musiccache_prefix, 0, 1},
     };
 
     for (size_t i = 0; i < sizeof(music_cmds) / sizeof(music_cmds[0]); i++) {
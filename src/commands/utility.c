@@ -7,6 +7,7 @@
 #include "commands/utility.h"
 #include "bot.h"
 #include "database.h"
+#include "scheduler.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -247,6 +248,63 @@ void cmd_afk_prefix(struct discord *client, const struct discord_message *msg, c
     discord_create_message(client, msg->channel_id, &params, NULL);
 }
 
+/* Reminders are delivered by the scheduler; the row is the durable copy */
+#define REMINDER_LOAD_PAGE 64
+
+static void deliver_reminder(void *arg) {
+    reminder_t *r = arg;
+    if (!g_bot || !g_bot->client) return;
+
+    char content[MAX_MESSAGE_LEN + 64];
+    snprintf(content, sizeof(content), "<@%s> **Reminder:** %s", r->user_id, r->message);
+
+    struct discord_create_message params = { .content = content };
+    discord_create_message(g_bot->client, strtoull(r->channel_id, NULL, 10), &params, NULL);
+    db_mark_reminder_completed(&g_bot->database, r->id);
+}
+
+static int schedule_reminder(const reminder_t *r) {
+    reminder_t *copy = malloc(sizeof(reminder_t));
+    if (!copy) return -1;
+    *copy = *r;
+    if (scheduler_add(copy->remind_at, deliver_reminder, free, copy) != 0) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+static void add_reminder(const char *user_id, const char *channel_id, const char *message, time_t remind_at) {
+    reminder_t r;
+    memset(&r, 0, sizeof(r));
+    if (db_add_reminder(&g_bot->database, user_id, channel_id, message, remind_at, &r.id) != 0) return;
+
+    strncpy(r.user_id, user_id, sizeof(r.user_id) - 1);
+    strncpy(r.channel_id, channel_id, sizeof(r.channel_id) - 1);
+    strncpy(r.message, message, sizeof(r.message) - 1);
+    r.remind_at = remind_at;
+    schedule_reminder(&r);
+}
+
+int utility_load_reminders(himiko_database_t *db) {
+    reminder_t *page = malloc(REMINDER_LOAD_PAGE * sizeof(reminder_t));
+    if (!page) return -1;
+
+    int64_t after_id = 0;
+    int total = 0;
+    int count;
+    do {
+        if (db_get_pending_reminders(db, after_id, page, REMINDER_LOAD_PAGE, &count) != 0) break;
+        for (int i = 0; i < count; i++) {
+            if (schedule_reminder(&page[i]) == 0) total++;
+        }
+        if (count > 0) after_id = page[count - 1].id;
+    } while (count == REMINDER_LOAD_PAGE);
+
+    free(page);
+    return total;
+}
+
 void cmd_remind(struct discord *client, const struct discord_interaction *interaction) {
     struct discord_application_command_interaction_data_options *opts = interaction->data->options;
     const char *time_str = NULL;
@@ -279,7 +337,7 @@ void cmd_remind(struct discord *client, const struct discord_interaction *intera
     snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)interaction->member->user->id);
     snprintf(channel_id_str, sizeof(channel_id_str), "%lu", (unsigned long)interaction->channel_id);
 
-    db_add_reminder(&g_bot->database, user_id_str, channel_id_str, message, remind_at);
+    add_reminder(user_id_str, channel_id_str, message, remind_at);
 
     char response[512];
     snprintf(response, sizeof(response),
@@ -327,7 +385,7 @@ void cmd_remind_prefix(struct discord *client, const struct discord_message *msg
     snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)msg->author->id);
     snprintf(channel_id_str, sizeof(channel_id_str), "%lu", (unsigned long)msg->channel_id);
 
-    db_add_reminder(&g_bot->database, user_id_str, channel_id_str, message, remind_at);
+    add_reminder(user_id_str, channel_id_str, message, remind_at);
 
     char response[512];
     snprintf(response, sizeof(response),
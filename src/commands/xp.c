@@ -7,6 +7,7 @@
 #include "commands/xp.h"
 #include "bot.h"
 #include "database.h"
+#include "modules/leveling.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -57,6 +58,7 @@ void cmd_xp(struct discord *client, const struct discord_interaction *interactio
         xp_data.xp = 0;
         xp_data.level = 0;
     }
+    xp_data.xp += leveling_pending_xp(interaction->guild_id, user_id);
 
     int level = calculate_level(xp_data.xp);
     int64_t current_level_xp = xp_for_level(level);
@@ -100,6 +102,7 @@ void cmd_xp_prefix(struct discord *client, const struct discord_message *msg, co
         xp_data.xp = 0;
         xp_data.level = 0;
     }
+    xp_data.xp += leveling_pending_xp(msg->guild_id, user_id);
 
     int level = calculate_level(xp_data.xp);
     int64_t current_level_xp = xp_for_level(level);
@@ -152,18 +155,9 @@ void cmd_rank(struct discord *client, const struct discord_interaction *interact
 
     int level = calculate_level(xp_data.xp);
 
-    /* Get leaderboard position */
-    user_xp_t leaderboard[100];
-    int count;
-    db_get_leaderboard(&g_bot->database, guild_id_str, leaderboard, 100, &count);
-
-    int position = count + 1; /* Default to last if not found */
-    for (int i = 0; i < count; i++) {
-        if (strcmp(leaderboard[i].user_id, user_id_str) == 0) {
-            position = i + 1;
-            break;
-        }
-    }
+    /* Leaderboard position */
+    int position = 0;
+    db_get_user_rank(&g_bot->database, guild_id_str, user_id_str, &position);
 
     char response[512];
     snprintf(response, sizeof(response),
@@ -199,17 +193,9 @@ void cmd_rank_prefix(struct discord *client, const struct discord_message *msg,
 
     int level = calculate_level(xp_data.xp);
 
-    user_xp_t leaderboard[100];
-    int count;
-    db_get_leaderboard(&g_bot->database, guild_id_str, leaderboard, 100, &count);
-
-    int position = count + 1;
-    for (int i = 0; i < count; i++) {
-        if (strcmp(leaderboard[i].user_id, user_id_str) == 0) {
-            position = i + 1;
-            break;
-        }
-    }
+    /* Leaderboard position */
+    int position = 0;
+    db_get_user_rank(&g_bot->database, guild_id_str, user_id_str, &position);
 
     char response[512];
     snprintf(response, sizeof(response),
@@ -319,6 +305,7 @@ void cmd_setxp(struct discord *client, const struct discord_interaction *interac
 
     int level = calculate_level(xp);
     db_set_user_xp(&g_bot->database, guild_id_str, user_id_str, xp, level);
+    leveling_forget(interaction->guild_id, user_id);
 
     char response[256];
     snprintf(response, sizeof(response),
@@ -356,6 +343,7 @@ void cmd_setxp_prefix(struct discord *client, const struct discord_message *msg,
 
     int level = calculate_level(xp);
     db_set_user_xp(&g_bot->database, guild_id_str, user_id_str, xp, level);
+    leveling_forget(msg->guild_id, user_id);
 
     char response[256];
     snprintf(response, sizeof(response),
@@ -392,6 +380,7 @@ void cmd_addxp(struct discord *client, const struct discord_interaction *interac
 
     user_xp_t xp_data;
     db_add_user_xp(&g_bot->database, guild_id_str, user_id_str, amount, &xp_data);
+    leveling_forget(interaction->guild_id, user_id);
 
     char response[256];
     snprintf(response, sizeof(response),
@@ -429,6 +418,7 @@ void cmd_addxp_prefix(struct discord *client, const struct discord_message *msg,
 
     user_xp_t xp_data;
     db_add_user_xp(&g_bot->database, guild_id_str, user_id_str, amount, &xp_data);
+    leveling_forget(msg->guild_id, user_id);
 
     char response[256];
     snprintf(response, sizeof(response),
@@ -19,6 +19,21 @@ void config_init_defaults(himiko_config_t *config) {
     config->features.command_history = 1;
     config->features.auto_update = 1;
     config->features.update_check_hours = 24;
+    config->features.message_xp = 1;
+    config->features.worker_threads = 4;
+    config->features.worker_queue_depth = 1024;
+    config->features.antispam_max_users = 100000;
+    config->features.antispam_max_memory_kb = 8192;
+    config->features.antispam_repeat_distance = 8;
+    config->features.antispam_wave_authors = 5;
+    config->features.antispam_wave_window_secs = 20;
+    config->features.regex_filter_budget_ms = 5;
+    config->features.keyword_dm_per_sec = 5;
+    config->features.keyword_cooldown_secs = 60;
+    strcpy(config->features.resolver_worker, "scripts/ytdlp_worker.py");
+    config->features.resolver_workers = 2;
+    config->features.resolver_timeout_secs = 30;
+    config->features.audio_buffer_ms = 500;
 }
 
 int config_load(himiko_config_t *config, const char *path) {
@@ -152,6 +167,51 @@ int config_load(himiko_config_t *config, const char *path) {
         if (json_object_object_get_ex(features_obj, "debug_mode", &value)) {
             config->features.debug_mode = json_object_get_boolean(value);
         }
+        if (json_object_object_get_ex(features_obj, "message_xp", &value)) {
+            config->features.message_xp = json_object_get_boolean(value);
+        }
+        if (json_object_object_get_ex(features_obj, "worker_threads", &value)) {
+            config->features.worker_threads = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "worker_queue_depth", &value)) {
+            config->features.worker_queue_depth = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "antispam_max_users", &value)) {
+            config->features.antispam_max_users = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "antispam_max_memory_kb", &value)) {
+            config->features.antispam_max_memory_kb = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "antispam_repeat_distance", &value)) {
+            config->features.antispam_repeat_distance = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "antispam_wave_authors", &value)) {
+            config->features.antispam_wave_authors = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "antispam_wave_window_secs", &value)) {
+            config->features.antispam_wave_window_secs = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "regex_filter_budget_ms", &value)) {
+            config->features.regex_filter_budget_ms = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "keyword_dm_per_sec", &value)) {
+            config->features.keyword_dm_per_sec = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "keyword_cooldown_secs", &value)) {
+            config->features.keyword_cooldown_secs = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "resolver_worker", &value)) {
+            strncpy(config->features.resolver_worker, json_object_get_string(value), MAX_PATH_LEN - 1);
+        }
+        if (json_object_object_get_ex(features_obj, "resolver_workers", &value)) {
+            config->features.resolver_workers = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "resolver_timeout_secs", &value)) {
+            config->features.resolver_timeout_secs = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(features_obj, "audio_buffer_ms", &value)) {
+            config->features.audio_buffer_ms = json_object_get_int(value);
+        }
     }
 
     json_object_put(root);
@@ -3,38 +3,250 @@
  * Copyright (C) 2025 Himiko Contributors
  * SPDX-License-Identifier: AGPL-3.0-or-later
  *
- * Database schema is EXACTLY compatible with Himiko Go version.
- * This uses the same CREATE TABLE statements from database.go.
+ * Database schema is compatible with Himiko Go version.
+ * This uses the same CREATE TABLE statements from database.go, with one
+ * deliberate exception: keyword_notifications is UNIQUE(user_id, guild_id,
+ * keyword) rather than UNIQUE(user_id, keyword), so a keyword can be
+ * followed in several servers. Existing tables are migrated on startup.
  */
 
 #include "database.h"
+#include "db_cache.h"
+#include "ban_set.h"
+#include "db_writer.h"
+#include "leaderboard.h"
+#include "debug.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 
+/* WAL lets the read pool run alongside the single writer */
+static void db_tune_connection(sqlite3 *db, int writer) {
+    char pragmas[256];
+    snprintf(pragmas, sizeof(pragmas),
+             "PRAGMA mmap_size = %lld;"
+             "PRAGMA cache_size = -%d;"
+             "PRAGMA temp_store = MEMORY;",
+             (long long)DB_MMAP_SIZE, DB_CACHE_SIZE_KB);
+
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+    if (writer) {
+        /* NORMAL is durable across application crashes in WAL mode */
+        sqlite3_exec(db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+    } else {
+        sqlite3_exec(db, "PRAGMA query_only = ON;", NULL, NULL, NULL);
+    }
+    sqlite3_exec(db, pragmas, NULL, NULL, NULL);
+    db_register_functions(db);
+}
+
+static void db_open_readers(himiko_database_t *database, const char *uri) {
+    database->reader_count = 0;
+    for (int i = 0; i < DB_READ_POOL_SIZE; i++) {
+        db_reader_t *r = &database->readers[database->reader_count];
+        memset(r->stmt_cache, 0, sizeof(r->stmt_cache));
+        atomic_init(&r->in_use, 0);
+
+        if (sqlite3_open_v2(uri, &r->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Cannot open read connection: %s\n", sqlite3_errmsg(r->db));
+            sqlite3_close(r->db);
+            r->db = NULL;
+            break;
+        }
+        db_tune_connection(r->db, 0);
+        database->reader_count++;
+    }
+}
+
 int db_open(himiko_database_t *database, const char *path) {
     char uri[512];
     snprintf(uri, sizeof(uri), "%s?_foreign_keys=on", path);
 
+    for (int i = 0; i < DB_STMT_COUNT; i++) {
+        atomic_init(&database->stmt_cache[i], NULL);
+    }
+    atomic_init(&database->prepares_avoided, 0);
+    database->reader_count = 0;
+    database->writer = NULL;
+
     int rc = sqlite3_open(uri, &database->db);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(database->db));
         return -1;
     }
+    db_tune_connection(database->db, 1);
+
+    if (db_migrate(database) != 0) {
+        return -1;
+    }
+
+    /* Readers open after migration so they see the full schema */
+    db_open_readers(database, uri);
+
+    /* Without the writer thread, queued writes run inline */
+    database->writer = db_writer_start(uri, DB_WRITER_INTERVAL_MS, DB_WRITER_BATCH_ROWS);
 
-    return db_migrate(database);
+    /* Per-event ban checks are served from memory; SQL is only the fallback */
+    if (ban_set_load(database->db) != 0) {
+        fprintf(stderr, "Failed to load bot bans into memory: %s\n", sqlite3_errmsg(database->db));
+    }
+    return 0;
 }
 
 void db_close(himiko_database_t *database) {
+    /* Commit queued writes before anything else goes away */
+    db_writer_stop(database->writer);
+    database->writer = NULL;
+
+    for (int i = 0; i < database->reader_count; i++) {
+        db_reader_t *r = &database->readers[i];
+        for (int k = 0; k < DB_STMT_COUNT; k++) {
+            if (r->stmt_cache[k]) sqlite3_finalize(r->stmt_cache[k]);
+            r->stmt_cache[k] = NULL;
+        }
+        sqlite3_close(r->db);
+        r->db = NULL;
+    }
+    database->reader_count = 0;
+
     if (database->db) {
+        DEBUG_LOG("Statement cache: %llu prepares avoided", db_stmt_prepares_avoided(database));
+        for (int i = 0; i < DB_STMT_COUNT; i++) {
+            sqlite3_stmt *stmt = atomic_exchange(&database->stmt_cache[i], NULL);
+            if (stmt) sqlite3_finalize(stmt);
+        }
         sqlite3_close(database->db);
         database->db = NULL;
     }
+    db_cache_clear();
+    ban_set_clear();
+    leaderboard_clear();
+}
+
+int db_flush_writes(himiko_database_t *database) {
+    if (!database->writer) return 0;
+    return db_writer_flush(database->writer);
+}
+
+/* Prepared statement cache */
+int db_stmt_prepare(himiko_database_t *db, db_stmt_id_t id, const char *sql, sqlite3_stmt **stmt) {
+    /* Take the idle statement, if any; concurrent callers get their own */
+    *stmt = atomic_exchange_explicit(&db->stmt_cache[id], NULL, memory_order_acquire);
+    if (*stmt) {
+        atomic_fetch_add_explicit(&db->prepares_avoided, 1, memory_order_relaxed);
+        return SQLITE_OK;
+    }
+    return sqlite3_prepare_v3(db->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+}
+
+int db_stmt_prepare_read(himiko_database_t *db, db_stmt_id_t id, const char *sql, sqlite3_stmt **stmt) {
+    for (int i = 0; i < db->reader_count; i++) {
+        db_reader_t *r = &db->readers[i];
+        int expected = 0;
+        if (!atomic_compare_exchange_strong_explicit(&r->in_use, &expected, 1,
+                                                     memory_order_acquire, memory_order_relaxed)) {
+            continue;
+        }
+
+        if (r->stmt_cache[id]) {
+            *stmt = r->stmt_cache[id];
+            r->stmt_cache[id] = NULL;
+            atomic_fetch_add_explicit(&db->prepares_avoided, 1, memory_order_relaxed);
+            return SQLITE_OK;
+        }
+        if (sqlite3_prepare_v3(r->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL) == SQLITE_OK) {
+            return SQLITE_OK;
+        }
+        atomic_store_explicit(&r->in_use, 0, memory_order_release);
+        break;
+    }
+
+    /* Every reader busy (or unusable): run on the writer */
+    return db_stmt_prepare(db, id, sql, stmt);
+}
+
+void db_stmt_release(himiko_database_t *db, db_stmt_id_t id, sqlite3_stmt *stmt) {
+    if (!stmt) return;
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    /* Statements from a read connection go back to it and free the connection */
+    sqlite3 *handle = sqlite3_db_handle(stmt);
+    if (handle != db->db) {
+        for (int i = 0; i < db->reader_count; i++) {
+            db_reader_t *r = &db->readers[i];
+            if (r->db != handle) continue;
+            if (r->stmt_cache[id]) {
+                sqlite3_finalize(stmt);
+            } else {
+                r->stmt_cache[id] = stmt;
+            }
+            atomic_store_explicit(&r->in_use, 0, memory_order_release);
+            return;
+        }
+    }
+
+    sqlite3_stmt *expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&db->stmt_cache[id], &expected, stmt,
+                                                 memory_order_release, memory_order_relaxed)) {
+        sqlite3_finalize(stmt);
+    }
+}
+
+unsigned long long db_stmt_prepares_avoided(himiko_database_t *db) {
+    return atomic_load_explicit(&db->prepares_avoided, memory_order_relaxed);
 }
 
 /*
- * Schema migration - EXACT copy from Himiko Go database.go
+ * Keywords used to be unique per user across every server. SQLite cannot
+ * change a table constraint in place, so an old table is copied into one
+ * unique per (user, guild, keyword) and swapped in.
+ */
+static int migrate_keyword_notifications(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'keyword_notifications'";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+
+    int old_schema = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *table_sql = (const char *)sqlite3_column_text(stmt, 0);
+        old_schema = table_sql && strstr(table_sql, "UNIQUE(user_id, keyword)") != NULL;
+    }
+    sqlite3_finalize(stmt);
+    if (!old_schema) return 0;
+
+    const char *migration =
+        "BEGIN;"
+        "CREATE TABLE keyword_notifications_new ("
+        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    user_id TEXT NOT NULL,"
+        "    guild_id TEXT,"
+        "    keyword TEXT NOT NULL,"
+        "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+        "    UNIQUE(user_id, guild_id, keyword)"
+        ");"
+        "INSERT INTO keyword_notifications_new (id, user_id, guild_id, keyword, created_at) "
+        "    SELECT id, user_id, guild_id, keyword, created_at FROM keyword_notifications;"
+        "DROP TABLE keyword_notifications;"
+        "ALTER TABLE keyword_notifications_new RENAME TO keyword_notifications;"
+        "COMMIT;";
+
+    char *err_msg = NULL;
+    if (sqlite3_exec(db, migration, NULL, NULL, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "keyword_notifications migration failed: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Schema migration - copy from Himiko Go database.go (except the
+ * keyword_notifications constraint, see the top of this file).
  * This ensures both versions can use the same database file.
  */
 int db_migrate(himiko_database_t *database) {
@@ -155,7 +367,7 @@ int db_migrate(himiko_database_t *database) {
         "    guild_id TEXT,"
         "    keyword TEXT NOT NULL,"
         "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
-        "    UNIQUE(user_id, keyword)"
+        "    UNIQUE(user_id, guild_id, keyword)"
         ");"
 
         /* Indexes for basic tables */
@@ -417,8 +629,23 @@ int db_migrate(himiko_database_t *database) {
         "    played_at DATETIME DEFAULT CURRENT_TIMESTAMP"
         ");"
 
+        /* Music: yt-dlp results, keyed by normalized URL or search query */
+        "CREATE TABLE IF NOT EXISTS music_resolve_cache ("
+        "    cache_key TEXT PRIMARY KEY,"
+        "    has_meta INTEGER DEFAULT 0,"
+        "    title TEXT,"
+        "    duration INTEGER DEFAULT 0,"
+        "    thumbnail TEXT,"
+        "    webpage_url TEXT,"
+        "    webpage_key TEXT,"
+        "    stream_url TEXT,"
+        "    stream_expires INTEGER DEFAULT 0,"
+        "    updated_at INTEGER DEFAULT 0"
+        ");"
+
         /* Additional indexes */
         "CREATE INDEX IF NOT EXISTS idx_user_xp_guild ON user_xp(guild_id);"
+        "CREATE INDEX IF NOT EXISTS idx_user_xp_guild_xp ON user_xp(guild_id, xp DESC);"
         "CREATE INDEX IF NOT EXISTS idx_member_joins_guild ON member_joins(guild_id, joined_at);"
         "CREATE INDEX IF NOT EXISTS idx_scheduled_events_time ON scheduled_events(execute_at);"
         "CREATE INDEX IF NOT EXISTS idx_regex_filters_guild ON regex_filters(guild_id);"
@@ -429,7 +656,8 @@ int db_migrate(himiko_database_t *database) {
         "CREATE INDEX IF NOT EXISTS idx_user_aliases_user ON user_aliases(user_id);"
         "CREATE INDEX IF NOT EXISTS idx_user_activity_guild ON user_activity(guild_id);"
         "CREATE INDEX IF NOT EXISTS idx_music_queue_guild ON music_queue(guild_id, position);"
-        "CREATE INDEX IF NOT EXISTS idx_music_history_guild ON music_history(guild_id);";
+        "CREATE INDEX IF NOT EXISTS idx_music_history_guild ON music_history(guild_id);"
+        "CREATE INDEX IF NOT EXISTS idx_music_resolve_cache_webpage ON music_resolve_cache(webpage_key);";
 
     char *err_msg = NULL;
     int rc = sqlite3_exec(database->db, schema, NULL, NULL, &err_msg);
@@ -439,11 +667,22 @@ int db_migrate(himiko_database_t *database) {
         return -1;
     }
 
+    if (migrate_keyword_notifications(database->db) != 0) return -1;
+
+    rc = sqlite3_exec(database->db,
+        "CREATE INDEX IF NOT EXISTS idx_keyword_notifications_guild ON keyword_notifications(guild_id);",
+        NULL, NULL, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return -1;
+    }
+
     return 0;
 }
 
 /* Guild Settings */
-int db_get_guild_settings(himiko_database_t *db, const char *guild_id, guild_settings_t *settings) {
+static int load_guild_settings(himiko_database_t *db, const char *guild_id, guild_settings_t *settings, const db_cache_ticket_t *ticket) {
     sqlite3_stmt *stmt;
     const char *sql = "SELECT guild_id, prefix, mod_log_channel, welcome_channel, welcome_message, join_dm_title, join_dm_message "
                       "FROM guild_settings WHERE guild_id = ?";
@@ -452,13 +691,14 @@ int db_get_guild_settings(himiko_database_t *db, const char *guild_id, guild_set
     strncpy(settings->guild_id, guild_id, sizeof(settings->guild_id) - 1);
     strcpy(settings->prefix, "/");
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_LOAD_GUILD_SETTINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW) {
         const char *val;
         if ((val = (const char *)sqlite3_column_text(stmt, 1)) != NULL)
             strncpy(settings->prefix, val, sizeof(settings->prefix) - 1);
@@ -474,10 +714,23 @@ int db_get_guild_settings(himiko_database_t *db, const char *guild_id, guild_set
             strncpy(settings->join_dm_message, val, sizeof(settings->join_dm_message) - 1);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_LOAD_GUILD_SETTINGS, stmt);
+
+    /* Never cache defaults produced by a failed step */
+    if (step == SQLITE_ROW || step == SQLITE_DONE) {
+        db_cache_store(DB_CACHE_GUILD_SETTINGS, ticket, settings);
+    }
     return 0;
 }
 
+int db_get_guild_settings(himiko_database_t *db, const char *guild_id, guild_settings_t *settings) {
+    db_cache_ticket_t ticket;
+    if (db_cache_lookup(DB_CACHE_GUILD_SETTINGS, guild_id, settings, 0, sizeof(*settings), &ticket)) {
+        return 0;
+    }
+    return load_guild_settings(db, guild_id, settings, &ticket);
+}
+
 int db_set_guild_settings(himiko_database_t *db, const guild_settings_t *settings) {
     const char *sql = "INSERT INTO guild_settings (guild_id, prefix, mod_log_channel, welcome_channel, welcome_message, join_dm_title, join_dm_message, updated_at) "
                       "VALUES (?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP) "
@@ -488,7 +741,7 @@ int db_set_guild_settings(himiko_database_t *db, const guild_settings_t *setting
                       "updated_at = CURRENT_TIMESTAMP";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_GUILD_SETTINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -501,13 +754,24 @@ int db_set_guild_settings(himiko_database_t *db, const guild_settings_t *setting
     sqlite3_bind_text(stmt, 7, settings->join_dm_message[0] ? settings->join_dm_message : NULL, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_GUILD_SETTINGS, stmt);
+    db_cache_invalidate(DB_CACHE_GUILD_SETTINGS, settings->guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 int db_get_prefix(himiko_database_t *db, const char *guild_id, const char *default_prefix, char *out_prefix, size_t out_len) {
     guild_settings_t settings;
-    if (db_get_guild_settings(db, guild_id, &settings) == 0) {
+    db_cache_ticket_t ticket;
+
+    /* Hot path: copy just the prefix out of the cached row */
+    char prefix[sizeof(settings.prefix)];
+    if (db_cache_lookup(DB_CACHE_GUILD_SETTINGS, guild_id, prefix, offsetof(guild_settings_t, prefix), sizeof(prefix), &ticket)) {
+        strncpy(out_prefix, prefix[0] ? prefix : default_prefix, out_len - 1);
+        out_prefix[out_len - 1] = '\0';
+        return 0;
+    }
+
+    if (load_guild_settings(db, guild_id, &settings, &ticket) == 0) {
         strncpy(out_prefix, settings.prefix[0] ? settings.prefix : default_prefix, out_len - 1);
         out_prefix[out_len - 1] = '\0';
         return 0;
@@ -527,9 +791,13 @@ int db_set_prefix(himiko_database_t *db, const char *guild_id, const char *prefi
 /* Command history */
 int db_log_command(himiko_database_t *db, const char *guild_id, const char *channel_id, const char *user_id, const char *command, const char *args) {
     const char *sql = "INSERT INTO command_history (guild_id, channel_id, user_id, command, args) VALUES (?, ?, ?, ?, ?)";
+    if (db->writer) {
+        return db_writer_enqueue(db->writer, DB_STMT_LOG_COMMAND, sql, "ttttt", guild_id, channel_id, user_id, command, args);
+    }
+
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_LOG_COMMAND, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -540,7 +808,7 @@ int db_log_command(himiko_database_t *db, const char *guild_id, const char *chan
     sqlite3_bind_text(stmt, 5, args, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_LOG_COMMAND, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -549,7 +817,7 @@ int db_add_warning(himiko_database_t *db, const char *guild_id, const char *user
     const char *sql = "INSERT INTO warnings (guild_id, user_id, moderator_id, reason) VALUES (?, ?, ?, ?)";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_WARNING, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -559,7 +827,7 @@ int db_add_warning(himiko_database_t *db, const char *guild_id, const char *user
     sqlite3_bind_text(stmt, 4, reason, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_ADD_WARNING, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -569,7 +837,7 @@ int db_get_warnings(himiko_database_t *db, const char *guild_id, const char *use
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_WARNINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -587,7 +855,7 @@ int db_get_warnings(himiko_database_t *db, const char *guild_id, const char *use
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_WARNINGS, stmt);
     return 0;
 }
 
@@ -595,7 +863,7 @@ int db_clear_warnings(himiko_database_t *db, const char *guild_id, const char *u
     const char *sql = "DELETE FROM warnings WHERE guild_id = ? AND user_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_CLEAR_WARNINGS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -603,7 +871,7 @@ int db_clear_warnings(himiko_database_t *db, const char *guild_id, const char *u
     sqlite3_bind_text(stmt, 2, user_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_CLEAR_WARNINGS, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -611,23 +879,27 @@ int db_delete_warning(himiko_database_t *db, int64_t id) {
     const char *sql = "DELETE FROM warnings WHERE id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_DELETE_WARNING, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_int64(stmt, 1, id);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_DELETE_WARNING, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 /* Deleted messages (snipe) */
 int db_log_deleted_message(himiko_database_t *db, const char *guild_id, const char *channel_id, const char *user_id, const char *content) {
     const char *sql = "INSERT INTO deleted_messages (guild_id, channel_id, user_id, content) VALUES (?, ?, ?, ?)";
+    if (db->writer) {
+        return db_writer_enqueue(db->writer, DB_STMT_LOG_DELETED_MESSAGE, sql, "tttt", guild_id, channel_id, user_id, content);
+    }
+
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_LOG_DELETED_MESSAGE, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -637,7 +909,7 @@ int db_log_deleted_message(himiko_database_t *db, const char *guild_id, const ch
     sqlite3_bind_text(stmt, 4, content, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_LOG_DELETED_MESSAGE, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -647,7 +919,7 @@ int db_get_deleted_messages(himiko_database_t *db, const char *channel_id, delet
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_DELETED_MESSAGES, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -666,7 +938,7 @@ int db_get_deleted_messages(himiko_database_t *db, const char *channel_id, delet
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_DELETED_MESSAGES, stmt);
     return 0;
 }
 
@@ -674,7 +946,7 @@ int db_clean_old_deleted_messages(himiko_database_t *db, int older_than_hours) {
     const char *sql = "DELETE FROM deleted_messages WHERE deleted_at < datetime('now', ? || ' hours')";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_CLEAN_OLD_DELETED_MESSAGES, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -683,7 +955,7 @@ int db_clean_old_deleted_messages(himiko_database_t *db, int older_than_hours) {
     sqlite3_bind_text(stmt, 1, hours_str, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_CLEAN_OLD_DELETED_MESSAGES, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -696,11 +968,35 @@ int calculate_level(int64_t xp) {
     return (level < 0) ? 0 : level;
 }
 
+static void sql_xp_level(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    (void)argc;
+    sqlite3_result_int(ctx, calculate_level(sqlite3_value_int64(argv[0])));
+}
+
+void db_register_functions(sqlite3 *db) {
+    sqlite3_create_function(db, "xp_level", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, sql_xp_level, NULL, NULL);
+}
+
 int64_t xp_for_level(int level) {
     /* XP = 5*level^2 + 50*level + 100 */
     return (int64_t)(5 * level * level + 50 * level + 100);
 }
 
+/* Leaderboard index is keyed by numeric IDs; anything else takes the SQL path */
+static int parse_snowflake(const char *str, uint64_t *out) {
+    char *end;
+    if (!str || !*str) return -1;
+    *out = strtoull(str, &end, 10);
+    return (*end == '\0') ? 0 : -1;
+}
+
+static void leaderboard_update(const char *guild_id, const char *user_id, int64_t xp) {
+    uint64_t gid, uid;
+    if (parse_snowflake(guild_id, &gid) == 0 && parse_snowflake(user_id, &uid) == 0) {
+        leaderboard_set_xp(gid, uid, xp);
+    }
+}
+
 int db_get_user_xp(himiko_database_t *db, const char *guild_id, const char *user_id, user_xp_t *xp) {
     const char *sql = "SELECT guild_id, user_id, xp, level, updated_at FROM user_xp WHERE guild_id = ? AND user_id = ?";
     sqlite3_stmt *stmt;
@@ -709,7 +1005,7 @@ int db_get_user_xp(himiko_database_t *db, const char *guild_id, const char *user
     strncpy(xp->guild_id, guild_id, sizeof(xp->guild_id) - 1);
     strncpy(xp->user_id, user_id, sizeof(xp->user_id) - 1);
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_USER_XP, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -721,7 +1017,7 @@ int db_get_user_xp(himiko_database_t *db, const char *guild_id, const char *user
         xp->level = sqlite3_column_int(stmt, 3);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_USER_XP, stmt);
     return 0;
 }
 
@@ -732,7 +1028,7 @@ int db_set_user_xp(himiko_database_t *db, const char *guild_id, const char *user
                       "xp = excluded.xp, level = excluded.level, updated_at = CURRENT_TIMESTAMP";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_USER_XP, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -742,24 +1038,89 @@ int db_set_user_xp(himiko_database_t *db, const char *guild_id, const char *user
     sqlite3_bind_int(stmt, 4, level);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    db_stmt_release(db, DB_STMT_SET_USER_XP, stmt);
+    if (rc != SQLITE_DONE) return -1;
+
+    leaderboard_update(guild_id, user_id, xp);
+    return 0;
 }
 
+/* The level comes from the stored total plus the delta, not from the delta alone */
+static const char *add_user_xp_sql =
+    "INSERT INTO user_xp (guild_id, user_id, xp, level, updated_at) "
+    "VALUES (?1, ?2, ?3, xp_level(?3), CURRENT_TIMESTAMP) "
+    "ON CONFLICT(guild_id, user_id) DO UPDATE SET "
+    "xp = user_xp.xp + excluded.xp, level = xp_level(user_xp.xp + excluded.xp), "
+    "updated_at = CURRENT_TIMESTAMP";
+
 int db_add_user_xp(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t amount, user_xp_t *result) {
+    sqlite3_stmt *stmt;
+
+    /* The increment happens in SQL so concurrent adds cannot lose each other */
+    if (db_stmt_prepare(db, DB_STMT_ADD_USER_XP, add_user_xp_sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, user_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, amount);
+
+    int rc = sqlite3_step(stmt);
+    db_stmt_release(db, DB_STMT_ADD_USER_XP, stmt);
+    if (rc != SQLITE_DONE) return -1;
+
     db_get_user_xp(db, guild_id, user_id, result);
-    result->xp += amount;
-    result->level = calculate_level(result->xp);
-    return db_set_user_xp(db, guild_id, user_id, result->xp, result->level);
+    leaderboard_update(guild_id, user_id, result->xp);
+    return 0;
+}
+
+int db_add_user_xp_delta(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t delta) {
+    if (db->writer) {
+        return db_writer_enqueue(db->writer, DB_STMT_ADD_USER_XP, add_user_xp_sql, "tti",
+                                 guild_id, user_id, delta);
+    }
+
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare(db, DB_STMT_ADD_USER_XP, add_user_xp_sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, user_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, delta);
+
+    int rc = sqlite3_step(stmt);
+    db_stmt_release(db, DB_STMT_ADD_USER_XP, stmt);
+    return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 int db_get_leaderboard(himiko_database_t *db, const char *guild_id, user_xp_t *results, int max_results, int *count) {
+    uint64_t gid;
+    if (max_results > 0 && parse_snowflake(guild_id, &gid) == 0) {
+        leaderboard_entry_t *top = malloc((size_t)max_results * sizeof(leaderboard_entry_t));
+        int n = top ? leaderboard_top(db, gid, top, max_results) : -1;
+        if (n >= 0) {
+            for (int i = 0; i < n; i++) {
+                user_xp_t *ux = &results[i];
+                memset(ux, 0, sizeof(user_xp_t));
+                strncpy(ux->guild_id, guild_id, sizeof(ux->guild_id) - 1);
+                snprintf(ux->user_id, sizeof(ux->user_id), "%llu", (unsigned long long)top[i].user_id);
+                ux->xp = top[i].xp;
+                ux->level = calculate_level(top[i].xp);
+            }
+            free(top);
+            *count = n;
+            return 0;
+        }
+        free(top);
+    }
+
     const char *sql = "SELECT guild_id, user_id, xp, level, updated_at FROM user_xp "
                       "WHERE guild_id = ? ORDER BY xp DESC LIMIT ?";
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_LEADERBOARD, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -775,17 +1136,23 @@ int db_get_leaderboard(himiko_database_t *db, const char *guild_id, user_xp_t *r
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_LEADERBOARD, stmt);
     return 0;
 }
 
 int db_get_user_rank(himiko_database_t *db, const char *guild_id, const char *user_id, int *rank) {
+    uint64_t gid, uid;
+    if (parse_snowflake(guild_id, &gid) == 0 && parse_snowflake(user_id, &uid) == 0 &&
+        leaderboard_rank(db, gid, uid, rank) == 0) {
+        return 0;
+    }
+
     const char *sql = "SELECT COUNT(*) + 1 FROM user_xp WHERE guild_id = ? AND xp > "
                       "(SELECT COALESCE(xp, 0) FROM user_xp WHERE guild_id = ? AND user_id = ?)";
     sqlite3_stmt *stmt;
     *rank = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_USER_RANK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -797,7 +1164,7 @@ int db_get_user_rank(himiko_database_t *db, const char *guild_id, const char *us
         *rank = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_USER_RANK, stmt);
     return 0;
 }
 
@@ -807,7 +1174,7 @@ int db_add_level_rank(himiko_database_t *db, const char *guild_id, const char *r
                       "ON CONFLICT(guild_id, role_id) DO UPDATE SET level = excluded.level";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_LEVEL_RANK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -816,7 +1183,7 @@ int db_add_level_rank(himiko_database_t *db, const char *guild_id, const char *r
     sqlite3_bind_int(stmt, 3, level);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_ADD_LEVEL_RANK, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -824,7 +1191,7 @@ int db_remove_level_rank(himiko_database_t *db, const char *guild_id, const char
     const char *sql = "DELETE FROM level_ranks WHERE guild_id = ? AND role_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_REMOVE_LEVEL_RANK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -832,7 +1199,7 @@ int db_remove_level_rank(himiko_database_t *db, const char *guild_id, const char
     sqlite3_bind_text(stmt, 2, role_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_REMOVE_LEVEL_RANK, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -841,7 +1208,7 @@ int db_get_level_ranks(himiko_database_t *db, const char *guild_id, level_rank_t
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_LEVEL_RANKS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -856,7 +1223,7 @@ int db_get_level_ranks(himiko_database_t *db, const char *guild_id, level_rank_t
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_LEVEL_RANKS, stmt);
     return 0;
 }
 
@@ -865,7 +1232,7 @@ int db_get_ranks_for_level(himiko_database_t *db, const char *guild_id, int leve
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_RANKS_FOR_LEVEL, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -881,7 +1248,7 @@ int db_get_ranks_for_level(himiko_database_t *db, const char *guild_id, int leve
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_RANKS_FOR_LEVEL, stmt);
     return 0;
 }
 
@@ -892,7 +1259,7 @@ int db_add_bot_ban(himiko_database_t *db, const char *target_id, const char *ban
                       "ON CONFLICT(target_id) DO UPDATE SET ban_type = excluded.ban_type, reason = excluded.reason";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_BOT_BAN, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -902,31 +1269,54 @@ int db_add_bot_ban(himiko_database_t *db, const char *target_id, const char *ban
     sqlite3_bind_text(stmt, 4, banned_by, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    db_stmt_release(db, DB_STMT_ADD_BOT_BAN, stmt);
+    if (rc != SQLITE_DONE) return -1;
+
+    ban_set_add(strtoull(target_id, NULL, 10));
+    return 0;
 }
 
 int db_remove_bot_ban(himiko_database_t *db, const char *target_id) {
     const char *sql = "DELETE FROM bot_bans WHERE target_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_REMOVE_BOT_BAN, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, target_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    db_stmt_release(db, DB_STMT_REMOVE_BOT_BAN, stmt);
+    if (rc != SQLITE_DONE) return -1;
+
+    ban_set_remove(strtoull(target_id, NULL, 10));
+    return 0;
+}
+
+int db_is_bot_banned_id(himiko_database_t *db, uint64_t target_id) {
+    int banned = ban_set_contains(target_id);
+    if (banned >= 0) return banned;
+
+    /* Set failed to load at startup */
+    char id_str[32];
+    snprintf(id_str, sizeof(id_str), "%lu", (unsigned long)target_id);
+    return db_is_bot_banned(db, id_str);
 }
 
 int db_is_bot_banned(himiko_database_t *db, const char *target_id) {
+    char *end;
+    uint64_t id = strtoull(target_id, &end, 10);
+    if (*target_id && *end == '\0') {
+        int banned = ban_set_contains(id);
+        if (banned >= 0) return banned;
+    }
+
     const char *sql = "SELECT COUNT(*) FROM bot_bans WHERE target_id = ?";
     sqlite3_stmt *stmt;
     int banned = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_IS_BOT_BANNED, sql, &stmt) != SQLITE_OK) {
         return 0;
     }
 
@@ -936,7 +1326,7 @@ int db_is_bot_banned(himiko_database_t *db, const char *target_id) {
         banned = sqlite3_column_int(stmt, 0) > 0;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_IS_BOT_BANNED, stmt);
     return banned;
 }
 
@@ -946,7 +1336,7 @@ int db_set_afk(himiko_database_t *db, const char *user_id, const char *message)
                       "ON CONFLICT(user_id) DO UPDATE SET message = excluded.message, set_at = CURRENT_TIMESTAMP";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_AFK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -954,7 +1344,7 @@ int db_set_afk(himiko_database_t *db, const char *user_id, const char *message)
     sqlite3_bind_text(stmt, 2, message, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_AFK, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -964,7 +1354,7 @@ int db_get_afk(himiko_database_t *db, const char *user_id, afk_status_t *afk) {
 
     memset(afk, 0, sizeof(afk_status_t));
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_AFK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -978,7 +1368,7 @@ int db_get_afk(himiko_database_t *db, const char *user_id, afk_status_t *afk) {
         found = 1;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_AFK, stmt);
     return found ? 0 : -1;
 }
 
@@ -986,14 +1376,14 @@ int db_remove_afk(himiko_database_t *db, const char *user_id) {
     const char *sql = "DELETE FROM afk_status WHERE user_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_REMOVE_AFK, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, user_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_REMOVE_AFK, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1001,9 +1391,14 @@ int db_remove_afk(himiko_database_t *db, const char *user_id) {
 int db_add_mod_action(himiko_database_t *db, const mod_action_t *action) {
     const char *sql = "INSERT INTO mod_actions (guild_id, moderator_id, target_id, action, reason, timestamp) "
                       "VALUES (?, ?, ?, ?, ?, ?)";
+    if (db->writer) {
+        return db_writer_enqueue(db->writer, DB_STMT_ADD_MOD_ACTION, sql, "ttttti", action->guild_id, action->moderator_id, action->target_id, action->action,
+                                 action->reason[0] ? action->reason : NULL, (int64_t)action->timestamp);
+    }
+
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_MOD_ACTION, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1015,7 +1410,7 @@ int db_add_mod_action(himiko_database_t *db, const mod_action_t *action) {
     sqlite3_bind_int64(stmt, 6, action->timestamp);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_ADD_MOD_ACTION, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1024,7 +1419,7 @@ int db_get_mod_actions_count(himiko_database_t *db, const char *guild_id, int *c
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_MOD_ACTIONS_COUNT, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1034,16 +1429,17 @@ int db_get_mod_actions_count(himiko_database_t *db, const char *guild_id, int *c
         *count = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_MOD_ACTIONS_COUNT, stmt);
     return 0;
 }
 
 /* Reminders */
-int db_add_reminder(himiko_database_t *db, const char *user_id, const char *channel_id, const char *message, time_t remind_at) {
-    const char *sql = "INSERT INTO reminders (user_id, channel_id, message, remind_at) VALUES (?, ?, ?, datetime(?, 'unixepoch'))";
+int db_add_reminder(himiko_database_t *db, const char *user_id, const char *channel_id, const char *message, time_t remind_at, int64_t *id) {
+    const char *sql = "INSERT INTO reminders (user_id, channel_id, message, remind_at) VALUES (?, ?, ?, datetime(?, 'unixepoch')) "
+                      "RETURNING id";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_REMINDER, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1052,32 +1448,39 @@ int db_add_reminder(himiko_database_t *db, const char *user_id, const char *chan
     sqlite3_bind_text(stmt, 3, message, -1, SQLITE_STATIC);
     sqlite3_bind_int64(stmt, 4, remind_at);
 
+    /* RETURNING instead of last_insert_rowid: the connection is shared between threads */
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    if (rc == SQLITE_ROW && id) *id = sqlite3_column_int64(stmt, 0);
+    db_stmt_release(db, DB_STMT_ADD_REMINDER, stmt);
+    return (rc == SQLITE_ROW) ? 0 : -1;
 }
 
-int db_get_pending_reminders(himiko_database_t *db, reminder_t *reminders, int max_reminders, int *count) {
-    const char *sql = "SELECT id, user_id, channel_id, message, remind_at FROM reminders "
-                      "WHERE completed = 0 AND remind_at <= datetime('now') ORDER BY remind_at";
+int db_get_pending_reminders(himiko_database_t *db, int64_t after_id, reminder_t *reminders, int max_reminders, int *count) {
+    const char *sql = "SELECT id, user_id, channel_id, message, CAST(strftime('%s', remind_at) AS INTEGER) FROM reminders "
+                      "WHERE completed = 0 AND id > ? ORDER BY id LIMIT ?";
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_PENDING_REMINDERS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW && *count < max_reminders) {
+    sqlite3_bind_int64(stmt, 1, after_id);
+    sqlite3_bind_int(stmt, 2, max_reminders);
+
+    while (*count < max_reminders && sqlite3_step(stmt) == SQLITE_ROW) {
         reminder_t *r = &reminders[*count];
+        memset(r, 0, sizeof(*r));
         r->id = sqlite3_column_int64(stmt, 0);
         strncpy(r->user_id, (const char *)sqlite3_column_text(stmt, 1), sizeof(r->user_id) - 1);
         strncpy(r->channel_id, (const char *)sqlite3_column_text(stmt, 2), sizeof(r->channel_id) - 1);
         strncpy(r->message, (const char *)sqlite3_column_text(stmt, 3), sizeof(r->message) - 1);
+        r->remind_at = (time_t)sqlite3_column_int64(stmt, 4);
         r->completed = 0;
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_PENDING_REMINDERS, stmt);
     return 0;
 }
 
@@ -1085,19 +1488,91 @@ int db_mark_reminder_completed(himiko_database_t *db, int64_t id) {
     const char *sql = "UPDATE reminders SET completed = 1 WHERE id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_MARK_REMINDER_COMPLETED, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_int64(stmt, 1, id);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_MARK_REMINDER_COMPLETED, stmt);
+    return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
+/* Scheduled events */
+int db_add_scheduled_event(himiko_database_t *db, const char *guild_id, const char *event_type, const char *target_id, time_t execute_at, int64_t *id) {
+    const char *sql = "INSERT INTO scheduled_events (guild_id, event_type, target_id, execute_at) VALUES (?, ?, ?, ?) "
+                      "RETURNING id";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_ADD_SCHEDULED_EVENT, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, event_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, target_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, execute_at);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW && id) *id = sqlite3_column_int64(stmt, 0);
+    db_stmt_release(db, DB_STMT_ADD_SCHEDULED_EVENT, stmt);
+    return (rc == SQLITE_ROW) ? 0 : -1;
+}
+
+int db_get_scheduled_events(himiko_database_t *db, int64_t after_id, scheduled_event_t *events, int max_events, int *count) {
+    const char *sql = "SELECT id, guild_id, event_type, target_id, execute_at FROM scheduled_events "
+                      "WHERE id > ? ORDER BY id LIMIT ?";
+    sqlite3_stmt *stmt;
+    *count = 0;
+
+    if (db_stmt_prepare_read(db, DB_STMT_GET_SCHEDULED_EVENTS, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, after_id);
+    sqlite3_bind_int(stmt, 2, max_events);
+
+    while (*count < max_events && sqlite3_step(stmt) == SQLITE_ROW) {
+        scheduled_event_t *e = &events[*count];
+        memset(e, 0, sizeof(*e));
+        e->id = sqlite3_column_int64(stmt, 0);
+        const char *guild = (const char *)sqlite3_column_text(stmt, 1);
+        const char *type = (const char *)sqlite3_column_text(stmt, 2);
+        const char *target = (const char *)sqlite3_column_text(stmt, 3);
+        if (guild) strncpy(e->guild_id, guild, sizeof(e->guild_id) - 1);
+        if (type) strncpy(e->event_type, type, sizeof(e->event_type) - 1);
+        if (target) strncpy(e->target_id, target, sizeof(e->target_id) - 1);
+        e->execute_at = (time_t)sqlite3_column_int64(stmt, 4);
+        (*count)++;
+    }
+
+    db_stmt_release(db, DB_STMT_GET_SCHEDULED_EVENTS, stmt);
+    return 0;
+}
+
+int db_delete_scheduled_event(himiko_database_t *db, int64_t id) {
+    const char *sql = "DELETE FROM scheduled_events WHERE id = ?";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_DELETE_SCHEDULED_EVENT, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, id);
+
+    int rc = sqlite3_step(stmt);
+    db_stmt_release(db, DB_STMT_DELETE_SCHEDULED_EVENT, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 /* Anti-raid */
 int db_get_antiraid_config(himiko_database_t *db, const char *guild_id, antiraid_config_t *config) {
+    db_cache_ticket_t ticket;
+    if (db_cache_lookup(DB_CACHE_ANTIRAID, guild_id, config, 0, sizeof(*config), &ticket)) {
+        return 0;
+    }
+
     const char *sql = "SELECT guild_id, enabled, raid_time, raid_size, auto_silence, lockdown_duration, "
                       "silent_role_id, alert_role_id, log_channel_id, action FROM antiraid_config WHERE guild_id = ?";
     sqlite3_stmt *stmt;
@@ -1109,13 +1584,14 @@ int db_get_antiraid_config(himiko_database_t *db, const char *guild_id, antiraid
     config->lockdown_duration = 120;
     strcpy(config->action, "silence");
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_ANTIRAID_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW) {
         config->enabled = sqlite3_column_int(stmt, 1);
         config->raid_time = sqlite3_column_int(stmt, 2);
         config->raid_size = sqlite3_column_int(stmt, 3);
@@ -1132,15 +1608,22 @@ int db_get_antiraid_config(himiko_database_t *db, const char *guild_id, antiraid
             strncpy(config->action, val, sizeof(config->action) - 1);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_ANTIRAID_CONFIG, stmt);
+    if (step == SQLITE_ROW || step == SQLITE_DONE) {
+        db_cache_store(DB_CACHE_ANTIRAID, &ticket, config);
+    }
     return 0;
 }
 
 int db_record_member_join(himiko_database_t *db, const char *guild_id, const char *user_id, int64_t joined_at, int64_t account_created_at) {
     const char *sql = "INSERT INTO member_joins (guild_id, user_id, joined_at, account_created_at) VALUES (?, ?, ?, ?)";
+    if (db->writer) {
+        return db_writer_enqueue(db->writer, DB_STMT_RECORD_MEMBER_JOIN, sql, "ttii", guild_id, user_id, joined_at, account_created_at);
+    }
+
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_RECORD_MEMBER_JOIN, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1150,7 +1633,7 @@ int db_record_member_join(himiko_database_t *db, const char *guild_id, const cha
     sqlite3_bind_int64(stmt, 4, account_created_at);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_RECORD_MEMBER_JOIN, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1159,7 +1642,7 @@ int db_count_recent_joins(himiko_database_t *db, const char *guild_id, int64_t s
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_COUNT_RECENT_JOINS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1170,12 +1653,17 @@ int db_count_recent_joins(himiko_database_t *db, const char *guild_id, int64_t s
         *count = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_COUNT_RECENT_JOINS, stmt);
     return 0;
 }
 
 /* Anti-spam */
 int db_get_antispam_config(himiko_database_t *db, const char *guild_id, antispam_config_t *config) {
+    db_cache_ticket_t ticket;
+    if (db_cache_lookup(DB_CACHE_ANTISPAM, guild_id, config, 0, sizeof(*config), &ticket)) {
+        return 0;
+    }
+
     const char *sql = "SELECT guild_id, enabled, base_pressure, image_pressure, link_pressure, "
                       "ping_pressure, length_pressure, line_pressure, repeat_pressure, max_pressure, "
                       "pressure_decay, action, silent_role_id FROM antispam_config WHERE guild_id = ?";
@@ -1194,13 +1682,14 @@ int db_get_antispam_config(himiko_database_t *db, const char *guild_id, antispam
     config->pressure_decay = 2.5;
     strcpy(config->action, "delete");
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_ANTISPAM_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW) {
         config->enabled = sqlite3_column_int(stmt, 1);
         config->base_pressure = sqlite3_column_double(stmt, 2);
         config->image_pressure = sqlite3_column_double(stmt, 3);
@@ -1218,12 +1707,20 @@ int db_get_antispam_config(himiko_database_t *db, const char *guild_id, antispam
             strncpy(config->silent_role_id, val, sizeof(config->silent_role_id) - 1);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_ANTISPAM_CONFIG, stmt);
+    if (step == SQLITE_ROW || step == SQLITE_DONE) {
+        db_cache_store(DB_CACHE_ANTISPAM, &ticket, config);
+    }
     return 0;
 }
 
 /* Logging */
 int db_get_logging_config(himiko_database_t *db, const char *guild_id, logging_config_t *config) {
+    db_cache_ticket_t ticket;
+    if (db_cache_lookup(DB_CACHE_LOGGING, guild_id, config, 0, sizeof(*config), &ticket)) {
+        return 0;
+    }
+
     const char *sql = "SELECT guild_id, log_channel_id, enabled, message_delete, message_edit, "
                       "voice_join, voice_leave, nickname_change, avatar_change, presence_change, "
                       "presence_batch_mins FROM logging_config WHERE guild_id = ?";
@@ -1238,13 +1735,14 @@ int db_get_logging_config(himiko_database_t *db, const char *guild_id, logging_c
     config->nickname_change = 1;
     config->presence_batch_mins = 5;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_LOGGING_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW) {
         const char *val;
         if ((val = (const char *)sqlite3_column_text(stmt, 1)) != NULL)
             strncpy(config->log_channel_id, val, sizeof(config->log_channel_id) - 1);
@@ -1259,7 +1757,10 @@ int db_get_logging_config(himiko_database_t *db, const char *guild_id, logging_c
         config->presence_batch_mins = sqlite3_column_int(stmt, 10);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_LOGGING_CONFIG, stmt);
+    if (step == SQLITE_ROW || step == SQLITE_DONE) {
+        db_cache_store(DB_CACHE_LOGGING, &ticket, config);
+    }
     return 0;
 }
 
@@ -1269,7 +1770,7 @@ int db_set_log_channel(himiko_database_t *db, const char *guild_id, const char *
                       "ON CONFLICT(guild_id) DO UPDATE SET log_channel_id = excluded.log_channel_id, enabled = 1";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_LOG_CHANNEL, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1277,7 +1778,8 @@ int db_set_log_channel(himiko_database_t *db, const char *guild_id, const char *
     sqlite3_bind_text(stmt, 2, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_LOG_CHANNEL, stmt);
+    db_cache_invalidate(DB_CACHE_LOGGING, guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1289,7 +1791,7 @@ int db_get_custom_command(himiko_database_t *db, const char *guild_id, const cha
 
     memset(cmd, 0, sizeof(custom_command_t));
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_CUSTOM_COMMAND, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1307,7 +1809,7 @@ int db_get_custom_command(himiko_database_t *db, const char *guild_id, const cha
         found = 1;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_CUSTOM_COMMAND, stmt);
     return found ? 0 : -1;
 }
 
@@ -1315,7 +1817,7 @@ int db_create_custom_command(himiko_database_t *db, const char *guild_id, const
     const char *sql = "INSERT INTO custom_commands (guild_id, name, response, created_by) VALUES (?, ?, ?, ?)";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_CREATE_CUSTOM_COMMAND, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1325,7 +1827,7 @@ int db_create_custom_command(himiko_database_t *db, const char *guild_id, const
     sqlite3_bind_text(stmt, 4, created_by, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_CREATE_CUSTOM_COMMAND, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1333,7 +1835,7 @@ int db_delete_custom_command(himiko_database_t *db, const char *guild_id, const
     const char *sql = "DELETE FROM custom_commands WHERE guild_id = ? AND name = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_DELETE_CUSTOM_COMMAND, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1341,7 +1843,7 @@ int db_delete_custom_command(himiko_database_t *db, const char *guild_id, const
     sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_DELETE_CUSTOM_COMMAND, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1351,7 +1853,7 @@ int db_list_custom_commands(himiko_database_t *db, const char *guild_id, custom_
     sqlite3_stmt *stmt;
     *count = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_LIST_CUSTOM_COMMANDS, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1368,7 +1870,7 @@ int db_list_custom_commands(himiko_database_t *db, const char *guild_id, custom_
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_LIST_CUSTOM_COMMANDS, stmt);
     return 0;
 }
 
@@ -1376,7 +1878,7 @@ int db_increment_command_use(himiko_database_t *db, const char *guild_id, const
     const char *sql = "UPDATE custom_commands SET use_count = use_count + 1 WHERE guild_id = ? AND name = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_INCREMENT_COMMAND_USE, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1384,12 +1886,17 @@ int db_increment_command_use(himiko_database_t *db, const char *guild_id, const
     sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_INCREMENT_COMMAND_USE, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 /* Spam filter */
 int db_get_spam_filter_config(himiko_database_t *db, const char *guild_id, spam_filter_config_t *config) {
+    db_cache_ticket_t ticket;
+    if (db_cache_lookup(DB_CACHE_SPAM_FILTER, guild_id, config, 0, sizeof(*config), &ticket)) {
+        return 0;
+    }
+
     const char *sql = "SELECT guild_id, enabled, max_mentions, max_links, max_emojis, action "
                       "FROM spam_filter_config WHERE guild_id = ?";
     sqlite3_stmt *stmt;
@@ -1401,13 +1908,14 @@ int db_get_spam_filter_config(himiko_database_t *db, const char *guild_id, spam_
     config->max_emojis = 10;
     strcpy(config->action, "delete");
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_GET_SPAM_FILTER_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW) {
         config->enabled = sqlite3_column_int(stmt, 1);
         config->max_mentions = sqlite3_column_int(stmt, 2);
         config->max_links = sqlite3_column_int(stmt, 3);
@@ -1416,7 +1924,10 @@ int db_get_spam_filter_config(himiko_database_t *db, const char *guild_id, spam_
         if (val) strncpy(config->action, val, sizeof(config->action) - 1);
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_GET_SPAM_FILTER_CONFIG, stmt);
+    if (step == SQLITE_ROW || step == SQLITE_DONE) {
+        db_cache_store(DB_CACHE_SPAM_FILTER, &ticket, config);
+    }
     return 0;
 }
 
@@ -1428,7 +1939,7 @@ int db_set_spam_filter_config(himiko_database_t *db, const spam_filter_config_t
                       "max_links = excluded.max_links, max_emojis = excluded.max_emojis, action = excluded.action";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_SPAM_FILTER_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1440,7 +1951,8 @@ int db_set_spam_filter_config(himiko_database_t *db, const spam_filter_config_t
     sqlite3_bind_text(stmt, 6, config->action, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_SPAM_FILTER_CONFIG, stmt);
+    db_cache_invalidate(DB_CACHE_SPAM_FILTER, config->guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1455,7 +1967,7 @@ int db_set_antiraid_config(himiko_database_t *db, const antiraid_config_t *confi
                       "log_channel_id = excluded.log_channel_id, action = excluded.action";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_ANTIRAID_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1471,7 +1983,8 @@ int db_set_antiraid_config(himiko_database_t *db, const antiraid_config_t *confi
     sqlite3_bind_text(stmt, 10, config->action, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_ANTIRAID_CONFIG, stmt);
+    db_cache_invalidate(DB_CACHE_ANTIRAID, config->guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1489,7 +2002,7 @@ int db_set_antispam_config(himiko_database_t *db, const antispam_config_t *confi
                       "action = excluded.action, silent_role_id = excluded.silent_role_id";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_ANTISPAM_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1508,7 +2021,8 @@ int db_set_antispam_config(himiko_database_t *db, const antispam_config_t *confi
     sqlite3_bind_text(stmt, 13, config->silent_role_id[0] ? config->silent_role_id : NULL, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_ANTISPAM_CONFIG, stmt);
+    db_cache_invalidate(DB_CACHE_ANTISPAM, config->guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1524,7 +2038,7 @@ int db_set_logging_config(himiko_database_t *db, const logging_config_t *config)
                       "presence_change = excluded.presence_change, presence_batch_mins = excluded.presence_batch_mins";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_SET_LOGGING_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1541,7 +2055,8 @@ int db_set_logging_config(himiko_database_t *db, const logging_config_t *config)
     sqlite3_bind_int(stmt, 11, config->presence_batch_mins);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_SET_LOGGING_CONFIG, stmt);
+    db_cache_invalidate(DB_CACHE_LOGGING, config->guild_id);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1551,7 +2066,7 @@ int db_is_log_channel_disabled(himiko_database_t *db, const char *guild_id, cons
     sqlite3_stmt *stmt;
     *disabled = 0;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_IS_LOG_CHANNEL_DISABLED, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1562,7 +2077,7 @@ int db_is_log_channel_disabled(himiko_database_t *db, const char *guild_id, cons
         *disabled = sqlite3_column_int(stmt, 0) > 0;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_IS_LOG_CHANNEL_DISABLED, stmt);
     return 0;
 }
 
@@ -1570,7 +2085,7 @@ int db_add_disabled_log_channel(himiko_database_t *db, const char *guild_id, con
     const char *sql = "INSERT OR IGNORE INTO disabled_log_channels (guild_id, channel_id) VALUES (?, ?)";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_ADD_DISABLED_LOG_CHANNEL, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1578,7 +2093,7 @@ int db_add_disabled_log_channel(himiko_database_t *db, const char *guild_id, con
     sqlite3_bind_text(stmt, 2, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_ADD_DISABLED_LOG_CHANNEL, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1586,7 +2101,7 @@ int db_remove_disabled_log_channel(himiko_database_t *db, const char *guild_id,
     const char *sql = "DELETE FROM disabled_log_channels WHERE guild_id = ? AND channel_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_REMOVE_DISABLED_LOG_CHANNEL, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1594,7 +2109,7 @@ int db_remove_disabled_log_channel(himiko_database_t *db, const char *guild_id,
     sqlite3_bind_text(stmt, 2, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_REMOVE_DISABLED_LOG_CHANNEL, stmt);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -1605,8 +2120,9 @@ int db_get_bot_bans(himiko_database_t *db, const char *ban_type, bot_ban_t *bans
     *count = 0;
 
     const char *sql = (ban_type && ban_type[0]) ? sql_type : sql_all;
+    db_stmt_id_t qid = (ban_type && ban_type[0]) ? DB_STMT_GET_BOT_BANS_BY_TYPE : DB_STMT_GET_BOT_BANS;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, qid, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -1625,6 +2141,6 @@ int db_get_bot_bans(himiko_database_t *db, const char *ban_type, bot_ban_t *bans
         (*count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, qid, stmt);
     return 0;
 }
@@ -0,0 +1,247 @@
+/*
+ * Himiko Discord Bot (C Edition) - Guild Settings Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "db_cache.h"
+#include "database.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* One guild; rows are allocated on first store and live until db_cache_clear */
+typedef struct {
+    uint64_t guild_id;
+    atomic_uint seq;
+    atomic_uint gen[DB_CACHE_KIND_COUNT];
+    _Atomic(void *) rows[DB_CACHE_KIND_COUNT];
+    atomic_int valid[DB_CACHE_KIND_COUNT];
+} guild_cache_entry_t;
+
+/* Open-addressing table; replaced (never resized in place) when it fills */
+typedef struct cache_table {
+    size_t mask;
+    int count;
+    struct cache_table *retired;
+    _Atomic(guild_cache_entry_t *) slots[];
+} cache_table_t;
+
+static const size_t row_sizes[DB_CACHE_KIND_COUNT] = {
+    sizeof(guild_settings_t),
+    sizeof(antispam_config_t),
+    sizeof(antiraid_config_t),
+    sizeof(logging_config_t),
+    sizeof(spam_filter_config_t),
+};
+
+static _Atomic(cache_table_t *) g_table = NULL;
+static pthread_mutex_t g_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint_fast64_t g_hits = 0;
+static atomic_uint_fast64_t g_misses = 0;
+static atomic_uint_fast64_t g_invalidations = 0;
+
+static int parse_guild_id(const char *guild_id, uint64_t *out) {
+    if (!guild_id || !*guild_id) return -1;
+    uint64_t v = 0;
+    for (const char *p = guild_id; *p; p++) {
+        if (*p < '0' || *p > '9') return -1;
+        v = v * 10 + (uint64_t)(*p - '0');
+    }
+    *out = v;
+    return 0;
+}
+
+static inline size_t hash_id(uint64_t id) {
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    return (size_t)id;
+}
+
+static guild_cache_entry_t *find_entry(cache_table_t *table, uint64_t id) {
+    if (!table) return NULL;
+    size_t i = hash_id(id) & table->mask;
+    for (;;) {
+        guild_cache_entry_t *e = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+        if (!e) return NULL;
+        if (e->guild_id == id) return e;
+        i = (i + 1) & table->mask;
+    }
+}
+
+static void insert_slot(cache_table_t *table, guild_cache_entry_t *e) {
+    size_t i = hash_id(e->guild_id) & table->mask;
+    while (atomic_load_explicit(&table->slots[i], memory_order_relaxed)) {
+        i = (i + 1) & table->mask;
+    }
+    atomic_store_explicit(&table->slots[i], e, memory_order_release);
+    table->count++;
+}
+
+static cache_table_t *new_table(size_t capacity) {
+    cache_table_t *t = calloc(1, sizeof(cache_table_t) + capacity * sizeof(guild_cache_entry_t *));
+    if (t) t->mask = capacity - 1;
+    return t;
+}
+
+/* Caller holds g_write_lock */
+static guild_cache_entry_t *get_or_create_entry(uint64_t id) {
+    cache_table_t *table = atomic_load_explicit(&g_table, memory_order_relaxed);
+    guild_cache_entry_t *e = find_entry(table, id);
+    if (e) return e;
+
+    /* Keep load under one half; old tables stay readable until clear */
+    if (!table || (size_t)(table->count + 1) * 2 > table->mask + 1) {
+        size_t capacity = table ? (table->mask + 1) * 2 : 256;
+        cache_table_t *grown = new_table(capacity);
+        if (!grown) return NULL;
+        if (table) {
+            for (size_t i = 0; i <= table->mask; i++) {
+                guild_cache_entry_t *old = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+                if (old) insert_slot(grown, old);
+            }
+        }
+        grown->retired = table;
+        atomic_store_explicit(&g_table, grown, memory_order_release);
+        table = grown;
+    }
+
+    e = calloc(1, sizeof(guild_cache_entry_t));
+    if (!e) return NULL;
+    e->guild_id = id;
+    insert_slot(table, e);
+    return e;
+}
+
+int db_cache_lookup(db_cache_kind_t kind, const char *guild_id, void *out, size_t offset, size_t len, db_cache_ticket_t *ticket) {
+    ticket->entry = NULL;
+    ticket->gen = 0;
+
+    uint64_t id;
+    if (parse_guild_id(guild_id, &id) != 0) return 0;
+
+    guild_cache_entry_t *e = find_entry(atomic_load_explicit(&g_table, memory_order_acquire), id);
+    if (e) {
+        for (;;) {
+            unsigned s1 = atomic_load_explicit(&e->seq, memory_order_acquire);
+            if (s1 & 1) continue;
+
+            unsigned gen = atomic_load_explicit(&e->gen[kind], memory_order_relaxed);
+            int valid = atomic_load_explicit(&e->valid[kind], memory_order_relaxed);
+            char *row = atomic_load_explicit(&e->rows[kind], memory_order_relaxed);
+            if (valid && row) memcpy(out, row + offset, len);
+
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&e->seq, memory_order_relaxed) != s1) continue;
+
+            if (valid && row) {
+                atomic_fetch_add_explicit(&g_hits, 1, memory_order_relaxed);
+                return 1;
+            }
+            ticket->entry = e;
+            ticket->gen = gen;
+            break;
+        }
+    } else {
+        /* First touch for this guild */
+        pthread_mutex_lock(&g_write_lock);
+        e = get_or_create_entry(id);
+        if (e) {
+            ticket->entry = e;
+            ticket->gen = atomic_load_explicit(&e->gen[kind], memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&g_write_lock);
+    }
+
+    atomic_fetch_add_explicit(&g_misses, 1, memory_order_relaxed);
+    return 0;
+}
+
+static void write_begin(guild_cache_entry_t *e) {
+    atomic_fetch_add_explicit(&e->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(guild_cache_entry_t *e) {
+    atomic_fetch_add_explicit(&e->seq, 1, memory_order_release);
+}
+
+void db_cache_store(db_cache_kind_t kind, const db_cache_ticket_t *ticket, const void *row) {
+    guild_cache_entry_t *e = ticket->entry;
+    if (!e) return;
+
+    pthread_mutex_lock(&g_write_lock);
+
+    /* Invalidated while the caller was reading SQLite: the row may be stale */
+    if (atomic_load_explicit(&e->gen[kind], memory_order_relaxed) != ticket->gen) {
+        pthread_mutex_unlock(&g_write_lock);
+        return;
+    }
+
+    void *dst = atomic_load_explicit(&e->rows[kind], memory_order_relaxed);
+    if (!dst) {
+        dst = malloc(row_sizes[kind]);
+        if (!dst) {
+            pthread_mutex_unlock(&g_write_lock);
+            return;
+        }
+    }
+
+    write_begin(e);
+    memcpy(dst, row, row_sizes[kind]);
+    atomic_store_explicit(&e->rows[kind], dst, memory_order_relaxed);
+    atomic_store_explicit(&e->valid[kind], 1, memory_order_relaxed);
+    write_end(e);
+
+    pthread_mutex_unlock(&g_write_lock);
+}
+
+void db_cache_invalidate(db_cache_kind_t kind, const char *guild_id) {
+    uint64_t id;
+    if (parse_guild_id(guild_id, &id) != 0) return;
+
+    pthread_mutex_lock(&g_write_lock);
+    guild_cache_entry_t *e = find_entry(atomic_load_explicit(&g_table, memory_order_relaxed), id);
+    if (e) {
+        write_begin(e);
+        atomic_store_explicit(&e->valid[kind], 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&e->gen[kind], 1, memory_order_relaxed);
+        write_end(e);
+        atomic_fetch_add_explicit(&g_invalidations, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&g_write_lock);
+}
+
+void db_cache_get_stats(db_cache_stats_t *stats) {
+    stats->hits = atomic_load_explicit(&g_hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&g_misses, memory_order_relaxed);
+    stats->invalidations = atomic_load_explicit(&g_invalidations, memory_order_relaxed);
+
+    pthread_mutex_lock(&g_write_lock);
+    cache_table_t *table = atomic_load_explicit(&g_table, memory_order_relaxed);
+    stats->guilds = table ? table->count : 0;
+    pthread_mutex_unlock(&g_write_lock);
+}
+
+void db_cache_clear(void) {
+    pthread_mutex_lock(&g_write_lock);
+    cache_table_t *table = atomic_exchange_explicit(&g_table, NULL, memory_order_acq_rel);
+    if (table) {
+        for (size_t i = 0; i <= table->mask; i++) {
+            guild_cache_entry_t *e = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+            if (!e) continue;
+            for (int k = 0; k < DB_CACHE_KIND_COUNT; k++) {
+                free(atomic_load_explicit(&e->rows[k], memory_order_relaxed));
+            }
+            free(e);
+        }
+    }
+    while (table) {
+        cache_table_t *retired = table->retired;
+        free(table);
+        table = retired;
+    }
+    pthread_mutex_unlock(&g_write_lock);
+}
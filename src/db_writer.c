@@ -0,0 +1,348 @@
+/*
+ * Himiko Discord Bot (C Edition) - Database Writer
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "db_writer.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+typedef struct {
+    char type;
+    int64_t i;
+    const char *text;
+} write_arg_t;
+
+/* Queue node; text arguments are copied into the tail of the allocation */
+typedef struct write_node {
+    _Atomic(struct write_node *) next;
+    db_stmt_id_t id;
+    const char *sql;
+    int argc;
+    write_arg_t args[DB_WRITER_MAX_ARGS];
+    struct write_barrier *barrier;
+    char data[];
+} write_node_t;
+
+typedef struct write_barrier {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+} write_barrier_t;
+
+struct db_writer {
+    sqlite3 *conn;
+    sqlite3_stmt *stmts[DB_STMT_COUNT];
+    int interval_ms;
+    int batch_rows;
+
+    /* Vyukov intrusive MPSC queue: producers exchange head, the writer owns tail */
+    _Atomic(write_node_t *) head;
+    write_node_t *tail;
+    write_node_t stub;
+    atomic_int pending;
+    atomic_int stopping;
+
+    /* Only used to park the writer between batches */
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake_cond;
+    pthread_t thread;
+
+    unsigned long long rows_written;
+    unsigned long long commits;
+};
+
+static void queue_push(db_writer_t *w, write_node_t *node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    write_node_t *prev = atomic_exchange_explicit(&w->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/* Returns NULL when empty or while a producer is between its two stores */
+static write_node_t *queue_pop(db_writer_t *w) {
+    write_node_t *tail = w->tail;
+    write_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &w->stub) {
+        if (!next) return NULL;
+        w->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) {
+        w->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&w->head, memory_order_acquire)) return NULL;
+
+    queue_push(w, &w->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        w->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void wake_writer(db_writer_t *w) {
+    pthread_mutex_lock(&w->wake_lock);
+    pthread_cond_signal(&w->wake_cond);
+    pthread_mutex_unlock(&w->wake_lock);
+}
+
+static void submit(db_writer_t *w, write_node_t *node) {
+    /* The writer may free node as soon as it is pushed */
+    int is_barrier = node->barrier != NULL;
+    /* Count first so a stopping writer keeps draining until this node lands */
+    int pending = atomic_fetch_add_explicit(&w->pending, 1, memory_order_relaxed) + 1;
+    queue_push(w, node);
+    /* Only the producer that fills a batch (or a barrier) pays for the wakeup */
+    if (pending == w->batch_rows || is_barrier) {
+        wake_writer(w);
+    }
+}
+
+static void execute(db_writer_t *w, const write_node_t *node) {
+    sqlite3_stmt *stmt = w->stmts[node->id];
+    if (!stmt) {
+        if (sqlite3_prepare_v3(w->conn, node->sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "db_writer: prepare failed: %s\n", sqlite3_errmsg(w->conn));
+            return;
+        }
+        w->stmts[node->id] = stmt;
+    }
+
+    for (int i = 0; i < node->argc; i++) {
+        const write_arg_t *arg = &node->args[i];
+        if (arg->type == 'i') {
+            sqlite3_bind_int64(stmt, i + 1, arg->i);
+        } else if (arg->text) {
+            sqlite3_bind_text(stmt, i + 1, arg->text, -1, SQLITE_STATIC);
+        } else {
+            sqlite3_bind_null(stmt, i + 1);
+        }
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "db_writer: write failed: %s\n", sqlite3_errmsg(w->conn));
+    } else {
+        w->rows_written++;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+static void finish_barrier(write_barrier_t *b) {
+    pthread_mutex_lock(&b->lock);
+    b->done = 1;
+    pthread_cond_signal(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
+
+/* Execute everything currently visible; one transaction per batch */
+static void drain(db_writer_t *w) {
+    int in_txn = 0;
+    int rows = 0;
+    write_node_t *node;
+
+    while ((node = queue_pop(w)) != NULL) {
+        atomic_fetch_sub_explicit(&w->pending, 1, memory_order_relaxed);
+
+        if (node->barrier) {
+            if (in_txn) {
+                sqlite3_exec(w->conn, "COMMIT", NULL, NULL, NULL);
+                w->commits++;
+                in_txn = 0;
+                rows = 0;
+            }
+            finish_barrier(node->barrier);
+            free(node);
+            continue;
+        }
+
+        if (!in_txn) {
+            if (sqlite3_exec(w->conn, "BEGIN IMMEDIATE", NULL, NULL, NULL) == SQLITE_OK) {
+                in_txn = 1;
+            }
+        }
+        execute(w, node);
+        free(node);
+
+        if (in_txn && ++rows >= w->batch_rows) {
+            sqlite3_exec(w->conn, "COMMIT", NULL, NULL, NULL);
+            w->commits++;
+            in_txn = 0;
+            rows = 0;
+        }
+    }
+
+    if (in_txn) {
+        sqlite3_exec(w->conn, "COMMIT", NULL, NULL, NULL);
+        w->commits++;
+    }
+}
+
+static void *writer_thread(void *arg) {
+    db_writer_t *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->wake_lock);
+        if (!atomic_load_explicit(&w->stopping, memory_order_acquire) &&
+            atomic_load_explicit(&w->pending, memory_order_relaxed) < w->batch_rows) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)w->interval_ms * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&w->wake_cond, &w->wake_lock, &deadline);
+        }
+        pthread_mutex_unlock(&w->wake_lock);
+
+        drain(w);
+
+        if (atomic_load_explicit(&w->stopping, memory_order_acquire)) {
+            /* A producer may still be between its two queue stores */
+            while (atomic_load_explicit(&w->pending, memory_order_relaxed) > 0) {
+                sched_yield();
+                drain(w);
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+db_writer_t *db_writer_start(const char *uri, int interval_ms, int batch_rows) {
+    db_writer_t *w = calloc(1, sizeof(db_writer_t));
+    if (!w) return NULL;
+
+    if (sqlite3_open_v2(uri, &w->conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "db_writer: cannot open connection: %s\n", sqlite3_errmsg(w->conn));
+        sqlite3_close(w->conn);
+        free(w);
+        return NULL;
+    }
+    sqlite3_busy_timeout(w->conn, DB_BUSY_TIMEOUT_MS);
+    sqlite3_exec(w->conn, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+    db_register_functions(w->conn);
+
+    w->interval_ms = interval_ms > 0 ? interval_ms : DB_WRITER_INTERVAL_MS;
+    w->batch_rows = batch_rows > 0 ? batch_rows : DB_WRITER_BATCH_ROWS;
+    atomic_init(&w->stub.next, NULL);
+    atomic_init(&w->head, &w->stub);
+    w->tail = &w->stub;
+    atomic_init(&w->pending, 0);
+    atomic_init(&w->stopping, 0);
+    pthread_mutex_init(&w->wake_lock, NULL);
+    pthread_cond_init(&w->wake_cond, NULL);
+
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+        fprintf(stderr, "db_writer: cannot start thread\n");
+        pthread_mutex_destroy(&w->wake_lock);
+        pthread_cond_destroy(&w->wake_cond);
+        sqlite3_close(w->conn);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void db_writer_stop(db_writer_t *w) {
+    if (!w) return;
+
+    atomic_store_explicit(&w->stopping, 1, memory_order_release);
+    wake_writer(w);
+    pthread_join(w->thread, NULL);
+    DEBUG_LOG("db_writer: %llu rows in %llu commits", w->rows_written, w->commits);
+
+    for (int i = 0; i < DB_STMT_COUNT; i++) {
+        if (w->stmts[i]) sqlite3_finalize(w->stmts[i]);
+    }
+    sqlite3_close(w->conn);
+    pthread_mutex_destroy(&w->wake_lock);
+    pthread_cond_destroy(&w->wake_cond);
+    free(w);
+}
+
+int db_writer_enqueue(db_writer_t *w, db_stmt_id_t id, const char *sql, const char *types, ...) {
+    int argc = (int)strlen(types);
+    if (argc > DB_WRITER_MAX_ARGS) return -1;
+
+    /* Size the text arena first */
+    size_t text_len = 0;
+    va_list ap;
+    va_start(ap, types);
+    for (int i = 0; i < argc; i++) {
+        if (types[i] == 'i') {
+            (void)va_arg(ap, int64_t);
+        } else {
+            const char *s = va_arg(ap, const char *);
+            if (s) text_len += strlen(s) + 1;
+        }
+    }
+    va_end(ap);
+
+    write_node_t *node = malloc(sizeof(write_node_t) + text_len);
+    if (!node) return -1;
+    node->id = id;
+    node->sql = sql;
+    node->argc = argc;
+    node->barrier = NULL;
+
+    char *p = node->data;
+    va_start(ap, types);
+    for (int i = 0; i < argc; i++) {
+        write_arg_t *arg = &node->args[i];
+        arg->type = types[i];
+        arg->text = NULL;
+        if (types[i] == 'i') {
+            arg->i = va_arg(ap, int64_t);
+        } else {
+            const char *s = va_arg(ap, const char *);
+            if (s) {
+                size_t len = strlen(s) + 1;
+                memcpy(p, s, len);
+                arg->text = p;
+                p += len;
+            }
+        }
+    }
+    va_end(ap);
+
+    submit(w, node);
+    return 0;
+}
+
+int db_writer_flush(db_writer_t *w) {
+    write_barrier_t barrier;
+    pthread_mutex_init(&barrier.lock, NULL);
+    pthread_cond_init(&barrier.cond, NULL);
+    barrier.done = 0;
+
+    write_node_t *node = calloc(1, sizeof(write_node_t));
+    if (!node) {
+        pthread_mutex_destroy(&barrier.lock);
+        pthread_cond_destroy(&barrier.cond);
+        return -1;
+    }
+    node->barrier = &barrier;
+    submit(w, node);
+
+    pthread_mutex_lock(&barrier.lock);
+    while (!barrier.done) {
+        pthread_cond_wait(&barrier.cond, &barrier.lock);
+    }
+    pthread_mutex_unlock(&barrier.lock);
+
+    pthread_mutex_destroy(&barrier.lock);
+    pthread_cond_destroy(&barrier.cond);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Himiko Discord Bot (C Edition) - Guild Permission Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "guild_perms.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define GUILD_BUCKETS 256
+
+typedef struct {
+    u64snowflake id;
+    uint64_t permissions;
+} role_perms_t;
+
+typedef struct guild_perms {
+    struct guild_perms *next;
+    u64snowflake guild_id;
+    u64snowflake owner_id;
+    int role_count;
+    int role_cap;
+    role_perms_t *roles;
+} guild_perms_t;
+
+static guild_perms_t *g_guilds[GUILD_BUCKETS];
+static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static inline size_t guild_bucket(u64snowflake guild_id) {
+    return (size_t)((guild_id * 0x9e3779b97f4a7c15ULL) >> 56) & (GUILD_BUCKETS - 1);
+}
+
+/* Caller holds g_lock */
+static guild_perms_t *find_guild(u64snowflake guild_id) {
+    guild_perms_t *g = g_guilds[guild_bucket(guild_id)];
+    while (g && g->guild_id != guild_id) g = g->next;
+    return g;
+}
+
+/* Caller holds g_lock for writing */
+static guild_perms_t *find_or_add_guild(u64snowflake guild_id) {
+    guild_perms_t *g = find_guild(guild_id);
+    if (g) return g;
+
+    size_t bucket = guild_bucket(guild_id);
+    if ((g = calloc(1, sizeof(guild_perms_t)))) {
+        g->guild_id = guild_id;
+        g->next = g_guilds[bucket];
+        g_guilds[bucket] = g;
+    }
+    return g;
+}
+
+/* Caller holds g_lock for writing */
+static void set_role(guild_perms_t *g, u64snowflake role_id, uint64_t permissions) {
+    for (int i = 0; i < g->role_count; i++) {
+        if (g->roles[i].id == role_id) {
+            g->roles[i].permissions = permissions;
+            return;
+        }
+    }
+    if (g->role_count == g->role_cap) {
+        int cap = g->role_cap ? g->role_cap * 2 : 16;
+        role_perms_t *roles = realloc(g->roles, (size_t)cap * sizeof(role_perms_t));
+        if (!roles) return;
+        g->roles = roles;
+        g->role_cap = cap;
+    }
+    g->roles[g->role_count++] = (role_perms_t){ .id = role_id, .permissions = permissions };
+}
+
+void guild_perms_on_guild(const struct discord_guild *guild) {
+    if (!guild || !guild->id) return;
+
+    pthread_rwlock_wrlock(&g_lock);
+    guild_perms_t *g = find_or_add_guild(guild->id);
+    if (g) {
+        if (guild->owner_id) g->owner_id = guild->owner_id;
+        /* Updates carry the full role list; anything missing was deleted */
+        if (guild->roles) {
+            g->role_count = 0;
+            for (int i = 0; i < guild->roles->size; i++) {
+                set_role(g, guild->roles->array[i].id, guild->roles->array[i].permissions);
+            }
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+}
+
+void guild_perms_on_guild_delete(u64snowflake guild_id) {
+    pthread_rwlock_wrlock(&g_lock);
+    guild_perms_t **link = &g_guilds[guild_bucket(guild_id)];
+    while (*link && (*link)->guild_id != guild_id) link = &(*link)->next;
+    guild_perms_t *g = *link;
+    if (g) *link = g->next;
+    pthread_rwlock_unlock(&g_lock);
+
+    if (g) {
+        free(g->roles);
+        free(g);
+    }
+}
+
+void guild_perms_on_role(u64snowflake guild_id, const struct discord_role *role) {
+    if (!role) return;
+
+    pthread_rwlock_wrlock(&g_lock);
+    guild_perms_t *g = find_or_add_guild(guild_id);
+    if (g) set_role(g, role->id, role->permissions);
+    pthread_rwlock_unlock(&g_lock);
+}
+
+void guild_perms_on_role_delete(u64snowflake guild_id, u64snowflake role_id) {
+    pthread_rwlock_wrlock(&g_lock);
+    guild_perms_t *g = find_guild(guild_id);
+    for (int i = 0; g && i < g->role_count; i++) {
+        if (g->roles[i].id == role_id) {
+            g->roles[i] = g->roles[--g->role_count];
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+}
+
+uint64_t guild_perms_of(u64snowflake guild_id, u64snowflake user_id, const struct snowflakes *roles) {
+    uint64_t perms = 0;
+
+    pthread_rwlock_rdlock(&g_lock);
+    const guild_perms_t *g = find_guild(guild_id);
+    if (g && g->owner_id && g->owner_id == user_id) {
+        perms = ~0ULL;
+    } else if (g) {
+        for (int i = 0; i < g->role_count; i++) {
+            int has = g->roles[i].id == guild_id;      /* @everyone */
+            for (int j = 0; !has && roles && j < roles->size; j++) {
+                has = roles->array[j] == g->roles[i].id;
+            }
+            if (has) perms |= g->roles[i].permissions;
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+
+    return (perms & DISCORD_PERM_ADMINISTRATOR) ? ~0ULL : perms;
+}
+
+int guild_perms_has(u64snowflake guild_id, u64snowflake user_id, const struct snowflakes *roles, uint64_t mask) {
+    return (guild_perms_of(guild_id, user_id, roles) & mask) != 0;
+}
+
+void guild_perms_cleanup(void) {
+    pthread_rwlock_wrlock(&g_lock);
+    for (int i = 0; i < GUILD_BUCKETS; i++) {
+        guild_perms_t *g = g_guilds[i];
+        while (g) {
+            guild_perms_t *next = g->next;
+            free(g->roles);
+            free(g);
+            g = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    pthread_rwlock_unlock(&g_lock);
+}
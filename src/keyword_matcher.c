@@ -0,0 +1,306 @@
+/*
+ * Himiko Discord Bot (C Edition) - Keyword Matcher
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "keyword_matcher.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYWORD_MIN_LEN 2
+
+typedef struct {
+    int parent;
+    int child;              /* first child, -1 if none */
+    int sibling;            /* next child of parent, -1 if none */
+    int fail;
+    int dict;               /* nearest suffix node with subscribers, 0 if none */
+    int subs;               /* first subscription ending here, -1 if none */
+    int depth;
+    unsigned char byte;
+} node_t;
+
+typedef struct {
+    uint64_t id;
+    int next;               /* next subscription at the same node, or on the free list */
+} sub_t;
+
+struct keyword_matcher {
+    keyword_match_t mode;
+    node_t *nodes;
+    int node_count;
+    int node_cap;
+    int free_nodes;         /* chained through sibling */
+
+    sub_t *subs;
+    int sub_count;
+    int sub_cap;
+    int free_subs;
+    size_t live;
+
+    int dirty;              /* inserted since the last relink */
+    int root_next[256];     /* root's children, direct-indexed; most steps end here */
+    int *queue;             /* relink scratch, node_cap long */
+};
+
+static inline unsigned char lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static inline int is_word(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+static inline int child_of(const keyword_matcher_t *m, int node, unsigned char c) {
+    if (node == 0) return m->root_next[c];
+    for (int n = m->nodes[node].child; n >= 0; n = m->nodes[n].sibling) {
+        if (m->nodes[n].byte == c) return n;
+    }
+    return -1;
+}
+
+size_t keyword_normalize(const char *keyword, char *out, size_t out_size) {
+    if (!keyword || out_size == 0) return 0;
+    out[0] = '\0';
+
+    while (*keyword == ' ' || *keyword == '\t' || *keyword == '\n') keyword++;
+    size_t len = strlen(keyword);
+    while (len && (keyword[len - 1] == ' ' || keyword[len - 1] == '\t' || keyword[len - 1] == '\n')) len--;
+
+    if (len < KEYWORD_MIN_LEN || len >= KEYWORD_MAX_LEN || len >= out_size) return 0;
+    for (size_t i = 0; i < len; i++) out[i] = (char)lower((unsigned char)keyword[i]);
+    out[len] = '\0';
+    return len;
+}
+
+keyword_matcher_t *keyword_matcher_create(keyword_match_t mode) {
+    keyword_matcher_t *m = calloc(1, sizeof(keyword_matcher_t));
+    if (!m) return NULL;
+
+    m->mode = mode;
+    m->node_cap = 16;
+    m->nodes = malloc((size_t)m->node_cap * sizeof(node_t));
+    m->queue = malloc((size_t)m->node_cap * sizeof(int));
+    if (!m->nodes || !m->queue) {
+        keyword_matcher_free(m);
+        return NULL;
+    }
+    m->nodes[0] = (node_t){ .parent = -1, .child = -1, .sibling = -1, .subs = -1 };
+    m->node_count = 1;
+    m->free_nodes = -1;
+    m->free_subs = -1;
+    for (int c = 0; c < 256; c++) m->root_next[c] = -1;
+    return m;
+}
+
+void keyword_matcher_free(keyword_matcher_t *m) {
+    if (!m) return;
+    free(m->nodes);
+    free(m->subs);
+    free(m->queue);
+    free(m);
+}
+
+static int new_node(keyword_matcher_t *m, int parent, unsigned char c) {
+    int n = m->free_nodes;
+    if (n >= 0) {
+        m->free_nodes = m->nodes[n].sibling;
+    } else {
+        if (m->node_count == m->node_cap) {
+            int cap = m->node_cap * 2;
+            node_t *nodes = realloc(m->nodes, (size_t)cap * sizeof(node_t));
+            if (!nodes) return -1;
+            m->nodes = nodes;
+            int *queue = realloc(m->queue, (size_t)cap * sizeof(int));
+            if (!queue) return -1;
+            m->queue = queue;
+            m->node_cap = cap;
+        }
+        n = m->node_count++;
+    }
+
+    node_t *node = &m->nodes[n];
+    *node = (node_t){ .parent = parent, .child = -1, .subs = -1, .byte = c,
+                      .depth = m->nodes[parent].depth + 1 };
+    if (parent == 0) {
+        node->sibling = -1;
+        m->root_next[c] = n;
+    } else {
+        node->sibling = m->nodes[parent].child;
+        m->nodes[parent].child = n;
+    }
+    return n;
+}
+
+/* Unhook a childless, subscriber-less node and put it on the free list */
+static void drop_node(keyword_matcher_t *m, int n) {
+    node_t *node = &m->nodes[n];
+    if (node->parent == 0) {
+        m->root_next[node->byte] = -1;
+    } else {
+        int *link = &m->nodes[node->parent].child;
+        while (*link != n) link = &m->nodes[*link].sibling;
+        *link = node->sibling;
+    }
+    node->sibling = m->free_nodes;
+    node->parent = -1;
+    m->free_nodes = n;
+}
+
+/* Breadth-first: recompute failure and output links for the whole trie */
+static void relink(keyword_matcher_t *m) {
+    int head = 0, tail = 0;
+    m->dirty = 0;
+    for (int c = 0; c < 256; c++) {
+        int n = m->root_next[c];
+        if (n < 0) continue;
+        m->nodes[n].fail = 0;
+        m->nodes[n].dict = 0;
+        m->queue[tail++] = n;
+    }
+
+    while (head < tail) {
+        int v = m->queue[head++];
+        for (int u = m->nodes[v].child; u >= 0; u = m->nodes[u].sibling) {
+            unsigned char c = m->nodes[u].byte;
+            int f = m->nodes[v].fail, next;
+            while ((next = child_of(m, f, c)) < 0 && f) f = m->nodes[f].fail;
+            f = next < 0 ? 0 : next;
+
+            m->nodes[u].fail = f;
+            m->nodes[u].dict = m->nodes[f].subs >= 0 ? f : m->nodes[f].dict;
+            m->queue[tail++] = u;
+        }
+    }
+}
+
+static int find_node(const keyword_matcher_t *m, const char *keyword) {
+    int n = 0;
+    for (const unsigned char *p = (const unsigned char *)keyword; *p && n >= 0; p++) {
+        n = child_of(m, n, *p);
+    }
+    return n;
+}
+
+/* Add the subscription without relinking; sets *relink if links elsewhere change */
+static int insert(keyword_matcher_t *m, const char *keyword, uint64_t id, int *relink_needed) {
+    if (!m || !keyword || !keyword[0]) return -1;
+
+    int n = 0;
+    for (const unsigned char *p = (const unsigned char *)keyword; *p; p++) {
+        int next = child_of(m, n, *p);
+        if (next < 0 && (next = new_node(m, n, *p)) < 0) return -1;
+        n = next;
+    }
+
+    for (int s = m->nodes[n].subs; s >= 0; s = m->subs[s].next) {
+        if (m->subs[s].id == id) return 0;
+    }
+
+    int s = m->free_subs;
+    if (s >= 0) {
+        m->free_subs = m->subs[s].next;
+    } else {
+        if (m->sub_count == m->sub_cap) {
+            int cap = m->sub_cap ? m->sub_cap * 2 : 16;
+            sub_t *subs = realloc(m->subs, (size_t)cap * sizeof(sub_t));
+            if (!subs) return -1;
+            m->subs = subs;
+            m->sub_cap = cap;
+        }
+        s = m->sub_count++;
+    }
+    /* A new path or a node gaining output changes links elsewhere */
+    if (m->nodes[n].subs < 0) *relink_needed = 1;
+    m->subs[s].id = id;
+    m->subs[s].next = m->nodes[n].subs;
+    m->nodes[n].subs = s;
+    m->live++;
+    return 0;
+}
+
+int keyword_matcher_add(keyword_matcher_t *m, const char *keyword, uint64_t id) {
+    int relink_needed = 0;
+    int result = insert(m, keyword, id, &relink_needed);
+    if (relink_needed) relink(m);
+    return result;
+}
+
+int keyword_matcher_insert(keyword_matcher_t *m, const char *keyword, uint64_t id) {
+    int relink_needed = 0;
+    int result = insert(m, keyword, id, &relink_needed);
+    if (relink_needed) m->dirty = 1;
+    return result;
+}
+
+void keyword_matcher_build(keyword_matcher_t *m) {
+    if (m && m->dirty) relink(m);
+}
+
+int keyword_matcher_remove(keyword_matcher_t *m, const char *keyword, uint64_t id) {
+    if (!m || !keyword || !keyword[0]) return -1;
+
+    int n = find_node(m, keyword);
+    if (n <= 0) return -1;
+
+    int *link = &m->nodes[n].subs;
+    while (*link >= 0 && m->subs[*link].id != id) link = &m->subs[*link].next;
+    if (*link < 0) return -1;
+
+    int s = *link;
+    *link = m->subs[s].next;
+    m->subs[s].next = m->free_subs;
+    m->free_subs = s;
+    m->live--;
+    if (m->nodes[n].subs >= 0) return 0;
+
+    /* Last subscriber gone: prune the branch back to the nearest node still in use */
+    while (n > 0 && m->nodes[n].child < 0 && m->nodes[n].subs < 0) {
+        int parent = m->nodes[n].parent;
+        drop_node(m, n);
+        n = parent;
+    }
+    relink(m);
+    return 0;
+}
+
+int keyword_matcher_scan(const keyword_matcher_t *m, const char *text, uint64_t *ids, int max) {
+    if (!m || !text || m->live == 0 || max <= 0) return 0;
+
+    const unsigned char *s = (const unsigned char *)text;
+    int found = 0;
+    int state = 0;
+
+    for (size_t i = 0; s[i]; i++) {
+        unsigned char c = lower(s[i]);
+        int next;
+        while ((next = child_of(m, state, c)) < 0 && state) state = m->nodes[state].fail;
+        state = next < 0 ? 0 : next;
+
+        int n = m->nodes[state].subs >= 0 ? state : m->nodes[state].dict;
+        for (; n > 0; n = m->nodes[n].dict) {
+            /* Word mode: no word character on either side */
+            size_t start = i + 1 - (size_t)m->nodes[n].depth;
+            if (m->mode == KEYWORD_MATCH_WORD &&
+                ((start > 0 && is_word(s[start - 1]) && is_word(s[start])) ||
+                 (is_word(s[i + 1]) && is_word(s[i])))) {
+                continue;
+            }
+
+            for (int sub = m->nodes[n].subs; sub >= 0; sub = m->subs[sub].next) {
+                uint64_t id = m->subs[sub].id;
+                int dup = 0;
+                for (int k = 0; k < found && !dup; k++) dup = ids[k] == id;
+                if (dup) continue;
+                ids[found++] = id;
+                if (found == max) return found;
+            }
+        }
+    }
+    return found;
+}
+
+size_t keyword_matcher_count(const keyword_matcher_t *m) {
+    return m ? m->live : 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * Himiko Discord Bot (C Edition) - Leaderboard Index
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "leaderboard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Each forward link records how many nodes it skips, so ranks fall out of a search */
+typedef struct lb_node {
+    uint64_t user_id;
+    int64_t xp;
+    int level;
+    struct {
+        struct lb_node *next;
+        uint32_t span;
+    } lv[];
+} lb_node_t;
+
+typedef struct board {
+    struct board *next;      /* guild map chain */
+    uint64_t guild_id;
+    pthread_rwlock_t lock;
+    int loaded;
+
+    lb_node_t *head;
+    int level;
+    uint32_t length;
+    uint64_t rng;
+
+    /* user_id -> node, linear probing */
+    lb_node_t **users;
+    size_t user_mask;
+} board_t;
+
+#define GUILD_BUCKETS 1024
+
+static board_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_guilds_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline size_t hash_u64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+/* Higher XP first; ties broken by user ID so the order is total */
+static inline int node_before(const lb_node_t *n, int64_t xp, uint64_t user_id) {
+    return n->xp > xp || (n->xp == xp && n->user_id < user_id);
+}
+
+static lb_node_t *node_new(int level, uint64_t user_id, int64_t xp) {
+    lb_node_t *n = calloc(1, sizeof(lb_node_t) + (size_t)level * sizeof(n->lv[0]));
+    if (!n) return NULL;
+    n->user_id = user_id;
+    n->xp = xp;
+    n->level = level;
+    return n;
+}
+
+static int random_level(board_t *b) {
+    int level = 1;
+    /* xorshift64; p = 1/4 per extra level */
+    while (level < LEADERBOARD_MAX_LEVEL) {
+        b->rng ^= b->rng << 13;
+        b->rng ^= b->rng >> 7;
+        b->rng ^= b->rng << 17;
+        if ((b->rng & 3) != 0) break;
+        level++;
+    }
+    return level;
+}
+
+static lb_node_t *user_find(board_t *b, uint64_t user_id) {
+    if (!b->users) return NULL;
+    size_t i = hash_u64(user_id) & b->user_mask;
+    while (b->users[i]) {
+        if (b->users[i]->user_id == user_id) return b->users[i];
+        i = (i + 1) & b->user_mask;
+    }
+    return NULL;
+}
+
+static void user_insert_slot(lb_node_t **users, size_t mask, lb_node_t *n) {
+    size_t i = hash_u64(n->user_id) & mask;
+    while (users[i]) i = (i + 1) & mask;
+    users[i] = n;
+}
+
+static int user_insert(board_t *b, lb_node_t *n) {
+    /* Keep load under one half */
+    if (!b->users || (size_t)(b->length + 1) * 2 > b->user_mask + 1) {
+        size_t size = b->users ? (b->user_mask + 1) * 2 : 64;
+        lb_node_t **users = calloc(size, sizeof(lb_node_t *));
+        if (!users) return -1;
+        if (b->users) {
+            for (size_t i = 0; i <= b->user_mask; i++) {
+                if (b->users[i]) user_insert_slot(users, size - 1, b->users[i]);
+            }
+            free(b->users);
+        }
+        b->users = users;
+        b->user_mask = size - 1;
+    }
+    user_insert_slot(b->users, b->user_mask, n);
+    return 0;
+}
+
+/* Link an unlinked node in order */
+static void list_insert(board_t *b, lb_node_t *n) {
+    lb_node_t *update[LEADERBOARD_MAX_LEVEL];
+    uint32_t rank[LEADERBOARD_MAX_LEVEL];
+    lb_node_t *x = b->head;
+
+    for (int i = b->level - 1; i >= 0; i--) {
+        rank[i] = (i == b->level - 1) ? 0 : rank[i + 1];
+        while (x->lv[i].next && node_before(x->lv[i].next, n->xp, n->user_id)) {
+            rank[i] += x->lv[i].span;
+            x = x->lv[i].next;
+        }
+        update[i] = x;
+    }
+
+    if (n->level > b->level) {
+        for (int i = b->level; i < n->level; i++) {
+            rank[i] = 0;
+            update[i] = b->head;
+            update[i]->lv[i].span = b->length;
+        }
+        b->level = n->level;
+    }
+
+    for (int i = 0; i < n->level; i++) {
+        n->lv[i].next = update[i]->lv[i].next;
+        update[i]->lv[i].next = n;
+        n->lv[i].span = update[i]->lv[i].span - (rank[0] - rank[i]);
+        update[i]->lv[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = n->level; i < b->level; i++) {
+        update[i]->lv[i].span++;
+    }
+    b->length++;
+}
+
+/* Unlink a node that is currently in the list */
+static void list_remove(board_t *b, lb_node_t *n) {
+    lb_node_t *update[LEADERBOARD_MAX_LEVEL];
+    lb_node_t *x = b->head;
+
+    for (int i = b->level - 1; i >= 0; i--) {
+        while (x->lv[i].next && node_before(x->lv[i].next, n->xp, n->user_id)) {
+            x = x->lv[i].next;
+        }
+        update[i] = x;
+    }
+
+    for (int i = 0; i < b->level; i++) {
+        if (update[i]->lv[i].next == n) {
+            update[i]->lv[i].span += n->lv[i].span - 1;
+            update[i]->lv[i].next = n->lv[i].next;
+        } else {
+            update[i]->lv[i].span--;
+        }
+    }
+    while (b->level > 1 && !b->head->lv[b->level - 1].next) {
+        b->level--;
+    }
+    b->length--;
+}
+
+/* Members strictly ahead of xp */
+static uint32_t count_above(const board_t *b, int64_t xp) {
+    uint32_t rank = 0;
+    const lb_node_t *x = b->head;
+    for (int i = b->level - 1; i >= 0; i--) {
+        while (x->lv[i].next && x->lv[i].next->xp > xp) {
+            rank += x->lv[i].span;
+            x = x->lv[i].next;
+        }
+    }
+    return rank;
+}
+
+/* Caller holds the board's write lock */
+static void board_set(board_t *b, uint64_t user_id, int64_t xp) {
+    lb_node_t *n = user_find(b, user_id);
+    if (n) {
+        if (n->xp == xp) return;
+        list_remove(b, n);
+        n->xp = xp;
+        list_insert(b, n);
+        return;
+    }
+
+    n = node_new(random_level(b), user_id, xp);
+    if (!n) return;
+    if (user_insert(b, n) != 0) {
+        free(n);
+        return;
+    }
+    list_insert(b, n);
+}
+
+static void board_reset(board_t *b) {
+    if (b->head) {
+        lb_node_t *x = b->head->lv[0].next;
+        while (x) {
+            lb_node_t *next = x->lv[0].next;
+            free(x);
+            x = next;
+        }
+        memset(b->head->lv, 0, LEADERBOARD_MAX_LEVEL * sizeof(b->head->lv[0]));
+    }
+    free(b->users);
+    b->users = NULL;
+    b->user_mask = 0;
+    b->level = 1;
+    b->length = 0;
+    b->loaded = 0;
+}
+
+static board_t *find_board(uint64_t guild_id, int create) {
+    size_t bucket = hash_u64(guild_id) & (GUILD_BUCKETS - 1);
+
+    pthread_mutex_lock(&g_guilds_lock);
+    board_t *b = g_guilds[bucket];
+    while (b && b->guild_id != guild_id) b = b->next;
+
+    if (!b && create) {
+        b = calloc(1, sizeof(board_t));
+        if (b) {
+            b->head = node_new(LEADERBOARD_MAX_LEVEL, 0, 0);
+            if (!b->head) {
+                free(b);
+                b = NULL;
+            } else {
+                b->guild_id = guild_id;
+                b->level = 1;
+                b->rng = hash_u64(guild_id) | 1;
+                pthread_rwlock_init(&b->lock, NULL);
+                b->next = g_guilds[bucket];
+                g_guilds[bucket] = b;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+    return b;
+}
+
+/* Caller holds the write lock. Writers that ran before this block were committed,
+ * writers blocked behind it apply their absolute totals afterwards. */
+static int board_load(himiko_database_t *db, board_t *b) {
+    const char *sql = "SELECT user_id, xp FROM user_xp WHERE guild_id = ?";
+    sqlite3_stmt *stmt;
+
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%llu", (unsigned long long)b->guild_id);
+
+    if (db_stmt_prepare_read(db, DB_STMT_LOAD_LEADERBOARD, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, guild_id_str, -1, SQLITE_STATIC);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *user = (const char *)sqlite3_column_text(stmt, 0);
+        if (!user) continue;
+        board_set(b, strtoull(user, NULL, 10), sqlite3_column_int64(stmt, 1));
+    }
+    db_stmt_release(db, DB_STMT_LOAD_LEADERBOARD, stmt);
+
+    if (rc != SQLITE_DONE) {
+        board_reset(b);
+        return -1;
+    }
+    b->loaded = 1;
+    return 0;
+}
+
+/* Returns the board read-locked, loading it first if needed */
+static board_t *acquire_loaded(himiko_database_t *db, uint64_t guild_id) {
+    board_t *b = find_board(guild_id, 1);
+    if (!b) return NULL;
+
+    pthread_rwlock_rdlock(&b->lock);
+    if (b->loaded) return b;
+    pthread_rwlock_unlock(&b->lock);
+
+    pthread_rwlock_wrlock(&b->lock);
+    if (!b->loaded && board_load(db, b) != 0) {
+        pthread_rwlock_unlock(&b->lock);
+        return NULL;
+    }
+    pthread_rwlock_unlock(&b->lock);
+
+    pthread_rwlock_rdlock(&b->lock);
+    return b;
+}
+
+int leaderboard_rank(himiko_database_t *db, uint64_t guild_id, uint64_t user_id, int *rank) {
+    board_t *b = acquire_loaded(db, guild_id);
+    if (!b) return -1;
+
+    lb_node_t *n = user_find(b, user_id);
+    *rank = (int)count_above(b, n ? n->xp : 0) + 1;
+    pthread_rwlock_unlock(&b->lock);
+    return 0;
+}
+
+int leaderboard_top(himiko_database_t *db, uint64_t guild_id, leaderboard_entry_t *out, int max) {
+    board_t *b = acquire_loaded(db, guild_id);
+    if (!b) return -1;
+
+    int count = 0;
+    for (lb_node_t *x = b->head->lv[0].next; x && count < max; x = x->lv[0].next) {
+        out[count].user_id = x->user_id;
+        out[count].xp = x->xp;
+        count++;
+    }
+    pthread_rwlock_unlock(&b->lock);
+    return count;
+}
+
+void leaderboard_set_xp(uint64_t guild_id, uint64_t user_id, int64_t xp) {
+    board_t *b = find_board(guild_id, 0);
+    if (!b) return;
+
+    pthread_rwlock_wrlock(&b->lock);
+    if (b->loaded) board_set(b, user_id, xp);
+    pthread_rwlock_unlock(&b->lock);
+}
+
+void leaderboard_clear(void) {
+    pthread_mutex_lock(&g_guilds_lock);
+    for (int i = 0; i < GUILD_BUCKETS; i++) {
+        board_t *b = g_guilds[i];
+        while (b) {
+            board_t *next = b->next;
+            board_reset(b);
+            free(b->head);
+            pthread_rwlock_destroy(&b->lock);
+            free(b);
+            b = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+}
@@ -0,0 +1,183 @@
+/*
+ * Himiko Discord Bot (C Edition) - Message Features
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "message_features.h"
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Per-scan state that spans candidates */
+typedef struct {
+    message_features_t *f;
+    int open_emojis;    /* emoji openers not yet followed by a '>' */
+} scan_t;
+
+static inline int is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* True if the len bytes before text[i] are word */
+static inline int preceded_by(const unsigned char *text, size_t i, const char *word, size_t len) {
+    return i >= len && memcmp(text + i - len, word, len) == 0;
+}
+
+/* strncmp stops at the terminator, so this never reads past the string */
+static inline int followed_by(const unsigned char *text, size_t i, const char *word) {
+    return strncmp((const char *)text + i + 1, word, strlen(word)) == 0;
+}
+
+/* Look closely at text[i], one of ':', '/', '<', '>', '@' or 0xF0 */
+static void inspect(const unsigned char *text, size_t i, scan_t *st) {
+    message_features_t *f = st->f;
+    const unsigned char *p = text + i;
+
+    switch (*p) {
+    case ':':
+        if (p[1] == '/' && p[2] == '/' &&
+            (preceded_by(text, i, "http", 4) || preceded_by(text, i, "https", 5))) {
+            f->urls++;
+        }
+        break;
+    case '/':
+        if (preceded_by(text, i, "discord.gg", 10) ||
+            preceded_by(text, i, "discord.com/invite", 18) ||
+            preceded_by(text, i, "discordapp.com/invite", 21)) {
+            f->invites++;
+        }
+        break;
+    case '<':
+        if (p[1] == ':' || (p[1] == 'a' && p[2] == ':')) {
+            st->open_emojis++;
+        } else if (p[1] == '@') {
+            if (p[2] == '&' && is_digit(p[3])) f->role_mentions++;
+            else if (is_digit(p[2]) || (p[2] == '!' && is_digit(p[3]))) f->user_mentions++;
+        }
+        break;
+    case '>':
+        /* Any later '>' closes every opener before it */
+        f->custom_emojis += st->open_emojis;
+        st->open_emojis = 0;
+        break;
+    case '@':
+        if (followed_by(text, i, "everyone") || followed_by(text, i, "here")) {
+            f->everyone_mentions++;
+        }
+        break;
+    case 0xF0:
+        if (p[1] == 0x9F) f->unicode_emojis++;
+        break;
+    }
+}
+
+void message_features_scan_scalar(const char *text, message_features_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!text) return;
+
+    const unsigned char *s = (const unsigned char *)text;
+    scan_t st = { .f = out };
+    size_t i = 0;
+    for (; s[i]; i++) {
+        switch (s[i]) {
+        case '\n':
+            out->lines++;
+            break;
+        case ':': case '/': case '<': case '>': case '@': case 0xF0:
+            inspect(s, i, &st);
+            break;
+        }
+    }
+    out->length = i;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#ifdef __AVX2__
+#define VEC_BYTES 32
+typedef __m256i vec_t;
+typedef uint32_t vmask_t;
+#define vload(p) _mm256_load_si256((const __m256i *)(p))
+#define vsplat(c) _mm256_set1_epi8((char)(c))
+#define veq(a, b) _mm256_cmpeq_epi8(a, b)
+#define vor(a, b) _mm256_or_si256(a, b)
+#define vmask(v) ((vmask_t)_mm256_movemask_epi8(v))
+#else
+#define VEC_BYTES 16
+typedef __m128i vec_t;
+typedef uint32_t vmask_t;
+#define vload(p) _mm_load_si128((const __m128i *)(p))
+#define vsplat(c) _mm_set1_epi8((char)(c))
+#define veq(a, b) _mm_cmpeq_epi8(a, b)
+#define vor(a, b) _mm_or_si128(a, b)
+#define vmask(v) ((vmask_t)_mm_movemask_epi8(v))
+#endif
+
+/*
+ * Aligned loads never cross into the next page, so reading the whole
+ * vector that holds the terminator (or the bytes before text in the
+ * first one) is safe; ASan cannot know that, hence the exemption.
+ */
+__attribute__((no_sanitize_address))
+void message_features_scan(const char *text, message_features_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!text) return;
+
+    const unsigned char *s = (const unsigned char *)text;
+    const unsigned char *p = (const unsigned char *)((uintptr_t)s & ~(uintptr_t)(VEC_BYTES - 1));
+    scan_t st = { .f = out };
+
+    const vec_t zero = vsplat(0), newline = vsplat('\n');
+    const vec_t colon = vsplat(':'), slash = vsplat('/'), lt = vsplat('<');
+    const vec_t gt = vsplat('>'), at = vsplat('@'), lead4 = vsplat(0xF0);
+
+    /* Bytes of the first vector that come before text */
+    vmask_t live = (vmask_t)(~(vmask_t)0 << (s - p));
+
+    for (;; p += VEC_BYTES) {
+        vec_t v = vload(p);
+        vmask_t nul = vmask(veq(v, zero)) & live;
+        if (nul) live &= (nul & -nul) - 1;
+
+        out->lines += __builtin_popcount(vmask(veq(v, newline)) & live);
+
+        vmask_t cand = vmask(vor(vor(vor(veq(v, colon), veq(v, slash)), vor(veq(v, lt), veq(v, gt))),
+                                 vor(veq(v, at), veq(v, lead4)))) & live;
+        while (cand) {
+            inspect(s, (size_t)(p - s) + (size_t)__builtin_ctz(cand), &st);
+            cand &= cand - 1;
+        }
+
+        if (nul) {
+            out->length = (size_t)(p - s) + (size_t)__builtin_ctz(nul);
+            return;
+        }
+        live = ~(vmask_t)0;
+    }
+}
+
+#else
+
+void message_features_scan(const char *text, message_features_t *out) {
+    message_features_scan_scalar(text, out);
+}
+
+#endif
+
+const message_features_t *message_features_get(uint64_t message_id, const char *text) {
+    static _Thread_local struct {
+        uint64_t message_id;
+        const char *text;
+        message_features_t features;
+    } last;
+
+    if (!message_id || last.message_id != message_id || last.text != text) {
+        message_features_scan(text, &last.features);
+        last.message_id = message_id;
+        last.text = text;
+    }
+    return &last.features;
+}
@@ -0,0 +1,266 @@
+/*
+ * Himiko Discord Bot (C Edition) - Moderation Action Pipeline
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "mod_pipeline.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define GUILD_BUCKETS 256
+#define TARGET_BUCKETS 512
+
+struct guild_pipeline;
+
+typedef struct job {
+    struct job *next;           /* queue order */
+    struct job *chain;          /* target bucket; holds queued and in-flight jobs */
+    struct guild_pipeline *guild;
+    u64snowflake user_id;
+    u64snowflake role_id;
+    mod_request_type_t type;
+} job_t;
+
+/* Kept until shutdown once created; a guild raided once is likely raided again */
+typedef struct guild_pipeline {
+    struct guild_pipeline *next;
+    u64snowflake guild_id;
+    u64snowflake report_channel_id;
+    job_t *head;
+    job_t *tail;
+    job_t *targets[TARGET_BUCKETS];
+    int queued;
+    int in_flight;
+    int window;
+
+    /* The batch running since the pipeline was last idle */
+    int total;
+    int succeeded[MOD_ACTION_COUNT];
+    int failed;
+    struct timespec started;
+} guild_pipeline_t;
+
+static guild_pipeline_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_stopping = 0;
+
+static inline size_t guild_bucket(u64snowflake guild_id) {
+    return (size_t)((guild_id * 0x9e3779b97f4a7c15ULL) >> 56) & (GUILD_BUCKETS - 1);
+}
+
+static inline size_t target_bucket(u64snowflake user_id, mod_request_type_t type) {
+    return (size_t)(((user_id ^ (uint64_t)type) * 0x9e3779b97f4a7c15ULL) >> 55) & (TARGET_BUCKETS - 1);
+}
+
+static double elapsed_secs(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (double)(now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+static void on_action_done(struct discord *client, struct discord_response *resp);
+static void on_action_fail(struct discord *client, struct discord_response *resp);
+
+static CCORDcode issue(struct discord *client, job_t *job) {
+    u64snowflake gid = job->guild->guild_id;
+    struct discord_ret ret = { .done = on_action_done, .fail = on_action_fail, .data = job };
+
+    switch (job->type) {
+        case MOD_ACTION_SILENCE:
+            return discord_add_guild_member_role(client, gid, job->user_id, job->role_id, NULL, &ret);
+        case MOD_ACTION_KICK:
+            return discord_remove_guild_member(client, gid, job->user_id, NULL, &ret);
+        default: {
+            struct discord_create_guild_ban params = { .delete_message_days = 1 };
+            return discord_create_guild_ban(client, gid, job->user_id, &params, &ret);
+        }
+    }
+}
+
+static void post_report(struct discord *client, u64snowflake channel_id, const char *text) {
+    if (!channel_id) return;
+    struct discord_create_message params = { .content = (char *)text };
+    discord_create_message(client, channel_id, &params, NULL);
+}
+
+static void finish(struct discord *client, job_t *job, int ok);
+
+/* Send queued jobs while the window has room */
+static void pump(struct discord *client, guild_pipeline_t *g) {
+    for (;;) {
+        pthread_mutex_lock(&g_lock);
+        job_t *job = NULL;
+        if (!g_stopping && g->head && g->in_flight < g->window) {
+            job = g->head;
+            g->head = job->next;
+            if (!g->head) g->tail = NULL;
+            g->queued--;
+            g->in_flight++;
+        }
+        pthread_mutex_unlock(&g_lock);
+        if (!job) return;
+
+        if (issue(client, job) != CCORD_OK) finish(client, job, 0);
+    }
+}
+
+/* Account for a job that left the wire; reports when due */
+static void finish(struct discord *client, job_t *job, int ok) {
+    guild_pipeline_t *g = job->guild;
+    char report[512] = "";
+    u64snowflake channel_id;
+
+    pthread_mutex_lock(&g_lock);
+    g->in_flight--;
+    job_t **link = &g->targets[target_bucket(job->user_id, job->type)];
+    while (*link && *link != job) link = &(*link)->chain;
+    if (*link) *link = job->chain;
+
+    if (ok) {
+        g->succeeded[job->type]++;
+        if (g->window < MOD_PIPELINE_MAX_WINDOW) g->window++;
+    } else {
+        g->failed++;
+        g->window = g->window > 1 ? g->window / 2 : 1;
+    }
+
+    int succeeded = g->succeeded[MOD_ACTION_SILENCE] + g->succeeded[MOD_ACTION_KICK] + g->succeeded[MOD_ACTION_BAN];
+    int completed = succeeded + g->failed;
+    double secs = elapsed_secs(&g->started);
+    double rate = secs > 0 ? completed / secs : 0;
+    channel_id = g->report_channel_id;
+
+    if (!g->head && g->in_flight == 0) {
+        if (g->total >= MOD_PIPELINE_REPORT_MIN) {
+            snprintf(report, sizeof(report),
+                "**Raid Action Complete**\n"
+                "Banned: %d, Kicked: %d, Silenced: %d\n"
+                "Failed: %d\n"
+                "Took %.1fs (%.1f actions/s)",
+                g->succeeded[MOD_ACTION_BAN], g->succeeded[MOD_ACTION_KICK], g->succeeded[MOD_ACTION_SILENCE],
+                g->failed, secs, rate);
+        }
+        g->total = 0;
+        g->failed = 0;
+        memset(g->succeeded, 0, sizeof(g->succeeded));
+    } else if (completed % MOD_PIPELINE_REPORT_EVERY == 0) {
+        snprintf(report, sizeof(report),
+            "**Raid Action Progress**\n%d/%d done, %d failed (%.1f actions/s)",
+            completed, g->total, g->failed, rate);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    free(job);
+    if (report[0]) post_report(client, channel_id, report);
+}
+
+static void on_action_done(struct discord *client, struct discord_response *resp) {
+    job_t *job = resp->data;
+    guild_pipeline_t *g = job->guild;
+    finish(client, job, 1);
+    pump(client, g);
+}
+
+static void on_action_fail(struct discord *client, struct discord_response *resp) {
+    job_t *job = resp->data;
+    guild_pipeline_t *g = job->guild;
+    DEBUG_LOG("Moderation action %d on user %lu failed: %d", job->type, (unsigned long)job->user_id, resp->code);
+    finish(client, job, 0);
+    pump(client, g);
+}
+
+int mod_pipeline_submit(struct discord *client, const mod_request_t *action) {
+    if (!client || !action || action->type < 0 || action->type >= MOD_ACTION_COUNT) return -1;
+    if (action->type == MOD_ACTION_SILENCE && !action->role_id) return -1;
+
+    size_t bucket = guild_bucket(action->guild_id);
+    size_t target = target_bucket(action->user_id, action->type);
+
+    pthread_mutex_lock(&g_lock);
+    if (g_stopping) {
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    guild_pipeline_t *g = g_guilds[bucket];
+    while (g && g->guild_id != action->guild_id) g = g->next;
+    if (!g) {
+        if (!(g = calloc(1, sizeof(guild_pipeline_t)))) {
+            pthread_mutex_unlock(&g_lock);
+            return -1;
+        }
+        g->guild_id = action->guild_id;
+        g->window = MOD_PIPELINE_START_WINDOW;
+        g->next = g_guilds[bucket];
+        g_guilds[bucket] = g;
+    }
+
+    for (job_t *j = g->targets[target]; j; j = j->chain) {
+        if (j->user_id == action->user_id && j->type == action->type) {
+            pthread_mutex_unlock(&g_lock);
+            return 1;
+        }
+    }
+
+    job_t *job = calloc(1, sizeof(job_t));
+    if (!job) {
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+    job->guild = g;
+    job->user_id = action->user_id;
+    job->role_id = action->role_id;
+    job->type = action->type;
+    job->chain = g->targets[target];
+    g->targets[target] = job;
+    if (g->tail) g->tail->next = job;
+    else g->head = job;
+    g->tail = job;
+
+    if (g->total == 0) clock_gettime(CLOCK_MONOTONIC, &g->started);
+    g->total++;
+    g->queued++;
+    if (action->report_channel_id) g->report_channel_id = action->report_channel_id;
+    pthread_mutex_unlock(&g_lock);
+
+    pump(client, g);
+    return 0;
+}
+
+int mod_pipeline_pending(u64snowflake guild_id) {
+    pthread_mutex_lock(&g_lock);
+    guild_pipeline_t *g = g_guilds[guild_bucket(guild_id)];
+    while (g && g->guild_id != guild_id) g = g->next;
+    int pending = g ? g->queued + g->in_flight : 0;
+    pthread_mutex_unlock(&g_lock);
+    return pending;
+}
+
+void mod_pipeline_shutdown(void) {
+    pthread_mutex_lock(&g_lock);
+    g_stopping = 1;
+    for (size_t i = 0; i < GUILD_BUCKETS; i++) {
+        guild_pipeline_t *g = g_guilds[i];
+        while (g) {
+            guild_pipeline_t *next = g->next;
+            /* Every job, queued or in flight, is in the target table */
+            for (size_t t = 0; t < TARGET_BUCKETS; t++) {
+                job_t *j = g->targets[t];
+                while (j) {
+                    job_t *chain = j->chain;
+                    free(j);
+                    j = chain;
+                }
+            }
+            free(g);
+            g = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
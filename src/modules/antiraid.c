@@ -7,6 +7,9 @@
 #include "modules/antiraid.h"
 #include "bot.h"
 #include "database.h"
+#include "mod_pipeline.h"
+#include "guild_perms.h"
+#include "scheduler.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,33 +21,68 @@
 /* Global raid tracker */
 static raid_tracker_t g_raid_tracker;
 
+static void on_lockdown_end(const scheduled_event_t *event);
+
 /* Convert snowflake to timestamp in milliseconds */
 int64_t snowflake_to_timestamp_ms(u64snowflake id) {
     return ((int64_t)(id >> 22)) + DISCORD_EPOCH;
 }
 
-/* Get or create guild state */
-static raid_guild_state_t *get_guild_state(const char *guild_id) {
+static inline size_t guild_bucket(uint64_t guild_id) {
+    return (size_t)((guild_id * 0x9e3779b97f4a7c15ULL) >> 56) & (ANTIRAID_GUILD_BUCKETS - 1);
+}
+
+/* Get or create guild state; states live until cleanup, so the pointer stays valid */
+static raid_guild_state_t *get_guild_state(u64snowflake guild_id) {
+    size_t bucket = guild_bucket(guild_id);
     pthread_mutex_lock(&g_raid_tracker.mutex);
 
-    for (int i = 0; i < g_raid_tracker.guild_count; i++) {
-        if (strcmp(g_raid_tracker.guilds[i].guild_id, guild_id) == 0) {
-            pthread_mutex_unlock(&g_raid_tracker.mutex);
-            return &g_raid_tracker.guilds[i];
-        }
-    }
+    raid_guild_state_t *state = g_raid_tracker.guilds[bucket];
+    while (state && state->guild_id != guild_id) state = state->next;
 
-    /* Create new state if room */
-    if (g_raid_tracker.guild_count < 100) {
-        raid_guild_state_t *state = &g_raid_tracker.guilds[g_raid_tracker.guild_count++];
-        memset(state, 0, sizeof(*state));
-        strncpy(state->guild_id, guild_id, sizeof(state->guild_id) - 1);
-        pthread_mutex_unlock(&g_raid_tracker.mutex);
-        return state;
+    if (!state && (state = calloc(1, sizeof(raid_guild_state_t)))) {
+        state->guild_id = guild_id;
+        state->next = g_raid_tracker.guilds[bucket];
+        g_raid_tracker.guilds[bucket] = state;
     }
 
     pthread_mutex_unlock(&g_raid_tracker.mutex);
-    return NULL;
+    return state;
+}
+
+static void drop_oldest_join(raid_guild_state_t *state, int64_t young_ms) {
+    const raid_join_t *j = &state->joins[state->join_head];
+    if (j->joined_at - j->account_created_at < young_ms) state->young_accounts--;
+    state->join_head = (state->join_head + 1) % state->join_cap;
+    state->join_count--;
+}
+
+/* Append a join and forget those older than the window; caller holds the tracker mutex */
+static void record_join(raid_guild_state_t *state, const raid_join_t *join, int64_t window_ms) {
+    while (state->join_count > 0 && state->joins[state->join_head].joined_at < join->joined_at - window_ms) {
+        drop_oldest_join(state, ANTIRAID_YOUNG_ACCOUNT_MS);
+    }
+
+    if (state->join_count == state->join_cap && state->join_cap < ANTIRAID_JOIN_RING_MAX) {
+        int cap = state->join_cap ? state->join_cap * 2 : 16;
+        raid_join_t *joins = malloc((size_t)cap * sizeof(raid_join_t));
+        if (joins) {
+            /* Unwrap into the new ring so the oldest join sits at 0 */
+            for (int i = 0; i < state->join_count; i++) {
+                joins[i] = state->joins[(state->join_head + i) % state->join_cap];
+            }
+            free(state->joins);
+            state->joins = joins;
+            state->join_head = 0;
+            state->join_cap = cap;
+        }
+    }
+    if (state->join_cap == 0) return;
+    if (state->join_count == state->join_cap) drop_oldest_join(state, ANTIRAID_YOUNG_ACCOUNT_MS);
+
+    state->joins[(state->join_head + state->join_count) % state->join_cap] = *join;
+    state->join_count++;
+    if (join->joined_at - join->account_created_at < ANTIRAID_YOUNG_ACCOUNT_MS) state->young_accounts++;
 }
 
 /* Auto-silence mode labels */
@@ -81,22 +119,28 @@ void antiraid_init(himiko_bot_t *bot) {
     (void)bot;
     memset(&g_raid_tracker, 0, sizeof(g_raid_tracker));
     pthread_mutex_init(&g_raid_tracker.mutex, NULL);
+    scheduler_register_event(ANTIRAID_LOCKDOWN_EVENT, on_lockdown_end);
 }
 
 void antiraid_cleanup(himiko_bot_t *bot) {
     (void)bot;
+    for (size_t i = 0; i < ANTIRAID_GUILD_BUCKETS; i++) {
+        raid_guild_state_t *state = g_raid_tracker.guilds[i];
+        while (state) {
+            raid_guild_state_t *next = state->next;
+            free(state->joins);
+            free(state);
+            state = next;
+        }
+        g_raid_tracker.guilds[i] = NULL;
+    }
     pthread_mutex_destroy(&g_raid_tracker.mutex);
 }
 
-/* Check for raid and handle it */
-static int check_for_raid(struct discord *client, const char *guild_id, antiraid_config_t *cfg, time_t now) {
-    int64_t since_time = (now - cfg->raid_time) * 1000LL; /* Convert to ms */
-    int count = 0;
-
-    db_count_recent_joins(&g_bot->database, guild_id, since_time, &count);
-
+/* Check for raid and handle it; count and young are the joins in the window */
+static int check_for_raid(struct discord *client, const char *guild_id, antiraid_config_t *cfg, time_t now,
+                          raid_guild_state_t *state, int count, int young) {
     if (count >= cfg->raid_size) {
-        raid_guild_state_t *state = get_guild_state(guild_id);
         if (!state) return 1;
 
         pthread_mutex_lock(&g_raid_tracker.mutex);
@@ -120,10 +164,11 @@ static int check_for_raid(struct discord *client, const char *guild_id, antiraid
                 snprintf(msg, sizeof(msg),
                     "%s**RAID DETECTED**\n\n"
                     "%d users joined in the past %d seconds!\n"
+                    "New accounts (under a week old): %d\n"
                     "Action: %s\n"
                     "Auto-Silence: %s",
                     alert_text,
-                    count, cfg->raid_time,
+                    count, cfg->raid_time, young,
                     cfg->action, autosilence_label(cfg->auto_silence));
 
                 u64snowflake channel_id = strtoull(cfg->log_channel_id, NULL, 10);
@@ -139,6 +184,9 @@ static int check_for_raid(struct discord *client, const char *guild_id, antiraid
                     state->lockdown_start = now;
                     pthread_mutex_unlock(&g_raid_tracker.mutex);
 
+                    scheduler_add_event(&g_bot->database, guild_id, ANTIRAID_LOCKDOWN_EVENT, guild_id,
+                                        now + cfg->lockdown_duration);
+
                     /* Raise verification level */
                     u64snowflake gid = strtoull(guild_id, NULL, 10);
                     struct discord_modify_guild params = {
@@ -171,27 +219,60 @@ static int check_for_raid(struct discord *client, const char *guild_id, antiraid
     return 0;
 }
 
-/* Silence a member */
+/* Queue the configured action against a member; the pipeline sends it */
 static void silence_member(struct discord *client, const char *guild_id, const char *user_id, antiraid_config_t *cfg) {
-    if (!cfg->silent_role_id[0]) return;
-
-    u64snowflake gid = strtoull(guild_id, NULL, 10);
-    u64snowflake uid = strtoull(user_id, NULL, 10);
-    u64snowflake role_id = strtoull(cfg->silent_role_id, NULL, 10);
+    mod_request_t action = {
+        .guild_id = strtoull(guild_id, NULL, 10),
+        .user_id = strtoull(user_id, NULL, 10),
+        .report_channel_id = strtoull(cfg->log_channel_id, NULL, 10)
+    };
 
     if (strcmp(cfg->action, "silence") == 0) {
-        discord_add_guild_member_role(client, gid, uid, role_id, NULL, NULL);
+        if (!cfg->silent_role_id[0]) return;
+        action.type = MOD_ACTION_SILENCE;
+        action.role_id = strtoull(cfg->silent_role_id, NULL, 10);
     } else if (strcmp(cfg->action, "kick") == 0) {
-        discord_remove_guild_member(client, gid, uid, NULL, NULL);
+        action.type = MOD_ACTION_KICK;
     } else if (strcmp(cfg->action, "ban") == 0) {
-        struct discord_create_guild_ban params = {
-            .delete_message_days = 1
-        };
-        discord_create_guild_ban(client, gid, uid, &params, NULL);
+        action.type = MOD_ACTION_BAN;
+    } else {
+        return;
     }
+    mod_pipeline_submit(client, &action);
 }
 
-void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, const struct discord_user *user) {
+/*
+ * User IDs of joins within window_ms of now; caller frees. The ring is only
+ * pruned when someone joins, so after a quiet spell it still holds old joins.
+ */
+static int snapshot_raid_users(u64snowflake guild_id, int64_t window_ms, u64snowflake **out) {
+    *out = NULL;
+    raid_guild_state_t *state = get_guild_state(guild_id);
+    if (!state) return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t since_ms = (int64_t)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000 - window_ms;
+
+    pthread_mutex_lock(&g_raid_tracker.mutex);
+    int count = 0;
+    if (state->join_count > 0 && (*out = malloc((size_t)state->join_count * sizeof(u64snowflake)))) {
+        for (int i = 0; i < state->join_count; i++) {
+            const raid_join_t *j = &state->joins[(state->join_head + i) % state->join_cap];
+            if (j->joined_at >= since_ms) (*out)[count++] = j->user_id;
+        }
+    }
+    pthread_mutex_unlock(&g_raid_tracker.mutex);
+
+    if (count == 0) {
+        free(*out);
+        *out = NULL;
+    }
+    return count;
+}
+
+void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, const struct discord_user *user,
+                             int64_t joined_at_ms) {
     char guild_id_str[32], user_id_str[32];
     snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
     snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)user->id);
@@ -201,11 +282,21 @@ void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, cons
         return;
     }
 
-    time_t now = time(NULL);
-    int64_t now_ms = now * 1000LL;
+    int64_t now_ms = joined_at_ms > 0 ? joined_at_ms : (int64_t)time(NULL) * 1000LL;
+    time_t now = (time_t)(now_ms / 1000);
     int64_t account_created = snowflake_to_timestamp_ms(user->id);
 
-    /* Record the join */
+    /* Count it in memory; the database row is only history and goes through the writer queue */
+    raid_guild_state_t *state = get_guild_state(guild_id);
+    int joins = 0, young = 0;
+    if (state) {
+        raid_join_t join = { .user_id = user->id, .joined_at = now_ms, .account_created_at = account_created };
+        pthread_mutex_lock(&g_raid_tracker.mutex);
+        record_join(state, &join, cfg.raid_time * 1000LL);
+        joins = state->join_count;
+        young = state->young_accounts;
+        pthread_mutex_unlock(&g_raid_tracker.mutex);
+    }
     db_record_member_join(&g_bot->database, guild_id_str, user_id_str, now_ms, account_created);
 
     /* Handle based on auto-silence mode */
@@ -257,11 +348,11 @@ void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, cons
             break;
 
         case 0: /* Off - just check for raid */
-            check_for_raid(client, guild_id_str, &cfg, now);
+            check_for_raid(client, guild_id_str, &cfg, now, state, joins, young);
             break;
 
         case 1: /* Raid mode - silence if raid detected */
-            if (check_for_raid(client, guild_id_str, &cfg, now)) {
+            if (check_for_raid(client, guild_id_str, &cfg, now, state, joins, young)) {
                 silence_member(client, guild_id_str, user_id_str, &cfg);
             }
             break;
@@ -291,39 +382,34 @@ void antiraid_on_member_join(struct discord *client, u64snowflake guild_id, cons
     }
 }
 
-void antiraid_check_lockdown_expiry(struct discord *client) {
-    time_t now = time(NULL);
-
-    pthread_mutex_lock(&g_raid_tracker.mutex);
-    for (int i = 0; i < g_raid_tracker.guild_count; i++) {
-        raid_guild_state_t *state = &g_raid_tracker.guilds[i];
-        if (!state->in_lockdown) continue;
+/* Scheduled "lockdown_end" event; also runs after a restart, when the tracker is empty */
+static void on_lockdown_end(const scheduled_event_t *event) {
+    if (!g_bot || !g_bot->client) return;
 
-        antiraid_config_t cfg;
-        if (db_get_antiraid_config(&g_bot->database, state->guild_id, &cfg) != 0) {
-            continue;
-        }
+    antiraid_config_t cfg;
+    int have_cfg = db_get_antiraid_config(&g_bot->database, event->guild_id, &cfg) == 0;
 
-        if (now - state->lockdown_start > cfg.lockdown_duration) {
-            state->in_lockdown = 0;
+    raid_guild_state_t *state = get_guild_state(strtoull(event->guild_id, NULL, 10));
+    if (state) {
+        pthread_mutex_lock(&g_raid_tracker.mutex);
+        state->in_lockdown = 0;
+        pthread_mutex_unlock(&g_raid_tracker.mutex);
+    }
 
-            /* Lower verification level */
-            u64snowflake gid = strtoull(state->guild_id, NULL, 10);
-            struct discord_modify_guild params = {
-                .verification_level = DISCORD_VERIFICATION_MEDIUM
-            };
-            discord_modify_guild(client, gid, &params, NULL);
+    /* Lower verification level */
+    u64snowflake gid = strtoull(event->guild_id, NULL, 10);
+    struct discord_modify_guild params = {
+        .verification_level = DISCORD_VERIFICATION_MEDIUM
+    };
+    discord_modify_guild(g_bot->client, gid, &params, NULL);
 
-            if (cfg.log_channel_id[0]) {
-                u64snowflake channel_id = strtoull(cfg.log_channel_id, NULL, 10);
-                struct discord_create_message params = {
-                    .content = "**Lockdown Expired**\nServer verification level restored to **Medium**"
-                };
-                discord_create_message(client, channel_id, &params, NULL);
-            }
-        }
+    if (have_cfg && cfg.log_channel_id[0]) {
+        u64snowflake channel_id = strtoull(cfg.log_channel_id, NULL, 10);
+        struct discord_create_message params = {
+            .content = "**Lockdown Expired**\nServer verification level restored to **Medium**"
+        };
+        discord_create_message(g_bot->client, channel_id, &params, NULL);
     }
-    pthread_mutex_unlock(&g_raid_tracker.mutex);
 }
 
 /* Command: antiraid status/enable/disable/set */
@@ -700,16 +786,71 @@ void cmd_getraid_prefix(struct discord *client, const struct discord_message *ms
     discord_create_message(client, msg->channel_id, &params, NULL);
 }
 
+/* Ban everyone in the raid window; progress is reported to the alert channel */
+static void banraid(u64snowflake guild_id, u64snowflake channel_id, char *response, size_t size) {
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+
+    antiraid_config_t cfg;
+    u64snowflake report_channel = channel_id;
+    int64_t window_ms = ANTIRAID_DEFAULT_RAID_SECS * 1000LL;
+    if (db_get_antiraid_config(&g_bot->database, guild_id_str, &cfg) == 0) {
+        if (cfg.raid_time > 0) window_ms = cfg.raid_time * 1000LL;
+        if (cfg.log_channel_id[0]) report_channel = strtoull(cfg.log_channel_id, NULL, 10);
+    }
+
+    u64snowflake *users;
+    int count = snapshot_raid_users(guild_id, window_ms, &users);
+    if (count == 0) {
+        snprintf(response, size, "**Ban Raid Users**\nNo recent joins in the raid window.");
+        return;
+    }
+
+    int queued = 0;
+    for (int i = 0; i < count; i++) {
+        mod_request_t action = {
+            .guild_id = guild_id,
+            .user_id = users[i],
+            .type = MOD_ACTION_BAN,
+            .report_channel_id = report_channel
+        };
+        if (mod_pipeline_submit(g_bot->client, &action) == 0) queued++;
+    }
+    free(users);
+
+    snprintf(response, size,
+        "**Ban Raid Users**\nQueued %d of %d recent joins for banning.\nProgress will be posted in <#%lu>.",
+        queued, count, (unsigned long)report_channel);
+}
+
+#define BANRAID_PERMS (DISCORD_PERM_BAN_MEMBERS | DISCORD_PERM_ADMINISTRATOR)
+#define BANRAID_DENIED "You need the Ban Members permission to use this."
+
 void cmd_banraid(struct discord *client, const struct discord_interaction *interaction) {
-    respond_ephemeral(client, interaction, "Use the prefix command `banraid` for this feature.");
+    if (!interaction->member || !(interaction->member->permissions & BANRAID_PERMS)) {
+        respond_ephemeral(client, interaction, BANRAID_DENIED);
+        return;
+    }
+
+    char response[256];
+    banraid(interaction->guild_id, interaction->channel_id, response, sizeof(response));
+    respond_message(client, interaction, response);
 }
 
 void cmd_banraid_prefix(struct discord *client, const struct discord_message *msg, const char *args) {
     (void)args;
 
-    struct discord_create_message params = {
-        .content = "**Ban Raid Users**\nThis feature requires the db_get_recent_joins function to be implemented."
-    };
+    /* Gateway members carry roles but no permissions */
+    if (msg->guild_id == 0 || !msg->member ||
+        !guild_perms_has(msg->guild_id, msg->author->id, msg->member->roles, BANRAID_PERMS)) {
+        struct discord_create_message params = { .content = BANRAID_DENIED };
+        discord_create_message(client, msg->channel_id, &params, NULL);
+        return;
+    }
+
+    char response[256];
+    banraid(msg->guild_id, msg->channel_id, response, sizeof(response));
+    struct discord_create_message params = { .content = response };
     discord_create_message(client, msg->channel_id, &params, NULL);
 }
 
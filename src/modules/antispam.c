@@ -6,118 +6,68 @@
 
 #include "modules/antispam.h"
 #include "database.h"
+#include "debug.h"
+#include "message_features.h"
+#include "pressure_table.h"
+#include "simhash.h"
+#include "wave_detector.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <regex.h>
 
-/* Global spam tracker */
-static spam_tracker_t g_spam_tracker;
-static int g_spam_initialized = 0;
+/* Pressure state, striped by (guild, user) */
+static pressure_table_t *g_pressure = NULL;
+
+/* Fingerprints this many bits apart or fewer count as a repeat */
+static int g_repeat_distance = 8;
+
+/* Pressure of one message, computed before taking a stripe lock */
+typedef struct {
+    double pressure;
+    uint64_t fingerprint;
+    double decay_per_sec;
+    double repeat_pressure;
+    time_t now;
+} message_pressure_t;
 
 /* Forward declarations */
-static user_pressure_t *get_or_create_user(const char *key);
-static double calculate_pressure(const struct discord_message *msg, antispam_config_t *cfg, user_pressure_t *user);
+static void measure_message(const struct discord_message *msg, const antispam_config_t *cfg, message_pressure_t *mp);
+static double apply_pressure(user_pressure_t *user, void *ctx);
 static void handle_spam_action(struct discord *client, const struct discord_message *msg, antispam_config_t *cfg, double pressure);
 static void log_spam_action(struct discord *client, const char *guild_id, const struct discord_user *user, const char *action, double pressure);
-static int count_urls(const char *text);
-static int count_lines(const char *text);
 
 void antispam_init(himiko_bot_t *bot) {
-    (void)bot;
-    if (g_spam_initialized) return;
+    if (g_pressure) return;
+
+    size_t max_users = (size_t)(bot && bot->config.features.antispam_max_users > 0
+                                ? bot->config.features.antispam_max_users : 100000);
+    size_t max_kb = (size_t)(bot && bot->config.features.antispam_max_memory_kb > 0
+                             ? bot->config.features.antispam_max_memory_kb : 8192);
+    if (bot && bot->config.features.antispam_repeat_distance >= 0) {
+        g_repeat_distance = bot->config.features.antispam_repeat_distance;
+    }
+    g_pressure = pressure_table_create(PRESSURE_TABLE_STRIPES, max_users, max_kb * 1024);
+    if (!g_pressure) fprintf(stderr, "Anti-spam: failed to allocate pressure table\n");
 
-    memset(&g_spam_tracker, 0, sizeof(g_spam_tracker));
-    pthread_mutex_init(&g_spam_tracker.mutex, NULL);
-    g_spam_initialized = 1;
+    wave_detector_init(bot ? bot->config.features.antispam_wave_authors : 0,
+                       bot ? bot->config.features.antispam_wave_window_secs : 0);
 }
 
 void antispam_cleanup(himiko_bot_t *bot) {
     (void)bot;
-    if (!g_spam_initialized) return;
-
-    pthread_mutex_destroy(&g_spam_tracker.mutex);
-    g_spam_initialized = 0;
-}
-
-/* Get or create a user pressure entry */
-static user_pressure_t *get_or_create_user(const char *key) {
-    /* Look for existing entry */
-    for (int i = 0; i < g_spam_tracker.user_count; i++) {
-        if (strcmp(g_spam_tracker.users[i].guild_user_key, key) == 0) {
-            return &g_spam_tracker.users[i];
-        }
-    }
-
-    /* Create new entry if space available */
-    if (g_spam_tracker.user_count < 1000) {
-        user_pressure_t *user = &g_spam_tracker.users[g_spam_tracker.user_count];
-        memset(user, 0, sizeof(*user));
-        strncpy(user->guild_user_key, key, sizeof(user->guild_user_key) - 1);
-        g_spam_tracker.user_count++;
-        return user;
-    }
+    if (!g_pressure) return;
 
-    /* Evict oldest entry if full */
-    time_t oldest_time = g_spam_tracker.users[0].last_update;
-    int oldest_idx = 0;
-    for (int i = 1; i < g_spam_tracker.user_count; i++) {
-        if (g_spam_tracker.users[i].last_update < oldest_time) {
-            oldest_time = g_spam_tracker.users[i].last_update;
-            oldest_idx = i;
-        }
-    }
-    user_pressure_t *user = &g_spam_tracker.users[oldest_idx];
-    memset(user, 0, sizeof(*user));
-    strncpy(user->guild_user_key, key, sizeof(user->guild_user_key) - 1);
-    return user;
+    DEBUG_LOG("antispam: %zu users tracked, %llu evictions",
+              pressure_table_count(g_pressure), pressure_table_evictions(g_pressure));
+    pressure_table_destroy(g_pressure);
+    g_pressure = NULL;
+    wave_detector_cleanup();
 }
 
-/* Count URLs in text using simple pattern matching */
-static int count_urls(const char *text) {
-    if (!text) return 0;
-
-    int count = 0;
-    const char *p = text;
-
-    while ((p = strstr(p, "http")) != NULL) {
-        if (strncmp(p, "http://", 7) == 0 || strncmp(p, "https://", 8) == 0) {
-            count++;
-            p += 4;
-        } else {
-            p++;
-        }
-    }
-
-    return count;
-}
-
-/* Count newlines in text */
-static int count_lines(const char *text) {
-    if (!text) return 0;
-
-    int count = 0;
-    for (const char *p = text; *p; p++) {
-        if (*p == '\n') count++;
-    }
-    return count;
-}
-
-/* Calculate pressure for a message */
-static double calculate_pressure(const struct discord_message *msg, antispam_config_t *cfg, user_pressure_t *user) {
-    time_t now = time(NULL);
-
-    /* Decay pressure based on time since last message */
-    if (user->last_update > 0 && cfg->pressure_decay > 0) {
-        double elapsed = difftime(now, user->last_update);
-        double decay = cfg->base_pressure * (elapsed / cfg->pressure_decay);
-        user->pressure -= decay;
-        if (user->pressure < 0) {
-            user->pressure = 0;
-        }
-    }
-
+/* Score a message on its own; no shared state is touched */
+static void measure_message(const struct discord_message *msg, const antispam_config_t *cfg, message_pressure_t *mp) {
     /* Start with base pressure */
     double pressure = cfg->base_pressure;
 
@@ -129,60 +79,73 @@ static double calculate_pressure(const struct discord_message *msg, antispam_con
         pressure += msg->embeds->size * cfg->image_pressure;
     }
 
+    /* Content is scanned once; spam_filter reuses the same result */
+    const message_features_t *f = message_features_get(msg->id, msg->content);
+
     /* Link pressure */
-    int link_count = count_urls(msg->content);
-    pressure += link_count * cfg->link_pressure;
+    pressure += f->urls * cfg->link_pressure;
 
-    /* Ping pressure */
-    if (msg->mentions) {
-        pressure += msg->mentions->size * cfg->ping_pressure;
+    /* Ping pressure - repeated pings of one user count every time */
+    int pings = f->user_mentions;
+    if (msg->mentions && msg->mentions->size > pings) {
+        pings = msg->mentions->size;
     }
+    pressure += pings * cfg->ping_pressure;
     if (msg->mention_everyone) {
         pressure += cfg->ping_pressure * 10; /* Heavy penalty for @everyone */
     }
 
     /* Length pressure */
-    if (msg->content) {
-        pressure += strlen(msg->content) * cfg->length_pressure;
-    }
+    pressure += f->length * cfg->length_pressure;
 
     /* Line pressure */
-    int line_count = count_lines(msg->content);
-    pressure += line_count * cfg->line_pressure;
-
-    /* Repeat pressure - same message as last */
-    if (msg->content && user->last_message[0] &&
-        strcmp(msg->content, user->last_message) == 0 &&
-        msg->content[0] != '\0') {
-        pressure += cfg->repeat_pressure;
+    pressure += f->lines * cfg->line_pressure;
+
+    mp->pressure = pressure;
+    /* Empty messages have no fingerprint and never count as repeats */
+    mp->fingerprint = simhash_text(msg->content);
+    mp->repeat_pressure = cfg->repeat_pressure;
+    mp->decay_per_sec = cfg->pressure_decay > 0 ? cfg->base_pressure / cfg->pressure_decay : 0;
+    mp->now = time(NULL);
+}
+
+/* Runs under the user's stripe lock */
+static double apply_pressure(user_pressure_t *user, void *ctx) {
+    const message_pressure_t *mp = ctx;
+
+    /* Decay pressure based on time since last message */
+    if (user->last_update > 0 && mp->decay_per_sec > 0) {
+        user->pressure -= mp->decay_per_sec * difftime(mp->now, user->last_update);
+        if (user->pressure < 0) {
+            user->pressure = 0;
+        }
     }
 
-    /* Update user state */
-    user->pressure += pressure;
-    if (msg->content) {
-        strncpy(user->last_message, msg->content, sizeof(user->last_message) - 1);
+    user->pressure += mp->pressure;
+
+    /* Repeat pressure - same or nearly the same as a recent message */
+    if (mp->fingerprint) {
+        for (int i = 0; i < PRESSURE_TABLE_HISTORY; i++) {
+            if (user->recent[i] && simhash_distance(user->recent[i], mp->fingerprint) <= g_repeat_distance) {
+                user->pressure += mp->repeat_pressure;
+                break;
+            }
+        }
+        user->recent[user->recent_next++ % PRESSURE_TABLE_HISTORY] = mp->fingerprint;
     }
-    user->last_update = now;
+
+    /* Update user state */
+    user->last_update = mp->now;
 
     return user->pressure;
 }
 
 /* Reset a user's pressure */
 void antispam_reset_pressure(const char *guild_id, const char *user_id) {
-    char key[96];
-    snprintf(key, sizeof(key), "%s:%s", guild_id, user_id);
-
-    pthread_mutex_lock(&g_spam_tracker.mutex);
-
-    for (int i = 0; i < g_spam_tracker.user_count; i++) {
-        if (strcmp(g_spam_tracker.users[i].guild_user_key, key) == 0) {
-            g_spam_tracker.users[i].pressure = 0;
-            g_spam_tracker.users[i].last_message[0] = '\0';
-            break;
-        }
-    }
+    uint64_t uid = strtoull(user_id, NULL, 10);
+    if (!g_pressure || !uid) return;
 
-    pthread_mutex_unlock(&g_spam_tracker.mutex);
+    pressure_table_reset(g_pressure, strtoull(guild_id, NULL, 10), uid);
 }
 
 /* Log spam action to mod log */
@@ -258,6 +221,38 @@ static void handle_spam_action(struct discord *client, const struct discord_mess
     }
 }
 
+/* Same content from many accounts within seconds - returns 1 if action taken */
+static int check_wave(struct discord *client, const struct discord_message *msg, antispam_config_t *cfg) {
+    uint64_t fingerprint = wave_fingerprint(msg->content);
+    if (!fingerprint) return 0;
+
+    wave_post_t post = {
+        .channel_id = msg->channel_id,
+        .message_id = msg->id,
+        .author_id = msg->author->id,
+        .posted_at = time(NULL)
+    };
+    wave_post_t earlier[WAVE_MAX_POSTS];
+    int earlier_count = 0;
+    if (!wave_detector_observe(msg->guild_id, fingerprint, &post, earlier, WAVE_MAX_POSTS, &earlier_count)) {
+        return 0;
+    }
+
+    /* The posts that built the wave get the same action as the one that tripped it */
+    for (int i = 0; i < earlier_count; i++) {
+        struct discord_user author = { .id = earlier[i].author_id };
+        struct discord_message prior = {
+            .id = earlier[i].message_id,
+            .channel_id = earlier[i].channel_id,
+            .guild_id = msg->guild_id,
+            .author = &author
+        };
+        handle_spam_action(client, &prior, cfg, cfg->max_pressure);
+    }
+    handle_spam_action(client, msg, cfg, cfg->max_pressure);
+    return 1;
+}
+
 /* Main spam check function - returns 1 if action taken */
 int antispam_check(himiko_bot_t *bot, struct discord *client, const struct discord_message *msg) {
     if (!msg || !msg->author) return 0;
@@ -278,14 +273,14 @@ int antispam_check(himiko_bot_t *bot, struct discord *client, const struct disco
         return 0;
     }
 
-    /* Build key and calculate pressure */
-    char key[96];
-    snprintf(key, sizeof(key), "%s:%s", guild_id_str, user_id_str);
+    if (!g_pressure) return 0;
+
+    if (check_wave(client, msg, &cfg)) return 1;
 
-    pthread_mutex_lock(&g_spam_tracker.mutex);
-    user_pressure_t *user = get_or_create_user(key);
-    double pressure = calculate_pressure(msg, &cfg, user);
-    pthread_mutex_unlock(&g_spam_tracker.mutex);
+    /* Calculate pressure; only the final update holds a stripe lock */
+    message_pressure_t mp;
+    measure_message(msg, &cfg, &mp);
+    double pressure = pressure_table_update(g_pressure, msg->guild_id, msg->author->id, apply_pressure, &mp);
 
     /* Check if exceeded threshold */
     if (pressure >= cfg.max_pressure) {
@@ -6,75 +6,90 @@
 
 #include "modules/auto_cleaner.h"
 #include "database.h"
+#include "scheduler.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sqlite3.h>
 
-static time_t g_last_tick = 0;
-
-void auto_cleaner_init(himiko_bot_t *bot) {
-    (void)bot;
-    g_last_tick = 0;
-}
-
-void auto_cleaner_cleanup(himiko_bot_t *bot) {
-    (void)bot;
+/* Channels read per query while arming timers at startup */
+#define LOAD_PAGE 64
+
+static void schedule_channel(int id, time_t when);
+
+static void read_channel_row(sqlite3_stmt *stmt, autoclean_channel_t *c) {
+    memset(c, 0, sizeof(*c));
+    c->id = sqlite3_column_int(stmt, 0);
+    const char *guild = (const char *)sqlite3_column_text(stmt, 1);
+    const char *channel = (const char *)sqlite3_column_text(stmt, 2);
+    if (guild) strncpy(c->guild_id, guild, sizeof(c->guild_id) - 1);
+    if (channel) strncpy(c->channel_id, channel, sizeof(c->channel_id) - 1);
+    c->interval_hours = sqlite3_column_int(stmt, 3);
+    c->warning_minutes = sqlite3_column_int(stmt, 4);
+    c->next_run = (time_t)sqlite3_column_int64(stmt, 5);
+    c->clean_message = sqlite3_column_int(stmt, 6);
+    c->clean_image = sqlite3_column_int(stmt, 7);
+    const char *created_by = (const char *)sqlite3_column_text(stmt, 8);
+    if (created_by) strncpy(c->created_by, created_by, sizeof(c->created_by) - 1);
 }
 
-/* Get due auto-clean channels from database */
-static int get_due_channels(himiko_database_t *db, autoclean_channel_t *channels, int max_count) {
+/* All auto-clean channels with id > after_id, in id order */
+static int load_channels(himiko_database_t *db, int after_id, autoclean_channel_t *channels, int max_count) {
     if (!db || !db->db) return 0;
 
     const char *sql = "SELECT id, guild_id, channel_id, interval_hours, warning_minutes, "
                       "CAST(strftime('%s', next_run) AS INTEGER), clean_message, clean_image, created_by "
-                      "FROM autoclean_channels WHERE next_run <= datetime('now') "
-                      "ORDER BY next_run LIMIT ?";
+                      "FROM autoclean_channels WHERE id > ? ORDER BY id LIMIT ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+    if (db_stmt_prepare_read(db, DB_STMT_AUTOCLEAN_LOAD_CHANNELS, sql, &stmt) != SQLITE_OK) return 0;
 
-    sqlite3_bind_int(stmt, 1, max_count);
+    sqlite3_bind_int(stmt, 1, after_id);
+    sqlite3_bind_int(stmt, 2, max_count);
 
     int count = 0;
     while (count < max_count && sqlite3_step(stmt) == SQLITE_ROW) {
-        autoclean_channel_t *c = &channels[count];
-        memset(c, 0, sizeof(*c));
-
-        c->id = sqlite3_column_int(stmt, 0);
-        const char *guild = (const char *)sqlite3_column_text(stmt, 1);
-        const char *channel = (const char *)sqlite3_column_text(stmt, 2);
-        if (guild) strncpy(c->guild_id, guild, sizeof(c->guild_id) - 1);
-        if (channel) strncpy(c->channel_id, channel, sizeof(c->channel_id) - 1);
-        c->interval_hours = sqlite3_column_int(stmt, 3);
-        c->warning_minutes = sqlite3_column_int(stmt, 4);
-        c->next_run = (time_t)sqlite3_column_int64(stmt, 5);
-        c->clean_message = sqlite3_column_int(stmt, 6);
-        c->clean_image = sqlite3_column_int(stmt, 7);
-        const char *created_by = (const char *)sqlite3_column_text(stmt, 8);
-        if (created_by) strncpy(c->created_by, created_by, sizeof(c->created_by) - 1);
-
+        read_channel_row(stmt, &channels[count]);
         count++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_LOAD_CHANNELS, stmt);
     return count;
 }
 
+static int get_channel(himiko_database_t *db, int id, autoclean_channel_t *channel) {
+    if (!db || !db->db) return -1;
+
+    const char *sql = "SELECT id, guild_id, channel_id, interval_hours, warning_minutes, "
+                      "CAST(strftime('%s', next_run) AS INTEGER), clean_message, clean_image, created_by "
+                      "FROM autoclean_channels WHERE id = ?";
+
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare_read(db, DB_STMT_AUTOCLEAN_GET_CHANNEL, sql, &stmt) != SQLITE_OK) return -1;
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    int found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) read_channel_row(stmt, channel);
+
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_GET_CHANNEL, stmt);
+    return found ? 0 : -1;
+}
+
 /* Update next run time for a channel */
-static int update_next_run(himiko_database_t *db, int id, int interval_hours) {
+static int update_next_run(himiko_database_t *db, int id, time_t next_run) {
     if (!db || !db->db) return -1;
 
-    const char *sql = "UPDATE autoclean_channels SET next_run = datetime('now', '+' || ? || ' hours') WHERE id = ?";
+    const char *sql = "UPDATE autoclean_channels SET next_run = datetime(?, 'unixepoch') WHERE id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (db_stmt_prepare(db, DB_STMT_AUTOCLEAN_UPDATE_NEXT_RUN, sql, &stmt) != SQLITE_OK) return -1;
 
-    sqlite3_bind_int(stmt, 1, interval_hours);
+    sqlite3_bind_int64(stmt, 1, next_run);
     sqlite3_bind_int(stmt, 2, id);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_UPDATE_NEXT_RUN, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -95,41 +110,63 @@ static void clean_channel(struct discord *client, autoclean_channel_t *channel)
     }
 }
 
-/* Tick function - called periodically */
-void auto_cleaner_tick(struct discord *client) {
+/* Scheduler callback for one channel */
+static void run_channel(void *arg) {
+    int id = *(int *)arg;
+    if (!g_bot || !g_bot->client) return;
+
+    autoclean_channel_t c;
+    /* Removed since the timer was armed */
+    if (get_channel(&g_bot->database, id, &c) != 0) return;
+
+    /* Re-added with a later next_run; that call armed its own timer */
     time_t now = time(NULL);
+    if (c.next_run > now) return;
+
+    /* Send warning if enabled */
+    if (c.warning_minutes > 0 && c.clean_message) {
+        u64snowflake channel_id = strtoull(c.channel_id, NULL, 10);
+        char warning[256];
+        snprintf(warning, sizeof(warning),
+            "**Auto-Clean Warning**\nThis channel will be cleaned in **%d minutes**.",
+            c.warning_minutes);
+        struct discord_create_message params = { .content = warning };
+        discord_create_message(g_bot->client, channel_id, &params, NULL);
+    }
 
-    /* Only check every 60 seconds */
-    if (now - g_last_tick < 60) return;
-    g_last_tick = now;
+    /* Clean the channel */
+    clean_channel(g_bot->client, &c);
 
-    himiko_bot_t *bot = discord_get_data(client);
-    if (!bot) return;
+    /* Update next run time */
+    time_t next_run = now + (time_t)c.interval_hours * 3600;
+    if (update_next_run(&g_bot->database, c.id, next_run) == 0) {
+        schedule_channel(c.id, next_run);
+    }
+}
 
-    /* Get due channels */
-    autoclean_channel_t channels[10];
-    int count = get_due_channels(&bot->database, channels, 10);
-
-    for (int i = 0; i < count; i++) {
-        autoclean_channel_t *c = &channels[i];
-
-        /* Send warning if enabled */
-        if (c->warning_minutes > 0 && c->clean_message) {
-            u64snowflake channel_id = strtoull(c->channel_id, NULL, 10);
-            char warning[256];
-            snprintf(warning, sizeof(warning),
-                "**Auto-Clean Warning**\nThis channel will be cleaned in **%d minutes**.",
-                c->warning_minutes);
-            struct discord_create_message params = { .content = warning };
-            discord_create_message(client, channel_id, &params, NULL);
-        }
+static void schedule_channel(int id, time_t when) {
+    int *arg = malloc(sizeof(int));
+    if (!arg) return;
+    *arg = id;
+    if (scheduler_add(when, run_channel, free, arg) != 0) free(arg);
+}
 
-        /* Clean the channel */
-        clean_channel(client, c);
+void auto_cleaner_init(himiko_bot_t *bot) {
+    autoclean_channel_t channels[LOAD_PAGE];
+    int after_id = 0;
+    int count;
+
+    do {
+        count = load_channels(&bot->database, after_id, channels, LOAD_PAGE);
+        for (int i = 0; i < count; i++) {
+            schedule_channel(channels[i].id, channels[i].next_run);
+        }
+        if (count > 0) after_id = channels[count - 1].id;
+    } while (count == LOAD_PAGE);
+}
 
-        /* Update next run time */
-        update_next_run(&bot->database, c->id, c->interval_hours);
-    }
+void auto_cleaner_cleanup(himiko_bot_t *bot) {
+    (void)bot;
 }
 
 /* Add autoclean channel */
@@ -141,10 +178,11 @@ static int add_autoclean_channel(himiko_database_t *db, const char *guild_id, co
                       "VALUES (?, ?, ?, ?, datetime('now', '+' || ? || ' hours'), ?) "
                       "ON CONFLICT(guild_id, channel_id) DO UPDATE SET "
                       "interval_hours = excluded.interval_hours, warning_minutes = excluded.warning_minutes, "
-                      "next_run = excluded.next_run";
+                      "next_run = excluded.next_run "
+                      "RETURNING id, CAST(strftime('%s', next_run) AS INTEGER)";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (db_stmt_prepare(db, DB_STMT_AUTOCLEAN_ADD_CHANNEL, sql, &stmt) != SQLITE_OK) return -1;
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, channel_id, -1, SQLITE_STATIC);
@@ -154,9 +192,17 @@ static int add_autoclean_channel(himiko_database_t *db, const char *guild_id, co
     sqlite3_bind_text(stmt, 6, created_by, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int id = 0;
+    time_t next_run = 0;
+    if (rc == SQLITE_ROW) {
+        id = sqlite3_column_int(stmt, 0);
+        next_run = (time_t)sqlite3_column_int64(stmt, 1);
+    }
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_ADD_CHANNEL, stmt);
 
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    if (rc != SQLITE_ROW) return -1;
+    schedule_channel(id, next_run);
+    return 0;
 }
 
 /* Remove autoclean channel */
@@ -166,13 +212,13 @@ static int remove_autoclean_channel(himiko_database_t *db, const char *guild_id,
     const char *sql = "DELETE FROM autoclean_channels WHERE guild_id = ? AND channel_id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (db_stmt_prepare(db, DB_STMT_AUTOCLEAN_REMOVE_CHANNEL, sql, &stmt) != SQLITE_OK) return -1;
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_REMOVE_CHANNEL, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -187,7 +233,7 @@ static int get_autoclean_channels(himiko_database_t *db, const char *guild_id,
                       "FROM autoclean_channels WHERE guild_id = ? ORDER BY id";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+    if (db_stmt_prepare_read(db, DB_STMT_AUTOCLEAN_GET_CHANNELS, sql, &stmt) != SQLITE_OK) return 0;
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
 
@@ -210,7 +256,7 @@ static int get_autoclean_channels(himiko_database_t *db, const char *guild_id,
         count++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_GET_CHANNELS, stmt);
     return count;
 }
 
@@ -221,14 +267,14 @@ static int set_clean_message(himiko_database_t *db, const char *guild_id, const
     const char *sql = "UPDATE autoclean_channels SET clean_message = ? WHERE guild_id = ? AND channel_id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (db_stmt_prepare(db, DB_STMT_AUTOCLEAN_SET_CLEAN_MESSAGE, sql, &stmt) != SQLITE_OK) return -1;
 
     sqlite3_bind_int(stmt, 1, enabled);
     sqlite3_bind_text(stmt, 2, guild_id, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_SET_CLEAN_MESSAGE, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -240,14 +286,14 @@ static int set_clean_image(himiko_database_t *db, const char *guild_id, const ch
     const char *sql = "UPDATE autoclean_channels SET clean_image = ? WHERE guild_id = ? AND channel_id = ?";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (db_stmt_prepare(db, DB_STMT_AUTOCLEAN_SET_CLEAN_IMAGE, sql, &stmt) != SQLITE_OK) return -1;
 
     sqlite3_bind_int(stmt, 1, enabled);
     sqlite3_bind_text(stmt, 2, guild_id, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, channel_id, -1, SQLITE_STATIC);
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_AUTOCLEAN_SET_CLEAN_IMAGE, stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
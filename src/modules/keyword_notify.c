@@ -0,0 +1,794 @@
+/*
+ * Himiko Discord Bot (C Edition) - Keyword Notification Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "modules/keyword_notify.h"
+#include "database.h"
+#include "debug.h"
+#include "keyword_matcher.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#define GUILD_BUCKETS 256
+#define COOLDOWN_SLOTS 4096
+#define DM_CHANNEL_SLOTS 1024
+#define ACCESS_BUCKETS 64
+#define ACCESS_TTL_SECS 60          /* role and overwrite changes apply within this */
+#define ACCESS_REQUIRED (DISCORD_PERM_VIEW_CHANNEL | DISCORD_PERM_READ_MESSAGE_HISTORY)
+
+/* A guild's keywords; loaded on the first message seen from the guild */
+typedef struct guild_keywords {
+    struct guild_keywords *next;
+    uint64_t guild_id;
+    pthread_rwlock_t lock;
+    keyword_matcher_t *matcher;
+} guild_keywords_t;
+
+/* One pending DM */
+typedef struct dm_job {
+    struct dm_job *next;
+    uint64_t user_id;
+    uint64_t guild_id;
+    uint64_t channel_id;        /* where the keyword was said */
+    char content[768];
+} dm_job_t;
+
+/*
+ * What decides who can read a channel: a guild's owner and role
+ * permissions, or a channel's overwrites (and, for a thread, its parent).
+ */
+typedef struct {
+    uint64_t id;                /* role, or overwrite target */
+    int type;                   /* overwrites: 0 role, 1 member */
+    uint64_t allow;             /* roles: their permissions */
+    uint64_t deny;
+} access_rule_t;
+
+typedef struct access_entry {
+    struct access_entry *next;
+    uint64_t id;                /* guild or channel */
+    time_t fetched;
+    uint64_t owner_id;          /* guilds */
+    uint64_t parent_id;         /* threads */
+    int is_private_thread;
+    int count;
+    access_rule_t rules[];
+} access_entry_t;
+
+static guild_keywords_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_guilds_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_changes = 0;      /* subscription changes, under g_guilds_lock */
+static himiko_database_t *g_db = NULL;
+static struct discord *g_client = NULL;
+
+/* DM queue, drained on the scheduler thread at a fixed rate */
+static pthread_mutex_t g_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static dm_job_t *g_queue_head = NULL;
+static dm_job_t *g_queue_tail = NULL;
+static int g_queue_len = 0;
+static int g_drain_armed = 0;
+static time_t g_last_drain = 0;     /* each second's batch goes out at most once */
+static int g_dm_per_sec = 5;
+static int g_cooldown_secs = 60;
+
+/* Last notification per (user, channel); lossy, a collision only costs an extra DM */
+static struct {
+    uint64_t key;
+    time_t at;
+} g_cooldown[COOLDOWN_SLOTS];
+
+/* Guild roles and channel overwrites, refetched once stale */
+static pthread_mutex_t g_access_lock = PTHREAD_MUTEX_INITIALIZER;
+static access_entry_t *g_guild_access[ACCESS_BUCKETS];
+static access_entry_t *g_channel_access[ACCESS_BUCKETS];
+
+/* DM channel per user; lossy, a miss only costs one create_dm */
+static pthread_mutex_t g_dm_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    uint64_t user_id;
+    uint64_t channel_id;
+} g_dm_channels[DM_CHANNEL_SLOTS];
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Database helpers */
+static int add_keyword(himiko_database_t *db, const char *user_id, const char *guild_id, const char *keyword) {
+    if (!db || !db->db || !user_id || !guild_id || !keyword) return -1;
+
+    const char *sql = "INSERT INTO keyword_notifications (user_id, guild_id, keyword) VALUES (?, ?, ?)";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_KEYWORD_ADD, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, user_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, keyword, -1, SQLITE_STATIC);
+
+    int result = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
+    db_stmt_release(db, DB_STMT_KEYWORD_ADD, stmt);
+    return result;
+}
+
+static int remove_keyword(himiko_database_t *db, const char *user_id, const char *guild_id, const char *keyword) {
+    if (!db || !db->db || !user_id || !guild_id || !keyword) return -1;
+
+    const char *sql = "DELETE FROM keyword_notifications WHERE user_id = ? AND guild_id = ? AND keyword = ?";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_KEYWORD_REMOVE, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, user_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, keyword, -1, SQLITE_STATIC);
+
+    int result = (sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db->db) > 0) ? 0 : -1;
+    db_stmt_release(db, DB_STMT_KEYWORD_REMOVE, stmt);
+    return result;
+}
+
+static int get_user_keywords(himiko_database_t *db, const char *user_id, const char *guild_id,
+                             char keywords[][KEYWORD_MAX_LEN], int max_count, int *out_count) {
+    if (!db || !db->db || !user_id || !guild_id || !out_count) return -1;
+    *out_count = 0;
+
+    const char *sql = "SELECT keyword FROM keyword_notifications WHERE user_id = ? AND guild_id = ? ORDER BY keyword";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare_read(db, DB_STMT_KEYWORD_GET_USER, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, user_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, guild_id, -1, SQLITE_STATIC);
+
+    while (*out_count < max_count && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *kw = (const char *)sqlite3_column_text(stmt, 0);
+        strncpy(keywords[*out_count], kw ? kw : "", KEYWORD_MAX_LEN - 1);
+        keywords[*out_count][KEYWORD_MAX_LEN - 1] = '\0';
+        (*out_count)++;
+    }
+
+    db_stmt_release(db, DB_STMT_KEYWORD_GET_USER, stmt);
+    return 0;
+}
+
+static keyword_matcher_t *load_guild_keywords(himiko_database_t *db, uint64_t guild_id) {
+    keyword_matcher_t *m = keyword_matcher_create(KEYWORD_MATCH_WORD);
+    if (!m || !db || !db->db) return m;
+
+    const char *sql = "SELECT user_id, keyword FROM keyword_notifications WHERE guild_id = ?";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare_read(db, DB_STMT_KEYWORD_GET_GUILD, sql, &stmt) != SQLITE_OK) {
+        return m;
+    }
+
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+    sqlite3_bind_text(stmt, 1, guild_id_str, -1, SQLITE_STATIC);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *uid = (const char *)sqlite3_column_text(stmt, 0);
+        const char *kw = (const char *)sqlite3_column_text(stmt, 1);
+        if (uid && kw) keyword_matcher_insert(m, kw, strtoull(uid, NULL, 10));
+    }
+
+    db_stmt_release(db, DB_STMT_KEYWORD_GET_GUILD, stmt);
+    keyword_matcher_build(m);
+    return m;
+}
+
+/* Find a guild's entry; with create, load it from the database on a miss */
+static guild_keywords_t *find_guild(uint64_t guild_id, int create) {
+    size_t bucket = mix64(guild_id) & (GUILD_BUCKETS - 1);
+    keyword_matcher_t *loaded = NULL;
+    uint64_t loaded_at = 0;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    for (;;) {
+        guild_keywords_t *g = g_guilds[bucket];
+        while (g && g->guild_id != guild_id) g = g->next;
+        if (g || !create) {
+            pthread_mutex_unlock(&g_guilds_lock);
+            keyword_matcher_free(loaded);
+            return g;
+        }
+
+        /*
+         * Publish a matcher only if no subscription changed while it was
+         * loading; a change that found no entry to patch relies on the load
+         * having read its row.
+         */
+        if (loaded && g_changes == loaded_at) break;
+        keyword_matcher_free(loaded);
+
+        /* Read and build outside the lock; other guilds keep going meanwhile */
+        loaded_at = g_changes;
+        pthread_mutex_unlock(&g_guilds_lock);
+        loaded = load_guild_keywords(g_db, guild_id);
+        pthread_mutex_lock(&g_guilds_lock);
+        if (!loaded) {
+            pthread_mutex_unlock(&g_guilds_lock);
+            return NULL;
+        }
+    }
+
+    guild_keywords_t *g = calloc(1, sizeof(guild_keywords_t));
+    if (g) {
+        g->guild_id = guild_id;
+        g->matcher = loaded;
+        pthread_rwlock_init(&g->lock, NULL);
+        g->next = g_guilds[bucket];
+        g_guilds[bucket] = g;
+    } else {
+        keyword_matcher_free(loaded);
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+    return g;
+}
+
+static uint64_t dm_channel_lookup(uint64_t user_id) {
+    size_t slot = mix64(user_id) & (DM_CHANNEL_SLOTS - 1);
+    pthread_mutex_lock(&g_dm_lock);
+    uint64_t channel_id = g_dm_channels[slot].user_id == user_id ? g_dm_channels[slot].channel_id : 0;
+    pthread_mutex_unlock(&g_dm_lock);
+    return channel_id;
+}
+
+static void dm_channel_store(uint64_t user_id, uint64_t channel_id) {
+    size_t slot = mix64(user_id) & (DM_CHANNEL_SLOTS - 1);
+    pthread_mutex_lock(&g_dm_lock);
+    g_dm_channels[slot].user_id = user_id;
+    g_dm_channels[slot].channel_id = channel_id;
+    pthread_mutex_unlock(&g_dm_lock);
+}
+
+/* Caller holds g_access_lock; drops stale entries it walks past */
+static access_entry_t *access_find(access_entry_t **table, uint64_t id, time_t now) {
+    access_entry_t **link = &table[mix64(id) & (ACCESS_BUCKETS - 1)];
+    while (*link) {
+        access_entry_t *e = *link;
+        if (e->fetched + ACCESS_TTL_SECS < now) {
+            *link = e->next;
+            free(e);
+            continue;
+        }
+        if (e->id == id) return e;
+        link = &e->next;
+    }
+    return NULL;
+}
+
+/* Caller holds g_access_lock; replaces any entry with the same id */
+static void access_store(access_entry_t **table, access_entry_t *entry) {
+    access_entry_t **head = &table[mix64(entry->id) & (ACCESS_BUCKETS - 1)];
+    access_entry_t **link = head;
+    while (*link && (*link)->id != entry->id) link = &(*link)->next;
+    if (*link) {
+        access_entry_t *old = *link;
+        *link = old->next;
+        free(old);
+    }
+    entry->next = *head;
+    *head = entry;
+}
+
+static void access_clear(access_entry_t **table) {
+    for (int i = 0; i < ACCESS_BUCKETS; i++) {
+        while (table[i]) {
+            access_entry_t *next = table[i]->next;
+            free(table[i]);
+            table[i] = next;
+        }
+    }
+}
+
+static int has_role(const struct snowflakes *roles, uint64_t role_id) {
+    for (int i = 0; roles && i < roles->size; i++) {
+        if (roles->array[i] == role_id) return 1;
+    }
+    return 0;
+}
+
+/* Discord's order: base role permissions, then @everyone, role and member overwrites */
+static uint64_t channel_permissions(const access_entry_t *guild, const access_entry_t *channel,
+                                    uint64_t user_id, const struct snowflakes *roles) {
+    if (guild->owner_id == user_id) return ~0ULL;
+
+    uint64_t perms = 0;
+    for (int i = 0; i < guild->count; i++) {
+        const access_rule_t *r = &guild->rules[i];
+        if (r->id == guild->id || has_role(roles, r->id)) perms |= r->allow;
+    }
+    if (perms & DISCORD_PERM_ADMINISTRATOR) return ~0ULL;
+
+    uint64_t allow = 0, deny = 0;
+    for (int i = 0; i < channel->count; i++) {
+        const access_rule_t *r = &channel->rules[i];
+        if (r->type == 0 && r->id == guild->id) perms = (perms & ~r->deny) | r->allow;
+    }
+    for (int i = 0; i < channel->count; i++) {
+        const access_rule_t *r = &channel->rules[i];
+        if (r->type == 0 && r->id != guild->id && has_role(roles, r->id)) {
+            allow |= r->allow;
+            deny |= r->deny;
+        }
+    }
+    perms = (perms & ~deny) | allow;
+    for (int i = 0; i < channel->count; i++) {
+        const access_rule_t *r = &channel->rules[i];
+        if (r->type == 1 && r->id == user_id) perms = (perms & ~r->deny) | r->allow;
+    }
+    return perms;
+}
+
+static void check_access(struct discord *client, dm_job_t *job);
+static void send_dm(struct discord *client, dm_job_t *job);
+
+static void on_job_fail(struct discord *client, struct discord_response *resp) {
+    (void)client;
+    dm_job_t *job = resp->data;
+    DEBUG_LOG("Keyword DM to user %lu failed: %d", (unsigned long)job->user_id, resp->code);
+    free(job);
+}
+
+static void on_access_guild(struct discord *client, struct discord_response *resp, const struct discord_guild *guild) {
+    dm_job_t *job = resp->data;
+    int count = guild->roles ? guild->roles->size : 0;
+    access_entry_t *e = calloc(1, sizeof(access_entry_t) + (size_t)count * sizeof(access_rule_t));
+    if (!e) {
+        free(job);
+        return;
+    }
+    e->id = job->guild_id;
+    e->fetched = time(NULL);
+    e->owner_id = guild->owner_id;
+    e->count = count;
+    for (int i = 0; i < count; i++) {
+        e->rules[i].id = guild->roles->array[i].id;
+        e->rules[i].allow = guild->roles->array[i].permissions;
+    }
+
+    pthread_mutex_lock(&g_access_lock);
+    access_store(g_guild_access, e);
+    pthread_mutex_unlock(&g_access_lock);
+    check_access(client, job);
+}
+
+static void on_access_channel(struct discord *client, struct discord_response *resp, const struct discord_channel *channel) {
+    dm_job_t *job = resp->data;
+    int count = channel->permission_overwrites ? channel->permission_overwrites->size : 0;
+    access_entry_t *e = calloc(1, sizeof(access_entry_t) + (size_t)count * sizeof(access_rule_t));
+    if (!e) {
+        free(job);
+        return;
+    }
+    e->id = channel->id;
+    e->fetched = time(NULL);
+    if (channel->type == DISCORD_CHANNEL_GUILD_NEWS_THREAD || channel->type == DISCORD_CHANNEL_GUILD_PUBLIC_THREAD ||
+        channel->type == DISCORD_CHANNEL_GUILD_PRIVATE_THREAD) {
+        e->parent_id = channel->parent_id;
+        e->is_private_thread = channel->type == DISCORD_CHANNEL_GUILD_PRIVATE_THREAD;
+    }
+    e->count = count;
+    for (int i = 0; i < count; i++) {
+        const struct discord_overwrite *o = &channel->permission_overwrites->array[i];
+        e->rules[i] = (access_rule_t){ .id = o->id, .type = o->type, .allow = o->allow, .deny = o->deny };
+    }
+
+    pthread_mutex_lock(&g_access_lock);
+    access_store(g_channel_access, e);
+    pthread_mutex_unlock(&g_access_lock);
+    check_access(client, job);
+}
+
+static void on_access_member(struct discord *client, struct discord_response *resp, const struct discord_guild_member *member) {
+    dm_job_t *job = resp->data;
+    time_t now = time(NULL);
+    int missing = 0, allowed = 0;
+
+    pthread_mutex_lock(&g_access_lock);
+    access_entry_t *guild = access_find(g_guild_access, job->guild_id, now);
+    access_entry_t *channel = access_find(g_channel_access, job->channel_id, now);
+    if (channel && channel->parent_id) channel = access_find(g_channel_access, channel->parent_id, now);
+    if (!guild || !channel) {
+        missing = 1;
+    } else {
+        uint64_t perms = channel_permissions(guild, channel, job->user_id, member->roles);
+        allowed = (perms & ACCESS_REQUIRED) == ACCESS_REQUIRED;
+    }
+    pthread_mutex_unlock(&g_access_lock);
+
+    /* Went stale while the member was being fetched */
+    if (missing) {
+        check_access(client, job);
+    } else if (allowed) {
+        send_dm(client, job);
+    } else {
+        free(job);
+    }
+}
+
+/*
+ * Asynchronous; takes ownership of job. Fetches whatever is not cached
+ * (guild roles, channel overwrites, a thread's parent), then the member,
+ * and only DMs someone who could read the message in the channel itself.
+ */
+static void check_access(struct discord *client, dm_job_t *job) {
+    time_t now = time(NULL);
+    uint64_t fetch_channel = 0;
+    int have_guild, private_thread = 0;
+
+    pthread_mutex_lock(&g_access_lock);
+    have_guild = access_find(g_guild_access, job->guild_id, now) != NULL;
+    access_entry_t *channel = access_find(g_channel_access, job->channel_id, now);
+    if (!channel) {
+        fetch_channel = job->channel_id;
+    } else if (channel->is_private_thread) {
+        private_thread = 1;
+    } else if (channel->parent_id && !access_find(g_channel_access, channel->parent_id, now)) {
+        fetch_channel = channel->parent_id;
+    }
+    pthread_mutex_unlock(&g_access_lock);
+
+    /* Who joined a private thread is not worth tracking here; nobody is told */
+    if (private_thread) {
+        free(job);
+        return;
+    }
+
+    CCORDcode code;
+    if (!have_guild) {
+        struct discord_ret_guild ret = { .done = on_access_guild, .fail = on_job_fail, .data = job };
+        code = discord_get_guild(client, job->guild_id, &ret);
+    } else if (fetch_channel) {
+        struct discord_ret_channel ret = { .done = on_access_channel, .fail = on_job_fail, .data = job };
+        code = discord_get_channel(client, fetch_channel, &ret);
+    } else {
+        struct discord_ret_guild_member ret = { .done = on_access_member, .fail = on_job_fail, .data = job };
+        code = discord_get_guild_member(client, job->guild_id, job->user_id, &ret);
+    }
+    if (code != CCORD_OK) free(job);
+}
+
+/* The job is done with once its message is handed to Concord */
+static void post_dm(struct discord *client, uint64_t channel_id, dm_job_t *job) {
+    struct discord_create_message params = { .content = job->content };
+    discord_create_message(client, channel_id, &params, NULL);
+    free(job);
+}
+
+static void on_dm_channel(struct discord *client, struct discord_response *resp, const struct discord_channel *channel) {
+    dm_job_t *job = resp->data;
+    dm_channel_store(job->user_id, channel->id);
+    post_dm(client, channel->id, job);
+}
+
+/* Asynchronous; takes ownership of job */
+static void send_dm(struct discord *client, dm_job_t *job) {
+    uint64_t channel_id = dm_channel_lookup(job->user_id);
+    if (channel_id) {
+        post_dm(client, channel_id, job);
+        return;
+    }
+
+    struct discord_create_dm params = { .recipient_id = job->user_id };
+    struct discord_ret_channel ret = { .done = on_dm_channel, .fail = on_job_fail, .data = job };
+    if (discord_create_dm(client, &params, &ret) != CCORD_OK) free(job);
+}
+
+/* Scheduler callback: start up to g_dm_per_sec DMs, then come back in a second */
+static void drain_queue(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_queue_lock);
+    dm_job_t *batch = g_queue_head;
+    dm_job_t *last = NULL;
+    int taken = 0;
+    for (dm_job_t *j = g_queue_head; j && taken < g_dm_per_sec; j = j->next) {
+        last = j;
+        taken++;
+    }
+    if (last) {
+        g_queue_head = last->next;
+        if (!g_queue_head) g_queue_tail = NULL;
+        last->next = NULL;
+    } else {
+        batch = NULL;
+    }
+    g_queue_len -= taken;
+    if (taken) g_last_drain = time(NULL);
+
+    g_drain_armed = g_queue_head != NULL;
+    if (g_drain_armed && scheduler_add(time(NULL) + 1, drain_queue, NULL, NULL) != 0) {
+        g_drain_armed = 0;
+    }
+    pthread_mutex_unlock(&g_queue_lock);
+
+    while (batch) {
+        dm_job_t *next = batch->next;
+        if (g_client) check_access(g_client, batch);
+        else free(batch);
+        batch = next;
+    }
+}
+
+/* Queue one DM unless the user heard about this channel recently */
+static void enqueue_dm(uint64_t user_id, uint64_t guild_id, uint64_t channel_id, const char *content, time_t now) {
+    uint64_t key = mix64(user_id ^ mix64(channel_id));
+    size_t slot = key & (COOLDOWN_SLOTS - 1);
+
+    pthread_mutex_lock(&g_queue_lock);
+    if ((g_cooldown[slot].key == key && now - g_cooldown[slot].at < g_cooldown_secs) ||
+        g_queue_len >= KEYWORD_QUEUE_MAX) {
+        pthread_mutex_unlock(&g_queue_lock);
+        return;
+    }
+
+    dm_job_t *job = malloc(sizeof(dm_job_t));
+    if (!job) {
+        pthread_mutex_unlock(&g_queue_lock);
+        return;
+    }
+    job->next = NULL;
+    job->user_id = user_id;
+    job->guild_id = guild_id;
+    job->channel_id = channel_id;
+    snprintf(job->content, sizeof(job->content), "%s", content);
+
+    if (g_queue_tail) g_queue_tail->next = job;
+    else g_queue_head = job;
+    g_queue_tail = job;
+    g_queue_len++;
+    g_cooldown[slot].key = key;
+    g_cooldown[slot].at = now;
+
+    if (!g_drain_armed) {
+        time_t when = g_last_drain >= now ? g_last_drain + 1 : now;
+        g_drain_armed = scheduler_add(when, drain_queue, NULL, NULL) == 0;
+    }
+    pthread_mutex_unlock(&g_queue_lock);
+}
+
+void keyword_notify_init(himiko_bot_t *bot) {
+    if (!bot) return;
+    g_db = &bot->database;
+    g_client = bot->client;
+    if (bot->config.features.keyword_dm_per_sec > 0) {
+        g_dm_per_sec = bot->config.features.keyword_dm_per_sec;
+    }
+    if (bot->config.features.keyword_cooldown_secs >= 0) {
+        g_cooldown_secs = bot->config.features.keyword_cooldown_secs;
+    }
+}
+
+void keyword_notify_cleanup(himiko_bot_t *bot) {
+    (void)bot;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    for (int i = 0; i < GUILD_BUCKETS; i++) {
+        guild_keywords_t *g = g_guilds[i];
+        while (g) {
+            guild_keywords_t *next = g->next;
+            keyword_matcher_free(g->matcher);
+            pthread_rwlock_destroy(&g->lock);
+            free(g);
+            g = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+
+    pthread_mutex_lock(&g_queue_lock);
+    while (g_queue_head) {
+        dm_job_t *next = g_queue_head->next;
+        free(g_queue_head);
+        g_queue_head = next;
+    }
+    g_queue_tail = NULL;
+    g_queue_len = 0;
+    g_drain_armed = 0;
+    pthread_mutex_unlock(&g_queue_lock);
+
+    pthread_mutex_lock(&g_dm_lock);
+    memset(g_dm_channels, 0, sizeof(g_dm_channels));
+    pthread_mutex_unlock(&g_dm_lock);
+
+    pthread_mutex_lock(&g_access_lock);
+    access_clear(g_guild_access);
+    access_clear(g_channel_access);
+    pthread_mutex_unlock(&g_access_lock);
+    g_client = NULL;
+}
+
+void keyword_notify_on_message(struct discord *client, const struct discord_message *msg) {
+    if (!client || !msg || !msg->author || !msg->content || !msg->content[0]) return;
+    if (msg->author->bot || msg->guild_id == 0 || !g_db) return;
+
+    guild_keywords_t *g = find_guild(msg->guild_id, 1);
+    if (!g) return;
+
+    uint64_t users[KEYWORD_MAX_RECIPIENTS];
+    pthread_rwlock_rdlock(&g->lock);
+    int count = keyword_matcher_scan(g->matcher, msg->content, users, KEYWORD_MAX_RECIPIENTS);
+    pthread_rwlock_unlock(&g->lock);
+    if (count == 0) return;
+
+    /* One line of context; newlines would break the quote */
+    char snippet[301];
+    snprintf(snippet, sizeof(snippet), "%s", msg->content);
+    for (char *p = snippet; *p; p++) {
+        if (*p == '\n' || *p == '\r') *p = ' ';
+    }
+
+    char content[768];
+    snprintf(content, sizeof(content),
+        "A keyword you follow was mentioned in <#%lu> by <@%lu>:\n> %s%s\n"
+        "https://discord.com/channels/%lu/%lu/%lu",
+        (unsigned long)msg->channel_id, (unsigned long)msg->author->id,
+        snippet, strlen(msg->content) >= sizeof(snippet) ? "..." : "",
+        (unsigned long)msg->guild_id, (unsigned long)msg->channel_id, (unsigned long)msg->id);
+
+    time_t now = time(NULL);
+    for (int i = 0; i < count; i++) {
+        if (users[i] == msg->author->id) continue;
+
+        /* Anyone pinged directly already gets a notification */
+        int mentioned = 0;
+        for (int j = 0; msg->mentions && j < msg->mentions->size && !mentioned; j++) {
+            mentioned = msg->mentions->array[j].id == users[i];
+        }
+        if (!mentioned) enqueue_dm(users[i], msg->guild_id, msg->channel_id, content, now);
+    }
+}
+
+/* Subscribe or unsubscribe; writes the reply into response */
+static void change_keyword(u64snowflake guild_id, u64snowflake user_id, const char *keyword, int add,
+                           char *response, size_t response_size) {
+    char normalized[KEYWORD_MAX_LEN];
+    if (!keyword_normalize(keyword, normalized, sizeof(normalized))) {
+        snprintf(response, response_size, "Keywords must be 2 to %d characters long.", KEYWORD_MAX_LEN - 1);
+        return;
+    }
+
+    char guild_id_str[32], user_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)user_id);
+
+    if (add) {
+        char existing[KEYWORD_MAX_PER_USER][KEYWORD_MAX_LEN];
+        int count = 0;
+        if (get_user_keywords(g_db, user_id_str, guild_id_str, existing, KEYWORD_MAX_PER_USER, &count) != 0) {
+            snprintf(response, response_size, "Failed to read your keywords.");
+            return;
+        }
+        if (count >= KEYWORD_MAX_PER_USER) {
+            snprintf(response, response_size, "You can follow at most %d keywords per server.", KEYWORD_MAX_PER_USER);
+            return;
+        }
+        if (add_keyword(g_db, user_id_str, guild_id_str, normalized) != 0) {
+            snprintf(response, response_size, "You already follow **%s** here.", normalized);
+            return;
+        }
+    } else if (remove_keyword(g_db, user_id_str, guild_id_str, normalized) != 0) {
+        snprintf(response, response_size, "You don't follow **%s** here.", normalized);
+        return;
+    }
+
+    /* Patch the live trie; a guild not loaded yet reads the new row when it is */
+    pthread_mutex_lock(&g_guilds_lock);
+    g_changes++;
+    pthread_mutex_unlock(&g_guilds_lock);
+    guild_keywords_t *g = find_guild(guild_id, 0);
+    if (g) {
+        pthread_rwlock_wrlock(&g->lock);
+        if (add) keyword_matcher_add(g->matcher, normalized, user_id);
+        else keyword_matcher_remove(g->matcher, normalized, user_id);
+        pthread_rwlock_unlock(&g->lock);
+    }
+
+    snprintf(response, response_size, add ? "You'll get a DM when someone says **%s**." :
+             "No longer following **%s**.", normalized);
+}
+
+static void list_keywords(u64snowflake guild_id, u64snowflake user_id, char *response, size_t response_size) {
+    char guild_id_str[32], user_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)user_id);
+
+    char keywords[KEYWORD_MAX_PER_USER][KEYWORD_MAX_LEN];
+    int count = 0;
+    if (get_user_keywords(g_db, user_id_str, guild_id_str, keywords, KEYWORD_MAX_PER_USER, &count) != 0 ||
+        count == 0) {
+        snprintf(response, response_size, "You don't follow any keywords here.");
+        return;
+    }
+
+    size_t len = (size_t)snprintf(response, response_size, "**Your keywords** (%d/%d)\n", count, KEYWORD_MAX_PER_USER);
+    for (int i = 0; i < count && len < response_size; i++) {
+        len += (size_t)snprintf(response + len, response_size - len, "• %s\n", keywords[i]);
+    }
+}
+
+/* Command: keyword add/remove/list */
+void cmd_keyword(struct discord *client, const struct discord_interaction *interaction) {
+    if (!g_db || !interaction->member || !interaction->member->user) {
+        respond_ephemeral(client, interaction, "Keyword notifications only work in servers.");
+        return;
+    }
+
+    struct discord_application_command_interaction_data_options *opts = interaction->data->options;
+    u64snowflake user_id = interaction->member->user->id;
+    char response[1024];
+
+    if (!opts || opts->size == 0 || strcmp(opts->array[0].name, "list") == 0) {
+        list_keywords(interaction->guild_id, user_id, response, sizeof(response));
+        respond_ephemeral(client, interaction, response);
+        return;
+    }
+
+    const char *subcommand = opts->array[0].name;
+    struct discord_application_command_interaction_data_options *sub_opts = opts->array[0].options;
+    const char *keyword = NULL;
+    for (int i = 0; sub_opts && i < sub_opts->size; i++) {
+        if (strcmp(sub_opts->array[i].name, "keyword") == 0) {
+            keyword = sub_opts->array[i].value;
+        }
+    }
+
+    if ((strcmp(subcommand, "add") == 0 || strcmp(subcommand, "remove") == 0) && keyword) {
+        change_keyword(interaction->guild_id, user_id, keyword, subcommand[0] == 'a', response, sizeof(response));
+        respond_ephemeral(client, interaction, response);
+    } else {
+        respond_ephemeral(client, interaction, "Usage: /keyword add|remove <keyword>, or /keyword list");
+    }
+}
+
+/* Prefix command handler */
+void cmd_keyword_prefix(struct discord *client, const struct discord_message *msg, const char *args) {
+    if (!g_db || msg->guild_id == 0) return;
+
+    char response[1024];
+    char cmd[16] = "", keyword[128] = "";
+    int parsed = args ? sscanf(args, "%15s %127[^\n]", cmd, keyword) : 0;
+
+    if (parsed < 1 || strcmp(cmd, "list") == 0) {
+        /* The channel is public; only the slash reply can be ephemeral */
+        snprintf(response, sizeof(response), "Use `/keyword list` to see your keywords privately.");
+    } else if ((strcmp(cmd, "add") == 0 || strcmp(cmd, "remove") == 0) && parsed == 2) {
+        change_keyword(msg->guild_id, msg->author->id, keyword, cmd[0] == 'a', response, sizeof(response));
+    } else {
+        snprintf(response, sizeof(response),
+            "Usage:\n`keyword add <keyword>` - DM me when someone says it\n"
+            "`keyword remove <keyword>` - Stop following a keyword\n"
+            "`/keyword list` - List your keywords (only you see the reply)");
+    }
+
+    struct discord_create_message params = { .content = response };
+    discord_create_message(client, msg->channel_id, &params, NULL);
+}
+
+void register_keyword_notify_commands(himiko_bot_t *bot) {
+    himiko_command_t cmds[] = {
+        { "keyword", "Get a DM when someone says a keyword", "Utility", cmd_keyword, cmd_keyword_prefix, 0, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+        bot_register_command(bot, &cmds[i]);
+    }
+}
@@ -0,0 +1,328 @@
+/*
+ * Himiko Discord Bot (C Edition) - Message XP Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "modules/leveling.h"
+#include "database.h"
+#include "leaderboard.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* One guild member; base is the last total known to be in user_xp */
+typedef struct xp_entry {
+    struct xp_entry *next;
+    uint64_t guild_id;
+    uint64_t user_id;
+    int64_t base;
+    int64_t delta;
+    time_t last_award;
+    int loaded;
+} xp_entry_t;
+
+typedef struct {
+    uint64_t guild_id;
+    uint64_t user_id;
+    int64_t delta;
+} xp_flush_row_t;
+
+static xp_entry_t **g_buckets = NULL;
+static size_t g_bucket_mask = 0;
+static size_t g_entry_count = 0;
+static pthread_mutex_t g_xp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Held from swapping deltas out until they are queued, so forget never sees them half way */
+static pthread_mutex_t g_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t g_flush_thread;
+static pthread_cond_t g_flush_cond = PTHREAD_COND_INITIALIZER;
+static int g_running = 0;
+
+static inline size_t entry_hash(uint64_t guild_id, uint64_t user_id) {
+    uint64_t h = guild_id * 0x9e3779b97f4a7c15ULL ^ user_id;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+/* Caller holds g_xp_lock */
+static xp_entry_t **find_slot(uint64_t guild_id, uint64_t user_id) {
+    xp_entry_t **slot = &g_buckets[entry_hash(guild_id, user_id) & g_bucket_mask];
+    while (*slot && ((*slot)->guild_id != guild_id || (*slot)->user_id != user_id)) {
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static void grow_buckets(void) {
+    size_t size = (g_bucket_mask + 1) * 2;
+    xp_entry_t **buckets = calloc(size, sizeof(xp_entry_t *));
+    if (!buckets) return;
+
+    for (size_t i = 0; i <= g_bucket_mask; i++) {
+        xp_entry_t *e = g_buckets[i];
+        while (e) {
+            xp_entry_t *next = e->next;
+            size_t b = entry_hash(e->guild_id, e->user_id) & (size - 1);
+            e->next = buckets[b];
+            buckets[b] = e;
+            e = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = buckets;
+    g_bucket_mask = size - 1;
+}
+
+static xp_entry_t *get_or_create(uint64_t guild_id, uint64_t user_id) {
+    xp_entry_t **slot = find_slot(guild_id, user_id);
+    if (*slot) return *slot;
+
+    xp_entry_t *e = calloc(1, sizeof(xp_entry_t));
+    if (!e) return NULL;
+    e->guild_id = guild_id;
+    e->user_id = user_id;
+    *slot = e;
+
+    if (++g_entry_count > g_bucket_mask + 1) grow_buckets();
+    return e;
+}
+
+/* Swap out every non-zero delta and queue it as one batch of upserts */
+static void flush_pending(void) {
+    xp_flush_row_t *rows = NULL;
+    int row_count = 0;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&g_flush_lock);
+    pthread_mutex_lock(&g_xp_lock);
+    if (g_buckets && g_entry_count > 0) {
+        rows = malloc(g_entry_count * sizeof(xp_flush_row_t));
+    }
+    for (size_t i = 0; rows && i <= g_bucket_mask; i++) {
+        xp_entry_t **slot = &g_buckets[i];
+        while (*slot) {
+            xp_entry_t *e = *slot;
+            if (e->delta != 0) {
+                xp_flush_row_t *r = &rows[row_count++];
+                r->guild_id = e->guild_id;
+                r->user_id = e->user_id;
+                r->delta = e->delta;
+                e->base += e->delta;
+                e->delta = 0;
+            } else if (now - e->last_award > LEVELING_IDLE_SECS) {
+                *slot = e->next;
+                free(e);
+                g_entry_count--;
+                continue;
+            }
+            slot = &e->next;
+        }
+    }
+    pthread_mutex_unlock(&g_xp_lock);
+
+    /* The writer thread commits these together */
+    for (int i = 0; i < row_count; i++) {
+        char guild_id_str[32], user_id_str[32];
+        snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, rows[i].guild_id);
+        snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, rows[i].user_id);
+        db_add_user_xp_delta(&g_bot->database, guild_id_str, user_id_str, rows[i].delta);
+    }
+    pthread_mutex_unlock(&g_flush_lock);
+    free(rows);
+}
+
+static void *flush_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_xp_lock);
+    while (g_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += LEVELING_FLUSH_SECS;
+        pthread_cond_timedwait(&g_flush_cond, &g_xp_lock, &deadline);
+
+        pthread_mutex_unlock(&g_xp_lock);
+        flush_pending();
+        pthread_mutex_lock(&g_xp_lock);
+    }
+    pthread_mutex_unlock(&g_xp_lock);
+    return NULL;
+}
+
+void leveling_init(himiko_bot_t *bot) {
+    (void)bot;
+    if (g_running) return;
+
+    g_buckets = calloc(1024, sizeof(xp_entry_t *));
+    if (!g_buckets) return;
+    g_bucket_mask = 1023;
+    g_entry_count = 0;
+
+    g_running = 1;
+    if (pthread_create(&g_flush_thread, NULL, flush_thread, NULL) != 0) {
+        fprintf(stderr, "Leveling: failed to start flush thread\n");
+        g_running = 0;
+        free(g_buckets);
+        g_buckets = NULL;
+    }
+}
+
+void leveling_cleanup(himiko_bot_t *bot) {
+    (void)bot;
+    if (!g_running) return;
+
+    pthread_mutex_lock(&g_xp_lock);
+    g_running = 0;
+    pthread_cond_signal(&g_flush_cond);
+    pthread_mutex_unlock(&g_xp_lock);
+    pthread_join(g_flush_thread, NULL);
+
+    /* The thread's last pass may have raced a final message */
+    flush_pending();
+
+    pthread_mutex_lock(&g_xp_lock);
+    for (size_t i = 0; i <= g_bucket_mask; i++) {
+        xp_entry_t *e = g_buckets[i];
+        while (e) {
+            xp_entry_t *next = e->next;
+            free(e);
+            e = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = NULL;
+    g_bucket_mask = 0;
+    g_entry_count = 0;
+    pthread_mutex_unlock(&g_xp_lock);
+}
+
+static void grant_level_roles(struct discord *client, const struct discord_message *msg,
+                              const char *guild_id_str, int old_level, int new_level) {
+    level_rank_t ranks[32];
+    int count = 0;
+    if (db_get_ranks_for_level(&g_bot->database, guild_id_str, new_level, ranks, 32, &count) != 0) {
+        return;
+    }
+
+    /* Ranks come back highest first; only the newly reached ones are granted */
+    for (int i = 0; i < count && ranks[i].level > old_level; i++) {
+        u64snowflake role_id = strtoull(ranks[i].role_id, NULL, 10);
+        if (role_id) {
+            discord_add_guild_member_role(client, msg->guild_id, msg->author->id, role_id, NULL, NULL);
+        }
+    }
+}
+
+void leveling_on_message(struct discord *client, const struct discord_message *msg) {
+    if (!g_running || !msg->guild_id || !msg->author || msg->author->bot) return;
+
+    uint64_t guild_id = msg->guild_id;
+    uint64_t user_id = msg->author->id;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&g_xp_lock);
+    xp_entry_t *e = get_or_create(guild_id, user_id);
+    if (!e || now - e->last_award < LEVELING_COOLDOWN_SECS) {
+        pthread_mutex_unlock(&g_xp_lock);
+        return;
+    }
+    e->last_award = now;
+    int loaded = e->loaded;
+    pthread_mutex_unlock(&g_xp_lock);
+
+    char guild_id_str[32], user_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, guild_id);
+    snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, user_id);
+
+    /* First message since startup (or since an admin edit): learn the stored total */
+    int64_t stored = 0;
+    if (!loaded) {
+        user_xp_t row;
+        if (db_get_user_xp(&g_bot->database, guild_id_str, user_id_str, &row) == 0) {
+            stored = row.xp;
+        }
+    }
+
+    int64_t award = LEVELING_XP_MIN + rand() % (LEVELING_XP_MAX - LEVELING_XP_MIN + 1);
+
+    pthread_mutex_lock(&g_xp_lock);
+    /* The flush thread may have evicted the entry while we read the database */
+    e = get_or_create(guild_id, user_id);
+    if (!e) {
+        pthread_mutex_unlock(&g_xp_lock);
+        return;
+    }
+    if (!e->loaded) {
+        e->base = stored;
+        e->loaded = 1;
+    }
+    e->last_award = now;
+    int64_t before = e->base + e->delta;
+    e->delta += award;
+    int64_t after = before + award;
+    pthread_mutex_unlock(&g_xp_lock);
+
+    leaderboard_set_xp(guild_id, user_id, after);
+
+    int old_level = calculate_level(before);
+    int new_level = calculate_level(after);
+    if (new_level <= old_level) return;
+
+    char reply[160];
+    snprintf(reply, sizeof(reply), "<@%"PRIu64"> reached **level %d**!", user_id, new_level);
+    struct discord_create_message params = { .content = reply };
+    discord_create_message(client, msg->channel_id, &params, NULL);
+
+    grant_level_roles(client, msg, guild_id_str, old_level, new_level);
+}
+
+int64_t leveling_pending_xp(u64snowflake guild_id, u64snowflake user_id) {
+    int64_t delta = 0;
+    pthread_mutex_lock(&g_xp_lock);
+    if (g_buckets) {
+        xp_entry_t *e = *find_slot(guild_id, user_id);
+        if (e) delta = e->delta;
+    }
+    pthread_mutex_unlock(&g_xp_lock);
+    return delta;
+}
+
+void leveling_forget(u64snowflake guild_id, u64snowflake user_id) {
+    char guild_id_str[32], user_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, guild_id);
+    snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, user_id);
+
+    /*
+     * Deltas already swapped out of memory must be in user_xp before the
+     * total is read back, or the next message would announce a level again.
+     * No flush can queue more while we hold the flush lock.
+     */
+    pthread_mutex_lock(&g_flush_lock);
+    db_flush_writes(&g_bot->database);
+
+    user_xp_t row;
+    int loaded = db_get_user_xp(&g_bot->database, guild_id_str, user_id_str, &row) == 0;
+
+    pthread_mutex_lock(&g_xp_lock);
+    if (g_buckets) {
+        xp_entry_t *e = *find_slot(guild_id, user_id);
+        /* Keep the unflushed delta: it was earned on top of whatever the admin set */
+        if (e) {
+            e->base = loaded ? row.xp : 0;
+            e->loaded = loaded;
+        }
+    }
+    pthread_mutex_unlock(&g_xp_lock);
+    pthread_mutex_unlock(&g_flush_lock);
+}
+
+void leveling_flush(void) {
+    flush_pending();
+}
@@ -6,19 +6,42 @@
 
 #include "modules/mention_response.h"
 #include "database.h"
+#include "keyword_matcher.h"
+#include "guild_perms.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <pthread.h>
 #include <sqlite3.h>
 
-void mention_response_init(himiko_bot_t *bot) {
-    (void)bot;
-}
-
-void mention_response_cleanup(himiko_bot_t *bot) {
-    (void)bot;
+#define GUILD_BUCKETS 256
+
+typedef struct {
+    char *response;
+    char *image_url;            /* NULL for a plain text reply */
+} trigger_reply_t;
+
+/* One guild's triggers, compiled; a reply's index is its priority, newest first */
+typedef struct guild_triggers {
+    struct guild_triggers *next;
+    uint64_t guild_id;
+    int refs;                   /* the cache's own plus one per check in flight */
+    int count;
+    trigger_reply_t *replies;
+    keyword_matcher_t *matcher;
+} guild_triggers_t;
+
+/* Every guild with triggers is loaded at init; a guild not here has none */
+static guild_triggers_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_guilds_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Serializes reloads so the last database read is the one installed */
+static pthread_mutex_t g_reload_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline size_t guild_bucket(uint64_t guild_id) {
+    return (size_t)((guild_id * 0x9e3779b97f4a7c15ULL) >> 56) & (GUILD_BUCKETS - 1);
 }
 
 /* Database helpers */
@@ -30,7 +53,7 @@ static int add_mention_response(himiko_database_t *db, const char *guild_id, con
                       "VALUES (?, ?, ?, ?, ?, ?)";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_MENTION_ADD, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -42,7 +65,7 @@ static int add_mention_response(himiko_database_t *db, const char *guild_id, con
     sqlite3_bind_int64(stmt, 6, (sqlite3_int64)time(NULL));
 
     int result = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_MENTION_ADD, stmt);
     return result;
 }
 
@@ -52,7 +75,7 @@ static int remove_mention_response(himiko_database_t *db, const char *guild_id,
     const char *sql = "DELETE FROM mention_responses WHERE guild_id = ? AND trigger_text = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_MENTION_REMOVE, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -60,7 +83,7 @@ static int remove_mention_response(himiko_database_t *db, const char *guild_id,
     sqlite3_bind_text(stmt, 2, trigger, -1, SQLITE_STATIC);
 
     int result = (sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db->db) > 0) ? 0 : -1;
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_MENTION_REMOVE, stmt);
     return result;
 }
 
@@ -73,7 +96,7 @@ static int get_mention_responses(himiko_database_t *db, const char *guild_id,
                       "FROM mention_responses WHERE guild_id = ? ORDER BY created_at DESC";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_MENTION_GET_ALL, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -99,7 +122,7 @@ static int get_mention_responses(himiko_database_t *db, const char *guild_id,
         (*out_count)++;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_MENTION_GET_ALL, stmt);
     return 0;
 }
 
@@ -112,7 +135,7 @@ static int find_mention_response(himiko_database_t *db, const char *guild_id, co
                       "FROM mention_responses WHERE guild_id = ? AND trigger_text = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_MENTION_FIND, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -132,14 +155,174 @@ static int find_mention_response(himiko_database_t *db, const char *guild_id, co
         const char *created = (const char *)sqlite3_column_text(stmt, 5);
         if (created) strncpy(response->created_by, created, sizeof(response->created_by) - 1);
         response->created_at = sqlite3_column_int64(stmt, 6);
-        sqlite3_finalize(stmt);
+        db_stmt_release(db, DB_STMT_MENTION_FIND, stmt);
         return 0;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_MENTION_FIND, stmt);
     return -1;
 }
 
+static void free_guild_triggers(guild_triggers_t *g) {
+    if (!g) return;
+    for (int i = 0; i < g->count; i++) {
+        free(g->replies[i].response);
+        free(g->replies[i].image_url);
+    }
+    free(g->replies);
+    keyword_matcher_free(g->matcher);
+    free(g);
+}
+
+/* Load and compile a guild's triggers; *out is NULL when it has none */
+static int build_guild_triggers(himiko_database_t *db, uint64_t guild_id, guild_triggers_t **out) {
+    *out = NULL;
+
+    mention_response_t *rows = calloc(MENTION_RESPONSE_MAX_PER_GUILD, sizeof(mention_response_t));
+    if (!rows) return -1;
+
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, guild_id);
+    int count = 0;
+    if (get_mention_responses(db, guild_id_str, rows, MENTION_RESPONSE_MAX_PER_GUILD, &count) != 0) {
+        free(rows);
+        return -1;
+    }
+    if (count == 0) {
+        free(rows);
+        return 0;
+    }
+
+    guild_triggers_t *g = calloc(1, sizeof(guild_triggers_t));
+    if (!g || !(g->replies = calloc((size_t)count, sizeof(trigger_reply_t))) ||
+        !(g->matcher = keyword_matcher_create(KEYWORD_MATCH_SUBSTRING))) {
+        free_guild_triggers(g);
+        free(rows);
+        return -1;
+    }
+    g->guild_id = guild_id;
+
+    for (int i = 0; i < count; i++) {
+        trigger_reply_t *r = &g->replies[i];
+        g->count++;
+        r->response = strdup(rows[i].response);
+        r->image_url = rows[i].image_url[0] ? strdup(rows[i].image_url) : NULL;
+        if (!r->response || (rows[i].image_url[0] && !r->image_url)) {
+            free_guild_triggers(g);
+            free(rows);
+            return -1;
+        }
+        /* Triggers are stored lowercased, which is how the matcher folds text */
+        if (rows[i].trigger_text[0] && keyword_matcher_add(g->matcher, rows[i].trigger_text, (uint64_t)i) != 0) {
+            free_guild_triggers(g);
+            free(rows);
+            return -1;
+        }
+    }
+
+    free(rows);
+    *out = g;
+    return 0;
+}
+
+/* Drop one reference; the last one frees */
+static void release_guild_triggers(guild_triggers_t *g) {
+    if (!g) return;
+    pthread_mutex_lock(&g_guilds_lock);
+    int last = --g->refs == 0;
+    pthread_mutex_unlock(&g_guilds_lock);
+    if (last) free_guild_triggers(g);
+}
+
+static guild_triggers_t *acquire_guild_triggers(uint64_t guild_id) {
+    pthread_mutex_lock(&g_guilds_lock);
+    guild_triggers_t *g = g_guilds[guild_bucket(guild_id)];
+    while (g && g->guild_id != guild_id) g = g->next;
+    if (g) g->refs++;
+    pthread_mutex_unlock(&g_guilds_lock);
+    return g;
+}
+
+/* Swap in a guild's new triggers (NULL for none); checks in flight keep the old set */
+static void install_guild_triggers(uint64_t guild_id, guild_triggers_t *fresh) {
+    size_t bucket = guild_bucket(guild_id);
+
+    pthread_mutex_lock(&g_guilds_lock);
+    guild_triggers_t **link = &g_guilds[bucket];
+    while (*link && (*link)->guild_id != guild_id) link = &(*link)->next;
+    guild_triggers_t *old = *link;
+    if (old) *link = old->next;
+    if (fresh) {
+        fresh->refs = 1;
+        fresh->next = g_guilds[bucket];
+        g_guilds[bucket] = fresh;
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+
+    release_guild_triggers(old);
+}
+
+void mention_response_invalidate(himiko_bot_t *bot, u64snowflake guild_id) {
+    if (!bot) return;
+
+    pthread_mutex_lock(&g_reload_lock);
+    guild_triggers_t *g;
+    if (build_guild_triggers(&bot->database, guild_id, &g) == 0) {
+        install_guild_triggers(guild_id, g);
+    } else {
+        fprintf(stderr, "mention_response: failed to reload triggers for guild %"PRIu64"\n", guild_id);
+    }
+    pthread_mutex_unlock(&g_reload_lock);
+}
+
+void mention_response_init(himiko_bot_t *bot) {
+    if (!bot || !bot->database.db) return;
+
+    /* Collect the guilds first; each reload reads the table again */
+    const char *sql = "SELECT DISTINCT guild_id FROM mention_responses";
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare_read(&bot->database, DB_STMT_MENTION_GET_GUILDS, sql, &stmt) != SQLITE_OK) {
+        return;
+    }
+
+    uint64_t *guilds = NULL;
+    size_t count = 0, cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *gid = (const char *)sqlite3_column_text(stmt, 0);
+        if (!gid) continue;
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 64;
+            uint64_t *grown = realloc(guilds, new_cap * sizeof(uint64_t));
+            if (!grown) break;
+            guilds = grown;
+            cap = new_cap;
+        }
+        guilds[count++] = strtoull(gid, NULL, 10);
+    }
+    db_stmt_release(&bot->database, DB_STMT_MENTION_GET_GUILDS, stmt);
+
+    for (size_t i = 0; i < count; i++) {
+        mention_response_invalidate(bot, guilds[i]);
+    }
+    free(guilds);
+}
+
+void mention_response_cleanup(himiko_bot_t *bot) {
+    (void)bot;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    for (size_t i = 0; i < GUILD_BUCKETS; i++) {
+        guild_triggers_t *g = g_guilds[i];
+        g_guilds[i] = NULL;
+        while (g) {
+            guild_triggers_t *next = g->next;
+            if (--g->refs == 0) free_guild_triggers(g);
+            g = next;
+        }
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+}
+
 /* Convert string to lowercase */
 static void str_to_lower(char *str) {
     for (int i = 0; str[i]; i++) {
@@ -166,14 +349,12 @@ int mention_response_check(struct discord *client, const struct discord_message
     himiko_bot_t *bot = discord_get_data(client);
     if (!bot) return 0;
 
-    /* Check if message mentions the bot */
+    /* Check if message mentions the bot; our ID is unknown until ready */
+    u64snowflake self_id = bot->config.bot_id;
     int mentions_bot = 0;
-    if (msg->mentions && msg->mentions->size > 0) {
-        struct discord_user *self;
-        discord_get_current_user(client, &(struct discord_ret_user){ .sync = self });
-
+    if (self_id && msg->mentions) {
         for (int i = 0; i < msg->mentions->size; i++) {
-            if (msg->mentions->array[i].id == self->id) {
+            if (msg->mentions->array[i].id == self_id) {
                 mentions_bot = 1;
                 break;
             }
@@ -182,58 +363,43 @@ int mention_response_check(struct discord *client, const struct discord_message
 
     if (!mentions_bot) return 0;
 
-    /* Get the message content after the mention */
-    char content_lower[2048];
-    strncpy(content_lower, msg->content, sizeof(content_lower) - 1);
-    content_lower[sizeof(content_lower) - 1] = '\0';
-    str_to_lower(content_lower);
-
-    char guild_id_str[32];
-    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)msg->guild_id);
+    guild_triggers_t *g = acquire_guild_triggers(msg->guild_id);
+    if (!g) return 0;
 
-    /* Get all responses for this guild */
-    mention_response_t responses[50];
-    int count = 0;
-    if (get_mention_responses(&bot->database, guild_id_str, responses, 50, &count) != 0 || count == 0) {
-        return 0;
+    /* Every trigger in one pass; the newest one that matched wins */
+    uint64_t hits[MENTION_RESPONSE_MAX_PER_GUILD];
+    int found = keyword_matcher_scan(g->matcher, msg->content, hits, g->count);
+    int best = -1;
+    for (int i = 0; i < found; i++) {
+        if (best < 0 || (int)hits[i] < best) best = (int)hits[i];
     }
 
-    /* Check each trigger */
-    for (int i = 0; i < count; i++) {
-        char trigger_lower[256];
-        strncpy(trigger_lower, responses[i].trigger_text, sizeof(trigger_lower) - 1);
-        trigger_lower[sizeof(trigger_lower) - 1] = '\0';
-        str_to_lower(trigger_lower);
+    if (best >= 0) {
+        const trigger_reply_t *r = &g->replies[best];
 
-        if (strstr(content_lower, trigger_lower)) {
-            /* Found a match - send response */
+        if (r->image_url) {
             struct discord_embed embed = {0};
-            int use_embed = responses[i].image_url[0] != '\0';
-
-            if (use_embed) {
-                embed.description = responses[i].response;
-                embed.color = 0xFF69B4;
-                embed.image = &(struct discord_embed_image){ .url = responses[i].image_url };
-
-                struct discord_create_message params = {
-                    .embeds = &(struct discord_embeds){
-                        .size = 1,
-                        .array = &embed
-                    }
-                };
-                discord_create_message(client, msg->channel_id, &params, NULL);
-            } else {
-                struct discord_create_message params = {
-                    .content = responses[i].response
-                };
-                discord_create_message(client, msg->channel_id, &params, NULL);
-            }
+            embed.description = r->response;
+            embed.color = 0xFF69B4;
+            embed.image = &(struct discord_embed_image){ .url = r->image_url };
 
-            return 1;
+            struct discord_create_message params = {
+                .embeds = &(struct discord_embeds){
+                    .size = 1,
+                    .array = &embed
+                }
+            };
+            discord_create_message(client, msg->channel_id, &params, NULL);
+        } else {
+            struct discord_create_message params = {
+                .content = r->response
+            };
+            discord_create_message(client, msg->channel_id, &params, NULL);
         }
     }
 
-    return 0;
+    release_guild_triggers(g);
+    return best >= 0;
 }
 
 /* Check if user is admin */
@@ -262,7 +428,7 @@ void cmd_mention(struct discord *client, const struct discord_interaction *inter
 
     const char *subcommand = interaction->data->options->array[0].name;
     char guild_id_str[32];
-    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)interaction->guild_id);
+    snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, interaction->guild_id);
 
     if (strcmp(subcommand, "add") == 0) {
         /* Get options */
@@ -298,13 +464,14 @@ void cmd_mention(struct discord *client, const struct discord_interaction *inter
         str_to_lower(trigger_lower);
 
         char user_id_str[32];
-        snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)interaction->member->user->id);
+        snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, interaction->member->user->id);
 
         if (add_mention_response(&bot->database, guild_id_str, trigger_lower, response,
                                   image_url ? image_url : "", user_id_str) != 0) {
             respond_ephemeral(client, interaction, "Failed to add mention response. It may already exist.");
             return;
         }
+        mention_response_invalidate(bot, interaction->guild_id);
 
         char msg[512];
         char truncated_response[100];
@@ -346,6 +513,7 @@ void cmd_mention(struct discord *client, const struct discord_interaction *inter
             respond_ephemeral(client, interaction, "Failed to remove mention response or it doesn't exist.");
             return;
         }
+        mention_response_invalidate(bot, interaction->guild_id);
 
         char msg[256];
         snprintf(msg, sizeof(msg), "**Mention Response Removed**\nRemoved response for trigger: **%s**", trigger_lower);
@@ -403,8 +571,18 @@ void cmd_mention_prefix(struct discord *client, const struct discord_message *ms
     himiko_bot_t *bot = discord_get_data(client);
     if (!bot) return;
 
+    /* Admin only; gateway members carry roles but no permissions */
+    if (msg->guild_id == 0 || !msg->member ||
+        !guild_perms_has(msg->guild_id, msg->author->id, msg->member->roles, DISCORD_PERM_ADMINISTRATOR)) {
+        struct discord_create_message params = {
+            .content = "You need administrator permission to manage mention responses."
+        };
+        discord_create_message(client, msg->channel_id, &params, NULL);
+        return;
+    }
+
     char guild_id_str[32];
-    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)msg->guild_id);
+    snprintf(guild_id_str, sizeof(guild_id_str), "%"PRIu64, msg->guild_id);
 
     if (!args || !*args) {
         /* Show list */
@@ -486,7 +664,7 @@ void cmd_mention_prefix(struct discord *client, const struct discord_message *ms
         str_to_lower(trigger_lower);
 
         char user_id_str[32];
-        snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)msg->author->id);
+        snprintf(user_id_str, sizeof(user_id_str), "%"PRIu64, msg->author->id);
 
         if (add_mention_response(&bot->database, guild_id_str, trigger_lower, response, "", user_id_str) != 0) {
             struct discord_create_message params = {
@@ -495,6 +673,7 @@ void cmd_mention_prefix(struct discord *client, const struct discord_message *ms
             discord_create_message(client, msg->channel_id, &params, NULL);
             return;
         }
+        mention_response_invalidate(bot, msg->guild_id);
 
         char resp[256];
         snprintf(resp, sizeof(resp), "Added mention response for **%s**", trigger_lower);
@@ -528,6 +707,7 @@ void cmd_mention_prefix(struct discord *client, const struct discord_message *ms
             discord_create_message(client, msg->channel_id, &params, NULL);
             return;
         }
+        mention_response_invalidate(bot, msg->guild_id);
 
         char resp[128];
         snprintf(resp, sizeof(resp), "Removed mention response for **%s**", trigger_lower);
@@ -544,7 +724,7 @@ void cmd_mention_prefix(struct discord *client, const struct discord_message *ms
 
 void register_mention_response_commands(himiko_bot_t *bot) {
     himiko_command_t cmds[] = {
-        { "mention", "Manage custom mention responses", "Configuration", cmd_mention, cmd_mention_prefix, 0, DISCORD_PERM_ADMINISTRATOR },
+        { "mention", "Manage custom mention responses", "Configuration", cmd_mention, cmd_mention_prefix, 0, 0 },
     };
 
     for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
@@ -0,0 +1,508 @@
+/*
+ * Himiko Discord Bot (C Edition) - Regex Filter Module
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "modules/regex_filter.h"
+#include "database.h"
+#include "debug.h"
+#include "regex_engine.h"
+#include "guild_perms.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#define GUILD_BUCKETS 256
+#define MANAGE_PERMS (DISCORD_PERM_MANAGE_GUILD | DISCORD_PERM_ADMINISTRATOR)
+#define MANAGE_DENIED "You need the Manage Server permission to manage regex filters."
+
+/* One guild's filters, compiled; shared by every message check in flight */
+typedef struct guild_filters {
+    struct guild_filters *next;
+    uint64_t guild_id;
+    int refs;                   /* the cache's own plus one per check in flight */
+    int count;
+    regex_filter_t *filters;
+    regex_engine_t *engine;
+} guild_filters_t;
+
+static guild_filters_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_guilds_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Bumped on every invalidation so a build that raced one is not cached */
+static unsigned long g_generation = 0;
+static long g_budget_us = REGEX_FILTER_DEFAULT_BUDGET_MS * 1000L;
+
+static const char *VALID_ACTIONS[] = { "delete", "warn", "kick", "ban" };
+
+static inline size_t guild_bucket(uint64_t guild_id) {
+    return (size_t)((guild_id * 0x9e3779b97f4a7c15ULL) >> 56) & (GUILD_BUCKETS - 1);
+}
+
+/* Database helpers */
+static int add_regex_filter(himiko_database_t *db, const char *guild_id, const char *pattern,
+                            const char *action, const char *reason, const char *created_by, int *id) {
+    if (!db || !db->db || !guild_id || !pattern || !action) return -1;
+
+    const char *sql = "INSERT INTO regex_filters (guild_id, pattern, action, reason, created_by) "
+                      "VALUES (?, ?, ?, ?, ?) RETURNING id";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_REGEX_FILTER_ADD, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, pattern, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, action, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, reason && reason[0] ? reason : NULL, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, created_by, -1, SQLITE_STATIC);
+
+    int result = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (id) *id = sqlite3_column_int(stmt, 0);
+        result = 0;
+    }
+    db_stmt_release(db, DB_STMT_REGEX_FILTER_ADD, stmt);
+    return result;
+}
+
+static int remove_regex_filter(himiko_database_t *db, const char *guild_id, int id) {
+    if (!db || !db->db || !guild_id) return -1;
+
+    const char *sql = "DELETE FROM regex_filters WHERE guild_id = ? AND id = ?";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare(db, DB_STMT_REGEX_FILTER_REMOVE, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, id);
+
+    int result = (sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db->db) > 0) ? 0 : -1;
+    db_stmt_release(db, DB_STMT_REGEX_FILTER_REMOVE, stmt);
+    return result;
+}
+
+/* Oldest first, which is also the order filters are tried in */
+static int get_regex_filters(himiko_database_t *db, const char *guild_id,
+                             regex_filter_t *filters, int max_count, int *out_count) {
+    if (!db || !db->db || !guild_id || !filters || !out_count) return -1;
+    *out_count = 0;
+
+    const char *sql = "SELECT id, guild_id, pattern, action, reason, created_by "
+                      "FROM regex_filters WHERE guild_id = ? ORDER BY id";
+    sqlite3_stmt *stmt;
+
+    if (db_stmt_prepare_read(db, DB_STMT_REGEX_FILTER_GET_ALL, sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
+
+    while (*out_count < max_count && sqlite3_step(stmt) == SQLITE_ROW) {
+        regex_filter_t *f = &filters[*out_count];
+        memset(f, 0, sizeof(regex_filter_t));
+
+        f->id = sqlite3_column_int(stmt, 0);
+        const char *gid = (const char *)sqlite3_column_text(stmt, 1);
+        if (gid) strncpy(f->guild_id, gid, sizeof(f->guild_id) - 1);
+        const char *pattern = (const char *)sqlite3_column_text(stmt, 2);
+        if (pattern) strncpy(f->pattern, pattern, sizeof(f->pattern) - 1);
+        const char *action = (const char *)sqlite3_column_text(stmt, 3);
+        if (action) strncpy(f->action, action, sizeof(f->action) - 1);
+        const char *reason = (const char *)sqlite3_column_text(stmt, 4);
+        if (reason) strncpy(f->reason, reason, sizeof(f->reason) - 1);
+        const char *created = (const char *)sqlite3_column_text(stmt, 5);
+        if (created) strncpy(f->created_by, created, sizeof(f->created_by) - 1);
+
+        (*out_count)++;
+    }
+
+    db_stmt_release(db, DB_STMT_REGEX_FILTER_GET_ALL, stmt);
+    return 0;
+}
+
+static void free_guild_filters(guild_filters_t *g) {
+    if (!g) return;
+    regex_engine_free(g->engine);
+    free(g->filters);
+    free(g);
+}
+
+/* Load and compile a guild's filters; an empty set is cached too */
+static guild_filters_t *build_guild_filters(himiko_database_t *db, uint64_t guild_id) {
+    guild_filters_t *g = calloc(1, sizeof(guild_filters_t));
+    if (!g) return NULL;
+    g->guild_id = guild_id;
+    g->filters = calloc(REGEX_FILTER_MAX_PER_GUILD, sizeof(regex_filter_t));
+    if (!g->filters) {
+        free(g);
+        return NULL;
+    }
+
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+    if (get_regex_filters(db, guild_id_str, g->filters, REGEX_FILTER_MAX_PER_GUILD, &g->count) != 0) {
+        free_guild_filters(g);
+        return NULL;
+    }
+
+    const char *patterns[REGEX_FILTER_MAX_PER_GUILD];
+    for (int i = 0; i < g->count; i++) patterns[i] = g->filters[i].pattern;
+    g->engine = regex_engine_build(patterns, g->count);
+    if (!g->engine) {
+        free_guild_filters(g);
+        return NULL;
+    }
+    return g;
+}
+
+/* Take a reference to the guild's compiled filters, building them on a miss */
+static guild_filters_t *acquire_guild_filters(himiko_database_t *db, uint64_t guild_id) {
+    size_t bucket = guild_bucket(guild_id);
+
+    pthread_mutex_lock(&g_guilds_lock);
+    guild_filters_t *g = g_guilds[bucket];
+    while (g && g->guild_id != guild_id) g = g->next;
+    if (g) {
+        g->refs++;
+        pthread_mutex_unlock(&g_guilds_lock);
+        return g;
+    }
+    unsigned long generation = g_generation;
+    pthread_mutex_unlock(&g_guilds_lock);
+
+    /* Compile outside the lock; other guilds keep matching meanwhile */
+    guild_filters_t *built = build_guild_filters(db, guild_id);
+    if (!built) return NULL;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    g = g_guilds[bucket];
+    while (g && g->guild_id != guild_id) g = g->next;
+    if (g) {
+        /* Another thread got there first */
+        g->refs++;
+        pthread_mutex_unlock(&g_guilds_lock);
+        free_guild_filters(built);
+        return g;
+    }
+
+    if (generation == g_generation) {
+        built->refs = 2;
+        built->next = g_guilds[bucket];
+        g_guilds[bucket] = built;
+    } else {
+        /* Filters changed while loading; use this copy once, do not cache it */
+        built->refs = 1;
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+    return built;
+}
+
+static void release_guild_filters(guild_filters_t *g) {
+    pthread_mutex_lock(&g_guilds_lock);
+    int last = --g->refs == 0;
+    pthread_mutex_unlock(&g_guilds_lock);
+    if (last) free_guild_filters(g);
+}
+
+void regex_filter_invalidate(u64snowflake guild_id) {
+    guild_filters_t *drop = NULL;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    g_generation++;
+    for (guild_filters_t **pp = &g_guilds[guild_bucket(guild_id)]; *pp; pp = &(*pp)->next) {
+        if ((*pp)->guild_id == guild_id) {
+            guild_filters_t *g = *pp;
+            *pp = g->next;
+            if (--g->refs == 0) drop = g;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+
+    free_guild_filters(drop);
+}
+
+void regex_filter_init(himiko_bot_t *bot) {
+    if (bot && bot->config.features.regex_filter_budget_ms > 0) {
+        g_budget_us = bot->config.features.regex_filter_budget_ms * 1000L;
+    }
+}
+
+void regex_filter_cleanup(himiko_bot_t *bot) {
+    (void)bot;
+
+    pthread_mutex_lock(&g_guilds_lock);
+    for (int i = 0; i < GUILD_BUCKETS; i++) {
+        guild_filters_t *g = g_guilds[i];
+        while (g) {
+            guild_filters_t *next = g->next;
+            /* Checks still in flight free it on release */
+            if (--g->refs == 0) free_guild_filters(g);
+            g = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    g_generation++;
+    pthread_mutex_unlock(&g_guilds_lock);
+}
+
+/* Take action on a matched filter */
+static void take_action(struct discord *client, const struct discord_message *msg, const regex_filter_t *filter) {
+    const char *reason = filter->reason[0] ? filter->reason : "Matched a regex filter";
+
+    discord_delete_message(client, msg->channel_id, msg->id, NULL, NULL);
+
+    if (strcmp(filter->action, "kick") == 0) {
+        discord_remove_guild_member(client, msg->guild_id, msg->author->id, NULL, NULL);
+
+    } else if (strcmp(filter->action, "ban") == 0) {
+        struct discord_create_guild_ban params = { .delete_message_days = 1, .reason = (char *)reason };
+        discord_create_guild_ban(client, msg->guild_id, msg->author->id, &params, NULL);
+
+    } else if (strcmp(filter->action, "warn") == 0) {
+        char warning[384];
+        snprintf(warning, sizeof(warning), "<@%lu> your message was removed: %s",
+                 (unsigned long)msg->author->id, reason);
+        struct discord_create_message params = { .content = warning };
+        discord_create_message(client, msg->channel_id, &params, NULL);
+    }
+}
+
+/* Main filter check - returns 1 if a filter matched */
+int regex_filter_check(struct discord *client, const struct discord_message *msg) {
+    if (!client || !msg || !msg->author || !msg->content || !msg->content[0]) return 0;
+
+    /* Ignore bots and DMs */
+    if (msg->author->bot || msg->guild_id == 0) return 0;
+
+    himiko_bot_t *bot = discord_get_data(client);
+    if (!bot) return 0;
+
+    /* Moderators are never acted on */
+    if (msg->member && guild_perms_has(msg->guild_id, msg->author->id, msg->member->roles,
+                                       DISCORD_PERM_MANAGE_MESSAGES | DISCORD_PERM_ADMINISTRATOR)) {
+        return 0;
+    }
+
+    guild_filters_t *g = acquire_guild_filters(&bot->database, msg->guild_id);
+    if (!g) return 0;
+
+    int hit = regex_engine_match(g->engine, msg->content, g_budget_us);
+    if (hit == REGEX_ENGINE_OVER_BUDGET) {
+        DEBUG_LOG("regex filters for guild %lu ran out of time on message %lu",
+                  (unsigned long)msg->guild_id, (unsigned long)msg->id);
+    } else if (hit >= 0) {
+        DEBUG_LOG("regex filter #%d matched message %lu", g->filters[hit].id, (unsigned long)msg->id);
+        take_action(client, msg, &g->filters[hit]);
+    }
+
+    release_guild_filters(g);
+    return hit >= 0;
+}
+
+static int is_valid_action(const char *action) {
+    for (size_t i = 0; i < sizeof(VALID_ACTIONS) / sizeof(VALID_ACTIONS[0]); i++) {
+        if (strcmp(action, VALID_ACTIONS[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Validate and store a filter; writes the reply into response */
+static void add_filter(himiko_bot_t *bot, u64snowflake guild_id, u64snowflake user_id, const char *pattern,
+                       const char *action, const char *reason, char *response, size_t response_size) {
+    if (!is_valid_action(action)) {
+        snprintf(response, response_size, "Unknown action **%s**. Valid: delete, warn, kick, ban", action);
+        return;
+    }
+    if (strlen(pattern) >= sizeof(((regex_filter_t *)0)->pattern)) {
+        snprintf(response, response_size, "Pattern is too long.");
+        return;
+    }
+
+    char err[128];
+    if (regex_engine_check(pattern, err, sizeof(err)) != 0) {
+        snprintf(response, response_size, "Invalid pattern: %s", err);
+        return;
+    }
+
+    char guild_id_str[32], user_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+    snprintf(user_id_str, sizeof(user_id_str), "%lu", (unsigned long)user_id);
+
+    regex_filter_t *existing = calloc(REGEX_FILTER_MAX_PER_GUILD, sizeof(regex_filter_t));
+    int count = 0;
+    if (!existing || get_regex_filters(&bot->database, guild_id_str, existing, REGEX_FILTER_MAX_PER_GUILD, &count) != 0) {
+        free(existing);
+        snprintf(response, response_size, "Failed to read existing filters.");
+        return;
+    }
+    free(existing);
+    if (count >= REGEX_FILTER_MAX_PER_GUILD) {
+        snprintf(response, response_size, "This server already has %d filters.", REGEX_FILTER_MAX_PER_GUILD);
+        return;
+    }
+
+    int id = 0;
+    if (add_regex_filter(&bot->database, guild_id_str, pattern, action, reason, user_id_str, &id) != 0) {
+        snprintf(response, response_size, "Failed to add filter.");
+        return;
+    }
+    regex_filter_invalidate(guild_id);
+    snprintf(response, response_size, "Added filter **#%d** (%s): `%.200s`", id, action, pattern);
+}
+
+static void remove_filter(himiko_bot_t *bot, u64snowflake guild_id, int id, char *response, size_t response_size) {
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+
+    if (id <= 0 || remove_regex_filter(&bot->database, guild_id_str, id) != 0) {
+        snprintf(response, response_size, "No filter **#%d** in this server.", id);
+        return;
+    }
+    regex_filter_invalidate(guild_id);
+    snprintf(response, response_size, "Removed filter **#%d**", id);
+}
+
+static void list_filters(himiko_bot_t *bot, u64snowflake guild_id, char *response, size_t response_size) {
+    char guild_id_str[32];
+    snprintf(guild_id_str, sizeof(guild_id_str), "%lu", (unsigned long)guild_id);
+
+    regex_filter_t *filters = calloc(REGEX_FILTER_MAX_PER_GUILD, sizeof(regex_filter_t));
+    int count = 0;
+    if (!filters || get_regex_filters(&bot->database, guild_id_str, filters, REGEX_FILTER_MAX_PER_GUILD, &count) != 0 ||
+        count == 0) {
+        free(filters);
+        snprintf(response, response_size, "No regex filters configured.");
+        return;
+    }
+
+    size_t len = (size_t)snprintf(response, response_size, "**Regex Filters** (%d total)\n", count);
+    for (int i = 0; i < count && len < response_size; i++) {
+        char line[640];
+        snprintf(line, sizeof(line), "**#%d** %s `%.80s`\n", filters[i].id, filters[i].action, filters[i].pattern);
+        if (len + strlen(line) >= response_size - 20) {
+            snprintf(response + len, response_size - len, "... and %d more", count - i);
+            break;
+        }
+        strcpy(response + len, line);
+        len += strlen(line);
+    }
+    free(filters);
+}
+
+/* Command: regexfilter add/remove/list */
+void cmd_regexfilter(struct discord *client, const struct discord_interaction *interaction) {
+    himiko_bot_t *bot = discord_get_data(client);
+    if (!bot) return;
+
+    if (!interaction->member || !(interaction->member->permissions & MANAGE_PERMS)) {
+        respond_ephemeral(client, interaction, MANAGE_DENIED);
+        return;
+    }
+
+    struct discord_application_command_interaction_data_options *opts = interaction->data->options;
+    char response[2000];
+
+    if (!opts || opts->size == 0 || strcmp(opts->array[0].name, "list") == 0) {
+        list_filters(bot, interaction->guild_id, response, sizeof(response));
+        respond_message(client, interaction, response);
+        return;
+    }
+
+    const char *subcommand = opts->array[0].name;
+    struct discord_application_command_interaction_data_options *sub_opts = opts->array[0].options;
+
+    const char *pattern = NULL;
+    const char *action = NULL;
+    const char *reason = NULL;
+    const char *id = NULL;
+    for (int i = 0; sub_opts && i < sub_opts->size; i++) {
+        if (strcmp(sub_opts->array[i].name, "pattern") == 0) {
+            pattern = sub_opts->array[i].value;
+        } else if (strcmp(sub_opts->array[i].name, "action") == 0) {
+            action = sub_opts->array[i].value;
+        } else if (strcmp(sub_opts->array[i].name, "reason") == 0) {
+            reason = sub_opts->array[i].value;
+        } else if (strcmp(sub_opts->array[i].name, "id") == 0) {
+            id = sub_opts->array[i].value;
+        }
+    }
+
+    if (strcmp(subcommand, "add") == 0) {
+        if (!pattern || !*pattern) {
+            respond_ephemeral(client, interaction, "Usage: /regexfilter add <pattern> [action] [reason]");
+            return;
+        }
+        u64snowflake user_id = interaction->member && interaction->member->user ? interaction->member->user->id : 0;
+        add_filter(bot, interaction->guild_id, user_id, pattern, action ? action : "delete", reason,
+                   response, sizeof(response));
+        respond_message(client, interaction, response);
+
+    } else if (strcmp(subcommand, "remove") == 0) {
+        if (!id) {
+            respond_ephemeral(client, interaction, "Usage: /regexfilter remove <id>");
+            return;
+        }
+        remove_filter(bot, interaction->guild_id, atoi(id), response, sizeof(response));
+        respond_message(client, interaction, response);
+
+    } else {
+        respond_ephemeral(client, interaction, "Unknown subcommand. Valid: add, remove, list");
+    }
+}
+
+/* Prefix command handler */
+void cmd_regexfilter_prefix(struct discord *client, const struct discord_message *msg, const char *args) {
+    himiko_bot_t *bot = discord_get_data(client);
+    if (!bot) return;
+
+    /* Gateway members carry roles but no permissions */
+    if (msg->guild_id == 0 || !msg->member ||
+        !guild_perms_has(msg->guild_id, msg->author->id, msg->member->roles, MANAGE_PERMS)) {
+        struct discord_create_message params = { .content = MANAGE_DENIED };
+        discord_create_message(client, msg->channel_id, &params, NULL);
+        return;
+    }
+
+    char response[2000];
+    char cmd[32] = "", action[32] = "", pattern[600] = "";
+
+    /* The pattern is the rest of the line, spaces included */
+    int parsed = args ? sscanf(args, "%31s %31s %599[^\n]", cmd, action, pattern) : 0;
+
+    if (parsed < 1 || strcmp(cmd, "list") == 0) {
+        list_filters(bot, msg->guild_id, response, sizeof(response));
+
+    } else if (strcmp(cmd, "add") == 0 && parsed == 3) {
+        add_filter(bot, msg->guild_id, msg->author->id, pattern, action, NULL, response, sizeof(response));
+
+    } else if ((strcmp(cmd, "remove") == 0 || strcmp(cmd, "delete") == 0) && parsed >= 2) {
+        remove_filter(bot, msg->guild_id, atoi(action), response, sizeof(response));
+
+    } else {
+        snprintf(response, sizeof(response),
+            "Usage:\n`regexfilter add <delete|warn|kick|ban> <pattern>` - Add a filter\n"
+            "`regexfilter remove <id>` - Remove a filter\n"
+            "`regexfilter` - List all filters\n"
+            "Patterns are POSIX extended regular expressions, matched case-insensitively.");
+    }
+
+    struct discord_create_message params = { .content = response };
+    discord_create_message(client, msg->channel_id, &params, NULL);
+}
+
+void register_regex_filter_commands(himiko_bot_t *bot) {
+    himiko_command_t cmds[] = {
+        { "regexfilter", "Manage regex auto-moderation filters", "Moderation", cmd_regexfilter, cmd_regexfilter_prefix, 0, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+        bot_register_command(bot, &cmds[i]);
+    }
+}
@@ -6,6 +6,7 @@
 
 #include "modules/spam_filter.h"
 #include "database.h"
+#include "message_features.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,14 +20,13 @@ void spam_filter_cleanup(himiko_bot_t *bot) {
     (void)bot;
 }
 
-/* Count mentions in message content */
-static int count_mentions(const struct discord_message *msg) {
+/* Count mentions; repeated pings of one user or role count every time */
+static int count_mentions(const struct discord_message *msg, const message_features_t *f) {
     int count = 0;
 
-    /* Count user mentions from the mentions array */
-    if (msg->mentions) {
-        count += msg->mentions->size;
-    }
+    /* The mentions arrays hold each target once, the content every ping */
+    int users = msg->mentions ? msg->mentions->size : 0;
+    count += f->user_mentions > users ? f->user_mentions : users;
 
     /* Count @everyone and @here */
     if (msg->mention_everyone) {
@@ -34,71 +34,8 @@ static int count_mentions(const struct discord_message *msg) {
     }
 
     /* Count role mentions */
-    if (msg->mention_roles) {
-        count += msg->mention_roles->size;
-    }
-
-    return count;
-}
-
-/* Count URLs in message content */
-static int count_links(const char *content) {
-    if (!content) return 0;
-
-    int count = 0;
-    const char *p = content;
-
-    while ((p = strstr(p, "http")) != NULL) {
-        if (strncmp(p, "http://", 7) == 0 || strncmp(p, "https://", 8) == 0) {
-            count++;
-        }
-        p++;
-    }
-
-    return count;
-}
-
-/* Count emojis in message content */
-static int count_emojis(const char *content) {
-    if (!content) return 0;
-
-    int count = 0;
-    const char *p = content;
-
-    /* Count custom Discord emojis <:name:id> and <a:name:id> */
-    while ((p = strchr(p, '<')) != NULL) {
-        if ((p[1] == ':' || (p[1] == 'a' && p[2] == ':')) && strchr(p, '>')) {
-            count++;
-        }
-        p++;
-    }
-
-    /* Count Unicode emojis (basic detection) */
-    /* This is a simplified check for common emoji codepoints */
-    p = content;
-    while (*p) {
-        unsigned char c = (unsigned char)*p;
-        /* Check for emoji-like UTF-8 sequences (F0 9F range) */
-        if (c == 0xF0 && p[1]) {
-            unsigned char c2 = (unsigned char)p[1];
-            if (c2 == 0x9F) {
-                count++;
-                p += 4; /* Skip 4-byte UTF-8 sequence */
-                continue;
-            }
-        }
-        /* Check for other emoji ranges */
-        if (c >= 0xE2 && c <= 0xEF && p[1] && p[2]) {
-            /* Potentially an emoji in 3-byte range */
-            unsigned char c2 = (unsigned char)p[1];
-            if (c2 >= 0x80 && c2 <= 0xBF) {
-                /* Simple heuristic - count sequences that look like symbols */
-                p += 3;
-                continue;
-            }
-        }
-        p++;
-    }
+    int roles = msg->mention_roles ? msg->mention_roles->size : 0;
+    count += f->role_mentions > roles ? f->role_mentions : roles;
 
     return count;
 }
@@ -148,9 +85,11 @@ int spam_filter_check(struct discord *client, const struct discord_message *msg)
         return 0;
     }
 
+    const message_features_t *f = message_features_get(msg->id, msg->content);
+
     /* Check mentions */
     if (cfg.max_mentions > 0) {
-        int mentions = count_mentions(msg);
+        int mentions = count_mentions(msg, f);
         if (mentions > cfg.max_mentions) {
             take_action(client, msg, &cfg, "Too many mentions");
             return 1;
@@ -159,7 +98,7 @@ int spam_filter_check(struct discord *client, const struct discord_message *msg)
 
     /* Check links */
     if (cfg.max_links > 0) {
-        int links = count_links(msg->content);
+        int links = f->urls;
         if (links > cfg.max_links) {
             take_action(client, msg, &cfg, "Too many links");
             return 1;
@@ -168,7 +107,7 @@ int spam_filter_check(struct discord *client, const struct discord_message *msg)
 
     /* Check emojis */
     if (cfg.max_emojis > 0) {
-        int emojis = count_emojis(msg->content);
+        int emojis = f->custom_emojis + f->unicode_emojis;
         if (emojis > cfg.max_emojis) {
             take_action(client, msg, &cfg, "Too many emojis");
             return 1;
@@ -28,7 +28,7 @@ static int get_ticket_config(himiko_database_t *db, const char *guild_id, ticket
     const char *sql = "SELECT guild_id, channel_id, enabled, created_at FROM ticket_config WHERE guild_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare_read(db, DB_STMT_TICKET_GET_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -40,11 +40,11 @@ static int get_ticket_config(himiko_database_t *db, const char *guild_id, ticket
         if (channel) strncpy(config->channel_id, channel, sizeof(config->channel_id) - 1);
         config->enabled = sqlite3_column_int(stmt, 2);
         config->created_at = sqlite3_column_int64(stmt, 3);
-        sqlite3_finalize(stmt);
+        db_stmt_release(db, DB_STMT_TICKET_GET_CONFIG, stmt);
         return 0;
     }
 
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_TICKET_GET_CONFIG, stmt);
     return -1;
 }
 
@@ -56,7 +56,7 @@ static int set_ticket_config(himiko_database_t *db, const char *guild_id, const
                       "ON CONFLICT(guild_id) DO UPDATE SET channel_id = excluded.channel_id, enabled = excluded.enabled";
 
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_TICKET_SET_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
@@ -66,7 +66,7 @@ static int set_ticket_config(himiko_database_t *db, const char *guild_id, const
     sqlite3_bind_int64(stmt, 4, (sqlite3_int64)time(NULL));
 
     int result = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_TICKET_SET_CONFIG, stmt);
     return result;
 }
 
@@ -76,13 +76,13 @@ static int delete_ticket_config(himiko_database_t *db, const char *guild_id) {
     const char *sql = "DELETE FROM ticket_config WHERE guild_id = ?";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    if (db_stmt_prepare(db, DB_STMT_TICKET_DELETE_CONFIG, sql, &stmt) != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_text(stmt, 1, guild_id, -1, SQLITE_STATIC);
     int result = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
-    sqlite3_finalize(stmt);
+    db_stmt_release(db, DB_STMT_TICKET_DELETE_CONFIG, stmt);
     return result;
 }
 
@@ -0,0 +1,499 @@
+/*
+ * Himiko Discord Bot (C Edition) - Track Resolution Cache
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "music_cache.h"
+#include "db_writer.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define BUCKETS 2048
+
+typedef struct entry {
+    struct entry *chain;        /* hash bucket */
+    struct entry *prev;         /* LRU list, most recent first */
+    struct entry *next;
+    uint64_t hash;
+    char key[MUSIC_CACHE_KEY_LEN];
+    char webpage_key[MUSIC_CACHE_KEY_LEN];
+    bool has_meta;
+    music_cache_meta_t meta;
+    char *stream_url;
+    time_t stream_expires;
+} entry_t;
+
+static entry_t *g_buckets[BUCKETS];
+static entry_t *g_lru_head;
+static entry_t *g_lru_tail;
+static int g_count;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static himiko_database_t *g_db;
+
+static atomic_ullong g_meta_memory_hits, g_meta_disk_hits, g_meta_misses;
+static atomic_ullong g_stream_memory_hits, g_stream_disk_hits, g_stream_misses;
+
+static const char *get_sql =
+    "SELECT has_meta, title, duration, thumbnail, webpage_url, webpage_key, stream_url, stream_expires "
+    "FROM music_resolve_cache WHERE cache_key = ?";
+
+static const char *put_meta_sql =
+    "INSERT INTO music_resolve_cache (cache_key, has_meta, title, duration, thumbnail, webpage_url, webpage_key, updated_at) "
+    "VALUES (?, 1, ?, ?, ?, ?, ?, strftime('%s','now')) "
+    "ON CONFLICT(cache_key) DO UPDATE SET has_meta = 1, title = excluded.title, duration = excluded.duration, "
+    "thumbnail = excluded.thumbnail, webpage_url = excluded.webpage_url, webpage_key = excluded.webpage_key, "
+    "updated_at = excluded.updated_at";
+
+static const char *put_stream_sql =
+    "INSERT INTO music_resolve_cache (cache_key, stream_url, stream_expires, updated_at) "
+    "VALUES (?, ?, ?, strftime('%s','now')) "
+    "ON CONFLICT(cache_key) DO UPDATE SET stream_url = excluded.stream_url, "
+    "stream_expires = excluded.stream_expires, updated_at = excluded.updated_at";
+
+static uint64_t hash_key(const char *key) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void copy_str(char *dst, size_t len, const char *src) {
+    if (!src) src = "";
+    snprintf(dst, len, "%s", src);
+}
+
+/* Normalization */
+
+static bool is_video_id_char(char c) {
+    return isalnum((unsigned char)c) || c == '-' || c == '_';
+}
+
+/* Copy a YouTube video id starting at p; 0 if there is none */
+static int youtube_id(const char *p, char *key, size_t len) {
+    size_t n = 0;
+    while (is_video_id_char(p[n])) n++;
+    if (n == 0 || n > 64) return 0;
+    snprintf(key, len, "youtube:%.*s", (int)n, p);
+    return 1;
+}
+
+static int normalize_youtube(const char *host, size_t host_len, const char *rest, char *key, size_t len) {
+    if (host_len == 8 && strncmp(host, "youtu.be", 8) == 0) {
+        return *rest == '/' && youtube_id(rest + 1, key, len);
+    }
+
+    /* youtube.com, www., m. and music. alike */
+    if (host_len < 11 || strncmp(host + host_len - 11, "youtube.com", 11) != 0) return 0;
+    if (host_len > 11 && host[host_len - 12] != '.') return 0;
+
+    static const char *paths[] = { "/shorts/", "/embed/", "/live/", "/v/" };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        size_t n = strlen(paths[i]);
+        if (strncmp(rest, paths[i], n) == 0) return youtube_id(rest + n, key, len);
+    }
+
+    const char *query = strchr(rest, '?');
+    while (query) {
+        query++;
+        if (strncmp(query, "v=", 2) == 0) return youtube_id(query + 2, key, len);
+        query = strchr(query, '&');
+    }
+    return 0;
+}
+
+void music_cache_normalize(const char *query, char *key, size_t len) {
+    if (!key || len == 0) return;
+    key[0] = '\0';
+    if (!query) return;
+
+    while (isspace((unsigned char)*query)) query++;
+    size_t qlen = strlen(query);
+    while (qlen > 0 && isspace((unsigned char)query[qlen - 1])) qlen--;
+    if (qlen == 0) return;
+
+    const char *host = NULL;
+    if (qlen > 7 && strncasecmp(query, "http://", 7) == 0) host = query + 7;
+    if (qlen > 8 && strncasecmp(query, "https://", 8) == 0) host = query + 8;
+
+    if (host) {
+        char url[MUSIC_CACHE_KEY_LEN];
+        size_t ulen = qlen - (size_t)(host - query);
+        if (ulen >= sizeof(url)) ulen = sizeof(url) - 1;
+        memcpy(url, host, ulen);
+        url[ulen] = '\0';
+
+        /* Drop the fragment and a trailing slash */
+        char *hash = strchr(url, '#');
+        if (hash) *hash = '\0';
+        ulen = strlen(url);
+        if (ulen > 0 && url[ulen - 1] == '/') url[--ulen] = '\0';
+
+        size_t host_len = strcspn(url, "/?:");
+        for (size_t i = 0; i < host_len; i++) url[i] = (char)tolower((unsigned char)url[i]);
+
+        char *h = url;
+        if (host_len > 4 && strncmp(h, "www.", 4) == 0) {
+            h += 4;
+            host_len -= 4;
+        }
+
+        if (normalize_youtube(h, host_len, h + host_len, key, len)) return;
+        snprintf(key, len, "url:%s", h);
+        return;
+    }
+
+    /* Search query */
+    if (qlen > 9 && strncasecmp(query, "ytsearch:", 9) == 0) {
+        query += 9;
+        qlen -= 9;
+    }
+
+    size_t n = (size_t)snprintf(key, len, "search:");
+    bool space = false;
+    for (size_t i = 0; i < qlen && n + 1 < len; i++) {
+        unsigned char c = (unsigned char)query[i];
+        if (isspace(c)) {
+            space = true;
+            continue;
+        }
+        if (space && n > 7 && n + 2 < len) key[n++] = ' ';
+        space = false;
+        key[n++] = (char)tolower(c);
+    }
+    key[n] = '\0';
+}
+
+time_t music_cache_stream_expiry(const char *url, time_t now) {
+    if (!url) return 0;
+
+    /* YouTube signs expire=, CloudFront (SoundCloud) Expires= */
+    for (const char *p = strpbrk(url, "?&"); p; p = strpbrk(p + 1, "?&")) {
+        const char *name = p + 1;
+        size_t n = 0;
+        if (strncasecmp(name, "expire=", 7) == 0) n = 7;
+        else if (strncasecmp(name, "expires=", 8) == 0) n = 8;
+        if (!n || !isdigit((unsigned char)name[n])) continue;
+
+        long long expires = strtoll(name + n, NULL, 10);
+        if (expires > 0) return (time_t)expires;
+    }
+
+    return now + MUSIC_CACHE_STREAM_TTL;
+}
+
+/* In-memory level; call with g_lock held */
+
+static entry_t *find_entry(const char *key, uint64_t hash) {
+    for (entry_t *e = g_buckets[hash & (BUCKETS - 1)]; e; e = e->chain) {
+        if (e->hash == hash && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+static void lru_unlink(entry_t *e) {
+    if (e->prev) e->prev->next = e->next;
+    else g_lru_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else g_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(entry_t *e) {
+    e->next = g_lru_head;
+    if (g_lru_head) g_lru_head->prev = e;
+    g_lru_head = e;
+    if (!g_lru_tail) g_lru_tail = e;
+}
+
+static void touch(entry_t *e) {
+    if (g_lru_head == e) return;
+    lru_unlink(e);
+    lru_push(e);
+}
+
+static void remove_entry(entry_t *e) {
+    entry_t **link = &g_buckets[e->hash & (BUCKETS - 1)];
+    while (*link && *link != e) link = &(*link)->chain;
+    if (*link) *link = e->chain;
+    lru_unlink(e);
+    free(e->stream_url);
+    free(e);
+    g_count--;
+}
+
+/* Find or add an entry for key, evicting the least recently used when full */
+static entry_t *obtain_entry(const char *key) {
+    uint64_t hash = hash_key(key);
+    entry_t *e = find_entry(key, hash);
+    if (e) {
+        touch(e);
+        return e;
+    }
+
+    if (g_count >= MUSIC_CACHE_MEM_ENTRIES && g_lru_tail) remove_entry(g_lru_tail);
+
+    if (!(e = calloc(1, sizeof(entry_t)))) return NULL;
+    e->hash = hash;
+    copy_str(e->key, sizeof(e->key), key);
+    e->chain = g_buckets[hash & (BUCKETS - 1)];
+    g_buckets[hash & (BUCKETS - 1)] = e;
+    lru_push(e);
+    g_count++;
+    return e;
+}
+
+static bool stream_usable(const entry_t *e, time_t now) {
+    return e->stream_url && e->stream_expires - MUSIC_CACHE_EXPIRY_MARGIN > now;
+}
+
+/* Persistent level */
+
+/* Load key's row into memory. 1 if there was one, 0 if not. */
+static int load_row(const char *key) {
+    if (!g_db || !g_db->db) return 0;
+
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare_read(g_db, DB_STMT_MUSIC_CACHE_GET, get_sql, &stmt) != SQLITE_OK) return 0;
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+
+    int found = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        found = 1;
+        pthread_mutex_lock(&g_lock);
+        entry_t *e = obtain_entry(key);
+        if (e) {
+            if (sqlite3_column_int(stmt, 0) && !e->has_meta) {
+                e->has_meta = true;
+                copy_str(e->meta.title, sizeof(e->meta.title), (const char *)sqlite3_column_text(stmt, 1));
+                e->meta.duration = sqlite3_column_int(stmt, 2);
+                copy_str(e->meta.thumbnail, sizeof(e->meta.thumbnail), (const char *)sqlite3_column_text(stmt, 3));
+                copy_str(e->meta.webpage_url, sizeof(e->meta.webpage_url), (const char *)sqlite3_column_text(stmt, 4));
+                copy_str(e->webpage_key, sizeof(e->webpage_key), (const char *)sqlite3_column_text(stmt, 5));
+            }
+            const char *stream_url = (const char *)sqlite3_column_text(stmt, 6);
+            if (stream_url && !e->stream_url && (e->stream_url = strdup(stream_url))) {
+                e->stream_expires = (time_t)sqlite3_column_int64(stmt, 7);
+            }
+        }
+        pthread_mutex_unlock(&g_lock);
+    }
+    db_stmt_release(g_db, DB_STMT_MUSIC_CACHE_GET, stmt);
+    return found;
+}
+
+/* Look key up in memory, then on disk. 1 on a memory hit, 2 on a disk hit. */
+static int lookup(const char *key, bool want_meta, music_cache_meta_t *meta, char *url, size_t len) {
+    time_t now = time(NULL);
+
+    for (int level = 1; level <= 2; level++) {
+        if (level == 2 && !load_row(key)) break;
+
+        pthread_mutex_lock(&g_lock);
+        entry_t *e = find_entry(key, hash_key(key));
+        int hit = 0;
+        if (e && want_meta && e->has_meta) {
+            *meta = e->meta;
+            hit = level;
+        } else if (e && !want_meta && stream_usable(e, now)) {
+            copy_str(url, len, e->stream_url);
+            hit = level;
+        }
+        if (hit) touch(e);
+        pthread_mutex_unlock(&g_lock);
+        if (hit) return hit;
+    }
+    return 0;
+}
+
+int music_cache_init(himiko_database_t *db) {
+    g_db = db;
+    if (!db || !db->db) return -1;
+
+    /* Expired stream URLs are dead weight; rows with nothing else go entirely */
+    sqlite3_stmt *stmt;
+    const char *prune = "DELETE FROM music_resolve_cache WHERE has_meta = 0 AND stream_expires <= ?";
+    if (db_stmt_prepare(db, DB_STMT_MUSIC_CACHE_PRUNE, prune, &stmt) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)time(NULL));
+        sqlite3_step(stmt);
+        db_stmt_release(db, DB_STMT_MUSIC_CACHE_PRUNE, stmt);
+    }
+
+    const char *prune_streams =
+        "UPDATE music_resolve_cache SET stream_url = NULL, stream_expires = 0 "
+        "WHERE stream_url IS NOT NULL AND stream_expires <= ?";
+    if (db_stmt_prepare(db, DB_STMT_MUSIC_CACHE_PRUNE_STREAMS, prune_streams, &stmt) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)time(NULL));
+        sqlite3_step(stmt);
+        db_stmt_release(db, DB_STMT_MUSIC_CACHE_PRUNE_STREAMS, stmt);
+    }
+
+    DEBUG_LOG("Track resolution cache initialized");
+    return 0;
+}
+
+void music_cache_cleanup(void) {
+    pthread_mutex_lock(&g_lock);
+    while (g_lru_head) remove_entry(g_lru_head);
+    memset(g_buckets, 0, sizeof(g_buckets));
+    g_db = NULL;
+    pthread_mutex_unlock(&g_lock);
+}
+
+int music_cache_get_meta(const char *key, music_cache_meta_t *meta) {
+    if (!key || !*key || !meta) return 0;
+
+    int hit = lookup(key, true, meta, NULL, 0);
+    if (hit == 1) atomic_fetch_add_explicit(&g_meta_memory_hits, 1, memory_order_relaxed);
+    else if (hit == 2) atomic_fetch_add_explicit(&g_meta_disk_hits, 1, memory_order_relaxed);
+    else atomic_fetch_add_explicit(&g_meta_misses, 1, memory_order_relaxed);
+    return hit ? 1 : 0;
+}
+
+int music_cache_get_stream(const char *key, char *url, size_t len) {
+    if (!key || !*key || !url || len == 0) return 0;
+
+    int hit = lookup(key, false, NULL, url, len);
+    if (hit == 1) atomic_fetch_add_explicit(&g_stream_memory_hits, 1, memory_order_relaxed);
+    else if (hit == 2) atomic_fetch_add_explicit(&g_stream_disk_hits, 1, memory_order_relaxed);
+    else atomic_fetch_add_explicit(&g_stream_misses, 1, memory_order_relaxed);
+    return hit ? 1 : 0;
+}
+
+void music_cache_put_meta(const char *key, const music_cache_meta_t *meta) {
+    if (!key || !*key || !meta) return;
+
+    char webpage_key[MUSIC_CACHE_KEY_LEN];
+    music_cache_normalize(meta->webpage_url, webpage_key, sizeof(webpage_key));
+
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = obtain_entry(key);
+    if (e) {
+        e->has_meta = true;
+        e->meta = *meta;
+        copy_str(e->webpage_key, sizeof(e->webpage_key), webpage_key);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    if (!g_db || !g_db->db) return;
+    if (g_db->writer) {
+        db_writer_enqueue(g_db->writer, DB_STMT_MUSIC_CACHE_PUT_META, put_meta_sql, "ttittt",
+                          key, meta->title, (int64_t)meta->duration, meta->thumbnail, meta->webpage_url, webpage_key);
+        return;
+    }
+
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare(g_db, DB_STMT_MUSIC_CACHE_PUT_META, put_meta_sql, &stmt) != SQLITE_OK) return;
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, meta->title, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, meta->duration);
+    sqlite3_bind_text(stmt, 4, meta->thumbnail, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, meta->webpage_url, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, webpage_key, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    db_stmt_release(g_db, DB_STMT_MUSIC_CACHE_PUT_META, stmt);
+}
+
+void music_cache_put_stream(const char *key, const char *url) {
+    if (!key || !*key || !url || !*url) return;
+
+    time_t now = time(NULL);
+    time_t expires = music_cache_stream_expiry(url, now);
+    if (expires - MUSIC_CACHE_EXPIRY_MARGIN <= now) return;   /* would never be handed out */
+
+    char *copy = strdup(url);
+    if (!copy) return;
+
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = obtain_entry(key);
+    if (e) {
+        free(e->stream_url);
+        e->stream_url = copy;
+        e->stream_expires = expires;
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&g_lock);
+    free(copy);
+
+    if (!g_db || !g_db->db) return;
+    if (g_db->writer) {
+        db_writer_enqueue(g_db->writer, DB_STMT_MUSIC_CACHE_PUT_STREAM, put_stream_sql, "tti",
+                          key, url, (int64_t)expires);
+        return;
+    }
+
+    sqlite3_stmt *stmt;
+    if (db_stmt_prepare(g_db, DB_STMT_MUSIC_CACHE_PUT_STREAM, put_stream_sql, &stmt) != SQLITE_OK) return;
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, url, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64)expires);
+    sqlite3_step(stmt);
+    db_stmt_release(g_db, DB_STMT_MUSIC_CACHE_PUT_STREAM, stmt);
+}
+
+int music_cache_purge(const char *key) {
+    int removed = 0;
+
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = g_lru_head;
+    while (e) {
+        entry_t *next = e->next;
+        if (!key || strcmp(e->key, key) == 0 || strcmp(e->webpage_key, key) == 0) {
+            remove_entry(e);
+            removed++;
+        }
+        e = next;
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    if (!g_db || !g_db->db) return removed;
+
+    /* Queued writes would bring purged rows back */
+    if (g_db->writer) db_writer_flush(g_db->writer);
+
+    sqlite3_stmt *stmt;
+    int rc, rows;
+    if (key) {
+        const char *sql = "DELETE FROM music_resolve_cache WHERE cache_key = ? OR webpage_key = ?";
+        if (db_stmt_prepare(g_db, DB_STMT_MUSIC_CACHE_PURGE, sql, &stmt) != SQLITE_OK) return -1;
+        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, key, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt);
+        rows = sqlite3_changes(sqlite3_db_handle(stmt));
+        db_stmt_release(g_db, DB_STMT_MUSIC_CACHE_PURGE, stmt);
+    } else {
+        const char *sql = "DELETE FROM music_resolve_cache";
+        if (db_stmt_prepare(g_db, DB_STMT_MUSIC_CACHE_PURGE_ALL, sql, &stmt) != SQLITE_OK) return -1;
+        rc = sqlite3_step(stmt);
+        rows = sqlite3_changes(sqlite3_db_handle(stmt));
+        db_stmt_release(g_db, DB_STMT_MUSIC_CACHE_PURGE_ALL, stmt);
+    }
+    if (rc != SQLITE_DONE) return -1;
+
+    /* Every memory entry has a row unless its write failed */
+    return rows > removed ? rows : removed;
+}
+
+void music_cache_get_stats(music_cache_stats_t *stats) {
+    if (!stats) return;
+
+    stats->meta_memory_hits = atomic_load_explicit(&g_meta_memory_hits, memory_order_relaxed);
+    stats->meta_disk_hits = atomic_load_explicit(&g_meta_disk_hits, memory_order_relaxed);
+    stats->meta_misses = atomic_load_explicit(&g_meta_misses, memory_order_relaxed);
+    stats->stream_memory_hits = atomic_load_explicit(&g_stream_memory_hits, memory_order_relaxed);
+    stats->stream_disk_hits = atomic_load_explicit(&g_stream_disk_hits, memory_order_relaxed);
+    stats->stream_misses = atomic_load_explicit(&g_stream_misses, memory_order_relaxed);
+
+    pthread_mutex_lock(&g_lock);
+    stats->entries = g_count;
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,238 @@
+/*
+ * Himiko Discord Bot (C Edition) - Pressure Table
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "pressure_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <pthread.h>
+
+/* Keep probe chains short */
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+/* Aligned so neighbouring stripe locks do not share a cache line */
+typedef struct {
+    alignas(64) pthread_mutex_t lock;
+    user_pressure_t *slots;
+    size_t mask;
+    size_t count;
+    size_t max_slots;
+    size_t max_users;
+    size_t clock_hand;
+    unsigned long long evictions;
+} stripe_t;
+
+struct pressure_table {
+    stripe_t *stripes;
+    uint32_t stripe_mask;
+};
+
+static inline uint64_t pair_hash(uint64_t guild_id, uint64_t user_id) {
+    uint64_t h = guild_id * 0x9e3779b97f4a7c15ULL ^ user_id;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* High bits pick the stripe, low bits the slot */
+static inline stripe_t *stripe_for(pressure_table_t *t, uint64_t h) {
+    return &t->stripes[(h >> 40) & t->stripe_mask];
+}
+
+/* Caller holds the lock. Returns the entry's slot or the empty slot that ends its probe. */
+static size_t find_slot(stripe_t *s, uint64_t h, uint64_t guild_id, uint64_t user_id) {
+    size_t i = (size_t)h & s->mask;
+    for (;;) {
+        user_pressure_t *u = &s->slots[i];
+        if (!u->user_id || (u->user_id == user_id && u->guild_id == guild_id)) return i;
+        i = (i + 1) & s->mask;
+    }
+}
+
+/* Backward-shift delete keeps probe chains intact without tombstones */
+static void delete_slot(stripe_t *s, size_t i) {
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & s->mask;
+        if (!s->slots[j].user_id) break;
+        size_t home = (size_t)pair_hash(s->slots[j].guild_id, s->slots[j].user_id) & s->mask;
+        /* Entry at j may move to i only if its home is not in (i, j] */
+        int stays = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            s->slots[i] = s->slots[j];
+            i = j;
+        }
+    }
+    memset(&s->slots[i], 0, sizeof(s->slots[i]));
+    s->count--;
+}
+
+/* CLOCK: sweep from the hand, giving referenced entries a second chance */
+static void evict_one(stripe_t *s) {
+    for (;;) {
+        size_t i = s->clock_hand;
+        s->clock_hand = (i + 1) & s->mask;
+
+        user_pressure_t *u = &s->slots[i];
+        if (!u->user_id) continue;
+        if (u->referenced) {
+            u->referenced = 0;
+            continue;
+        }
+        delete_slot(s, i);
+        s->evictions++;
+        return;
+    }
+}
+
+static int grow_stripe(stripe_t *s) {
+    size_t size = (s->mask + 1) * 2;
+    user_pressure_t *slots = calloc(size, sizeof(user_pressure_t));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i <= s->mask; i++) {
+        user_pressure_t *u = &s->slots[i];
+        if (!u->user_id) continue;
+        size_t j = (size_t)pair_hash(u->guild_id, u->user_id) & (size - 1);
+        while (slots[j].user_id) j = (j + 1) & (size - 1);
+        slots[j] = *u;
+    }
+    free(s->slots);
+    s->slots = slots;
+    s->mask = size - 1;
+    s->clock_hand = 0;
+    return 0;
+}
+
+/* Caller holds the lock */
+static user_pressure_t *get_or_create(stripe_t *s, uint64_t h, uint64_t guild_id, uint64_t user_id) {
+    size_t i = find_slot(s, h, guild_id, user_id);
+    user_pressure_t *user = &s->slots[i];
+    if (user->user_id) {
+        user->referenced = 1;
+        return user;
+    }
+
+    /* Grow while the memory limit allows, evict once it does not */
+    size_t capacity = s->mask + 1;
+    if (s->count >= s->max_users) {
+        evict_one(s);
+        i = find_slot(s, h, guild_id, user_id);
+    } else if ((s->count + 1) * MAX_LOAD_DEN > capacity * MAX_LOAD_NUM) {
+        if (capacity >= s->max_slots || grow_stripe(s) != 0) evict_one(s);
+        i = find_slot(s, h, guild_id, user_id);
+    }
+
+    user = &s->slots[i];
+    memset(user, 0, sizeof(*user));
+    user->guild_id = guild_id;
+    user->user_id = user_id;
+    user->referenced = 1;
+    s->count++;
+    return user;
+}
+
+pressure_table_t *pressure_table_create(int stripes, size_t max_users, size_t max_bytes) {
+    uint32_t n = 1;
+    while ((int)n < stripes && n < 4096) n *= 2;
+
+    pressure_table_t *t = calloc(1, sizeof(pressure_table_t));
+    if (!t) return NULL;
+    t->stripes = aligned_alloc(alignof(stripe_t), n * sizeof(stripe_t));
+    if (!t->stripes) {
+        free(t);
+        return NULL;
+    }
+    memset(t->stripes, 0, n * sizeof(stripe_t));
+    t->stripe_mask = n - 1;
+
+    /* Largest power-of-two stripe that fits its share of the memory limit */
+    size_t stripe_bytes = max_bytes / n;
+    size_t max_slots = PRESSURE_TABLE_INITIAL_SLOTS;
+    while (max_slots * 2 * sizeof(user_pressure_t) <= stripe_bytes) max_slots *= 2;
+
+    size_t stripe_users = (max_users + n - 1) / n;
+    if (stripe_users > max_slots * MAX_LOAD_NUM / MAX_LOAD_DEN) {
+        stripe_users = max_slots * MAX_LOAD_NUM / MAX_LOAD_DEN;
+    }
+    if (stripe_users == 0) stripe_users = 1;
+
+    for (uint32_t i = 0; i < n; i++) {
+        stripe_t *s = &t->stripes[i];
+        s->slots = calloc(PRESSURE_TABLE_INITIAL_SLOTS, sizeof(user_pressure_t));
+        if (!s->slots) {
+            for (uint32_t j = 0; j < i; j++) {
+                pthread_mutex_destroy(&t->stripes[j].lock);
+                free(t->stripes[j].slots);
+            }
+            free(t->stripes);
+            free(t);
+            return NULL;
+        }
+        s->mask = PRESSURE_TABLE_INITIAL_SLOTS - 1;
+        s->max_slots = max_slots;
+        s->max_users = stripe_users;
+        pthread_mutex_init(&s->lock, NULL);
+    }
+    return t;
+}
+
+void pressure_table_destroy(pressure_table_t *t) {
+    if (!t) return;
+    for (uint32_t i = 0; i <= t->stripe_mask; i++) {
+        pthread_mutex_destroy(&t->stripes[i].lock);
+        free(t->stripes[i].slots);
+    }
+    free(t->stripes);
+    free(t);
+}
+
+double pressure_table_update(pressure_table_t *t, uint64_t guild_id, uint64_t user_id,
+                             pressure_update_fn fn, void *ctx) {
+    uint64_t h = pair_hash(guild_id, user_id);
+    stripe_t *s = stripe_for(t, h);
+
+    pthread_mutex_lock(&s->lock);
+    double result = fn(get_or_create(s, h, guild_id, user_id), ctx);
+    pthread_mutex_unlock(&s->lock);
+    return result;
+}
+
+void pressure_table_reset(pressure_table_t *t, uint64_t guild_id, uint64_t user_id) {
+    uint64_t h = pair_hash(guild_id, user_id);
+    stripe_t *s = stripe_for(t, h);
+
+    pthread_mutex_lock(&s->lock);
+    user_pressure_t *user = &s->slots[find_slot(s, h, guild_id, user_id)];
+    if (user->user_id) {
+        user->pressure = 0;
+        memset(user->recent, 0, sizeof(user->recent));
+        user->recent_next = 0;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+size_t pressure_table_count(pressure_table_t *t) {
+    size_t count = 0;
+    for (uint32_t i = 0; i <= t->stripe_mask; i++) {
+        pthread_mutex_lock(&t->stripes[i].lock);
+        count += t->stripes[i].count;
+        pthread_mutex_unlock(&t->stripes[i].lock);
+    }
+    return count;
+}
+
+unsigned long long pressure_table_evictions(pressure_table_t *t) {
+    unsigned long long evictions = 0;
+    for (uint32_t i = 0; i <= t->stripe_mask; i++) {
+        pthread_mutex_lock(&t->stripes[i].lock);
+        evictions += t->stripes[i].evictions;
+        pthread_mutex_unlock(&t->stripes[i].lock);
+    }
+    return evictions;
+}
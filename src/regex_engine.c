@@ -0,0 +1,371 @@
+/*
+ * Himiko Discord Bot (C Edition) - Regex Engine
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "regex_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <regex.h>
+#include <time.h>
+
+#define REGEX_FLAGS (REG_EXTENDED | REG_ICASE | REG_NOSUB)
+
+typedef struct {
+    regex_t re;
+    int compiled;
+    int has_literal;        /* 0 = always confirm */
+    int next_same_state;    /* next pattern whose literal ends in the same state */
+    atomic_int strikes;
+} pattern_t;
+
+struct regex_engine {
+    pattern_t *patterns;
+    int count;
+    int literal_count;
+
+    /* Automaton over byte classes; class 0 is every byte no literal uses */
+    uint8_t byte_class[256];
+    int classes;
+    int states;
+    int *next;              /* states x classes, failure links folded in */
+    int *out;               /* first pattern ending at a state, or -1 */
+    int *dict;              /* nearest suffix state with output, or 0 */
+};
+
+static inline unsigned char lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static inline int is_alnum(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Index just past the bracket expression that starts at p[i] */
+static size_t skip_bracket(const char *p, size_t i) {
+    i++;
+    if (p[i] == '^') i++;
+    if (p[i] == ']') i++;
+    while (p[i] && p[i] != ']') {
+        /* [:class:], [=x=] and [.x.] may contain ']' */
+        if (p[i] == '[' && (p[i + 1] == ':' || p[i + 1] == '=' || p[i + 1] == '.')) {
+            char end = p[i + 1];
+            i += 2;
+            while (p[i] && !(p[i] == end && p[i + 1] == ']')) i++;
+            if (p[i]) i += 2;
+            continue;
+        }
+        i++;
+    }
+    return p[i] ? i + 1 : i;
+}
+
+/* Index just past the group that starts at p[i] */
+static size_t skip_group(const char *p, size_t i) {
+    int depth = 0;
+    while (p[i]) {
+        if (p[i] == '\\' && p[i + 1]) {
+            i += 2;
+        } else if (p[i] == '[') {
+            i = skip_bracket(p, i);
+        } else {
+            if (p[i] == '(') depth++;
+            else if (p[i] == ')' && --depth == 0) return i + 1;
+            i++;
+        }
+    }
+    return i;
+}
+
+size_t regex_engine_literal(const char *pattern, char *out, size_t out_size) {
+    char run[REGEX_ENGINE_MAX_LITERAL];
+    size_t run_len = 0, best_len = 0;
+    int last_literal = 0;   /* previous atom was the last byte of run */
+    size_t i = 0;
+
+    if (out_size) out[0] = '\0';
+    if (!pattern) return 0;
+
+#define END_RUN() do { \
+        if (run_len > best_len && run_len < out_size) { \
+            memcpy(out, run, run_len); \
+            out[run_len] = '\0'; \
+            best_len = run_len; \
+        } \
+        run_len = 0; \
+    } while (0)
+
+    while (pattern[i]) {
+        unsigned char c = (unsigned char)pattern[i];
+        int literal = -1;
+
+        switch (c) {
+        case '|':
+            /* Top-level alternation: no literal is required */
+            if (out_size) out[0] = '\0';
+            return 0;
+        case '*': case '?': case '{':
+            /* The previous atom may be absent */
+            if (last_literal && run_len) run_len--;
+            END_RUN();
+            if (c == '{') {
+                while (pattern[i] && pattern[i] != '}') i++;
+            }
+            if (pattern[i]) i++;
+            last_literal = 0;
+            continue;
+        case '+':
+            END_RUN();
+            i++;
+            last_literal = 0;
+            continue;
+        case '[':
+            END_RUN();
+            i = skip_bracket(pattern, i);
+            last_literal = 0;
+            continue;
+        case '(':
+            END_RUN();
+            i = skip_group(pattern, i);
+            last_literal = 0;
+            continue;
+        case '\\':
+            /* \w, \b, back-references and the like are not literals */
+            if (pattern[i + 1] && !is_alnum((unsigned char)pattern[i + 1]) &&
+                !((unsigned char)pattern[i + 1] & 0x80)) {
+                literal = (unsigned char)pattern[i + 1];
+            }
+            i += pattern[i + 1] ? 2 : 1;
+            break;
+        case '^': case '$': case '.': case ')':
+            i++;
+            break;
+        default:
+            /* Case folding beyond ASCII is locale-dependent; stay out of it */
+            if (!(c & 0x80)) literal = c;
+            i++;
+            break;
+        }
+
+        if (literal < 0) {
+            END_RUN();
+            last_literal = 0;
+        } else {
+            if (run_len == sizeof(run)) END_RUN();
+            run[run_len++] = (char)lower((unsigned char)literal);
+            last_literal = 1;
+        }
+    }
+    END_RUN();
+#undef END_RUN
+
+    return best_len;
+}
+
+/* Add a trie path for literal; returns its final state or -1 */
+static int trie_insert(regex_engine_t *e, const char *literal, int *capacity) {
+    int state = 0;
+    for (const unsigned char *p = (const unsigned char *)literal; *p; p++) {
+        int *slot = &e->next[state * e->classes + e->byte_class[*p]];
+        if (*slot <= 0) {
+            if (e->states == *capacity) return -1;
+            *slot = e->states++;
+        }
+        state = *slot;
+    }
+    return state;
+}
+
+/* Breadth-first pass: resolve failure links into the transition table */
+static int build_automaton(regex_engine_t *e, int capacity) {
+    int *fail = calloc((size_t)capacity, sizeof(int));
+    int *queue = malloc((size_t)capacity * sizeof(int));
+    if (!fail || !queue) {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    int head = 0, tail = 0;
+    for (int c = 0; c < e->classes; c++) {
+        int s = e->next[c];
+        if (s > 0) {
+            fail[s] = 0;
+            queue[tail++] = s;
+        } else {
+            e->next[c] = 0;
+        }
+    }
+
+    while (head < tail) {
+        int s = queue[head++];
+        int f = fail[s];
+        e->dict[s] = e->out[f] >= 0 ? f : e->dict[f];
+
+        for (int c = 0; c < e->classes; c++) {
+            int *slot = &e->next[s * e->classes + c];
+            int via_fail = e->next[f * e->classes + c];
+            if (*slot > 0) {
+                fail[*slot] = via_fail;
+                queue[tail++] = *slot;
+            } else {
+                *slot = via_fail;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+regex_engine_t *regex_engine_build(const char *const *patterns, int count) {
+    if (count < 0) count = 0;
+    if (count > REGEX_ENGINE_MAX_PATTERNS) count = REGEX_ENGINE_MAX_PATTERNS;
+
+    regex_engine_t *e = calloc(1, sizeof(regex_engine_t));
+    if (!e) return NULL;
+    e->patterns = calloc(count ? (size_t)count : 1, sizeof(pattern_t));
+    if (!e->patterns) {
+        free(e);
+        return NULL;
+    }
+    e->count = count;
+
+    /* Literals first: they decide the byte classes and the trie size */
+    char (*literals)[REGEX_ENGINE_MAX_LITERAL + 1] = calloc(count ? (size_t)count : 1, sizeof(*literals));
+    if (!literals) {
+        regex_engine_free(e);
+        return NULL;
+    }
+
+    int capacity = 1;
+    for (int i = 0; i < count; i++) {
+        pattern_t *pt = &e->patterns[i];
+        pt->next_same_state = -1;
+        pt->compiled = patterns[i] && regcomp(&pt->re, patterns[i], REGEX_FLAGS) == 0;
+        if (!pt->compiled) continue;
+
+        size_t len = regex_engine_literal(patterns[i], literals[i], sizeof(literals[i]));
+        if (len < REGEX_ENGINE_MIN_LITERAL) continue;
+
+        pt->has_literal = 1;
+        e->literal_count++;
+        capacity += (int)len;
+        for (size_t j = 0; j < len; j++) {
+            unsigned char c = (unsigned char)literals[i][j];
+            if (e->byte_class[c]) continue;
+            e->byte_class[c] = (uint8_t)++e->classes;
+            /* REG_ICASE: both cases of a letter share a class */
+            if (c >= 'a' && c <= 'z') e->byte_class[c - 32] = e->byte_class[c];
+        }
+    }
+    e->classes++;
+
+    e->next = calloc((size_t)capacity * (size_t)e->classes, sizeof(int));
+    e->out = malloc((size_t)capacity * sizeof(int));
+    e->dict = calloc((size_t)capacity, sizeof(int));
+    if (!e->next || !e->out || !e->dict) {
+        free(literals);
+        regex_engine_free(e);
+        return NULL;
+    }
+    for (int s = 0; s < capacity; s++) e->out[s] = -1;
+    e->states = 1;
+
+    /* Chain in reverse so each state's list stays in build order */
+    for (int i = count - 1; i >= 0; i--) {
+        if (!e->patterns[i].has_literal) continue;
+        int s = trie_insert(e, literals[i], &capacity);
+        if (s < 0) {
+            e->patterns[i].has_literal = 0;
+            e->literal_count--;
+            continue;
+        }
+        e->patterns[i].next_same_state = e->out[s];
+        e->out[s] = i;
+    }
+    free(literals);
+
+    if (build_automaton(e, capacity) != 0) {
+        regex_engine_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void regex_engine_free(regex_engine_t *e) {
+    if (!e) return;
+    for (int i = 0; i < e->count; i++) {
+        if (e->patterns[i].compiled) regfree(&e->patterns[i].re);
+    }
+    free(e->patterns);
+    free(e->next);
+    free(e->out);
+    free(e->dict);
+    free(e);
+}
+
+static long elapsed_us(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(now.tv_sec - since->tv_sec) * 1000000L + (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+int regex_engine_match(regex_engine_t *e, const char *text, long budget_us) {
+    if (!e || !text || e->count == 0) return REGEX_ENGINE_NO_MATCH;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* Prefilter: one pass marks every pattern whose literal occurs */
+    unsigned char seen[REGEX_ENGINE_MAX_PATTERNS] = { 0 };
+    int remaining = e->literal_count;
+    int state = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p && remaining > 0; p++) {
+        state = e->next[state * e->classes + e->byte_class[*p]];
+        for (int s = e->out[state] >= 0 ? state : e->dict[state]; s > 0; s = e->dict[s]) {
+            for (int i = e->out[s]; i >= 0; i = e->patterns[i].next_same_state) {
+                if (!seen[i]) {
+                    seen[i] = 1;
+                    remaining--;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < e->count; i++) {
+        pattern_t *pt = &e->patterns[i];
+        if (!pt->compiled || (pt->has_literal && !seen[i])) continue;
+        if (atomic_load_explicit(&pt->strikes, memory_order_relaxed) >= REGEX_ENGINE_STRIKES) continue;
+
+        long before = elapsed_us(&start);
+        if (budget_us > 0 && before >= budget_us) return REGEX_ENGINE_OVER_BUDGET;
+
+        int matched = regexec(&pt->re, text, 0, NULL, 0) == 0;
+
+        if (budget_us > 0 && elapsed_us(&start) - before > budget_us) {
+            if (atomic_fetch_add(&pt->strikes, 1) + 1 == REGEX_ENGINE_STRIKES) {
+                fprintf(stderr, "Regex engine: pattern %d keeps overrunning the %ld us budget, disabled\n",
+                        i, budget_us);
+            }
+        }
+        if (matched) return i;
+    }
+    return REGEX_ENGINE_NO_MATCH;
+}
+
+int regex_engine_check(const char *pattern, char *err, size_t err_size) {
+    regex_t re;
+    int rc = regcomp(&re, pattern, REGEX_FLAGS);
+    if (rc != 0) {
+        if (err && err_size) regerror(rc, &re, err, err_size);
+        return -1;
+    }
+    regfree(&re);
+    return 0;
+}
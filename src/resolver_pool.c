@@ -0,0 +1,656 @@
+/*
+ * Himiko Discord Bot (C Edition) - Resolver Pool
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#define _GNU_SOURCE
+#include "resolver_pool.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <json-c/json.h>
+
+typedef enum {
+    OP_RESOLVE,
+    OP_STREAM
+} resolver_op_t;
+
+/* Lives on the caller's stack until status leaves 0 */
+typedef struct request {
+    struct request *next;
+    resolver_op_t op;
+    const char *query;
+    music_cache_meta_t *meta;
+    char *out;
+    size_t out_len;
+    int status;     /* 0 pending, 1 done, -1 failed */
+} request_t;
+
+/* How a round trip with a worker ended */
+enum {
+    EXCHANGE_OK = 0,
+    EXCHANGE_FAILED = -1,   /* the worker answered, but not with a result */
+    EXCHANGE_LOST = -2,     /* the worker was already gone; the request never reached it */
+    EXCHANGE_BROKEN = -3    /* timed out, crashed or garbled mid-request; the worker is gone now */
+};
+
+typedef struct {
+    pthread_t thread;
+    pid_t pid;
+    int to_fd;      /* worker stdin */
+    int from_fd;    /* worker stdout */
+    char *buf;
+    size_t buf_len;
+    int started;    /* has run before, so the next start is a restart */
+    struct timespec last_start;
+} worker_t;
+
+static worker_t g_workers[RESOLVER_POOL_MAX_WORKERS];
+static int g_worker_count = 0;
+static int g_timeout_ms = RESOLVER_POOL_DEFAULT_TIMEOUT * 1000;
+static char g_worker_path[512];
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_done_cond = PTHREAD_COND_INITIALIZER;
+static request_t *g_head = NULL;
+static request_t *g_tail = NULL;
+static int g_queued = 0;
+static int g_running = 0;
+static int g_stopping = 0;
+
+/* Written to on shutdown so workers stop waiting on replies */
+static int g_stop_pipe[2] = {-1, -1};
+
+static atomic_uint_fast64_t g_next_id = 1;
+static atomic_uint_fast64_t g_requests = 0;
+static atomic_uint_fast64_t g_failures = 0;
+static atomic_uint_fast64_t g_timeouts = 0;
+static atomic_uint_fast64_t g_restarts = 0;
+static atomic_int g_alive = 0;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Fork and exec argv with stdin/stdout on the given fds (-1 for /dev/null).
+ * A CLOEXEC pipe reports a failed exec, so a missing worker shows up here
+ * rather than as an EOF on the first request.
+ */
+static pid_t spawn(char *const argv[], int in_fd, int out_fd, const int *close_fds, int close_count) {
+    int status_pipe[2];
+    if (pipe2(status_pipe, O_CLOEXEC) < 0) {
+        DEBUG_LOG("Failed to create pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        DEBUG_LOG("Failed to fork: %s", strerror(errno));
+        close(status_pipe[0]);
+        close(status_pipe[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Child process; the pool's threads block SIGPIPE */
+        sigset_t none;
+        sigemptyset(&none);
+        pthread_sigmask(SIG_SETMASK, &none, NULL);
+
+        for (int i = 0; i < close_count; i++) close(close_fds[i]);
+
+        int devnull = open("/dev/null", O_RDWR);
+        dup2(in_fd >= 0 ? in_fd : devnull, STDIN_FILENO);
+        dup2(out_fd >= 0 ? out_fd : devnull, STDOUT_FILENO);
+        if (!debug_is_enabled() && devnull >= 0) dup2(devnull, STDERR_FILENO);
+        if (devnull > STDERR_FILENO) close(devnull);
+
+        execvp(argv[0], argv);
+
+        int err = errno;
+        ssize_t unused = write(status_pipe[1], &err, sizeof(err));
+        (void)unused;
+        _exit(127);
+    }
+
+    close(status_pipe[1]);
+    int err = 0;
+    ssize_t n;
+    do {
+        n = read(status_pipe[0], &err, sizeof(err));
+    } while (n < 0 && errno == EINTR);
+    close(status_pipe[0]);
+
+    if (n > 0) {
+        DEBUG_LOG("Failed to run %s: %s", argv[0], strerror(err));
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+static void stop_worker(worker_t *w, int force) {
+    if (w->pid <= 0) return;
+
+    close(w->to_fd);
+    close(w->from_fd);
+    w->to_fd = w->from_fd = -1;
+
+    /* With stdin closed a healthy worker exits on its own */
+    int status;
+    pid_t result = 0;
+    if (!force) {
+        for (int i = 0; i < 20 && (result = waitpid(w->pid, &status, WNOHANG)) == 0; i++) {
+            usleep(25000);
+        }
+    }
+    if (result == 0) {
+        kill(w->pid, SIGKILL);
+        waitpid(w->pid, &status, 0);
+    }
+
+    w->pid = -1;
+    w->buf_len = 0;
+    atomic_fetch_sub(&g_alive, 1);
+}
+
+static int start_worker(worker_t *w) {
+    /* A worker that keeps dying should not be restarted in a tight loop */
+    if (w->started) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t elapsed = (int64_t)(now.tv_sec - w->last_start.tv_sec) * 1000 +
+                          (now.tv_nsec - w->last_start.tv_nsec) / 1000000;
+        if (elapsed < RESOLVER_POOL_RESTART_DELAY_MS) {
+            usleep((useconds_t)(RESOLVER_POOL_RESTART_DELAY_MS - elapsed) * 1000);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w->last_start);
+
+    int in[2], out[2];
+    if (pipe2(in, O_CLOEXEC) < 0) return -1;
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+
+    char *argv[] = {g_worker_path, NULL};
+    int parent_ends[] = {in[1], out[0]};
+    pid_t pid = spawn(argv, in[0], out[1], parent_ends, 2);
+    close(in[0]);
+    close(out[1]);
+    if (pid < 0) {
+        close(in[1]);
+        close(out[0]);
+        return -1;
+    }
+
+    if (w->started) atomic_fetch_add(&g_restarts, 1);
+    w->started = 1;
+    w->pid = pid;
+    w->to_fd = in[1];
+    w->from_fd = out[0];
+    w->buf_len = 0;
+    atomic_fetch_add(&g_alive, 1);
+    DEBUG_LOG("Resolver worker %d started (%s)", (int)pid, g_worker_path);
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Read fd until a complete line is buffered or the deadline passes.
+ * Returns the line length (newline replaced by NUL), -2 on timeout,
+ * -3 on shutdown, -1 on EOF, error or a line longer than the buffer.
+ */
+static ssize_t read_line(int fd, char *buf, size_t cap, size_t *len, int64_t deadline) {
+    for (;;) {
+        char *nl = memchr(buf, '\n', *len);
+        if (nl) {
+            *nl = '\0';
+            return nl - buf;
+        }
+        if (*len >= cap - 1) return -1;
+
+        int64_t remaining = deadline - now_ms();
+        if (remaining <= 0) return -2;
+
+        struct pollfd fds[2] = {
+            {.fd = fd, .events = POLLIN},
+            {.fd = g_stop_pipe[0], .events = POLLIN}
+        };
+        int rc = poll(fds, 2, (int)remaining);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (rc == 0) return -2;
+        if (fds[1].revents) return -3;
+
+        ssize_t n = read(fd, buf + *len, cap - 1 - *len);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        if (n == 0) return -1;
+        *len += (size_t)n;
+    }
+}
+
+static void copy_field(struct json_object *obj, const char *name, char *dst, size_t len) {
+    struct json_object *value;
+    if (json_object_object_get_ex(obj, name, &value) && json_object_is_type(value, json_type_string)) {
+        strncpy(dst, json_object_get_string(value), len - 1);
+        dst[len - 1] = '\0';
+    }
+}
+
+/* Fill the request's output from an ok reply */
+static int take_result(request_t *req, struct json_object *reply) {
+    struct json_object *value;
+
+    if (req->op == OP_RESOLVE) {
+        memset(req->meta, 0, sizeof(*req->meta));
+        copy_field(reply, "title", req->meta->title, sizeof(req->meta->title));
+        copy_field(reply, "thumbnail", req->meta->thumbnail, sizeof(req->meta->thumbnail));
+        copy_field(reply, "webpage_url", req->meta->webpage_url, sizeof(req->meta->webpage_url));
+        if (json_object_object_get_ex(reply, "duration", &value)) {
+            req->meta->duration = json_object_get_int(value);
+        }
+        return req->meta->title[0] ? 0 : -1;
+    }
+
+    if (!json_object_object_get_ex(reply, "url", &value) ||
+        !json_object_is_type(value, json_type_string)) {
+        return -1;
+    }
+    const char *url = json_object_get_string(value);
+    /* A truncated signed URL is worse than none */
+    if (!url[0] || strlen(url) >= req->out_len) return -1;
+    strcpy(req->out, url);
+    return 0;
+}
+
+/* One request/reply with a running worker */
+static int exchange(worker_t *w, request_t *req) {
+    uint64_t id = atomic_fetch_add(&g_next_id, 1);
+
+    struct json_object *msg = json_object_new_object();
+    json_object_object_add(msg, "id", json_object_new_int64((int64_t)id));
+    json_object_object_add(msg, "op", json_object_new_string(req->op == OP_RESOLVE ? "resolve" : "stream"));
+    json_object_object_add(msg, "query", json_object_new_string(req->query));
+
+    const char *text = json_object_to_json_string_ext(msg, JSON_C_TO_STRING_PLAIN);
+    int sent = write_all(w->to_fd, text, strlen(text)) == 0 && write_all(w->to_fd, "\n", 1) == 0;
+    json_object_put(msg);
+
+    if (!sent) {
+        stop_worker(w, 1);
+        return EXCHANGE_LOST;
+    }
+
+    int64_t deadline = now_ms() + g_timeout_ms;
+    for (;;) {
+        ssize_t n = read_line(w->from_fd, w->buf, RESOLVER_POOL_REPLY_MAX, &w->buf_len, deadline);
+        if (n == -2) {
+            atomic_fetch_add(&g_timeouts, 1);
+            DEBUG_LOG("Resolver worker %d timed out on '%s'", (int)w->pid, req->query);
+            stop_worker(w, 1);
+            return EXCHANGE_BROKEN;
+        }
+        if (n == -3) {
+            stop_worker(w, 1);
+            return EXCHANGE_BROKEN;
+        }
+        if (n < 0) {
+            DEBUG_LOG("Resolver worker %d went away on '%s'", (int)w->pid, req->query);
+            stop_worker(w, 1);
+            return EXCHANGE_BROKEN;
+        }
+
+        struct json_object *reply = json_tokener_parse(w->buf);
+
+        /* Drop the line; anything after it stays for the next read */
+        size_t used = (size_t)n + 1;
+        memmove(w->buf, w->buf + used, w->buf_len - used);
+        w->buf_len -= used;
+
+        struct json_object *value;
+        if (!reply || !json_object_object_get_ex(reply, "id", &value) ||
+            (uint64_t)json_object_get_int64(value) != id) {
+            /* Stray output or a reply to something abandoned; keep waiting */
+            if (reply) json_object_put(reply);
+            continue;
+        }
+
+        int ok = json_object_object_get_ex(reply, "ok", &value) && json_object_get_boolean(value);
+        int rc = EXCHANGE_FAILED;
+        if (ok) {
+            rc = take_result(req, reply) == 0 ? EXCHANGE_OK : EXCHANGE_FAILED;
+        } else if (json_object_object_get_ex(reply, "error", &value)) {
+            DEBUG_LOG("Resolver failed on '%s': %s", req->query, json_object_get_string(value));
+        }
+        json_object_put(reply);
+        return rc;
+    }
+}
+
+/* Everything fd writes until EOF, the deadline or a full buffer; -2 on timeout */
+static ssize_t read_output(int fd, char *buf, size_t cap, int64_t deadline) {
+    size_t len = 0;
+    while (len < cap - 1) {
+        int64_t remaining = deadline - now_ms();
+        if (remaining <= 0) return -2;
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int rc = poll(&pfd, 1, (int)remaining);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc < 0) return -1;
+        if (rc == 0) return -2;
+
+        ssize_t n = read(fd, buf + len, cap - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    buf[len] = '\0';
+    return (ssize_t)len;
+}
+
+/* Next line of buf, advancing *cursor past it; NULL when there are none left */
+static char *next_line(char **cursor) {
+    char *line = *cursor;
+    if (!line || !*line) return NULL;
+    char *nl = strchr(line, '\n');
+    if (nl) {
+        *nl = '\0';
+        *cursor = nl + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return line;
+}
+
+/*
+ * No pool (or no worker would start): run yt-dlp for this request alone,
+ * from an argv rather than a shell command line, and read its output.
+ */
+static int run_once(request_t *req) {
+    char *resolve_argv[] = {
+        "yt-dlp", "--no-download",
+        "--print", "title", "--print", "duration",
+        "--print", "thumbnail", "--print", "webpage_url",
+        "--", (char *)req->query, NULL
+    };
+    char *stream_argv[] = {"yt-dlp", "-f", "bestaudio", "--get-url", "--", (char *)req->query, NULL};
+
+    int out[2];
+    if (pipe2(out, O_CLOEXEC) < 0) return -1;
+    pid_t pid = spawn(req->op == OP_RESOLVE ? resolve_argv : stream_argv, -1, out[1], &out[0], 1);
+    close(out[1]);
+    if (pid < 0) {
+        close(out[0]);
+        return -1;
+    }
+
+    char *buf = malloc(RESOLVER_POOL_REPLY_MAX);
+    ssize_t len = buf ? read_output(out[0], buf, RESOLVER_POOL_REPLY_MAX, now_ms() + g_timeout_ms) : -1;
+    close(out[0]);
+
+    /* Searches can match more than we read; don't wait for the rest */
+    kill(pid, len == -2 ? SIGKILL : SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (len == -2) {
+        atomic_fetch_add(&g_timeouts, 1);
+        DEBUG_LOG("yt-dlp timed out on '%s'", req->query);
+    }
+    if (len <= 0) {
+        free(buf);
+        return -1;
+    }
+
+    int rc = -1;
+    char *cursor = buf;
+    if (req->op == OP_RESOLVE) {
+        char *lines[4];
+        int count = 0;
+        while (count < 4 && (lines[count] = next_line(&cursor))) count++;
+        if (count == 4 && lines[0][0]) {
+            memset(req->meta, 0, sizeof(*req->meta));
+            strncpy(req->meta->title, lines[0], sizeof(req->meta->title) - 1);
+            req->meta->duration = atoi(lines[1]);
+            strncpy(req->meta->thumbnail, lines[2], sizeof(req->meta->thumbnail) - 1);
+            strncpy(req->meta->webpage_url, lines[3], sizeof(req->meta->webpage_url) - 1);
+            rc = 0;
+        }
+    } else {
+        char *url = next_line(&cursor);
+        if (url && url[0] && strlen(url) < req->out_len) {
+            strcpy(req->out, url);
+            rc = 0;
+        }
+    }
+
+    free(buf);
+    return rc;
+}
+
+static void *driver_thread(void *arg) {
+    worker_t *w = arg;
+
+    /* Writing to a worker that just died must fail with EPIPE, not kill the bot */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    /* Warm up before the first request arrives */
+    start_worker(w);
+
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (!g_stopping && !g_head) pthread_cond_wait(&g_work_cond, &g_lock);
+        if (g_stopping) break;
+
+        request_t *req = g_head;
+        g_head = req->next;
+        if (!g_head) g_tail = NULL;
+        g_queued--;
+        pthread_mutex_unlock(&g_lock);
+
+        int rc;
+        if (w->pid <= 0 && start_worker(w) != 0) {
+            rc = run_once(req) == 0 ? EXCHANGE_OK : EXCHANGE_FAILED;
+        } else {
+            rc = exchange(w, req);
+            /* Died while idle: the request is not to blame, so it gets a fresh worker */
+            if (rc == EXCHANGE_LOST && start_worker(w) == 0) {
+                rc = exchange(w, req);
+            }
+        }
+        if (rc == EXCHANGE_FAILED) atomic_fetch_add(&g_failures, 1);
+
+        pthread_mutex_lock(&g_lock);
+        req->status = rc == EXCHANGE_OK ? 1 : -1;
+        pthread_cond_broadcast(&g_done_cond);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    stop_worker(w, 0);
+    return NULL;
+}
+
+int resolver_pool_init(const char *worker_path, int workers, int timeout_secs) {
+    pthread_mutex_lock(&g_lock);
+    if (g_running) {
+        pthread_mutex_unlock(&g_lock);
+        return 0;
+    }
+
+    if (workers < 0) workers = 0;
+    if (workers > RESOLVER_POOL_MAX_WORKERS) workers = RESOLVER_POOL_MAX_WORKERS;
+    if (timeout_secs <= 0) timeout_secs = RESOLVER_POOL_DEFAULT_TIMEOUT;
+    g_timeout_ms = timeout_secs * 1000;
+    if (!worker_path || !worker_path[0]) workers = 0;
+    else snprintf(g_worker_path, sizeof(g_worker_path), "%s", worker_path);
+
+    if (workers > 0 && pipe2(g_stop_pipe, O_CLOEXEC) < 0) {
+        DEBUG_LOG("Failed to create pipe: %s", strerror(errno));
+        workers = 0;
+    }
+
+    g_stopping = 0;
+    g_worker_count = 0;
+    for (int i = 0; i < workers; i++) {
+        worker_t *w = &g_workers[i];
+        memset(w, 0, sizeof(*w));
+        w->pid = -1;
+        w->to_fd = w->from_fd = -1;
+        w->buf = malloc(RESOLVER_POOL_REPLY_MAX);
+        if (!w->buf) break;
+        if (pthread_create(&w->thread, NULL, driver_thread, w) != 0) {
+            free(w->buf);
+            break;
+        }
+        g_worker_count++;
+    }
+
+    g_running = 1;
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_worker_count > 0) {
+        DEBUG_LOG("Resolver pool: %d workers running %s, %d s timeout", g_worker_count, g_worker_path, timeout_secs);
+    } else {
+        DEBUG_LOG("Resolver pool: running yt-dlp once per request, %d s timeout", timeout_secs);
+    }
+    return 0;
+}
+
+void resolver_pool_shutdown(void) {
+    pthread_mutex_lock(&g_lock);
+    if (!g_running) {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_stopping = 1;
+
+    /* Nobody will pick these up now */
+    for (request_t *req = g_head; req; req = req->next) req->status = -1;
+    g_head = g_tail = NULL;
+    g_queued = 0;
+
+    pthread_cond_broadcast(&g_work_cond);
+    pthread_cond_broadcast(&g_done_cond);
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_stop_pipe[1] >= 0) {
+        ssize_t unused = write(g_stop_pipe[1], "x", 1);
+        (void)unused;
+    }
+
+    for (int i = 0; i < g_worker_count; i++) {
+        pthread_join(g_workers[i].thread, NULL);
+        free(g_workers[i].buf);
+        g_workers[i].buf = NULL;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    g_worker_count = 0;
+    g_running = 0;
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_stop_pipe[0] >= 0) {
+        close(g_stop_pipe[0]);
+        close(g_stop_pipe[1]);
+        g_stop_pipe[0] = g_stop_pipe[1] = -1;
+    }
+    DEBUG_LOG("Resolver pool stopped");
+}
+
+/* Queue req and wait for a worker to finish it */
+static int submit(request_t *req) {
+    atomic_fetch_add(&g_requests, 1);
+
+    pthread_mutex_lock(&g_lock);
+    if (g_stopping || g_worker_count == 0) {
+        int stopping = g_stopping;
+        pthread_mutex_unlock(&g_lock);
+        if (stopping) return -1;
+        int rc = run_once(req);
+        if (rc != 0) atomic_fetch_add(&g_failures, 1);
+        return rc;
+    }
+    if (g_queued >= RESOLVER_POOL_QUEUE_DEPTH) {
+        pthread_mutex_unlock(&g_lock);
+        DEBUG_LOG("Resolver queue full, dropping '%s'", req->query);
+        return -1;
+    }
+
+    req->next = NULL;
+    req->status = 0;
+    if (g_tail) g_tail->next = req;
+    else g_head = req;
+    g_tail = req;
+    g_queued++;
+    pthread_cond_signal(&g_work_cond);
+
+    while (req->status == 0) pthread_cond_wait(&g_done_cond, &g_lock);
+    int rc = req->status == 1 ? 0 : -1;
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+int resolver_pool_resolve(const char *query, music_cache_meta_t *meta) {
+    if (!query || !query[0] || !meta) return -1;
+    request_t req = {.op = OP_RESOLVE, .query = query, .meta = meta};
+    return submit(&req);
+}
+
+int resolver_pool_stream_url(const char *url, char *out, size_t len) {
+    if (!url || !url[0] || !out || len == 0) return -1;
+    request_t req = {.op = OP_STREAM, .query = url, .out = out, .out_len = len};
+    return submit(&req);
+}
+
+void resolver_pool_get_stats(resolver_pool_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    stats->requests = atomic_load(&g_requests);
+    stats->failures = atomic_load(&g_failures);
+    stats->timeouts = atomic_load(&g_timeouts);
+    stats->restarts = atomic_load(&g_restarts);
+    stats->workers_alive = atomic_load(&g_alive);
+
+    pthread_mutex_lock(&g_lock);
+    stats->workers = g_worker_count;
+    stats->queued = g_queued;
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,286 @@
+/*
+ * Himiko Discord Bot (C Edition) - Scheduler
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "scheduler.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Rows read per query while loading scheduled_events */
+#define LOAD_PAGE 64
+
+typedef struct {
+    time_t when;
+    uint64_t seq;       /* equal deadlines fire in insertion order */
+    scheduler_fn fn;
+    scheduler_fn drop;
+    void *arg;
+} sched_timer_t;
+
+typedef struct {
+    char event_type[32];
+    scheduler_event_fn fn;
+} event_handler_t;
+
+static sched_timer_t *g_heap = NULL;
+static int g_count = 0;
+static int g_capacity = 0;
+static uint64_t g_seq = 0;
+
+static event_handler_t g_handlers[SCHEDULER_MAX_EVENT_TYPES];
+static int g_handler_count = 0;
+
+static himiko_database_t *g_db = NULL;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static int g_running = 0;
+
+static inline int timer_before(const sched_timer_t *a, const sched_timer_t *b) {
+    return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+static void sift_up(int i) {
+    sched_timer_t t = g_heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!timer_before(&t, &g_heap[parent])) break;
+        g_heap[i] = g_heap[parent];
+        i = parent;
+    }
+    g_heap[i] = t;
+}
+
+static void sift_down(int i) {
+    sched_timer_t t = g_heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= g_count) break;
+        if (child + 1 < g_count && timer_before(&g_heap[child + 1], &g_heap[child])) child++;
+        if (!timer_before(&g_heap[child], &t)) break;
+        g_heap[i] = g_heap[child];
+        i = child;
+    }
+    g_heap[i] = t;
+}
+
+/* Caller holds g_lock */
+static sched_timer_t heap_pop(void) {
+    sched_timer_t top = g_heap[0];
+    g_heap[0] = g_heap[--g_count];
+    if (g_count > 0) sift_down(0);
+    return top;
+}
+
+static void *scheduler_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_lock);
+    while (g_running) {
+        if (g_count == 0) {
+            pthread_cond_wait(&g_cond, &g_lock);
+            continue;
+        }
+
+        time_t now = time(NULL);
+        if (g_heap[0].when > now) {
+            /* Deadlines are wall-clock, so wait on the realtime clock too */
+            struct timespec deadline = { .tv_sec = g_heap[0].when, .tv_nsec = 0 };
+            pthread_cond_timedwait(&g_cond, &g_lock, &deadline);
+            continue;
+        }
+
+        sched_timer_t t = heap_pop();
+        pthread_mutex_unlock(&g_lock);
+
+        t.fn(t.arg);
+        if (t.drop) t.drop(t.arg);
+
+        pthread_mutex_lock(&g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+int scheduler_add(time_t when, scheduler_fn fn, scheduler_fn drop, void *arg) {
+    pthread_mutex_lock(&g_lock);
+    if (g_count == g_capacity) {
+        int capacity = g_capacity ? g_capacity * 2 : 64;
+        sched_timer_t *heap = realloc(g_heap, (size_t)capacity * sizeof(sched_timer_t));
+        if (!heap) {
+            pthread_mutex_unlock(&g_lock);
+            return -1;
+        }
+        g_heap = heap;
+        g_capacity = capacity;
+    }
+
+    int i = g_count++;
+    g_heap[i].when = when;
+    g_heap[i].seq = g_seq++;
+    g_heap[i].fn = fn;
+    g_heap[i].drop = drop;
+    g_heap[i].arg = arg;
+    sift_up(i);
+
+    /* Only a new earliest deadline changes how long the thread should sleep */
+    if (g_heap[0].seq == g_seq - 1) pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+int scheduler_pending(void) {
+    pthread_mutex_lock(&g_lock);
+    int count = g_count;
+    pthread_mutex_unlock(&g_lock);
+    return count;
+}
+
+/* Scheduled events */
+
+static scheduler_event_fn find_handler(const char *event_type) {
+    scheduler_event_fn fn = NULL;
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_handler_count; i++) {
+        if (strcmp(g_handlers[i].event_type, event_type) == 0) {
+            fn = g_handlers[i].fn;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return fn;
+}
+
+static void fire_event(void *arg) {
+    scheduled_event_t *event = arg;
+
+    scheduler_event_fn fn = find_handler(event->event_type);
+    if (!fn) {
+        /* Leave the row for a build that has the module enabled */
+        DEBUG_LOG("scheduler: no handler for event '%s'", event->event_type);
+        return;
+    }
+
+    fn(event);
+    if (g_db) db_delete_scheduled_event(g_db, event->id);
+}
+
+static int arm_event(const scheduled_event_t *event) {
+    scheduled_event_t *copy = malloc(sizeof(scheduled_event_t));
+    if (!copy) return -1;
+    *copy = *event;
+    if (scheduler_add(copy->execute_at, fire_event, free, copy) != 0) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+int scheduler_register_event(const char *event_type, scheduler_event_fn fn) {
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_handler_count; i++) {
+        if (strcmp(g_handlers[i].event_type, event_type) == 0) {
+            g_handlers[i].fn = fn;
+            pthread_mutex_unlock(&g_lock);
+            return 0;
+        }
+    }
+    if (g_handler_count >= SCHEDULER_MAX_EVENT_TYPES) {
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+    event_handler_t *h = &g_handlers[g_handler_count++];
+    strncpy(h->event_type, event_type, sizeof(h->event_type) - 1);
+    h->event_type[sizeof(h->event_type) - 1] = '\0';
+    h->fn = fn;
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+int scheduler_add_event(himiko_database_t *db, const char *guild_id, const char *event_type,
+                        const char *target_id, time_t execute_at) {
+    scheduled_event_t event;
+    memset(&event, 0, sizeof(event));
+    if (db_add_scheduled_event(db, guild_id, event_type, target_id, execute_at, &event.id) != 0) {
+        return -1;
+    }
+    strncpy(event.guild_id, guild_id, sizeof(event.guild_id) - 1);
+    strncpy(event.event_type, event_type, sizeof(event.event_type) - 1);
+    strncpy(event.target_id, target_id, sizeof(event.target_id) - 1);
+    event.execute_at = execute_at;
+    return arm_event(&event);
+}
+
+static int load_events(himiko_database_t *db) {
+    scheduled_event_t events[LOAD_PAGE];
+    int64_t after_id = 0;
+    int total = 0;
+    int count;
+
+    do {
+        if (db_get_scheduled_events(db, after_id, events, LOAD_PAGE, &count) != 0) return -1;
+        for (int i = 0; i < count; i++) {
+            if (arm_event(&events[i]) == 0) total++;
+        }
+        if (count > 0) after_id = events[count - 1].id;
+    } while (count == LOAD_PAGE);
+
+    return total;
+}
+
+int scheduler_init(himiko_database_t *db) {
+    pthread_mutex_lock(&g_lock);
+    if (g_running) {
+        pthread_mutex_unlock(&g_lock);
+        return 0;
+    }
+    g_db = db;
+    g_running = 1;
+    pthread_mutex_unlock(&g_lock);
+
+    if (pthread_create(&g_thread, NULL, scheduler_thread, NULL) != 0) {
+        fprintf(stderr, "Scheduler: failed to start thread\n");
+        pthread_mutex_lock(&g_lock);
+        g_running = 0;
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    int loaded = db ? load_events(db) : 0;
+    if (loaded < 0) {
+        fprintf(stderr, "Scheduler: failed to load scheduled events\n");
+    } else {
+        DEBUG_LOG("scheduler: loaded %d scheduled events", loaded);
+    }
+    return 0;
+}
+
+void scheduler_shutdown(void) {
+    pthread_mutex_lock(&g_lock);
+    if (!g_running) {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_running = 0;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+
+    /* Persisted timers are armed again from the database on the next start */
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_count; i++) {
+        if (g_heap[i].drop) g_heap[i].drop(g_heap[i].arg);
+    }
+    free(g_heap);
+    g_heap = NULL;
+    g_count = 0;
+    g_capacity = 0;
+    g_db = NULL;
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,68 @@
+/*
+ * Himiko Discord Bot (C Edition) - SimHash
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "simhash.h"
+#include <string.h>
+
+/* Longer texts are fingerprinted from their first SIMHASH_MAX_BYTES */
+#define SIMHASH_MAX_BYTES 2048
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline void add_feature(int32_t *v, uint64_t h) {
+    for (int bit = 0; bit < 64; bit++) {
+        v[bit] += (int32_t)((h >> bit) & 1) * 2 - 1;
+    }
+}
+
+uint64_t simhash_text(const char *text) {
+    if (!text) return 0;
+
+    /* Normalize into a bounded buffer */
+    unsigned char buf[SIMHASH_MAX_BYTES];
+    size_t len = 0;
+    int pending_space = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p && len < sizeof(buf); p++) {
+        unsigned char c = *p;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            pending_space = len > 0;
+            continue;
+        }
+        if (c < 0x20) continue;
+        if (pending_space && len < sizeof(buf) - 1) buf[len++] = ' ';
+        pending_space = 0;
+        buf[len++] = (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+    }
+    if (len == 0) return 0;
+
+    int32_t v[64];
+    memset(v, 0, sizeof(v));
+
+    if (len < 3) {
+        uint64_t h = 0;
+        memcpy(&h, buf, len);
+        add_feature(v, mix64(h | ((uint64_t)len << 56)));
+    } else {
+        for (size_t i = 0; i + 3 <= len; i++) {
+            uint64_t gram = (uint64_t)buf[i] | ((uint64_t)buf[i + 1] << 8) | ((uint64_t)buf[i + 2] << 16);
+            add_feature(v, mix64(gram));
+        }
+    }
+
+    uint64_t hash = 0;
+    for (int bit = 0; bit < 64; bit++) {
+        if (v[bit] > 0) hash |= 1ULL << bit;
+    }
+    /* 0 means "no fingerprint" to callers */
+    return hash ? hash : 1;
+}
@@ -0,0 +1,307 @@
+/*
+ * Himiko Discord Bot (C Edition) - Spam Wave Detector
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "wave_detector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define GUILD_BUCKETS 256
+
+/* A heavy hitter and the posts seen since it was admitted */
+typedef struct {
+    uint64_t fingerprint;   /* 0 = free */
+    time_t last_seen;
+    int flagged;
+    int post_count;
+    wave_post_t posts[WAVE_MAX_POSTS];
+} heavy_t;
+
+/* A post whose content was not tracked yet, kept so admission can backfill it */
+typedef struct {
+    uint64_t fingerprint;   /* 0 = free */
+    wave_post_t post;
+} recent_t;
+
+typedef struct guild_waves {
+    struct guild_waves *next;
+    uint64_t guild_id;
+    pthread_mutex_t lock;
+    int64_t epochs[WAVE_SUBWINDOWS];    /* sub-window number each sketch holds */
+    uint16_t sketch[WAVE_SUBWINDOWS][WAVE_SKETCH_DEPTH][WAVE_SKETCH_WIDTH];
+    heavy_t top[WAVE_TOP_K];
+    recent_t recent[WAVE_RECENT_POSTS];
+    int recent_next;
+} guild_waves_t;
+
+static guild_waves_t *g_guilds[GUILD_BUCKETS];
+static pthread_mutex_t g_guilds_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Observers hold it shared for the whole call; cleanup takes it exclusively */
+static pthread_rwlock_t g_state_lock = PTHREAD_RWLOCK_INITIALIZER;
+static int g_min_authors = WAVE_DEFAULT_MIN_AUTHORS;
+static int g_window_secs = WAVE_DEFAULT_WINDOW_SECS;
+static int g_subwindow_secs = 5;
+static atomic_int g_running = 0;
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t wave_fingerprint(const char *text) {
+    if (!text) return 0;
+
+    /* FNV-1a over what survives normalization */
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int kept = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        unsigned char c = *p;
+        if (c >= 'A' && c <= 'Z') {
+            c = (unsigned char)(c + 32);
+        } else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)) {
+            continue;
+        }
+        h ^= c;
+        h *= 0x100000001b3ULL;
+        kept++;
+    }
+    if (kept < WAVE_MIN_CONTENT) return 0;
+    return h ? h : 1;
+}
+
+/* Caller holds g->lock */
+static void sketch_add(guild_waves_t *g, uint64_t fp, time_t now) {
+    int64_t epoch = (int64_t)now / g_subwindow_secs;
+    int slot = (int)(epoch % WAVE_SUBWINDOWS);
+    if (g->epochs[slot] != epoch) {
+        memset(g->sketch[slot], 0, sizeof(g->sketch[slot]));
+        g->epochs[slot] = epoch;
+    }
+
+    uint64_t h = mix64(fp);
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (int row = 0; row < WAVE_SKETCH_DEPTH; row++) {
+        uint16_t *cell = &g->sketch[slot][row][(h1 + (uint32_t)row * h2) % WAVE_SKETCH_WIDTH];
+        if (*cell < UINT16_MAX) (*cell)++;
+    }
+}
+
+/* Occurrences of fp across the live sub-windows; never an undercount */
+static uint32_t sketch_estimate(const guild_waves_t *g, uint64_t fp, time_t now) {
+    int64_t epoch = (int64_t)now / g_subwindow_secs;
+    uint64_t h = mix64(fp);
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    uint32_t best = UINT32_MAX;
+
+    for (int row = 0; row < WAVE_SKETCH_DEPTH; row++) {
+        uint32_t col = (h1 + (uint32_t)row * h2) % WAVE_SKETCH_WIDTH;
+        uint32_t sum = 0;
+        for (int slot = 0; slot < WAVE_SUBWINDOWS; slot++) {
+            if (g->epochs[slot] > epoch - WAVE_SUBWINDOWS) sum += g->sketch[slot][row][col];
+        }
+        if (sum < best) best = sum;
+    }
+    return best;
+}
+
+static inline int heavy_stale(const heavy_t *h, time_t now) {
+    return !h->fingerprint || h->last_seen + g_window_secs < now;
+}
+
+/* Space-saving admission: take a stale slot, else the weakest one if fp beats it */
+static heavy_t *admit(guild_waves_t *g, uint64_t fp, uint32_t estimate, time_t now) {
+    heavy_t *victim = NULL;
+    uint32_t victim_estimate = UINT32_MAX;
+
+    for (int i = 0; i < WAVE_TOP_K; i++) {
+        heavy_t *h = &g->top[i];
+        if (heavy_stale(h, now)) {
+            victim = h;
+            victim_estimate = 0;
+            break;
+        }
+        if (h->flagged) continue;
+        uint32_t e = sketch_estimate(g, h->fingerprint, now);
+        if (e < victim_estimate) {
+            victim = h;
+            victim_estimate = e;
+        }
+    }
+    if (!victim || (victim->fingerprint && victim_estimate >= estimate && !heavy_stale(victim, now))) {
+        return NULL;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->fingerprint = fp;
+    return victim;
+}
+
+/* Caller holds g->lock */
+static void remember_recent(guild_waves_t *g, uint64_t fp, const wave_post_t *post) {
+    recent_t *r = &g->recent[g->recent_next];
+    r->fingerprint = fp;
+    r->post = *post;
+    g->recent_next = (g->recent_next + 1) % WAVE_RECENT_POSTS;
+}
+
+/* Move earlier untracked sightings of h's content into h, oldest first */
+static void backfill(guild_waves_t *g, heavy_t *h, time_t now) {
+    for (int n = 0; n < WAVE_RECENT_POSTS && h->post_count < WAVE_MAX_POSTS - 1; n++) {
+        recent_t *r = &g->recent[(g->recent_next + n) % WAVE_RECENT_POSTS];
+        if (r->fingerprint != h->fingerprint) continue;
+        if (r->post.posted_at + g_window_secs >= now) h->posts[h->post_count++] = r->post;
+        r->fingerprint = 0;
+    }
+}
+
+static int distinct_authors(const heavy_t *h) {
+    int distinct = 0;
+    for (int i = 0; i < h->post_count; i++) {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = h->posts[j].author_id == h->posts[i].author_id;
+        }
+        if (!seen) distinct++;
+    }
+    return distinct;
+}
+
+static guild_waves_t *find_guild(uint64_t guild_id) {
+    size_t bucket = mix64(guild_id) & (GUILD_BUCKETS - 1);
+
+    pthread_mutex_lock(&g_guilds_lock);
+    guild_waves_t *g = g_guilds[bucket];
+    while (g && g->guild_id != guild_id) g = g->next;
+
+    if (!g) {
+        g = calloc(1, sizeof(guild_waves_t));
+        if (g) {
+            g->guild_id = guild_id;
+            pthread_mutex_init(&g->lock, NULL);
+            for (int i = 0; i < WAVE_SUBWINDOWS; i++) g->epochs[i] = -1;
+            g->next = g_guilds[bucket];
+            g_guilds[bucket] = g;
+        }
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+    return g;
+}
+
+int wave_detector_init(int min_authors, int window_secs) {
+    if (min_authors < 2) min_authors = WAVE_DEFAULT_MIN_AUTHORS;
+    if (min_authors > WAVE_MAX_POSTS) min_authors = WAVE_MAX_POSTS;
+    if (window_secs <= 0) window_secs = WAVE_DEFAULT_WINDOW_SECS;
+
+    g_min_authors = min_authors;
+    g_window_secs = window_secs;
+    g_subwindow_secs = (window_secs + WAVE_SUBWINDOWS - 1) / WAVE_SUBWINDOWS;
+    atomic_store(&g_running, 1);
+    return 0;
+}
+
+void wave_detector_cleanup(void) {
+    /* Waits out observers still holding a guild, and keeps new ones out */
+    pthread_rwlock_wrlock(&g_state_lock);
+    atomic_store(&g_running, 0);
+    pthread_mutex_lock(&g_guilds_lock);
+    for (int i = 0; i < GUILD_BUCKETS; i++) {
+        guild_waves_t *g = g_guilds[i];
+        while (g) {
+            guild_waves_t *next = g->next;
+            pthread_mutex_destroy(&g->lock);
+            free(g);
+            g = next;
+        }
+        g_guilds[i] = NULL;
+    }
+    pthread_mutex_unlock(&g_guilds_lock);
+    pthread_rwlock_unlock(&g_state_lock);
+}
+
+/* Caller holds g_state_lock shared */
+static int observe_guild(guild_waves_t *g, uint64_t fingerprint, const wave_post_t *post,
+                         wave_post_t *earlier, int max_earlier, int *earlier_count) {
+    time_t now = post->posted_at;
+    pthread_mutex_lock(&g->lock);
+
+    sketch_add(g, fingerprint, now);
+
+    heavy_t *h = NULL;
+    for (int i = 0; i < WAVE_TOP_K; i++) {
+        if (g->top[i].fingerprint == fingerprint) {
+            h = &g->top[i];
+            break;
+        }
+    }
+    if (h && heavy_stale(h, now)) {
+        memset(h, 0, sizeof(*h));
+        h->fingerprint = fingerprint;
+    }
+    /*
+     * One sighting is not a wave; the sketch keeps singletons out of the
+     * top-K. They wait in the recent ring instead, so the post that gets
+     * the content admitted brings its earlier sightings along.
+     */
+    if (!h) {
+        uint32_t estimate = sketch_estimate(g, fingerprint, now);
+        if (estimate < 2 || !(h = admit(g, fingerprint, estimate, now))) {
+            remember_recent(g, fingerprint, post);
+            pthread_mutex_unlock(&g->lock);
+            return 0;
+        }
+        backfill(g, h, now);
+    }
+    h->last_seen = now;
+
+    if (h->flagged) {
+        pthread_mutex_unlock(&g->lock);
+        return 1;
+    }
+
+    /* Drop posts that slid out of the window, then record this one */
+    int kept = 0;
+    for (int i = 0; i < h->post_count; i++) {
+        if (h->posts[i].posted_at + g_window_secs >= now) h->posts[kept++] = h->posts[i];
+    }
+    h->post_count = kept;
+    if (h->post_count == WAVE_MAX_POSTS) {
+        memmove(&h->posts[0], &h->posts[1], (WAVE_MAX_POSTS - 1) * sizeof(wave_post_t));
+        h->post_count--;
+    }
+    h->posts[h->post_count++] = *post;
+
+    if (distinct_authors(h) < g_min_authors) {
+        pthread_mutex_unlock(&g->lock);
+        return 0;
+    }
+
+    h->flagged = 1;
+    int count = 0;
+    for (int i = 0; i < h->post_count - 1 && earlier && count < max_earlier; i++) {
+        earlier[count++] = h->posts[i];
+    }
+    if (earlier_count) *earlier_count = count;
+    pthread_mutex_unlock(&g->lock);
+    return 1;
+}
+
+int wave_detector_observe(uint64_t guild_id, uint64_t fingerprint, const wave_post_t *post,
+                          wave_post_t *earlier, int max_earlier, int *earlier_count) {
+    if (earlier_count) *earlier_count = 0;
+    if (!fingerprint) return 0;
+
+    /* Checked under the lock cleanup takes, so no guild is freed mid-call */
+    pthread_rwlock_rdlock(&g_state_lock);
+    guild_waves_t *g = atomic_load(&g_running) ? find_guild(guild_id) : NULL;
+    int flagged = g ? observe_guild(g, fingerprint, post, earlier, max_earlier, earlier_count) : 0;
+    pthread_rwlock_unlock(&g_state_lock);
+    return flagged;
+}
@@ -0,0 +1,292 @@
+/*
+ * Himiko Discord Bot (C Edition) - Worker Pool
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "worker_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Jobs a worker runs from one lane before letting other lanes in */
+#define LANE_BATCH 8
+
+typedef struct job {
+    struct job *next;
+    worker_job_fn fn;
+    void *arg;
+} job_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    job_t *head;
+    job_t *tail;
+    int scheduled;  /* on some worker's deque, or being run */
+    int home;       /* worker whose deque it is pushed to */
+} lane_t;
+
+/* Ring of runnable lanes; the owner takes from the front, thieves from the back */
+typedef struct {
+    pthread_mutex_t lock;
+    lane_t *ring[WORKER_POOL_LANES];
+    int head;
+    int count;
+    pthread_t thread;
+    int index;
+} worker_t;
+
+static lane_t g_lanes[WORKER_POOL_LANES];
+static worker_t g_workers[WORKER_POOL_MAX_THREADS];
+static int g_worker_count = 0;
+static int g_queue_depth = 0;
+
+static atomic_int g_running = 0;
+static atomic_int g_pending = 0;
+static atomic_int g_runnable = 0;
+static atomic_int g_submitting = 0;  /* submits past the running check */
+
+/* Parks idle workers */
+static pthread_mutex_t g_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_idle_cond = PTHREAD_COND_INITIALIZER;
+static int g_idle_waiters = 0;
+static int g_stopping = 0;
+
+static inline uint32_t lane_for(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key & (WORKER_POOL_LANES - 1);
+}
+
+static void deque_push(worker_t *w, lane_t *lane) {
+    pthread_mutex_lock(&w->lock);
+    w->ring[(w->head + w->count) % WORKER_POOL_LANES] = lane;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static lane_t *deque_pop_front(worker_t *w) {
+    lane_t *lane = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->count > 0) {
+        lane = w->ring[w->head];
+        w->head = (w->head + 1) % WORKER_POOL_LANES;
+        w->count--;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return lane;
+}
+
+static lane_t *deque_steal_back(worker_t *w) {
+    lane_t *lane = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->count > 0) {
+        w->count--;
+        lane = w->ring[(w->head + w->count) % WORKER_POOL_LANES];
+    }
+    pthread_mutex_unlock(&w->lock);
+    return lane;
+}
+
+static void make_runnable(worker_t *w, lane_t *lane) {
+    deque_push(w, lane);
+    atomic_fetch_add_explicit(&g_runnable, 1, memory_order_release);
+
+    pthread_mutex_lock(&g_idle_lock);
+    if (g_idle_waiters > 0) pthread_cond_signal(&g_idle_cond);
+    pthread_mutex_unlock(&g_idle_lock);
+}
+
+static lane_t *find_work(worker_t *self) {
+    lane_t *lane = deque_pop_front(self);
+    if (!lane) {
+        for (int i = 1; i < g_worker_count && !lane; i++) {
+            lane = deque_steal_back(&g_workers[(self->index + i) % g_worker_count]);
+        }
+    }
+    if (lane) atomic_fetch_sub_explicit(&g_runnable, 1, memory_order_relaxed);
+    return lane;
+}
+
+static void run_lane(worker_t *self, lane_t *lane) {
+    for (int n = 0; n < LANE_BATCH; n++) {
+        pthread_mutex_lock(&lane->lock);
+        job_t *job = lane->head;
+        if (!job) {
+            lane->scheduled = 0;
+            pthread_mutex_unlock(&lane->lock);
+            return;
+        }
+        lane->head = job->next;
+        if (!lane->head) lane->tail = NULL;
+        pthread_mutex_unlock(&lane->lock);
+
+        job->fn(job->arg);
+        free(job);
+        atomic_fetch_sub_explicit(&g_pending, 1, memory_order_relaxed);
+    }
+
+    /* Still busy: requeue behind whatever else is runnable here */
+    pthread_mutex_lock(&lane->lock);
+    if (!lane->head) {
+        lane->scheduled = 0;
+        pthread_mutex_unlock(&lane->lock);
+        return;
+    }
+    pthread_mutex_unlock(&lane->lock);
+    make_runnable(self, lane);
+}
+
+static void *worker_main(void *arg) {
+    worker_t *self = arg;
+
+    for (;;) {
+        lane_t *lane = find_work(self);
+        if (lane) {
+            run_lane(self, lane);
+            continue;
+        }
+
+        pthread_mutex_lock(&g_idle_lock);
+        while (atomic_load_explicit(&g_runnable, memory_order_acquire) == 0 && !g_stopping) {
+            g_idle_waiters++;
+            pthread_cond_wait(&g_idle_cond, &g_idle_lock);
+            g_idle_waiters--;
+        }
+        /* Lanes still being run requeue onto their own worker, which never parks */
+        int done = g_stopping && atomic_load_explicit(&g_runnable, memory_order_acquire) == 0;
+        pthread_mutex_unlock(&g_idle_lock);
+        if (done) break;
+    }
+    return NULL;
+}
+
+int worker_pool_init(int threads, int queue_depth) {
+    if (atomic_load(&g_running)) return 0;
+    if (threads <= 0) return -1;
+    if (threads > WORKER_POOL_MAX_THREADS) threads = WORKER_POOL_MAX_THREADS;
+
+    g_queue_depth = queue_depth > 0 ? queue_depth : WORKER_POOL_DEFAULT_QUEUE_DEPTH;
+    g_stopping = 0;
+    atomic_store(&g_pending, 0);
+    atomic_store(&g_runnable, 0);
+
+    for (int i = 0; i < WORKER_POOL_LANES; i++) {
+        pthread_mutex_init(&g_lanes[i].lock, NULL);
+        g_lanes[i].head = g_lanes[i].tail = NULL;
+        g_lanes[i].scheduled = 0;
+        g_lanes[i].home = i % threads;
+    }
+
+    g_worker_count = 0;
+    for (int i = 0; i < threads; i++) {
+        worker_t *w = &g_workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->head = 0;
+        w->count = 0;
+        w->index = i;
+        g_worker_count++;
+    }
+    /* Workers index each other, so start them once every deque exists */
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&g_workers[i].thread, NULL, worker_main, &g_workers[i]) != 0) {
+            fprintf(stderr, "Worker pool: failed to start thread %d\n", i);
+            pthread_mutex_lock(&g_idle_lock);
+            g_stopping = 1;
+            pthread_cond_broadcast(&g_idle_cond);
+            pthread_mutex_unlock(&g_idle_lock);
+            for (int j = 0; j < i; j++) pthread_join(g_workers[j].thread, NULL);
+            return -1;
+        }
+    }
+
+    atomic_store(&g_running, 1);
+    printf("Worker pool: %d threads, queue depth %d\n", threads, g_queue_depth);
+    return 0;
+}
+
+void worker_pool_shutdown(void) {
+    if (!atomic_exchange(&g_running, 0)) return;
+
+    /* Later submits see g_running == 0; let the ones already inside finish queueing */
+    while (atomic_load(&g_submitting) != 0) sched_yield();
+
+    pthread_mutex_lock(&g_idle_lock);
+    g_stopping = 1;
+    pthread_cond_broadcast(&g_idle_cond);
+    pthread_mutex_unlock(&g_idle_lock);
+
+    for (int i = 0; i < g_worker_count; i++) {
+        pthread_join(g_workers[i].thread, NULL);
+    }
+    for (int i = 0; i < g_worker_count; i++) {
+        pthread_mutex_destroy(&g_workers[i].lock);
+    }
+
+    /* Workers only exit with nothing runnable, so this is normally empty */
+    for (int i = 0; i < WORKER_POOL_LANES; i++) {
+        job_t *job = g_lanes[i].head;
+        while (job) {
+            job_t *next = job->next;
+            job->fn(job->arg);
+            free(job);
+            job = next;
+        }
+        g_lanes[i].head = g_lanes[i].tail = NULL;
+        pthread_mutex_destroy(&g_lanes[i].lock);
+    }
+    atomic_store(&g_pending, 0);
+    g_worker_count = 0;
+}
+
+int worker_pool_submit(uint64_t key, worker_job_fn fn, void *arg) {
+    atomic_fetch_add(&g_submitting, 1);
+    if (!atomic_load(&g_running)) {
+        atomic_fetch_sub(&g_submitting, 1);
+        return -1;
+    }
+
+    if (atomic_fetch_add_explicit(&g_pending, 1, memory_order_relaxed) >= g_queue_depth) {
+        atomic_fetch_sub_explicit(&g_pending, 1, memory_order_relaxed);
+        atomic_fetch_sub(&g_submitting, 1);
+        return -1;
+    }
+
+    job_t *job = malloc(sizeof(job_t));
+    if (!job) {
+        atomic_fetch_sub_explicit(&g_pending, 1, memory_order_relaxed);
+        atomic_fetch_sub(&g_submitting, 1);
+        return -1;
+    }
+    job->next = NULL;
+    job->fn = fn;
+    job->arg = arg;
+
+    lane_t *lane = &g_lanes[lane_for(key)];
+    pthread_mutex_lock(&lane->lock);
+    if (lane->tail) {
+        lane->tail->next = job;
+    } else {
+        lane->head = job;
+    }
+    lane->tail = job;
+    int wake = !lane->scheduled;
+    lane->scheduled = 1;
+    pthread_mutex_unlock(&lane->lock);
+
+    if (wake) make_runnable(&g_workers[lane->home], lane);
+    atomic_fetch_sub(&g_submitting, 1);
+    return 0;
+}
+
+int worker_pool_pending(void) {
+    return atomic_load_explicit(&g_pending, memory_order_relaxed);
+}
+
+int worker_pool_running(void) {
+    return atomic_load_explicit(&g_running, memory_order_acquire);
+}
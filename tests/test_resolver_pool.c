@@ -0,0 +1,79 @@
+/*
+ * Himiko Discord Bot (C Edition) - Resolver Pool Test
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Drives the pool against scripts/ytdlp_worker_stub.py (path given as
+ * argv[1]): a normal reply, a worker that crashes mid-request and is
+ * started again, and a worker that hangs past the deadline and is killed.
+ */
+
+#include "resolver_pool.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TIMEOUT_SECS 1
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s (%s:%d)\n", msg, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <path to ytdlp_worker_stub.py>\n", argv[0]);
+        return 2;
+    }
+
+    resolver_pool_stats_t stats;
+    music_cache_meta_t meta;
+    char url[512];
+
+    /* One worker, so every request below lands on the same process slot */
+    CHECK(resolver_pool_init(argv[1], 1, TIMEOUT_SECS) == 0, "init");
+
+    memset(&meta, 0, sizeof(meta));
+    CHECK(resolver_pool_resolve("ytsearch:hello", &meta) == 0, "resolve succeeds");
+    CHECK(strcmp(meta.title, "Stub: hello") == 0, "title comes from the worker's reply");
+    CHECK(meta.duration > 0, "duration is parsed");
+    CHECK(strncmp(meta.webpage_url, "https://stub.invalid/watch?v=", 29) == 0, "webpage_url is parsed");
+
+    CHECK(resolver_pool_stream_url("https://example.invalid/a.opus", url, sizeof(url)) == 0, "stream succeeds");
+    CHECK(strcmp(url, "https://example.invalid/a.opus") == 0, "stream URL comes from the worker's reply");
+
+    CHECK(resolver_pool_resolve("stub:fail", &meta) != 0, "ok:false fails the request");
+    resolver_pool_get_stats(&stats);
+    CHECK(stats.failures == 1, "ok:false counts as a failure");
+    CHECK(stats.restarts == 0, "ok:false keeps the worker");
+
+    /* Crash: the request fails and the next one gets a fresh worker */
+    CHECK(resolver_pool_resolve("stub:crash", &meta) != 0, "a crashed worker fails its request");
+    memset(&meta, 0, sizeof(meta));
+    CHECK(resolver_pool_resolve("ytsearch:after crash", &meta) == 0, "the next request succeeds");
+    CHECK(strcmp(meta.title, "Stub: after crash") == 0, "the restarted worker answers");
+    resolver_pool_get_stats(&stats);
+    CHECK(stats.restarts == 1, "the crashed worker was restarted once");
+    CHECK(stats.workers_alive == 1, "one worker is alive after the restart");
+
+    /* Hang: the deadline kills the worker and the next request restarts it */
+    CHECK(resolver_pool_resolve("stub:hang", &meta) != 0, "a hung worker fails its request");
+    resolver_pool_get_stats(&stats);
+    CHECK(stats.timeouts == 1, "the hang counts as a timeout");
+    memset(&meta, 0, sizeof(meta));
+    CHECK(resolver_pool_resolve("ytsearch:after hang", &meta) == 0, "the request after a timeout succeeds");
+    CHECK(strcmp(meta.title, "Stub: after hang") == 0, "a fresh worker answers after the timeout");
+    resolver_pool_get_stats(&stats);
+    CHECK(stats.restarts == 2, "the killed worker was restarted");
+
+    resolver_pool_shutdown();
+    resolver_pool_get_stats(&stats);
+    CHECK(stats.workers_alive == 0, "shutdown stops the worker");
+
+    if (failures) return 1;
+    printf("test_resolver_pool: ok\n");
+    return 0;
+}
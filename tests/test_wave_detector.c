@@ -0,0 +1,76 @@
+/*
+ * Himiko Discord Bot (C Edition) - Spam Wave Detector Test
+ * Copyright (C) 2025 Himiko Contributors
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * The same content from exactly min_authors distinct accounts trips the
+ * detector on the last of them, and one fewer does not. The first
+ * sighting must count even though it is not in the top-K yet.
+ */
+
+#include "wave_detector.h"
+#include <stdio.h>
+
+#define MIN_AUTHORS 5
+#define WINDOW_SECS 20
+#define SPAM "Free nitro for everyone, claim it at example dot com now"
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s (%s:%d)\n", msg, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/* Post SPAM once from each of authors accounts; returns the call that flagged, or 0 */
+static int post_wave(uint64_t guild_id, int authors, time_t start, int *earlier_count) {
+    uint64_t fp = wave_fingerprint(SPAM);
+    wave_post_t earlier[WAVE_MAX_POSTS];
+
+    for (int i = 1; i <= authors; i++) {
+        wave_post_t post = {
+            .channel_id = 100,
+            .message_id = guild_id * 1000 + (uint64_t)i,
+            .author_id = 5000 + (uint64_t)i,
+            .posted_at = start + i,
+        };
+        if (wave_detector_observe(guild_id, fp, &post, earlier, WAVE_MAX_POSTS, earlier_count)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    int earlier_count = 0;
+
+    CHECK(wave_detector_init(MIN_AUTHORS, WINDOW_SECS) == 0, "init");
+    CHECK(wave_fingerprint(SPAM) != 0, "spam is long enough to fingerprint");
+    CHECK(wave_fingerprint("gm") == 0, "short chatter is ignored");
+
+    CHECK(post_wave(1, MIN_AUTHORS - 1, 1000, &earlier_count) == 0,
+          "one author short of the threshold does not trip");
+
+    CHECK(post_wave(2, MIN_AUTHORS, 1000, &earlier_count) == MIN_AUTHORS,
+          "exactly min_authors authors trip on the last post");
+    CHECK(earlier_count == MIN_AUTHORS - 1, "every earlier post, first sighting included, is returned");
+
+    /* Same author repeating is not a wave */
+    uint64_t fp = wave_fingerprint(SPAM);
+    int tripped = 0;
+    for (int i = 0; i < MIN_AUTHORS * 2; i++) {
+        wave_post_t post = { .channel_id = 100, .message_id = 9000 + (uint64_t)i,
+                             .author_id = 42, .posted_at = 1000 + i };
+        tripped |= wave_detector_observe(3, fp, &post, NULL, 0, NULL);
+    }
+    CHECK(!tripped, "one author repeating does not trip");
+
+    wave_detector_cleanup();
+    CHECK(post_wave(4, MIN_AUTHORS, 1000, &earlier_count) == 0, "nothing is observed after cleanup");
+
+    if (failures) return 1;
+    printf("test_wave_detector: ok\n");
+    return 0;
+}